@@ -0,0 +1,152 @@
+/*
+ * Bump allocator for scratch memory that lives for one collection cycle.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "arena.h"
+
+#define ARENA_ALIGN             16
+#define ARENA_MIN_CHUNK         4096
+/* a chunk this many times larger than the last cycle is given back */
+#define ARENA_SHRINK_RATIO      4
+#define ARENA_ROUND(size)       (((size) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+struct ARENA_CHUNK
+{
+    ARENA_CHUNK *next;
+    size_t size;                /* bytes of data */
+    size_t used;
+};
+
+/* the data follows the header, aligned */
+#define ARENA_HEADER            ARENA_ROUND(sizeof(ARENA_CHUNK))
+
+static ARENA_CHUNK *arena_chunk_new(ARENA *arena, size_t size)
+{
+    ARENA_CHUNK *chunk = NULL;
+    size_t chunk_size = ARENA_MIN_CHUNK;
+
+    if (NULL != arena->chunks && chunk_size < arena->chunks->size * 2)
+    {
+        chunk_size = arena->chunks->size * 2;
+    }
+    if (chunk_size < arena->hint)
+    {
+        chunk_size = ARENA_ROUND(arena->hint);
+    }
+    if (chunk_size < size)
+    {
+        chunk_size = size;
+    }
+
+    chunk = (ARENA_CHUNK *)malloc(ARENA_HEADER + chunk_size);
+    if (NULL == chunk)
+    {
+        return NULL;
+    }
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->hint = 0;
+    return chunk;
+}
+
+/*****************************************************************************
+Function   : arena_alloc
+Description: carve zeroed memory out of the current chunk, adding a chunk
+             when it is full
+Input      : arena -- the arena
+             size  -- bytes wanted
+Output     : None
+Return     : the memory, or NULL
+*****************************************************************************/
+void *arena_alloc(ARENA *arena, size_t size)
+{
+    ARENA_CHUNK *chunk = arena->chunks;
+    char *ptr = NULL;
+
+    size = ARENA_ROUND(size);
+    if (0 == size)
+    {
+        size = ARENA_ALIGN;
+    }
+    if (NULL == chunk || chunk->size - chunk->used < size)
+    {
+        chunk = arena_chunk_new(arena, size);
+        if (NULL == chunk)
+        {
+            return NULL;
+        }
+    }
+
+    ptr = (char *)chunk + ARENA_HEADER + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    (void)memset_s(ptr, size, 0, size);
+    return ptr;
+}
+
+/*****************************************************************************
+Function   : arena_reset
+Description: forget everything handed out; a cycle that needed several
+             chunks, or far less than the one chunk, is resized on the next
+             allocation to what it used
+Input      : arena -- the arena
+Output     : None
+Return     : None
+*****************************************************************************/
+void arena_reset(ARENA *arena)
+{
+    ARENA_CHUNK *chunk = arena->chunks;
+    ARENA_CHUNK *next = NULL;
+
+    if (NULL != chunk && NULL == chunk->next
+        && (chunk->size <= ARENA_MIN_CHUNK || chunk->size <= arena->used * ARENA_SHRINK_RATIO))
+    {
+        chunk->used = 0;
+        arena->used = 0;
+        return;
+    }
+
+    while (NULL != chunk)
+    {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->hint = arena->used;
+    arena->used = 0;
+}
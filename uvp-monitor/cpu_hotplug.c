@@ -39,7 +39,13 @@
 #include <sys/wait.h>
 #include <limits.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/utsname.h>
 #include "securec.h"
+#include "uevent.h"
+#include "footprint.h"
 
 /* ִнű ʱʱ */
 #define POPEN_TIMEOUT 	30
@@ -62,6 +68,34 @@
 /*CPU Ȳֵ֧cpu */
 #define CPU_NR_MAX 64
 
+#define CPU_SYSFS_DIR       "/sys/devices/system/cpu"
+#define CPU_PATH_LEN        128
+#define CPU_LINE_LEN        256
+/* ȴcpu onlineʱ()ÿȴһcpu ueventʱ() */
+#define CPU_ONLINE_TIMEOUT  300
+#define CPU_WAIT_SLICE_MS   1000
+
+#define CPU_STATE_ABSENT    0
+#define CPU_STATE_ONLINE    1
+#define CPU_STATE_OFFLINE   2
+
+typedef struct
+{
+    int cpu;
+    int ret;
+    int err;
+} CPU_ONLINE_JOB;
+
+/* ÿbitʾһcpuCPU_NR_MAXcpu÷64λ */
+typedef unsigned long long CPU_MASK;
+#define CPU_BIT(cpu)        (1ULL << (cpu))
+
+typedef struct
+{
+    int      cpu_nr;
+    CPU_MASK mask;
+} CPU_AVAIL;
+
 /*******************************************************************************
   Function        : uvpPopen
   Description     : ͨϵͳִshellűؽ
@@ -187,16 +221,44 @@ int uvpPopen(const char* pszCmd, char* pszBuffer, int size)
 }
 
 /*****************************************************************************
- Function   : uvp_sleep
- Description: sleep 1 seconds
- Input      : None
- Output     : None
- Return     : None
+ Function   : cpu_read_kconfig
+ Description: read one option of the running kernel's /boot/config-<release>
+ Input      : name  -- option name, e.g. "CONFIG_NR_CPUS"
+              size  -- size of value
+ Output     : value -- the option value without the newline
+ Return     : XEN_SUCC or XEN_FAIL
  *****************************************************************************/
-void uvp_sleep()
+static int cpu_read_kconfig(const char *name, char *value, int size)
 {
-    (void)sleep(1);
-    return;
+    struct utsname uts;
+    char path[CPU_PATH_LEN] = {0};
+    char line[CPU_LINE_LEN] = {0};
+    size_t len = strlen(name);
+    FILE *fp = NULL;
+    int ret = XEN_FAIL;
+
+    if (0 != uname(&uts))
+    {
+        return XEN_FAIL;
+    }
+    (void)snprintf_s(path, sizeof(path), sizeof(path), "/boot/config-%s", uts.release);
+    fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        return XEN_FAIL;
+    }
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        if (0 == strncmp(line, name, len) && '=' == line[len])
+        {
+            line[strcspn(line, "\n")] = '\0';
+            (void)strncpy_s(value, size, line + len + 1, size - 1);
+            ret = XEN_SUCC;
+            break;
+        }
+    }
+    (void)fclose(fp);
+    return ret;
 }
 
 /*****************************************************************************
@@ -208,19 +270,9 @@ void uvp_sleep()
  *****************************************************************************/
 int IsSupportCpuHotplug(void)
 {
-    int ret = 0;
-    char *pszHotplugFlagScript = "uname_str=`uname -r`;"
-         "cpu_hotplug_conf=`grep 'CONFIG_HOTPLUG_CPU' /boot/config-$uname_str 2>/dev/null | awk -F= '{print $2}'`;"
-         "printf $cpu_hotplug_conf 2>/dev/null ;";
-    char pszHotplugFlag[1024] = {0};
-
-    ret = uvpPopen(pszHotplugFlagScript, pszHotplugFlag, 1024);
-    if (0 != ret)
-    {
-        ERR_LOG("Failed to call uvpPopen, ret=%d.", ret);
-        return ret;
-    }
+    char pszHotplugFlag[CPU_LINE_LEN] = {0};
 
+    (void)cpu_read_kconfig("CONFIG_HOTPLUG_CPU", pszHotplugFlag, sizeof(pszHotplugFlag));
     if (0 == strcmp("y", pszHotplugFlag))
     {
         return XEN_SUCC;
@@ -241,20 +293,10 @@ int IsSupportCpuHotplug(void)
  *****************************************************************************/
 int GetSupportMaxnumCpu(void)
 {
-    int ret = 0;
-    int cpu_nr = 0;
-    char *pszSysCpuNumScript = "uname_str=`uname -r`;"
-         "syscpu_enable_num=`grep 'CONFIG_NR_CPUS' /boot/config-$uname_str 2>/dev/null | awk -F= '{print($2)}'`;"
-         "printf $syscpu_enable_num 2>/dev/null ;";
-    char pszSysCpuNum[1024] = {0};
-
-    ret = uvpPopen(pszSysCpuNumScript, pszSysCpuNum, 1024);
-    if (0 != ret)
-    {
-        ERR_LOG("Failed to call uvpPopen, ret=%d.", ret);
-        return ret;
-    }
+    unsigned long cpu_nr = 0;
+    char pszSysCpuNum[CPU_LINE_LEN] = {0};
 
+    (void)cpu_read_kconfig("CONFIG_NR_CPUS", pszSysCpuNum, sizeof(pszSysCpuNum));
     cpu_nr = strtoul(pszSysCpuNum, NULL, 10);
 
     /*lint -e648 */
@@ -265,7 +307,7 @@ int GetSupportMaxnumCpu(void)
     /*lint +e648 */
     else if (cpu_nr <= CPU_NR_MAX)
     {
-        return cpu_nr;
+        return (int)cpu_nr;
     }
     else
     {
@@ -307,118 +349,320 @@ void cpuhotplug_regwatch(void * phandle)
 }
 
 /*****************************************************************************
- Function   : do_cpu_online
- Description: update cpu to online and wrtie state into xenstore
- Input      : handle -- xenbus file handle
+ Function   : cpu_parse_list
+ Description: parse a kernel cpu list such as "0-3,5,7-9"
+ Input      : list -- the cpu list
  Output     : None
- Return     : XEN_SUCC or XEN_ERROR
+ Return     : the cpus of the list below CPU_NR_MAX
  *****************************************************************************/
-int DoCpuHotplug(void * phandle)
+static CPU_MASK cpu_parse_list(const char *list)
 {
-    char pszBuff[1024] = {0};
-    char pszCommand[1024] = {0};
-    int  i = 0;
-    int  cpu_enable_num = 0;
-    int  cpu_nr = 0;
-    char *cpu_online = NULL;
-    int  idelay = 0;
-    int  ret = -1;
-    int  rc = -1;
+    CPU_MASK mask = 0;
+    char *end = NULL;
+    long first, last;
 
-    cpu_nr = GetSupportMaxnumCpu();
-    if (cpu_nr <= 0)
+    while ('\0' != *list && '\n' != *list)
     {
-        INFO_LOG("This OS has unexpectable cpus: %d.", cpu_nr);
-        goto out;
+        first = strtol(list, &end, 10);
+        if (end == list)
+        {
+            break;
+        }
+        last = first;
+        if ('-' == *end)
+        {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list)
+            {
+                break;
+            }
+        }
+        for (; first <= last && first < CPU_NR_MAX; first++)
+        {
+            if (first >= 0)
+            {
+                mask |= CPU_BIT(first);
+            }
+        }
+        list = (',' == *end) ? end + 1 : end;
     }
+    return mask;
+}
 
-    INFO_LOG("This OS has cpu hotplug and less than %d.", cpu_nr);
+/*****************************************************************************
+ Function   : cpu_online_mask
+ Description: the online cpus of /sys/devices/system/cpu/online
+ Input      : None
+ Output     : None
+ Return     : the mask, 0 when the file cannot be read and every cpu must be
+              checked on its own
+ *****************************************************************************/
+static CPU_MASK cpu_online_mask(void)
+{
+    char list[CPU_LINE_LEN] = {0};
+    ssize_t len;
+    int fd = -1;
 
-    /* obtain cpu numbers */
-    for(i = 0; i <= cpu_nr - 1; i++)
+    fd = open(CPU_SYSFS_DIR "/online", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
     {
-        (void)snprintf_s(pszCommand, 1024, 1024, "cpu/%d/availability", i);
-        cpu_online = read_from_xenstore(phandle, pszCommand);
-        if((NULL != cpu_online) && (0 == strcmp(cpu_online, "online")))
-        {
-            cpu_enable_num ++;
-        }
-        free(cpu_online);
-        cpu_online = NULL;
+        return 0;
+    }
+    len = read(fd, list, sizeof(list) - 1);
+    (void)close(fd);
+    if (len <= 0)
+    {
+        return 0;
     }
+    list[len] = '\0';
+    return cpu_parse_list(list);
+}
 
-    i = 1;
+/* read_children_from_xenstore callback: mark cpu/<N> whose availability is online */
+static void cpu_availability(const char *child, const char *value, void *arg)
+{
+    CPU_AVAIL *avail = (CPU_AVAIL *)arg;
+    char *end = NULL;
+    long cpu;
 
-    /* loop for upgrade cpu online */
-    while (i < cpu_enable_num )
+    cpu = strtol(child, &end, 10);
+    if (end == child || '\0' != *end || cpu < 0 || cpu >= avail->cpu_nr)
     {
-        if (idelay >= 300)
-        {
-            i ++;
-            idelay = 0;
-            continue;
-        }
+        return;
+    }
+    if (NULL != value && 0 == strcmp(value, "online"))
+    {
+        avail->mask |= CPU_BIT(cpu);
+    }
+}
+
+/*****************************************************************************
+ Function   : cpu_sysfs_state
+ Description: state of a vcpu as sysfs shows it
+ Input      : cpu -- cpu number
+ Output     : None
+ Return     : CPU_STATE_ABSENT  -- the kernel has not added the cpu yet
+              CPU_STATE_ONLINE  -- online, or not hot-pluggable at all
+              CPU_STATE_OFFLINE -- present and offline
+ *****************************************************************************/
+static int cpu_sysfs_state(int cpu)
+{
+    char path[CPU_PATH_LEN] = {0};
+    char state = '\0';
+    int fd = -1;
 
-        (void)memset_s(pszCommand, 1024, 0, 1024);
-        (void)memset_s(pszBuff, 1024, 0, 1024);
-        (void)snprintf_s(pszCommand, 1024, 1024,
-            "if [ -d \"/sys/devices/system/cpu/cpu%d\" ]; then \n  printf \"online\" \nfi", i);
+    (void)snprintf_s(path, sizeof(path), sizeof(path), "%s/cpu%d", CPU_SYSFS_DIR, cpu);
+    if (0 != access(path, F_OK))
+    {
+        return CPU_STATE_ABSENT;
+    }
+    (void)snprintf_s(path, sizeof(path), sizeof(path), "%s/cpu%d/online", CPU_SYSFS_DIR, cpu);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return CPU_STATE_ONLINE;
+    }
+    if (1 != read(fd, &state, 1))
+    {
+        state = '\0';
+    }
+    (void)close(fd);
+    return '1' == state ? CPU_STATE_ONLINE : CPU_STATE_OFFLINE;
+}
 
-        ret = uvpPopen(pszCommand, pszBuff, 1024);
+/*****************************************************************************
+ Function   : cpu_online_thread
+ Description: write 1 to the online file of one vcpu
+ Input      : arg -- the CPU_ONLINE_JOB of the vcpu
+ Output     : job->ret
+ Return     : NULL
+ *****************************************************************************/
+static void *cpu_online_thread(void *arg)
+{
+    CPU_ONLINE_JOB *job = (CPU_ONLINE_JOB *)arg;
+    char path[CPU_PATH_LEN] = {0};
+    int fd = -1;
+
+    job->ret = XEN_FAIL;
+    (void)snprintf_s(path, sizeof(path), sizeof(path), "%s/cpu%d/online", CPU_SYSFS_DIR, job->cpu);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        job->err = errno;
+        return NULL;
+    }
+    if (1 == write(fd, "1", 1))
+    {
+        job->ret = XEN_SUCC;
+    }
+    else
+    {
+        job->err = errno;
+    }
+    (void)close(fd);
+    return NULL;
+}
 
-        if (0 != ret)
+/*****************************************************************************
+ Function   : cpu_online_batch
+ Description: online the offline vcpus of one pass at the same time, one
+              thread each; a vcpu whose thread cannot be created is onlined
+              by the caller
+ Input      : jobs  -- the vcpus
+              count -- number of jobs
+ Output     : jobs[].ret
+ Return     : None
+ *****************************************************************************/
+static void cpu_online_batch(CPU_ONLINE_JOB *jobs, int count)
+{
+    pthread_t tids[CPU_NR_MAX];
+    int started[CPU_NR_MAX] = {0};
+    pthread_attr_t attr;
+    int i;
+
+    (void)pthread_attr_init(&attr);
+    footprint_thread_attr(&attr);
+    for (i = 0; i < count; i++)
+    {
+        started[i] = (1 < count && 0 == pthread_create(&tids[i], &attr, cpu_online_thread, &jobs[i]));
+        if (!started[i])
         {
-            ERR_LOG("Failed to call uvpPopen, ret=%d.", ret);
-            idelay++;
-            uvp_sleep();
-            continue;
+            (void)cpu_online_thread(&jobs[i]);
         }
-
-        if (0 != strcmp("online", pszBuff))
+    }
+    (void)pthread_attr_destroy(&attr);
+    for (i = 0; i < count; i++)
+    {
+        if (started[i])
         {
-            idelay++;
-            uvp_sleep();
-            continue;
+            (void)pthread_join(tids[i], NULL);
         }
+    }
+}
 
-        /*  жcpuǰǷonline */
-        (void)memset_s(pszCommand, 1024, 0, 1024);
-        (void)memset_s(pszBuff, 1024, 0, 1024);
-        (void)snprintf_s(pszCommand, 1024, 1024, "cat /sys/devices/system/cpu/cpu%d/online", i);
-        ret = uvpPopen(pszCommand, pszBuff, 1024);
+static long long cpu_now_ms(void)
+{
+    struct timespec ts;
 
-        if (0 != ret)
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*****************************************************************************
+ Function   : do_cpu_online
+ Description: online the cpus of pending. Each pass drops the cpus the
+              online mask already has, onlines the present offline ones
+              together, and for the ones the kernel has not added yet, and
+              for failed writes, waits for a cpu uevent and scans again,
+              until CPU_ONLINE_TIMEOUT seconds have passed
+ Input      : pending -- available cpus dom0 asked to online
+ Output     : None
+ Return     : None
+ *****************************************************************************/
+static void do_cpu_online(CPU_MASK pending)
+{
+    CPU_ONLINE_JOB jobs[CPU_NR_MAX];
+    int left, count, i;
+    unsigned int generation = 0;
+    long long deadline;
+    long long remain;
+
+    /* join the uevent group before the first scan so no add is missed */
+    (void)uevent_refresh();
+    generation = uevent_generation(UEVENT_CPU);
+    deadline = cpu_now_ms() + CPU_ONLINE_TIMEOUT * 1000LL;
+
+    for (;;)
+    {
+        pending &= ~cpu_online_mask();
+        left = 0;
+        count = 0;
+        for (i = 1; i < CPU_NR_MAX; i++)
         {
-            ERR_LOG("Failed to call uvpPopen, ret=%d.", ret);
-            idelay++;
-            uvp_sleep();
-            continue;
+            if (0 == (pending & CPU_BIT(i)))
+            {
+                continue;
+            }
+            switch (cpu_sysfs_state(i))
+            {
+                case CPU_STATE_ONLINE:
+                    pending &= ~CPU_BIT(i);
+                    break;
+                case CPU_STATE_OFFLINE:
+                    jobs[count].cpu = i;
+                    jobs[count].err = 0;
+                    count++;
+                    break;
+                default:
+                    left++;
+                    break;
+            }
         }
 
-        if ('1' == pszBuff[0])
+        cpu_online_batch(jobs, count);
+        for (i = 0; i < count; i++)
         {
-            INFO_LOG("Cpu%d is always online.", i);
-            i++;
-            idelay = 0;
-            continue;
+            if (XEN_SUCC == jobs[i].ret)
+            {
+                INFO_LOG("Cpu%d is online.", jobs[i].cpu);
+                pending &= ~CPU_BIT(jobs[i].cpu);
+            }
+            else
+            {
+                ERR_LOG("Failed to online cpu%d, errno=%d.", jobs[i].cpu, jobs[i].err);
+                left++;
+            }
         }
-        (void)memset_s(pszCommand, 1024, 0, 1024);
-        (void)memset_s(pszBuff, 1024, 0, 1024);
-        (void)snprintf_s(pszCommand, 1024, 1024, "echo 1 > /sys/devices/system/cpu/cpu%d/online", i);
 
-        ret = uvpPopen(pszCommand, pszBuff, 1024);
-        if (0 != ret)
+        if (0 == left)
         {
-            ERR_LOG("Failed to call uvpPopen, ret=%d.", ret);
-            idelay++;
-            uvp_sleep();
-            continue;
+            return;
         }
+        remain = deadline - cpu_now_ms();
+        if (remain <= 0)
+        {
+            ERR_LOG("%d cpus are still not online after %d seconds.", left, CPU_ONLINE_TIMEOUT);
+            return;
+        }
+        (void)uevent_wait(UEVENT_CPU, generation, remain < CPU_WAIT_SLICE_MS ? (int)remain : CPU_WAIT_SLICE_MS);
+        generation = uevent_generation(UEVENT_CPU);
+    }
+}
 
-        idelay = 0;
-        i++;
+/*****************************************************************************
+ Function   : DoCpuHotplug
+ Description: update cpu to online and wrtie state into xenstore
+ Input      : handle -- xenbus file handle
+ Output     : None
+ Return     : XEN_SUCC or XEN_ERROR
+ *****************************************************************************/
+int DoCpuHotplug(void * phandle)
+{
+    CPU_AVAIL avail = {0, 0};
+    CPU_MASK  online = 0;
+    int  rc = -1;
+
+    avail.cpu_nr = GetSupportMaxnumCpu();
+    if (avail.cpu_nr <= 0)
+    {
+        INFO_LOG("This OS has unexpectable cpus: %d.", avail.cpu_nr);
+        goto out;
     }
 
+    INFO_LOG("This OS has cpu hotplug and less than %d.", avail.cpu_nr);
+
+    /* һгcpuĿ¼ͬһжȡcpuavailability */
+    if (read_children_from_xenstore(phandle, "cpu", "availability", cpu_availability, &avail) < 0)
+    {
+        goto out;
+    }
+
+    online = cpu_online_mask();
+    INFO_LOG("Available cpus 0x%llx, online cpus 0x%llx.", avail.mask, online);
+    /* cpu0Ȳ */
+    do_cpu_online(avail.mask & ~online & ~CPU_BIT(0));
+
     rc = XEN_SUCC;
 
 out:
@@ -426,4 +670,3 @@ out:
     (void)write_to_xenstore(phandle, CPU_HOTPLUG_SIGNAL, "0");
     return rc;
 }
-
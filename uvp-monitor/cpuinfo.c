@@ -31,17 +31,23 @@
 #include "libxenctl.h"
 #include "public_common.h"
 #include <ctype.h>
+#include <limits.h>
 #include "securec.h"
+#include "procparse.h"
+#include "perfbin.h"
 
 #define NCPUSTATES  9
-#define MAXCPUNUM   64
+/* cpus per xenstore key: control/uvp/cpu, then control/uvp/cpu-ext-N */
+#define CPU_NUM_PER_KEY 64
+#define CPU_ROW_LEN     1024
+#define CPU_DATA_EXT_PATH "control/uvp/cpu-ext"
+#define CPU_POSSIBLE_PATH "/sys/devices/system/cpu/possible"
+#define CPU_XS_PATH_LEN 64
 #define BUFFSIZE    2048
-#define TIMEBUFSIZE  128
 #define IDLE_USAGE   3
-#define CPU_STATE_FILE          "/proc/stat"
-#define CPU_INFO_SIZE		10   /*record the information of CPU in form of "%d:%.2f;",
-since there max number of cpu is 64, the longest size of the information for each CPU is 8bytes*/
 #define CPU_USAGE_SIZE 32
+/* below this many ticks since the last sample the delta is noise and the previous usage is kept (100 ms at USER_HZ 100) */
+#define CPU_MIN_SAMPLE_TICKS 10
 typedef unsigned long long TIC_t;
 typedef          long long SIC_t;
 #define TRIMz(x)  ((tz = (SIC_t)(x)) < 0 ? 0 : tz)
@@ -60,101 +66,148 @@ struct cpu_data
     int     cpu_usage[NCPUSTATES];
 };
 
+/*
+ * Per-cpu counters of the previous sample, indexed by cpu number, so that
+ * each sample measures usage over the whole interval since the last one
+ * instead of sleeping between two reads; the first sample averages since
+ * boot. Sized once to the possible cpus, which hotplug does not change.
+ * Like the /proc snapshots of procsrc.c it is only touched by the single
+ * collector thread, so it is not locked.
+ */
+static struct cpu_data *g_CpuRecord = NULL;
+static float *g_fCpuUsage = NULL;
+static int g_CpuPossibleNum = 0;
+
+void write_xs_cpu(struct xs_handle *handle, int is_weak, char xs_value[][CPU_ROW_LEN], int max_rows, int row_num);
+
 
 /*****************************************************************************
-Function   : skip_token
-Description: skip the string, delete the "cpu" head
-Input       : pointer to character
+Function   : cpu_line_number
+Description: get the cpu number of a "cpuN" line of /proc/stat
+Input       : line -- the parsed line
 Output     : None
-Return     : pointer to character
+Return     : cpu number, -1 if the key is not "cpuN"
 *****************************************************************************/
-char *cpu_skip_token(const char *pString)
+static int cpu_line_number(const PROC_LINE *line)
 {
-    /*coverity warning *pString Ϊ'\0' ж*/
-    while (*pString && isspace((unsigned char)(*pString)))
+    PROC_LINE key;
+    unsigned long long cpu;
+
+    if (line->key_len <= 3 || 0 != strncmp(line->key, "cpu", 3))
     {
-        pString++;
+        return -1;
     }
-    while (*pString && !isspace((unsigned char)(*pString)))
+    key.key = line->key;
+    key.key_len = line->key_len;
+    key.pos = line->key + 3;
+    key.end = line->key + line->key_len;
+    cpu = proc_line_ull(&key);
+    if (key.pos != key.end || cpu > INT_MAX)
     {
-        pString++;
+        return -1;
     }
-    return (char *)pString;
+    return (int)cpu;
 }
 
 
 /*****************************************************************************
-Function   : OpenStatFile
-Description: Open the /proc/stat file
+Function   : GetCPUPossibleNum
+Description: get the number of possible cpus, one more than the highest cpu
+             number in /sys/devices/system/cpu/possible ("0-127", "0,2-5")
 Input       : None
 Output     : None
-Return     : success : return pointer to file,  fail : return NULL
+Return     : Count, at least 1
 *****************************************************************************/
-FILE *OpenStatFile()
+int GetCPUPossibleNum()
 {
-    FILE *pstat = NULL;
+    FILE    *file = NULL;
+    char    buf[BUFFSIZE] = {0};
+    char    *pos = NULL;
+    long    cpu = 0;
+    long    maxcpu = -1;
 
-    if(NULL == (pstat = fopen(CPU_STATE_FILE, "r")))
+    if (0 != g_CpuPossibleNum)
     {
-        //   LogPrint("open file /proc/stat error\n");
-        return NULL;
+        return g_CpuPossibleNum;
     }
-    else
+
+    file = fopen(CPU_POSSIBLE_PATH, "r");
+    if (NULL != file)
     {
-        return pstat;
+        if (NULL != fgets(buf, sizeof(buf), file))
+        {
+            pos = buf;
+            while (isdigit((unsigned char)*pos))
+            {
+                cpu = strtol(pos, &pos, 10);
+                if ('-' == *pos)
+                {
+                    cpu = strtol(pos + 1, &pos, 10);
+                }
+                if (cpu > maxcpu)
+                {
+                    maxcpu = cpu;
+                }
+                if (',' != *pos)
+                {
+                    break;
+                }
+                pos++;
+            }
+        }
+        (void)fclose(file);
     }
-}
 
+    if (maxcpu < 0)
+    {
+        ERR_LOG("Read %s failed, errno=%d.", CPU_POSSIBLE_PATH, errno);
+        maxcpu = sysconf(_SC_NPROCESSORS_CONF) - 1;
+        if (maxcpu < 0)
+        {
+            maxcpu = 0;
+        }
+    }
+    g_CpuPossibleNum = (int)maxcpu + 1;
+    return g_CpuPossibleNum;
+}
 
 /*****************************************************************************
 Function   : GetCPUCount
-Description: get the CPU Count
+Description: get the CPU Count, takes a fresh snapshot of /proc/stat
 Input       : None
 Output     : None
-Return     : Count [1~32]
+Return     : Count [1~possible cpus]
 *****************************************************************************/
 int GetCPUCount()
 {
-    char    buf[BUFFSIZE];
-    int     check_char;
     int     count = 0;
-    FILE    *pFile = NULL;
+    PROC_VIEW view;
+    PROC_LINE line;
 
-    if(NULL == (pFile = OpenStatFile()))
+    if(SUCC != proc_source_read(PROC_STAT, PROC_SOURCE_REFRESH, &view))
     {
         return 0;
     }
-    while(EOF != (check_char = fgetc(pFile)))
+    while(proc_view_next_line(&view, &line))
     {
-        if (('c' == check_char) && ('p' == fgetc(pFile)))
-        {
-            (void)fseek(pFile, -2, SEEK_CUR);
-            if(NULL != fgets(buf, BUFFSIZE, pFile))
-            {
-                count++;
-            }
-        }
-        else
+        if (line.key_len < 2 || 0 != strncmp(line.key, "cp", 2))
         {
             break;
         }
+        count++;
     }
 
     if (1 >= count)
     {
         count = 1;
     }
-    else if (MAXCPUNUM < count)
+    else if (GetCPUPossibleNum() < count - 1)
     {
-        count = MAXCPUNUM + 1;
+        count = GetCPUPossibleNum() + 1;
     }
     count--;
 
-    fclose(pFile);
-    //lint -save -e438
-    pFile = NULL;
     return count;
-    //lint -restore
 }
 
 
@@ -211,120 +264,145 @@ long percentages(int StateCount, struct cpu_data *pCpuTmp)
     return(total_change);
 }
 
+/*****************************************************************************
+Function   : cpu_ticks_elapsed
+Description: ticks of all states since the saved sample of one cpu
+Input       : cpu states count, pointer to cpu_usage struct
+Output     : None
+Return     : number of ticks
+*****************************************************************************/
+static long cpu_ticks_elapsed(int StateCount, const struct cpu_data *pCpuTmp)
+{
+    int     i = 0;
+    long    total_change = 0;
+
+    for (i = 0; i < StateCount; i++)
+    {
+        total_change += labs(pCpuTmp->cp_new[i] - pCpuTmp->cp_old[i]);
+    }
+    return total_change;
+}
+
 
 /*****************************************************************************
 Function   : pGetCPUUsage
-Description: get the CPU usage
-Input       :None
-Output     : CPU usage string
-Return     : success : return CPU usage string,  fail : return ERR_STR
+Description: get the CPU usage since the previous call
+Input       : max_rows -- number of rows of pResult
+Output     : pResult -- CPU usage strings, CPU_NUM_PER_KEY cpus per row
+             row_num -- number of rows filled
+Return     : SUCC or ERROR
 *****************************************************************************/
-char *pGetCPUUsage(char *pResult)
+int pGetCPUUsage(char pResult[][CPU_ROW_LEN], int max_rows, int *row_num)
 {
     int     i = 0;
     int     j = 0;
-    int     flg = 0;
+    int     cpu = 0;
+    int     row = 0;
     int     cpucount = 0;
-    int     shiftsize = 0;
-    char    *pTmpString = NULL;
-    char    *pResultTmp = NULL;
-    FILE    *pFileStat = NULL;
-    char    CpuInfoTmp[CPU_INFO_SIZE*4];
-    errno_t rc = 0;
-
-    char    BufTmp[BUFFSIZE];
-    float   fCpuUsage[MAXCPUNUM];
-    struct  cpu_data CpuRecord[MAXCPUNUM];
-
-    for(i = 0; i < MAXCPUNUM; i ++)
+    int     possible = 0;
+    PROC_VIEW view;
+    PROC_LINE line;
+    float   fCpuUsage = 0.0;
+    struct  cpu_data *pCpuRecord = NULL;
+    unsigned char raw[PERFBIN_RAW_MAX];
+    PERFBIN_BUF bin;
+    size_t  mark = 0;
+    bool    binary = perfbin_enabled();
+
+    *row_num = 0;
+    if (binary)
     {
-        fCpuUsage[i] = 0.0;
+        perfbin_buf_init(&bin, raw, sizeof(raw));
+        mark = perfbin_tlv_begin(&bin, PERFBIN_TLV_CPU);
     }
-    (void)memset_s(BufTmp, BUFFSIZE, 0, BUFFSIZE);
-    (void)memset_s(CpuRecord, MAXCPUNUM, 0, MAXCPUNUM * sizeof(struct cpu_data));
 
+    possible = GetCPUPossibleNum();
     cpucount = GetCPUCount();
 
-    while(1)
+    /* reuse the snapshot GetCPUCount has just taken */
+    if(SUCC != proc_source_read(PROC_STAT, PROC_SOURCE_CACHED, &view))
     {
-        pFileStat = OpenStatFile();
-        if(NULL == pFileStat)
+        return ERROR;
+    }
+
+    /* skip the "cpu" line of all cpus */
+    if(!proc_view_next_line(&view, &line))
+    {
+        return ERROR;
+    }
+
+    if (NULL == g_CpuRecord)
+    {
+        g_CpuRecord = (struct cpu_data *)calloc(possible, sizeof(struct cpu_data));
+        g_fCpuUsage = (float *)calloc(possible, sizeof(float));
+        if (NULL == g_CpuRecord || NULL == g_fCpuUsage)
         {
-            return ERR_STR;
+            free(g_CpuRecord);
+            free(g_fCpuUsage);
+            g_CpuRecord = NULL;
+            g_fCpuUsage = NULL;
+            return ERROR;
         }
+    }
 
-        if(NULL == fgets(BufTmp, BUFFSIZE, pFileStat))
+    for(i = 0; i < cpucount; i++)
+    {
+        if(!proc_view_next_line(&view, &line))
         {
-            fclose(pFileStat);
-            return ERR_STR;
+            return ERROR;
         }
-
-
-        for(i = 0; i < cpucount; i++)
+        /* offline cpus are not listed, keep the history of each cpu by its number */
+        cpu = cpu_line_number(&line);
+        if(cpu < 0 || cpu >= possible)
         {
-            if(NULL == fgets(BufTmp, BUFFSIZE, pFileStat))
-            {
-                fclose(pFileStat);
-                return ERR_STR;
-            }
-            pTmpString = cpu_skip_token(BufTmp);	 /* skip "cpu" */
-            for(j = 0; j < NCPUSTATES; j ++)
-            {
-                CpuRecord[i].cp_new[j] = strtoul(pTmpString, &pTmpString, 0);
-            }
+            cpu = i;
+        }
+        pCpuRecord = &g_CpuRecord[cpu];
+        for(j = 0; j < NCPUSTATES; j ++)
+        {
+            pCpuRecord->cp_new[j] = (long)proc_line_ull(&line);
+        }
 
-            (void)percentages(NCPUSTATES, &CpuRecord[i]);
-            fCpuUsage[i] = 0.0;
+        /* too short since the last sample: report the last usage */
+        if(cpu_ticks_elapsed(NCPUSTATES, pCpuRecord) >= CPU_MIN_SAMPLE_TICKS)
+        {
+            (void)percentages(NCPUSTATES, pCpuRecord);
+            fCpuUsage = 0.0;
             for(j = 0; j < NCPUSTATES ; j ++)
             {
-                fCpuUsage[i] = fCpuUsage[i] + CpuRecord[i].cpu_usage[j] / 10.0;
+                fCpuUsage = fCpuUsage + pCpuRecord->cpu_usage[j] / 10.0;
             }
-            fCpuUsage[i] = fCpuUsage[i] - CpuRecord[i].cpu_usage[IDLE_USAGE] / 10.0;
+            fCpuUsage = fCpuUsage - pCpuRecord->cpu_usage[IDLE_USAGE] / 10.0;
 
-            if( fCpuUsage[i] < 0)
+            if( fCpuUsage < 0)
             {
-                fCpuUsage[i] = abs(fCpuUsage[i]);
+                fCpuUsage = -fCpuUsage;
             }
-
+            g_fCpuUsage[cpu] = fCpuUsage;
         }
-
-        fclose(pFileStat);
-        pFileStat = NULL;
-        if (0 != flg)
-        {
-            break;
-        }
-
-        (void)usleep(500000);
-
-        flg++;
-    }/* End of while(1) */
-
-    pResultTmp = pResult;
-
-    for (i = 0; i < cpucount; i++)
-    {
-        memset_s(CpuInfoTmp,sizeof(CpuInfoTmp),0,sizeof(CpuInfoTmp));
-
-        shiftsize = snprintf_s(CpuInfoTmp,sizeof(CpuInfoTmp),  sizeof(CpuInfoTmp), "%d:%.2f;", i, fCpuUsage[i]);
-        if(-1 == shiftsize)
+        if (binary)
         {
-            return ERR_STR;
+            perfbin_put_uint(&bin, (unsigned long long)i);
+            perfbin_put_uint(&bin, (unsigned long long)(g_fCpuUsage[cpu] * 100.0 + 0.5));
         }
 
-        rc = memcpy_s(pResultTmp, strlen(CpuInfoTmp), CpuInfoTmp, strlen(CpuInfoTmp));
-
-
-        if(rc != 0 )
+        row = i / CPU_NUM_PER_KEY;
+        if (row >= max_rows)
         {
-            /* hand erro*/
-            return ERR_STR;
+            break;
         }
-
-        pResultTmp = pResultTmp + shiftsize;
+        (void)snprintf_s(pResult[row] + strlen(pResult[row]),
+                         CPU_ROW_LEN - strlen(pResult[row]),
+                         CPU_ROW_LEN - strlen(pResult[row]) - 1,
+                         "%d:%.2f;", i, g_fCpuUsage[cpu]);
+        *row_num = row + 1;
     }
-    (void)snprintf_s(pResultTmp, 1, 1, '\0');
 
+    if (binary)
+    {
+        perfbin_tlv_end(&bin, mark);
+        perfbin_section_set(PERFBIN_SECTION_CPU, &bin);
+    }
     return SUCC;
 }
 
@@ -338,27 +416,31 @@ Return     : -1: fail  0: success
 int CpuTimeWaitPercentage(char *cputimevalue)
 {
     SIC_t u_frme, s_frme, n_frme, i_frme, w_frme, x_frme, y_frme, z_frme, tot_frme, tz;
-    FILE *fp = NULL;
+    PROC_VIEW view;
+    PROC_LINE line;
     char *CpuTimeValue = NULL;
-    char buf[TIMEBUFSIZE] = {0};
     float scale;
     static CPU_t cpus;
-    if (!(fp = OpenStatFile()))
+    /* same snapshot as the per-cpu usage of this sample */
+    if (SUCC != proc_source_read(PROC_STAT, PROC_SOURCE_CACHED, &view))
     {
-       DEBUG_LOG("Failed open /proc/stat, errno=%d.", errno);
+       DEBUG_LOG("Failed read /proc/stat, errno=%d.", errno);
        return ERROR;
     }
-    if (!fgets(buf, sizeof(buf), fp))
+    if (!proc_view_next_line(&view, &line))
     {
-       fclose(fp);
        DEBUG_LOG("/proc/stat content is NULL.");
        return ERROR;
     }
-    cpus.x_current = 0;  // FIXME: can't tell by kernel version number
-    cpus.y_current = 0;  // FIXME: can't tell by kernel version number
-    cpus.z_current = 0;  // FIXME: can't tell by kernel version number
-    /*ÿеݸֵǰ*/
-    (void)sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",&cpus.u_current,&cpus.n_current,&cpus.s_current,&cpus.i_current,&cpus.w_current,&cpus.x_current,&cpus.y_current,&cpus.z_current);
+    /*ÿеݸֵǰ棬ںûеΪ0*/
+    cpus.u_current = proc_line_ull(&line);
+    cpus.n_current = proc_line_ull(&line);
+    cpus.s_current = proc_line_ull(&line);
+    cpus.i_current = proc_line_ull(&line);
+    cpus.w_current = proc_line_ull(&line);
+    cpus.x_current = proc_line_ull(&line);
+    cpus.y_current = proc_line_ull(&line);
+    cpus.z_current = proc_line_ull(&line);
     /*һζȡĻǰǰֵ*/
     if(0 == CpuTimeFirstFlag)
     {
@@ -401,7 +483,6 @@ int CpuTimeWaitPercentage(char *cputimevalue)
     cpus.x_save = cpus.x_current;
     cpus.y_save = cpus.y_current;
     cpus.z_save = cpus.z_current;
-    fclose(fp);
     return SUCC;
 }
 /*****************************************************************************
@@ -413,15 +494,18 @@ Return     : None
 *****************************************************************************/
 int cpuworkctlmon(struct xs_handle *handle)
 {
-    char *value = NULL;
+    char (*value)[CPU_ROW_LEN] = NULL;
     char *cputimevalue = NULL;
     int  CpuUsageFlag = 0;
-    value = (char *)malloc(MAXCPUNUM * CPU_INFO_SIZE + 1);
+    int  max_rows = 0;
+    int  row_num = 0;
+
+    max_rows = (GetCPUPossibleNum() + CPU_NUM_PER_KEY - 1) / CPU_NUM_PER_KEY;
+    value = (char (*)[CPU_ROW_LEN])calloc(max_rows, CPU_ROW_LEN);
     if(NULL == value)
     {
         return ERROR;
     }
-    (void)memset_s(value, MAXCPUNUM * CPU_INFO_SIZE + 1, 0, MAXCPUNUM * CPU_INFO_SIZE + 1);
 
     cputimevalue = (char *)malloc(CPU_USAGE_SIZE);
     if(NULL == cputimevalue)
@@ -435,40 +519,23 @@ int cpuworkctlmon(struct xs_handle *handle)
     }
     (void)memset_s(cputimevalue, CPU_USAGE_SIZE, 0, CPU_USAGE_SIZE);
 
-    (void)pGetCPUUsage(value);
-    if(g_exinfo_flag_value & EXINFO_FLAG_CPU_USAGE)
+    if (SUCC != pGetCPUUsage(value, max_rows, &row_num))
     {
-       CpuUsageFlag = CpuTimeWaitPercentage(cputimevalue);
-    }
-    if(xb_write_first_flag == 0)
-    {
-        write_to_xenstore(handle, CPU_DATA_PATH, value);
-        if(g_exinfo_flag_value & EXINFO_FLAG_CPU_USAGE)
+        row_num = 0;
+        if (perfbin_enabled())
         {
-            if(SUCC == CpuUsageFlag)
-            {
-                write_to_xenstore(handle, CPU_TIME_PATH, cputimevalue);
-            }
-            else
-            {
-                write_to_xenstore(handle, CPU_TIME_PATH, "error");
-            }
+            perfbin_section_fail(PERFBIN_SECTION_CPU, PERFBIN_TLV_CPU);
         }
     }
-    else
+    if(g_exinfo_flag_value & EXINFO_FLAG_CPU_USAGE)
     {
-        write_weak_to_xenstore(handle, CPU_DATA_PATH, value);
-        if(g_exinfo_flag_value & EXINFO_FLAG_CPU_USAGE)
-        {
-            if(SUCC == CpuUsageFlag)
-            {
-                write_weak_to_xenstore(handle, CPU_TIME_PATH, cputimevalue);
-            }
-            else
-            {
-                write_weak_to_xenstore(handle, CPU_TIME_PATH, "error");
-            }
-        }
+       CpuUsageFlag = CpuTimeWaitPercentage(cputimevalue);
+    }
+    write_xs_cpu(handle, xb_write_first_flag, value, max_rows, row_num);
+    if(g_exinfo_flag_value & EXINFO_FLAG_CPU_USAGE)
+    {
+        write_perf_to_xenstore(handle, CPU_TIME_PATH,
+                               (SUCC == CpuUsageFlag) ? cputimevalue : "error", xb_write_first_flag);
     }
 
     free(value);
@@ -479,3 +546,40 @@ int cpuworkctlmon(struct xs_handle *handle)
     return SUCC;
     //lint -save -e438
 }
+
+/*****************************************************************************
+Function   : write_xs_cpu
+Description: write the per-cpu usage rows to control/uvp/cpu and
+             control/uvp/cpu-ext-N; rows of cpus that are not online are
+             set to "0", every row to "error" when sampling failed
+Input       :handle : handle of xenstore
+             is_weak : retry failed writes
+             xs_value : the rows
+             max_rows : rows needed for all possible cpus
+             row_num : rows filled, 0 on failure
+Output     : None
+Return     : None
+*****************************************************************************/
+void write_xs_cpu(struct xs_handle *handle, int is_weak, char xs_value[][CPU_ROW_LEN], int max_rows, int row_num)
+{
+    int i = 0;
+    char xs_path[CPU_XS_PATH_LEN] = {0};
+    char *pValue = NULL;
+
+    for (i = 0; i < max_rows; i++)
+    {
+        if (0 == i)
+            (void)snprintf_s(xs_path, sizeof(xs_path), sizeof(xs_path) - 1, "%s", CPU_DATA_PATH);
+        else
+            (void)snprintf_s(xs_path, sizeof(xs_path), sizeof(xs_path) - 1, "%s-%d", CPU_DATA_EXT_PATH, i);
+
+        if (0 == row_num)
+            pValue = "error";
+        else if (i < row_num)
+            pValue = xs_value[i];
+        else
+            pValue = "0";
+
+        write_perf_to_xenstore(handle, xs_path, pValue, is_weak);
+    }
+}
@@ -0,0 +1,287 @@
+/*
+ * Reads the live table of a device-mapper device over the DM ioctl
+ * interface and the lower devices of a block device from sysfs, so
+ * that the disk collector needs neither dmsetup nor a shell.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "devmapper.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <linux/dm-ioctl.h>
+
+#define DM_CONTROL_PATH         "/dev/mapper/control"
+#define DM_SYSFS_DEV_PATH       "/sys/dev/block"
+#define DM_SYSFS_CLASS_PATH     "/sys/class/block"
+#define DM_IOCTL_INIT_LEN       (16 * 1024)
+#define DM_IOCTL_MAX_LEN        (1024 * 1024)
+/* "start length " and the newline of one target line */
+#define DM_LINE_OVERHEAD        48
+#define DM_PATH_LEN             256
+#define DM_VALUE_LEN            64
+
+static int g_dm_control_fd = -1;
+static char *g_dm_ioctl_buf = NULL;
+static size_t g_dm_ioctl_len = 0;
+static char *g_dm_table_buf = NULL;
+static size_t g_dm_table_len = 0;
+
+static int dm_control_open(void)
+{
+    int flag;
+
+    if (g_dm_control_fd >= 0)
+    {
+        return SUCC;
+    }
+    g_dm_control_fd = open(DM_CONTROL_PATH, O_RDWR);
+    if (g_dm_control_fd < 0)
+    {
+        DEBUG_LOG("Failed to open %s, errno=%d.", DM_CONTROL_PATH, errno);
+        return ERROR;
+    }
+    flag = fcntl(g_dm_control_fd, F_GETFD);
+    (void)fcntl(g_dm_control_fd, F_SETFD, flag | FD_CLOEXEC);
+    return SUCC;
+}
+
+static int dm_buffer_reserve(char **buf, size_t *len, size_t size)
+{
+    char *tmp = NULL;
+
+    if (size <= *len)
+    {
+        return SUCC;
+    }
+    tmp = (char *)realloc(*buf, size);
+    if (NULL == tmp)
+    {
+        return ERROR;
+    }
+    *buf = tmp;
+    *len = size;
+    return SUCC;
+}
+
+/* the kernel decodes dm_ioctl.dev with huge_decode_dev() */
+static unsigned long long dm_encode_dev(int devID)
+{
+    unsigned long long ma = major(devID);
+    unsigned long long mi = minor(devID);
+
+    return (mi & 0xff) | (ma << 8) | ((mi & ~0xffULL) << 12);
+}
+
+/*****************************************************************************
+Function   : dm_table_status
+Description: issue DM_TABLE_STATUS for the live table of a device, growing
+             the buffer while the kernel reports it full
+Input      : devID -- device number of the dm device
+Output     : None
+Return     : the filled dm_ioctl or NULL
+*****************************************************************************/
+static struct dm_ioctl *dm_table_status(int devID)
+{
+    struct dm_ioctl *io = NULL;
+    size_t size = g_dm_ioctl_len ? g_dm_ioctl_len : DM_IOCTL_INIT_LEN;
+
+    for (;;)
+    {
+        if (SUCC != dm_buffer_reserve(&g_dm_ioctl_buf, &g_dm_ioctl_len, size))
+        {
+            return NULL;
+        }
+        io = (struct dm_ioctl *)g_dm_ioctl_buf;
+        (void)memset_s(io, sizeof(struct dm_ioctl), 0, sizeof(struct dm_ioctl));
+        io->version[0] = DM_VERSION_MAJOR;
+        io->data_size = (unsigned int)g_dm_ioctl_len;
+        io->data_start = sizeof(struct dm_ioctl);
+        io->flags = DM_STATUS_TABLE_FLAG;
+        io->dev = dm_encode_dev(devID);
+
+        if (ioctl(g_dm_control_fd, DM_TABLE_STATUS, io) < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            DEBUG_LOG("DM_TABLE_STATUS failed for %d:%d, errno=%d.", major(devID), minor(devID), errno);
+            return NULL;
+        }
+        if (!(io->flags & DM_BUFFER_FULL_FLAG))
+        {
+            return io;
+        }
+        if (g_dm_ioctl_len >= DM_IOCTL_MAX_LEN)
+        {
+            ERR_LOG("Table of %d:%d is larger than %d bytes.", major(devID), minor(devID), DM_IOCTL_MAX_LEN);
+            return NULL;
+        }
+        size = g_dm_ioctl_len * 2;
+    }
+}
+
+/*****************************************************************************
+Function   : dm_table_read
+Description: read the live table of a device-mapper device, formatted as
+             "dmsetup table" prints it
+Input      : devID -- device number of the dm device
+Output     : view  -- one target per line
+Return     : number of targets or ERROR
+*****************************************************************************/
+int dm_table_read(int devID, PROC_VIEW *view)
+{
+    struct dm_ioctl *io = NULL;
+    struct dm_target_spec *spec = NULL;
+    const char *end = NULL;
+    size_t offset = 0;
+    size_t pos = 0;
+    int len;
+    unsigned int i;
+
+    if (NULL == view || SUCC != dm_control_open())
+    {
+        return ERROR;
+    }
+    io = dm_table_status(devID);
+    if (NULL == io)
+    {
+        return ERROR;
+    }
+    if (SUCC != dm_buffer_reserve(&g_dm_table_buf, &g_dm_table_len,
+                                  io->data_size + (size_t)io->target_count * DM_LINE_OVERHEAD + 1))
+    {
+        return ERROR;
+    }
+
+    /* spec->next is relative to the first target spec */
+    end = g_dm_ioctl_buf + io->data_size;
+    for (i = 0; i < io->target_count; i++)
+    {
+        spec = (struct dm_target_spec *)(g_dm_ioctl_buf + io->data_start + offset);
+        if ((const char *)(spec + 1) >= end)
+        {
+            return ERROR;
+        }
+        len = snprintf_s(g_dm_table_buf + pos, g_dm_table_len - pos, g_dm_table_len - pos - 1,
+                         "%llu %llu %s %s\n",
+                         (unsigned long long)spec->sector_start, (unsigned long long)spec->length,
+                         spec->target_type, (const char *)(spec + 1));
+        if (len < 0)
+        {
+            return ERROR;
+        }
+        pos += (size_t)len;
+        offset = spec->next;
+    }
+    g_dm_table_buf[pos] = '\0';
+
+    view->data = g_dm_table_buf;
+    view->len = pos;
+    view->pos = 0;
+    return (int)io->target_count;
+}
+
+static int dm_read_value(const char *path, char *value, int size)
+{
+    int fd;
+    ssize_t n;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return ERROR;
+    }
+    n = read(fd, value, size - 1);
+    (void)close(fd);
+    if (n <= 0)
+    {
+        return ERROR;
+    }
+    value[n] = '\0';
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : dm_slaves_read
+Description: list the lower devices of a block device from
+             /sys/dev/block/M:m/slaves, e.g. the PVs under an LV
+Input      : devID  -- device number of the upper device
+             max    -- size of slaves
+Output     : slaves -- names, device numbers and sizes of the lower devices
+Return     : number of lower devices or ERROR
+*****************************************************************************/
+int dm_slaves_read(int devID, DM_SLAVE *slaves, int max)
+{
+    char path[DM_PATH_LEN] = {0};
+    char value[DM_VALUE_LEN] = {0};
+    DIR *dir = NULL;
+    struct dirent *entry = NULL;
+    int count = 0;
+
+    (void)snprintf_s(path, sizeof(path), sizeof(path), DM_SYSFS_DEV_PATH "/%d:%d/slaves",
+                     major(devID), minor(devID));
+    dir = opendir(path);
+    if (NULL == dir)
+    {
+        return ERROR;
+    }
+
+    while (count < max && NULL != (entry = readdir(dir)))
+    {
+        if ('.' == entry->d_name[0])
+        {
+            continue;
+        }
+        (void)snprintf_s(path, sizeof(path), sizeof(path), DM_SYSFS_CLASS_PATH "/%s/dev", entry->d_name);
+        if (SUCC != dm_read_value(path, value, sizeof(value))
+            || 2 != sscanf_s(value, "%d:%d", &slaves[count].major, &slaves[count].minor))
+        {
+            continue;
+        }
+        (void)snprintf_s(path, sizeof(path), sizeof(path), DM_SYSFS_CLASS_PATH "/%s/size", entry->d_name);
+        if (SUCC != dm_read_value(path, value, sizeof(value)))
+        {
+            continue;
+        }
+        slaves[count].sectors = strtoull(value, NULL, 10);
+        (void)strncpy_s(slaves[count].name, sizeof(slaves[count].name), entry->d_name, sizeof(slaves[count].name) - 1);
+        count++;
+    }
+
+    (void)closedir(dir);
+    return count;
+}
@@ -32,17 +32,21 @@
 #include "libxenctl.h"
 #include "public_common.h"
 #include <sys/vfs.h>
+#include <sys/statvfs.h>
 #include <mntent.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include "securec.h"
+#include "procsrc.h"
+#include "devmapper.h"
+#include "uevent.h"
+#include "arena.h"
+#include "perfbin.h"
 
-#define PROC_PARTITIONS             "/proc/partitions"
-#define PROC_SWAPS                  "/proc/swaps"
-#define PROC_MOUNTS                 "/proc/mounts"
 #define PROC_DEVICES                "/proc/devices"
 #define DISK_DATA_PATH              "control/uvp/disk"
 #define DISK_DATA_EXT_PATH          "control/uvp/disk-ext"
@@ -64,6 +68,7 @@
 #define LOOP_MAJOR                  7
 #define MAX_DISKUSAGE_LEN           1024
 #define MAX_NAME_LEN                64
+#define MAX_FS_NAME_LEN             256
 #define MAX_STR_LEN                 4096
 #define UNIT_TRANSFER_CYCLE         1024
 #define MAX_DISK_NUMBER             128          /* TODO:1.ֽ׶֧11xvdạ17scsịԺֵ֧Ĵ˴ӦӦ. 
@@ -72,6 +77,10 @@
 #define MAX_FILENAMES_SIZE          52800
 /*xenstoreֵ󳤶Ϊ4096ȥֵȣʣ³Ϊfilesystemɷŵĳ*/
 #define MAX_FILENAMES_XENSTORLEN    4042
+/*df -lȥʱ¼ļϵͳ豸Ÿ*/
+#define MAX_LOCAL_FS_NUM            256
+/*²豸ֲ̯*/
+#define MAX_DM_SLAVE_NUM            64
 /*ֻϱ60̵Ϣ*/
 #define MAX_DISKUSAGE_STRING_NUM 60
 #define SECTOR_SIZE 512
@@ -86,7 +95,7 @@ struct DevMajorMinor
 {
     int  devMajor;                              /* 豸豸 */
     int  devMinor;                              /* 豸豸 */
-    char devBlockSize[MAX_STR_LEN];             /* 豸ĿС(KB) */
+    unsigned long long devBlockSize;            /* 豸ĿС(KB) */
     char devName[MAX_NAME_LEN];                 /* 豸 */
 };
 
@@ -94,16 +103,16 @@ struct DevMajorMinor
 struct DeviceInfo
 {
     char phyDevName[MAX_NAME_LEN];                     /*  */
-    char deviceTotalSpace[MAX_STR_LEN];                /* ̵ܿռ(MB) */
-    char diskUsage[MAX_DISKUSAGE_LEN];                 /* ̵ʹÿռ(MB) */
+    unsigned long long deviceTotalSpace;               /* ̵ܿռ(MB) */
+    unsigned long long diskUsage;                      /* ̵ʹÿռ(MB) */
 };
 
 /* صӦļϵͳϢʹÿռĽṹ */
 struct DiskInfo
 {
     int  st_rdev;                                  /* 洢ļϵͳӦ豸ID */
-    char filesystem[MAX_STR_LEN];                  /* ļϵͳӦFileSystem */
-    char usage[MAX_DISKUSAGE_LEN];                 /* ļϵͳʹÿռ(MB) */
+    char filesystem[MAX_FS_NAME_LEN];              /* ļϵͳӦFileSystem */
+    unsigned long long usage;                      /* ļϵͳʹÿռ(MB) */
     char mountPoint[MAX_STR_LEN];                  /* ļϵͳĹص */
 };
 
@@ -130,368 +139,73 @@ enum dm_type
     DM_RAID,
     DM_MIRROR,
     DM_SNAPSHOT,
+    DM_SLAVES,               /* ӳɶsysfsе²豸 */
     DM_UNKNOWN
 };
 
-extern CheckName(const char * name);
-
-void write_xs_disk(struct xs_handle *handle, int is_weak, char xs_value[][MAX_DISKUSAGE_LEN], int row_num);
-
-/*****************************************************************************
- Function   : strAdd()
- Description: ַӺ
- Input      : inputNum1          һַ
-              inputNum2          ڶַ
- Output     : outputResult       ַ͵ַ
- Return     : SUCC = success, ERROR = failure
- Other      : N/A
- *****************************************************************************/
-int strAdd(char *inputNum1, char *inputNum2, char *outputResult)
+/* ߼ڵ㣺豸šӳͼ丸ڵ */
+struct TopoDmNode
 {
-    char *pszFirstNum = inputNum1;
-    char *pszSecondNum = inputNum2;
-    char szTmpResult[MAX_STR_LEN] = {0};
-    int nFirstNumLen;
-    int nSecondNumLen;
-    int nTmpStrLen;
-    int nNum1 = 0;
-    int nNum2 = 0;
-    int sum = 0;
-    int ten = 0;
-    int i;
-    int j = 0;
-    int k = 0;
-
-    /* һΪNULLش */
-    if (NULL == pszFirstNum || NULL == pszSecondNum || NULL == outputResult)
-    {
-        return ERROR;
-    }
-
-    nFirstNumLen = strlen(pszFirstNum);
-    nSecondNumLen = strlen(pszSecondNum);
-
-    /* нϳһݵĳ */
-    nTmpStrLen = (nFirstNumLen < nSecondNumLen) ? nSecondNumLen : nFirstNumLen;
-    if (MAX_STR_LEN <= nTmpStrLen)
-    {
-        return ERROR;
-    }
-    /* ѭȡÿһλ */
-    for (i = 0; i < nTmpStrLen; i++)
-    {
-        /* ӦݳСѭλΪ0ֱӻȡλݣҽASCIIתΪ */
-        j = nFirstNumLen - i - 1;
-        k = nSecondNumLen - i - 1;
-        (j >= 0) ? (nNum1 = pszFirstNum[j] - 48) : (nNum1 = 0);
-        (k >= 0) ? (nNum2 = pszSecondNum[k] - 48) : (nNum2 = 0);
-        /* ʱ־λĺͣȡλʮλ */
-        sum = nNum1 + nNum2 + ten;
-        ten = sum / 10;
-        sum = sum % 10;
-        /* Ӧĺ͵ĸλָʱַ */
-        *(szTmpResult + i) = sum + 48;
-    }
-    /* ˳ѭλ־1ٽλ1ʱַ */
-    if (1 == ten)
-    {
-        *(szTmpResult + i) = ten + 48;
-    }
-
-    /* ȡʱַĳȣ䰴Ƹ */
-    nTmpStrLen = strlen(szTmpResult);
-    for (i = 0; i < nTmpStrLen; i++)
-    {
-        outputResult[i] = szTmpResult[nTmpStrLen - i - 1];
-    }
-    /* ֶַĩβ\0ֹظʹô */
-    outputResult[i] = '\0';
-
-    return SUCC;
-}
+    int devID;
+    int nDmType;
+    int nParentCnt;
+    struct DmInfo *pstDmInfo;
+};
 
-/*****************************************************************************
- Function   : strMinus()
- Description: ַ
- Input      : inputNum1          
-              inputNum2          
- Output     : outputResult       ַַ
- Return     : SUCC = success, ERROR = failure
- Other      : N/A
- *****************************************************************************/
-int strMinus(char *inputNum1, char *inputNum2, char *outputResult)
+/* drbd豸丸豸 */
+struct TopoDrbdNode
 {
-    char *pszFirstNum = inputNum1;
-    char *pszSecondNum = inputNum2;
-    char szTmpResult[MAX_STR_LEN] = {0};
-    int nFirstNumLen;
-    int nSecondNumLen;
-    int nTmpStrLen;
-    int nNum1 = 0;
-    int nNum2 = 0;
-    /* ÿλŵʱ */
-    int wanting = 0;
-    /* ǽλ */
-    int isNegative = 0;
-    /* Žַ± */
-    int nTmpLocation = 0;
-    int i;
-
-    /* һΪNULLش */
-    if (NULL == pszFirstNum || NULL == pszSecondNum || NULL == outputResult)
-    {
-        return ERROR;
-    }
-
-    nFirstNumLen = strlen(pszFirstNum);
-    nSecondNumLen = strlen(pszSecondNum);
-
-    /* ĳȴڱĳ(Ϊ)ش */
-    if (nFirstNumLen < nSecondNumLen)
-    {
-        return ERROR;
-    }
-
-    /* ѭȡÿһλݣȻжӦݲ */
-    for (i = 0; i < nSecondNumLen; i++)
-    {
-        /* ȡӦλϵ */
-        nNum1 = pszFirstNum[nFirstNumLen - i - 1] - 48;
-        nNum2 = pszSecondNum[nSecondNumLen - i - 1] - 48;
-        /* жϱӦݱλǷڼĶӦСڣҪһλλ򣬲Ҫ */
-        if (nNum1 >= nNum2 + isNegative)
-        {
-            wanting = nNum1 - nNum2 - isNegative;
-            isNegative = 0;
-        }
-        else
-        {
-            wanting = nNum1 + 10 - nNum2 - isNegative;
-            isNegative = 1;
-        }
-        /* Ӧλֵַʱַ */
-        *(szTmpResult + i) = wanting + 48;
-    }
-
-    /* ѭֱĳΪֹ */
-    for (; i < nFirstNumLen; i++)
-    {
-        nNum1 = pszFirstNum[nFirstNumLen - i - 1] - 48;
-        /* λ־0Ӧ㣬ֱӽǰλݴݸ */
-        if (1 == isNegative)
-        {
-            /* ǰλõֵС1ֱһλλ */
-            if (nNum1 >= 1)
-            {
-                wanting = nNum1 - isNegative;
-                *(szTmpResult + i) = wanting + 48;
-                isNegative = 0;
-            }
-            else
-            {
-                wanting = nNum1 + 10 - isNegative;
-                *(szTmpResult + i) = wanting + 48;
-                isNegative = 1;
-            }
-        }
-        else
-        {
-            *(szTmpResult + i) = nNum1 + 48;
-        }
-    }
-    /* 걻λλǻǴ0򷵻ش */
-    if (1 == isNegative)
-    {
-        return ERROR;
-    }
-
-    /* ȡʱַĳȣ䰴Ƹ */
-    nTmpStrLen = strlen(szTmpResult);
-    for (i = 0; i < nTmpStrLen; i++)
-    {
-        /* ȥλ0 */
-        if (0 == strlen(outputResult) && '0' == szTmpResult[nTmpStrLen - i - 1])
-        {
-            continue;
-        }
-        outputResult[nTmpLocation] = szTmpResult[nTmpStrLen - i - 1];
-        nTmpLocation++;
-    }
-
-    /* ַΪ0θֵһ0 */
-    if (0 == strlen(outputResult))
-    {
-        (void)strncpy_s(outputResult, 3, "0", 2);
-    }
-
-    return SUCC;
-}
+    char drbdName[MAX_NAME_LEN];
+    char parentName[MAX_NAME_LEN];
+};
 
-/*****************************************************************************
- Function   : strMulti()
- Description: ַ˺
- Input      : inputNum1         һַ
-                inputNum1         ڶַ
- Output     : outputResult      ַַ
- Return     : SUCC = success, ERROR = failure
- Other      : N/A
- *****************************************************************************/
-int strMulti(char *inputNum1, char *inputNum2, char *outputResult)
+/*
+ * ڻĿ豸ˣ/proc/partitionsеķбԼ߼drbd豸Ĺϵ
+ * ֻ/proc/partitionsݱ仯յblockϵͳueventʱؽÿֻػĹϵۼʹÿռ䣻
+ * ueventʱ޷֪ӳı仯߼drbdĹϵÿ»ȡ
+ */
+struct BlockTopology
 {
-    char *pszFirstNum = inputNum1;
-    char *pszSecondNum = inputNum2;
-    char szTmpResult[MAX_STR_LEN] = {0};
-    char szOneTimeResult[MAX_STR_LEN] = {0};
-    char szFinalResult[MAX_STR_LEN] = {0};
-    int nFirstNumLen;
-    int nSecondNumLen;
-    int nTmpStrLen = 0;
-    int nNum1 = 0;
-    int nNum2 = 0;
-    /* Žλʱ */
-    int carry = 0;
-    int nTempResult = 0;
-    int nLen;
-    int i;
-    int j = 0;
-
-    /* һΪNULLش */
-    if (NULL == pszFirstNum || NULL == pszSecondNum || NULL == outputResult)
-    {
-        return ERROR;
-    }
-
-    nFirstNumLen = strlen(pszFirstNum);
-    nSecondNumLen = strlen(pszSecondNum);
+    int valid;
+    unsigned int ueventGen;
+    char *partitions;                       /* ʱ/proc/partitions */
+    size_t partitionsLen;
+    struct DevMajorMinor *devMajorMinor;
+    int partNum;
+    struct DeviceInfo *disks;               /* ʹÿռΪ0ÿڸƺۼ */
+    int diskNum;
+    struct TopoDmNode *dmNodes;
+    int dmNum;
+    int dmCapacity;
+    struct TopoDrbdNode *drbdNodes;
+    int drbdNum;
+    int drbdCapacity;
+};
 
-    /* ѭһַÿһλһλʼ */
-    for (i = nFirstNumLen; i > 0; i--)
-    {
-        /* ȡӦλõ */
-        nNum1 = *(pszFirstNum + i - 1) - 48;
-        /* ѭһַÿһλһλʼ */
-        for (j = nSecondNumLen; j > 0; j--)
-        {
-            /* ȡӦλõ */
-            nNum2 = *(pszSecondNum + j - 1) - 48;
-            /* ȡ˺λ */
-            nTempResult = nNum1 * nNum2 + carry;
-            /* ֱȡλββݸʱַ */
-            carry = nTempResult / 10;
-            nTempResult = nTempResult % 10;
-            *(szTmpResult + nSecondNumLen - j) = nTempResult + 48;
-        }
-        /* ɺ󣬽λԲΪ0򽫽λݸʱַ */
-        if (0 != carry)
-        {
-            *(szTmpResult + nSecondNumLen) = carry + 48;
-            carry = 0;
-        }
-        /* ȡʱַĳȣ䰴ƴݸִеʱַ */
-        nTmpStrLen = strlen(szTmpResult);
-        for (j = 0; j < nTmpStrLen; j++)
-        {
-            szOneTimeResult[j] = szTmpResult[nTmpStrLen - j - 1];
-        }
-        /* ÿνĵλ0Թ˺ַӦλ */
-        for (j = 0; j < nFirstNumLen - i; j++)
-        {
-            (void)strncat_s(szOneTimeResult, MAX_STR_LEN, "0", 2);
-        }
-        /* ִн˽ۼ */
-        (void)strAdd(szOneTimeResult, szFinalResult, szFinalResult);
-        /* ʱַ͵νַ */
-        memset_s(szTmpResult, MAX_STR_LEN, 0, sizeof(szTmpResult));
-        memset_s(szOneTimeResult, MAX_STR_LEN, 0, sizeof(szOneTimeResult));
-    }
+static struct BlockTopology g_blockTopo = {0};
+/* ˻g_diskArenaֻڲɼ߳ʹ(diskworkctlmonֻɲɼ̵߳) */
+/*
+ * ÿڵĴ̡صʱ飬ڿյʵ룬ڽʱ帴λ
+ * mlockall³פڴʵ豸仯ǰMAX_DISKUSAGE_LEN
+ */
+static ARENA g_diskArena = ARENA_INITIALIZER;
 
-    /* ַɣսݸ */
-    nLen = strlen(szFinalResult);
-    /* ַΪ0ʱ˵Ϊ0 */
-    if ('0' == szFinalResult[0])
-    {
-        nLen = 1;
-    }
-    (void)strncpy_s(outputResult, nLen + 1, szFinalResult, nLen);
-    outputResult[nLen] = '\0';
+extern CheckName(const char * name);
 
-    return SUCC;
-}
+void write_xs_disk(struct xs_handle *handle, int is_weak, char xs_value[][MAX_DISKUSAGE_LEN], int row_num);
 
 /*****************************************************************************
  Function   : unitTransfer()
  Description: λתֽںKBתΪMBʹõǽλ
- Input      : sourceStr      ΣֽڴС/KBС
+ Input      : source         ΣֽڴС/KBС
               level          Σλı
- Output     : targetStr      Σڴ洢
- Return     : SUCC = success, ERROR = failure
+ Output     : N/A
+ Return     : תĴС
  Other      : N/A
  *****************************************************************************/
-int unitTransfer(char *sourceStr, unsigned long level, char *targetStr)
+static unsigned long long unitTransfer(unsigned long long source, unsigned long level)
 {
-    char *pszFirstNum = sourceStr;
-    char szResult[MAX_STR_LEN] = {0};
-    unsigned long nCycle = level;
-    int nNumLen;
-    unsigned long tmpNum = 0;
-    /* ̳ʼΪ0 */
-    int divide = 0;
-    /* ʼΪ0 */
-    unsigned long remainder = 0;
-    int nLen;
-    int i;
-    /* ̵ַ± */
-    int j = 0;
-
-    /* жַǷΪNULL߳Ϊ0򷵻ش */
-    if (NULL == pszFirstNum || NULL == targetStr || 0 == nCycle)
-    {
-        return ERROR;
-    }
-
-    nNumLen = strlen(pszFirstNum);
-
-    /* ѭȡÿһλ */
-    for (i = 0; i < nNumLen; i++)
-    {
-        /* λȡֵַ */
-        tmpNum = remainder * 10 + (pszFirstNum[i] - 48);
-        /* жʱֵǷڳ̵ַǷΪգСΪգʱֵַ */
-        if(tmpNum < nCycle && 0 == strlen(szResult))
-        {
-            remainder = tmpNum;
-        }
-        else
-        {
-            /* ʱݴڳʼʽļ㣬̵ʱݳԳʱģ */
-            divide = tmpNum / nCycle;
-            remainder = tmpNum % nCycle;
-            /* ̸ֵӦĽ */
-            *(szResult + j) = divide + 48;
-            j++;
-        }
-    }
-    /* ַȫȡϣûдڳ򽫽Ϊ0 */
-    if(0 == j)
-    {
-        *(szResult + j) = divide + 48;
-    }
-    /* ִ֮Ϊ0λ(+1) */
-    if (0 != remainder)
-    {
-        (void)strAdd(szResult, "1", szResult);
-    }
-
-    /* սַƸ */
-    nLen = strlen(szResult);
-    if (MAX_STR_LEN <= nLen)
-    {
-        nLen = MAX_STR_LEN - 1;
-    }
-    (void)strncpy_s(targetStr, nLen + 1, szResult, nLen);
-    targetStr[nLen] = '\0';
-
-    return SUCC;
+    return (source + level - 1) / level;
 }
 
 /*****************************************************************************
@@ -837,25 +551,27 @@ static char* getXmlDevName(struct xs_handle *handle, const char *ptName)
  Function   : getPartitionsInfo()
  Description: ȡ/proc/partition豸Լ豸Ϣ
  Input      : struct xs_handle* handle   handle of xenstore
+              int nCapacity                          ṹ
  Output     : struct DevMajorMinor* devMajorMinor    豸Ƽ豸ŵĽṹ
               int* pnPartNum                         
               struct DeviceInfo* diskUsage           Ƽʹÿռ䡢ܿռĽṹ
               int* pnDiskNum                         
  Return     : SUCC = success, ERROR = failure
- Other      : N/A
+ Other      : һζȡ/proc/partitions
  *****************************************************************************/
 int getPartitionsInfo(struct xs_handle *handle,
                              struct DevMajorMinor *devMajorMinor,
                              int *pnPartNum,
                              struct DeviceInfo *diskUsage,
-                             int *pnDiskNum)
+                             int *pnDiskNum,
+                             int nCapacity)
 {
-    FILE    *fpProcPt;
+    PROC_VIEW view;
     char    szLine[MAX_STR_LEN];
     char    szPtName[MAX_NAME_LEN];
     int     nMajor = 0;
     int     nMinor = 0;
-    char    szSize[MAX_STR_LEN];
+    unsigned long long ullSize = 0;
     int     nPartitionNum = 0;
     int     nDiskNum = 0;
     int     nPtNameLen;
@@ -863,18 +579,16 @@ int getPartitionsInfo(struct xs_handle *handle,
     struct DevMajorMinor    *tmpDev = NULL;
     struct DeviceInfo       *tmpUsage = NULL;
 
-    /* /proc/partitionsļ */
-    fpProcPt = openFile(PROC_PARTITIONS, "r");
-    if (NULL == fpProcPt)
+    if (SUCC != proc_source_read(PROC_PARTITIONS, PROC_SOURCE_CACHED, &view))
     {
         return ERROR;
     }
 
     /* ѭȡÿһеϢ */
-    while (fgets(szLine, sizeof(szLine), fpProcPt))
+    while (nPartitionNum < nCapacity && proc_view_gets(szLine, sizeof(szLine), &view))
     {
         /* ʽȡӦ */
-        if (sscanf_s(szLine, " %d %d %s %[^\n ]", &nMajor, &nMinor, szSize, sizeof(szSize), szPtName, sizeof(szPtName)) != 4)
+        if (sscanf_s(szLine, " %d %d %llu %[^\n ]", &nMajor, &nMinor, &ullSize, szPtName, sizeof(szPtName)) != 4)
         {
             continue;
         }
@@ -888,9 +602,8 @@ int getPartitionsInfo(struct xs_handle *handle,
         tmpDev->devMajor = nMajor;
         tmpDev->devMinor = nMinor;
 
-        szSize[MAX_STR_LEN - 1] = '\0';
         szPtName[MAX_NAME_LEN - 1] = '\0';
-        (void)strncpy_s(tmpDev->devBlockSize, MAX_STR_LEN, szSize, strlen(szSize));
+        tmpDev->devBlockSize = ullSize;
         (void)strncpy_s(tmpDev->devName, MAX_NAME_LEN, szPtName, strlen(szPtName));
         nPartitionNum++;
         /* ĿǰUVPֹ֧xvd*hd*sd*͵豸 */
@@ -929,44 +642,41 @@ int getPartitionsInfo(struct xs_handle *handle,
         tmpUsage->phyDevName[MAX_NAME_LEN - 1] = '\0';
 
         /* ʼʹϢΪ0 */
-        (void)strncpy_s(tmpUsage->diskUsage, MAX_DISKUSAGE_LEN, "0", 2);
-        (void)unitTransfer(szSize, UNIT_TRANSFER_CYCLE, tmpUsage->deviceTotalSpace);
+        tmpUsage->diskUsage = 0;
+        tmpUsage->deviceTotalSpace = unitTransfer(ullSize, UNIT_TRANSFER_CYCLE);
         nDiskNum++;
     }
 
     *pnPartNum = nPartitionNum;
     *pnDiskNum = nDiskNum;
 
-    (void)fclose(fpProcPt);
     return SUCC;
 }
 
 /*****************************************************************************
  Function   : getSwapInfo()
  Description: ȡswapļϵͳԼӦĿռС
- Input      : N/A
+ Input      : int nCapacity                      diskMap
  Output     : struct DiskInfo* diskMap           swapϢʹÿռ
               int* pnMountNum                    swap
  Return     : SUCC = success, ERROR = failure
- Other      : N/A
+ Other      : һζȡ/proc/swaps
  *****************************************************************************/
-int getSwapInfo(struct DiskInfo *diskMap, int *pnMountNum)
+int getSwapInfo(struct DiskInfo *diskMap, int *pnMountNum, int nCapacity)
 {
-    FILE *fpProcSwap;
+    PROC_VIEW view;
     int nFsSize = 0;
     int nSwapPartitionNum = *pnMountNum;
     char szLine[MAX_STR_LEN] = {0};
     char szSwapName[MAX_STR_LEN] = {0};
     struct DiskInfo *tmpDisk = NULL;
 
-    /* /proc/swapsļ */
-    fpProcSwap = openFile(PROC_SWAPS, "r");
-    if (NULL == fpProcSwap)
+    if (SUCC != proc_source_read(PROC_SWAPS, PROC_SOURCE_CACHED, &view))
     {
         return ERROR;
     }
     /* diskMapswapϢ */
-    while (fgets(szLine, sizeof(szLine), fpProcSwap))
+    while (nSwapPartitionNum < nCapacity && proc_view_gets(szLine, sizeof(szLine), &view))
     {
         if (sscanf_s(szLine, "%s %*s %d %*[^\n ]", szSwapName, sizeof(szSwapName), &nFsSize) != 2)
         {
@@ -975,133 +685,381 @@ int getSwapInfo(struct DiskInfo *diskMap, int *pnMountNum)
         tmpDisk = diskMap + nSwapPartitionNum;
 
         szSwapName[MAX_STR_LEN - 1] = '\0';
-        (void)strncpy_s(tmpDisk->filesystem, MAX_STR_LEN, szSwapName, strlen(szSwapName));
-        (void)snprintf_s(tmpDisk->usage, sizeof(tmpDisk->usage), sizeof(tmpDisk->usage), "%d", nFsSize / UNIT_TRANSFER_CYCLE);
+        (void)strncpy_s(tmpDisk->filesystem, sizeof(tmpDisk->filesystem), szSwapName, sizeof(tmpDisk->filesystem) - 1);
+        /* KB棬getDiskInfoͳһתΪMB */
+        tmpDisk->usage = (unsigned long long)nFsSize;
         nSwapPartitionNum++;
     }
     *pnMountNum = nSwapPartitionNum;
-    (void)fclose(fpProcSwap);
-    //lint -save -e438
-    fpProcSwap = NULL;
 
     return SUCC;
-    //lint -restore
 }
 
 /*****************************************************************************
- Function   : getDrbdParent()
- Description: drbd豸ȡӦĸڵ
- Input      : char* drbdName                     drbd豸
- Output     : char* parentName                   ڵ
- Return     : 0
+ Function   : reserveTopoNodes()
+ Description: ˻нڵ
+ Input      : void **ppNodes                        ڵ
+              int *pCapacity                        ǰ
+              int count                             ҪĽڵ
+              size_t size                           ڵС
+ Output     : void **ppNodes, int *pCapacity
+ Return     : SUCC = success, ERROR = failure
  Other      : N/A
  *****************************************************************************/
-int getDrbdParent(char *drbdName, char *parentName)
+static int reserveTopoNodes(void **ppNodes, int *pCapacity, int count, size_t size)
 {
-    char szCmd[MAX_STR_LEN] = {0};
-    FILE *fpDmCmd;
-    char szLine[MAX_STR_LEN] = {0};
-    char tmpParentName[MAX_NAME_LEN] = {0};
+    void *pNodes = NULL;
+    int capacity = *pCapacity ? *pCapacity : 8;
 
-    if(SUCC != CheckName(drbdName))
+    if (count <= *pCapacity)
+    {
+        return SUCC;
+    }
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    pNodes = realloc(*ppNodes, capacity * size);
+    if (NULL == pNodes)
     {
         return ERROR;
     }
+    *ppNodes = pNodes;
+    *pCapacity = capacity;
+    return SUCC;
+}
 
-    /* ݵǰdrbd豸drbdsetupȡ豸 */
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "drbdsetup \"%s$\" show |grep /dev", drbdName);
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
+static struct TopoDmNode *getTopoDmNode(int devID)
+{
+    int i;
+
+    for (i = 0; i < g_blockTopo.dmNum; i++)
     {
-        return 0;
+        if (devID == g_blockTopo.dmNodes[i].devID)
+        {
+            return g_blockTopo.dmNodes + i;
+        }
+    }
+    return NULL;
+}
+
+/* ɹpstDmInfo黺 */
+static int addTopoDmNode(int devID, int nDmType, struct DmInfo *pstDmInfo, int nParentCnt)
+{
+    struct TopoDmNode *pstNode = NULL;
+
+    if (SUCC != reserveTopoNodes((void **)&g_blockTopo.dmNodes, &g_blockTopo.dmCapacity,
+                                 g_blockTopo.dmNum + 1, sizeof(struct TopoDmNode)))
+    {
+        return ERROR;
     }
+    pstNode = g_blockTopo.dmNodes + g_blockTopo.dmNum;
+    pstNode->devID = devID;
+    pstNode->nDmType = nDmType;
+    pstNode->nParentCnt = nParentCnt;
+    pstNode->pstDmInfo = pstDmInfo;
+    g_blockTopo.dmNum++;
+    return SUCC;
+}
 
-    /* ȡִнļָ */
-    if (NULL != fgets(szLine, sizeof(szLine), fpDmCmd))
+static int getTopoDrbdParent(const char *drbdName, char *parentName, int size)
+{
+    int i;
+
+    for (i = 0; i < g_blockTopo.drbdNum; i++)
     {
-        /* drbdsetupȡ豸 */
-        if (sscanf_s(szLine, "%*[^\"]\"%[^\"]", tmpParentName, sizeof(tmpParentName)) != 1)
+        if (0 == strcmp(drbdName, g_blockTopo.drbdNodes[i].drbdName))
         {
-            (void)pclose(fpDmCmd);
-            return 0;
+            (void)strncpy_s(parentName, size, g_blockTopo.drbdNodes[i].parentName, size - 1);
+            return SUCC;
         }
     }
+    return ERROR;
+}
 
-    (void)pclose(fpDmCmd);
-    //lint -save -e438
-    fpDmCmd = NULL;
-    //lint -restore
-    memset_s(parentName, strlen(parentName), 0, strlen(parentName));
-    (void)strncpy_s(parentName, strlen(parentName) + 1, tmpParentName, strlen(tmpParentName));
+static void addTopoDrbdNode(const char *drbdName, const char *parentName)
+{
+    struct TopoDrbdNode *pstNode = NULL;
 
-    return 0;
+    /* ƹdrbd豸 */
+    if (strlen(drbdName) >= MAX_NAME_LEN
+        || SUCC != reserveTopoNodes((void **)&g_blockTopo.drbdNodes, &g_blockTopo.drbdCapacity,
+                                    g_blockTopo.drbdNum + 1, sizeof(struct TopoDrbdNode)))
+    {
+        return;
+    }
+    pstNode = g_blockTopo.drbdNodes + g_blockTopo.drbdNum;
+    (void)strncpy_s(pstNode->drbdName, MAX_NAME_LEN, drbdName, MAX_NAME_LEN - 1);
+    (void)strncpy_s(pstNode->parentName, MAX_NAME_LEN, parentName, MAX_NAME_LEN - 1);
+    g_blockTopo.drbdNum++;
+}
+
+/* ߼drbdĸӹϵ */
+static void clearTopoNodes(void)
+{
+    int i;
+
+    for (i = 0; i < g_blockTopo.dmNum; i++)
+    {
+        free(g_blockTopo.dmNodes[i].pstDmInfo);
+    }
+    g_blockTopo.dmNum = 0;
+    g_blockTopo.drbdNum = 0;
 }
 
 /*****************************************************************************
- Function   : getMountInfo()
- Description: ȡ/proc/mountsʵļϵͳԼصӦϢ(ȥظtmp)
- Input      : N/A
- Output     : struct DiskInfo mountInfo[]     صӦļϵͳϢʹÿռĽṹ
-              int* pnMountNum                 صӦļϵͳϢĸ
+ Function   : buildBlockTopology()
+ Description: »ȡ/proc/partitionsеķб浽˻
+ Input      : struct xs_handle* handle   handle of xenstore
+ Output     : N/A
  Return     : SUCC = success, ERROR = failure
- Other      : N/A
+ Other      : ˢ/proc/partitionsգ鰴룬ֻʵʸķʹ
  *****************************************************************************/
-int getMountInfo(struct DiskInfo *mountInfo, int *pnMountNum)
+static int buildBlockTopology(struct xs_handle *handle)
 {
-    FILE *fpProcMount;
-    char szLine[MAX_STR_LEN] = {0};
-    struct DiskInfo *tmpMountInfo;
-    struct DiskInfo *firstInfo = NULL;
-    struct DiskInfo *secondInfo = NULL;
-    char szFilesystemName[MAX_NAME_LEN] = {0};
-    char szMountPointName[MAX_STR_LEN] = {0};
-    char szMountType[MAX_STR_LEN] = {0};
-    int nTmpMountNum = *pnMountNum;
-    int nMountNum = 0;
-    int nFlag = 0;
-    /* жϹصǷΪĿ¼־λ */
-    int nIsGetOneInfo = 0;
-    int i;
-    int j = 0;
+    PROC_VIEW view;
+    struct DevMajorMinor *devMajorMinor = NULL;
+    struct DeviceInfo *disks = NULL;
+    char *partitions = NULL;
+    void *shrunk = NULL;
+    int partNum = 0;
+    int diskNum = 0;
+    int nLines;
 
-    tmpMountInfo = (struct DiskInfo *)malloc(MAX_STR_LEN * sizeof(struct DiskInfo));
-    if (NULL == tmpMountInfo)
+    g_blockTopo.valid = 0;
+
+    if (SUCC != proc_source_read(PROC_PARTITIONS, PROC_SOURCE_CACHED, &view))
     {
         return ERROR;
     }
-    memset_s(tmpMountInfo, MAX_STR_LEN * sizeof(struct DiskInfo), 0, MAX_STR_LEN * sizeof(struct DiskInfo));
-
-    /* /proc/mountsļ */
-    fpProcMount = openFile(PROC_MOUNTS, "r");
-    if (NULL == fpProcMount)
+    /* ÿһ̵ĸᳬյ */
+    nLines = proc_view_lines(&view);
+    if (0 == nLines)
     {
-        free(tmpMountInfo);
-        //lint -save -e438
-        tmpMountInfo = NULL;
         return ERROR;
-        //lint -restore
     }
-
-    for (i = 0; i < nTmpMountNum; i++)
+    devMajorMinor = (struct DevMajorMinor *)calloc(nLines, sizeof(struct DevMajorMinor));
+    disks = (struct DeviceInfo *)calloc(nLines, sizeof(struct DeviceInfo));
+    if (NULL == devMajorMinor || NULL == disks)
     {
-        firstInfo = tmpMountInfo + i;
-        secondInfo = mountInfo + i;
-        (void)strncpy_s(firstInfo->filesystem, MAX_STR_LEN, secondInfo->filesystem, strlen(secondInfo->filesystem));
+        free(devMajorMinor);
+        free(disks);
+        return ERROR;
     }
 
-    /* ѭȡÿһ */
-    while (fgets(szLine, sizeof(szLine), fpProcMount))
+    if (ERROR == getPartitionsInfo(handle, devMajorMinor, &partNum, disks, &diskNum, nLines)
+        || 0 == partNum || 0 == diskNum
+        || NULL == (partitions = (char *)malloc(view.len + 1)))
     {
-        /* ʽȡӦҪ */
-        if (sscanf_s(szLine, "%s %s %s %*[^\n ]", 
-                    szFilesystemName, sizeof(szFilesystemName), 
-                    szMountPointName, sizeof(szMountPointName),
-                    szMountType, sizeof(szMountType)) != 3)
-        {
-            continue;
-        }
+        free(devMajorMinor);
+        free(disks);
+        return ERROR;
+    }
+    /* ¼ν/proc/partitionsݣжϷǷ仯 */
+    (void)memcpy_s(partitions, view.len + 1, view.data, view.len);
 
-        /* ȥ/dev/ͷļϵͳtmpfsȣȥloop豸ȥظص/Ŀ¼ĺ漸ļϵͳ
+    free(g_blockTopo.devMajorMinor);
+    free(g_blockTopo.disks);
+    free(g_blockTopo.partitions);
+    /* ʵʸʧʱԭ */
+    shrunk = realloc(devMajorMinor, partNum * sizeof(struct DevMajorMinor));
+    if (NULL != shrunk)
+    {
+        devMajorMinor = (struct DevMajorMinor *)shrunk;
+    }
+    shrunk = realloc(disks, diskNum * sizeof(struct DeviceInfo));
+    if (NULL != shrunk)
+    {
+        disks = (struct DeviceInfo *)shrunk;
+    }
+    g_blockTopo.devMajorMinor = devMajorMinor;
+    g_blockTopo.disks = disks;
+    g_blockTopo.partitions = partitions;
+    g_blockTopo.partitionsLen = view.len;
+    g_blockTopo.partNum = partNum;
+    g_blockTopo.diskNum = diskNum;
+    g_blockTopo.valid = 1;
+    return SUCC;
+}
+
+/*****************************************************************************
+ Function   : refreshBlockTopology()
+ Description: 豸˻ǷȻЧҪʱؽ
+ Input      : struct xs_handle* handle   handle of xenstore
+ Output     : N/A
+ Return     : SUCC = success, ERROR = failure
+ Other      : N/A
+ *****************************************************************************/
+static int refreshBlockTopology(struct xs_handle *handle)
+{
+    PROC_VIEW view;
+    int nUeventValid;
+    unsigned int ueventGen;
+
+    nUeventValid = (SUCC == uevent_refresh());
+    ueventGen = uevent_generation(UEVENT_BLOCK);
+
+    /* ӳı仯ֻͨuevent֪ */
+    if (!nUeventValid || ueventGen != g_blockTopo.ueventGen)
+    {
+        clearTopoNodes();
+    }
+
+    if (SUCC != proc_source_read(PROC_PARTITIONS, PROC_SOURCE_REFRESH, &view))
+    {
+        g_blockTopo.valid = 0;
+        return ERROR;
+    }
+    if (g_blockTopo.valid && ueventGen == g_blockTopo.ueventGen
+        && view.len == g_blockTopo.partitionsLen && 0 == memcmp(view.data, g_blockTopo.partitions, view.len))
+    {
+        return SUCC;
+    }
+
+    clearTopoNodes();
+    g_blockTopo.ueventGen = ueventGen;
+    return buildBlockTopology(handle);
+}
+
+/*****************************************************************************
+ Function   : getDrbdParentByCmd()
+ Description: sysfsûdrbd豸²豸ʱͨdrbdsetupȡڵ
+ Input      : char* drbdName                     drbd豸
+ Output     : char* parentName                   ڵ
+ Return     : SUCC = success, ERROR = failure
+ Other      : N/A
+ *****************************************************************************/
+static int getDrbdParentByCmd(const char *drbdName, char *parentName, int size)
+{
+    char szCmd[MAX_STR_LEN] = {0};
+    FILE *fpDmCmd;
+    char szLine[MAX_STR_LEN] = {0};
+
+    /* ݵǰdrbd豸drbdsetupȡ豸 */
+    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "drbdsetup \"%s$\" show |grep /dev", drbdName);
+    fpDmCmd = openPipe(szCmd, "r");
+    if (NULL == fpDmCmd)
+    {
+        return ERROR;
+    }
+
+    /* ȡִнļָ */
+    if (NULL != fgets(szLine, sizeof(szLine), fpDmCmd))
+    {
+        /* drbdsetupȡ豸 */
+        if (sscanf_s(szLine, "%*[^\"]\"%[^\"]", parentName, size) != 1)
+        {
+            (void)pclose(fpDmCmd);
+            return ERROR;
+        }
+    }
+
+    (void)pclose(fpDmCmd);
+    //lint -save -e438
+    fpDmCmd = NULL;
+    //lint -restore
+    return SUCC;
+}
+
+/*****************************************************************************
+ Function   : getDrbdParent()
+ Description: drbd豸ȡӦĸڵ
+ Input      : char* drbdName                     drbd豸
+ Output     : char* parentName                   ڵ
+ Return     : 0
+ Other      : N/A
+ *****************************************************************************/
+int getDrbdParent(char *drbdName, char *parentName)
+{
+    char tmpParentName[MAX_NAME_LEN] = {0};
+    struct stat statBuf;
+    DM_SLAVE stSlave;
+
+    if(SUCC != CheckName(drbdName))
+    {
+        return ERROR;
+    }
+
+    /* 豸ѻʱֱʹ */
+    if (SUCC != getTopoDrbdParent(drbdName, tmpParentName, sizeof(tmpParentName)))
+    {
+        /* ȴ/sys/dev/block/M:m/slavesȡ豸ȡʱٵdrbdsetup */
+        if (0 == stat(drbdName, &statBuf) && 1 == dm_slaves_read(statBuf.st_rdev, &stSlave, 1))
+        {
+            (void)snprintf_s(tmpParentName, sizeof(tmpParentName), sizeof(tmpParentName), "/dev/%s", stSlave.name);
+        }
+        else if (SUCC != getDrbdParentByCmd(drbdName, tmpParentName, sizeof(tmpParentName)))
+        {
+            return 0;
+        }
+        addTopoDrbdNode(drbdName, tmpParentName);
+    }
+
+    memset_s(parentName, strlen(parentName), 0, strlen(parentName));
+    (void)strncpy_s(parentName, strlen(parentName) + 1, tmpParentName, strlen(tmpParentName));
+
+    return 0;
+}
+
+/*****************************************************************************
+ Function   : getMountInfo()
+ Description: ȡ/proc/mountsʵļϵͳԼصӦϢ(ȥظtmp)
+ Input      : int nCapacity                   mountInfo
+ Output     : struct DiskInfo mountInfo[]     صӦļϵͳϢʹÿռĽṹ
+              int* pnMountNum                 صӦļϵͳϢĸ
+ Return     : SUCC = success, ERROR = failure
+ Other      : һζȡ/proc/mountsգʱȡg_diskArena
+ *****************************************************************************/
+int getMountInfo(struct DiskInfo *mountInfo, int *pnMountNum, int nCapacity)
+{
+    PROC_VIEW view;
+    char szLine[MAX_STR_LEN] = {0};
+    struct DiskInfo *tmpMountInfo;
+    struct DiskInfo *firstInfo = NULL;
+    struct DiskInfo *secondInfo = NULL;
+    char szFilesystemName[MAX_NAME_LEN] = {0};
+    char szMountPointName[MAX_STR_LEN] = {0};
+    char szMountType[MAX_STR_LEN] = {0};
+    int nTmpMountNum = *pnMountNum;
+    int nMountNum = 0;
+    int nFlag = 0;
+    /* жϹصǷΪĿ¼־λ */
+    int nIsGetOneInfo = 0;
+    int i;
+    int j = 0;
+
+    /* ȥغļ¼diskMap */
+    tmpMountInfo = (struct DiskInfo *)arena_alloc(&g_diskArena, nCapacity * sizeof(struct DiskInfo));
+    if (NULL == tmpMountInfo)
+    {
+        return ERROR;
+    }
+
+    if (SUCC != proc_source_read(PROC_MOUNTS, PROC_SOURCE_CACHED, &view))
+    {
+        return ERROR;
+    }
+
+    for (i = 0; i < nTmpMountNum; i++)
+    {
+        firstInfo = tmpMountInfo + i;
+        secondInfo = mountInfo + i;
+        (void)strncpy_s(firstInfo->filesystem, MAX_FS_NAME_LEN, secondInfo->filesystem, strlen(secondInfo->filesystem));
+    }
+
+    /* ѭȡÿһ */
+    while (proc_view_gets(szLine, sizeof(szLine), &view))
+    {
+        /* ʽȡӦҪ */
+        if (sscanf_s(szLine, "%s %s %s %*[^\n ]", 
+                    szFilesystemName, sizeof(szFilesystemName), 
+                    szMountPointName, sizeof(szMountPointName),
+                    szMountType, sizeof(szMountType)) != 3)
+        {
+            continue;
+        }
+
+        /* ȥ/dev/ͷļϵͳtmpfsȣȥloop豸ȥظص/Ŀ¼ĺ漸ļϵͳ
          * ȥcdromĹص㣬صĹramfsiso9660
          */
         if (0 != strncmp(szFilesystemName, "/dev/", 5) || 0 == strncmp(szFilesystemName, "/dev/loop", 9)
@@ -1118,17 +1076,17 @@ int getMountInfo(struct DiskInfo *mountInfo, int *pnMountNum)
             /* ѯtmpMountInfoǷڸùصӦϢѾڣtmpMountInfoиùصӦϢ */
             if (0 == strcmp(szMountPointName, firstInfo->mountPoint))
             {
-                memset_s(firstInfo->filesystem, MAX_STR_LEN, 0, strlen(firstInfo->filesystem));
-                (void)strncpy_s(firstInfo->filesystem, MAX_STR_LEN, szFilesystemName, strlen(szFilesystemName));
+                memset_s(firstInfo->filesystem, MAX_FS_NAME_LEN, 0, strlen(firstInfo->filesystem));
+                (void)strncpy_s(firstInfo->filesystem, MAX_FS_NAME_LEN, szFilesystemName, strlen(szFilesystemName));
                 nFlag = 1;
                 break;
             }
         }
-        if (0 == nFlag)
+        if (0 == nFlag && nTmpMountNum < nCapacity)
         {
             firstInfo = tmpMountInfo + nTmpMountNum;
             /* жͨ˵ϢΪҪӵһ¼¼ӵӦṹУݼۼ */
-            strncpy_s(firstInfo->filesystem, MAX_STR_LEN, szFilesystemName, strlen(szFilesystemName));
+            strncpy_s(firstInfo->filesystem, MAX_FS_NAME_LEN, szFilesystemName, strlen(szFilesystemName));
             strncpy_s(firstInfo->mountPoint, MAX_STR_LEN, szMountPointName, strlen(szMountPointName));
             nTmpMountNum++;
         }
@@ -1155,23 +1113,20 @@ int getMountInfo(struct DiskInfo *mountInfo, int *pnMountNum)
             nFlag = 0;
             continue;
         }
+        if (nMountNum >= nCapacity)
+        {
+            break;
+        }
         secondInfo = mountInfo + nMountNum;
         /* mountInfoûиļϵͳӦϢһ¼¼ݼۼ */
-        strncpy_s(secondInfo->filesystem, MAX_STR_LEN, firstInfo->filesystem, strlen(firstInfo->filesystem));
+        strncpy_s(secondInfo->filesystem, MAX_FS_NAME_LEN, firstInfo->filesystem, strlen(firstInfo->filesystem));
         strncpy_s(secondInfo->mountPoint, MAX_STR_LEN, firstInfo->mountPoint, strlen(firstInfo->mountPoint));
         nMountNum++;
     }
 
     *pnMountNum = nMountNum;
-    (void)fclose(fpProcMount);
-    //lint -save -e438
-    fpProcMount = NULL;
-
-    free(tmpMountInfo);
-    tmpMountInfo = NULL;
 
     return SUCC;
-    //lint -restore
 }
 
 /*****************************************************************************
@@ -1181,15 +1136,14 @@ int getMountInfo(struct DiskInfo *mountInfo, int *pnMountNum)
               int partNum                            
               int devID                              豸豸
  Output     : char* devName                          ڵ
-              char* devBlockSize                     ڵռС
- Return     : 0
+              unsigned long long* devBlockSize       ڵռС(KB)
+ Return     : SUCC = ҵ豸, ERROR = /proc/partitionsûи豸
  Other      : N/A
  *****************************************************************************/
-int getInfoFromID(struct DevMajorMinor *devMajorMinor, int partNum, int devID, char *devName, char *devBlockSize)
+int getInfoFromID(struct DevMajorMinor *devMajorMinor, int partNum, int devID, char *devName, unsigned long long *devBlockSize)
 {
     int i;
     char szDevName[MAX_STR_LEN] = {0};
-    char szBlockSize[MAX_STR_LEN] = {0};
     int nMajor = major(devID);
     int nMinor = minor(devID);
     struct DevMajorMinor *tmpDev = NULL;
@@ -1201,22 +1155,21 @@ int getInfoFromID(struct DevMajorMinor *devMajorMinor, int partNum, int devID, c
         if (nMajor == tmpDev->devMajor && nMinor == tmpDev->devMinor)
         {
             (void)strncpy_s(szDevName, MAX_STR_LEN, tmpDev->devName, strlen(tmpDev->devName));
-            (void)strncpy_s(szBlockSize, MAX_STR_LEN, tmpDev->devBlockSize, strlen(tmpDev->devBlockSize));
             /* devNameΪNULL豸ŶӦ豸ݸ */
             if (NULL != devName && 0 != strlen(szDevName))
             {
                 (void)strncpy_s(devName, strlen(szDevName)+1, szDevName, strlen(szDevName));
             }
             /* devBlockSizeΪNULL豸ŶӦ豸ʵʿռСݸ */
-            if (NULL != devBlockSize && 0 != strlen(szBlockSize))
+            if (NULL != devBlockSize)
             {
-                (void)strncpy_s(devBlockSize, strlen(szBlockSize)+1, szBlockSize, strlen(szBlockSize));
+                *devBlockSize = tmpDev->devBlockSize;
             }
-            break;
+            return SUCC;
         }
     }
 
-    return 0;
+    return ERROR;
 }
 
 /*****************************************************************************
@@ -1224,22 +1177,23 @@ int getInfoFromID(struct DevMajorMinor *devMajorMinor, int partNum, int devID, c
  Description: ȡdfжӦϢ洢ṹ
  Input      : struct DevMajorMinor* devMajorMinor     豸Ƽ豸Žṹ
               int partNum                             
+              int nCapacity                           diskMap
  Output     : struct DiskInfo* diskMap                صӦļϵͳϢʹÿռĽṹ
               int* pnMountNum                         ڴ洢ش
  Return     : SUCC = success, ERROR = failure
  Other      : N/A
  *****************************************************************************/
-int getDiskInfo(struct DevMajorMinor *devMajorMinor, int partNum, struct DiskInfo *diskMap, int *pnMountNum)
+int getDiskInfo(struct DevMajorMinor *devMajorMinor, int partNum, struct DiskInfo *diskMap, int *pnMountNum,
+                int nCapacity)
 {
     /* ֮ǰڵúУȻȡswapȽswapֵص */
     int nMountedFsNum = *pnMountNum;
     int nResult;
     struct statfs statfsInfo;
     struct stat statBuf;
-    char szFreeSize[MAX_STR_LEN] = {0};
-    char szFsFreeBlock[MAX_STR_LEN] = {0};
-    char szFsBlockSize[MAX_STR_LEN] = {0};
-    char szFsSize[MAX_STR_LEN] = {0};
+    unsigned long long ullFreeSize = 0;
+    unsigned long long ullFsSize = 0;
+    int nHasFree = 0;
     int i;
     struct DiskInfo *tmpDisk = NULL;
     char *substr = NULL;
@@ -1248,7 +1202,7 @@ int getDiskInfo(struct DevMajorMinor *devMajorMinor, int partNum, struct DiskInf
     int len = 0;
 
     /* getMountInfoȡصļϵͳϢ(swap֮ۼ) */
-    nResult = getMountInfo(diskMap, &nMountedFsNum);
+    nResult = getMountInfo(diskMap, &nMountedFsNum, nCapacity);
     if (ERROR == nResult)
     {
         return ERROR;
@@ -1298,37 +1252,35 @@ int getDiskInfo(struct DevMajorMinor *devMajorMinor, int partNum, struct DiskInf
             /* ܿ0mountϢǿգصϢļִָ² */
             if (statfsInfo.f_blocks > 0)
             {
-                /* ÿĴСֵszFsBlockSizeļϵͳֵṹĶӦԱ */
-                (void)snprintf_s(szFsBlockSize, sizeof(szFsBlockSize), sizeof(szFsBlockSize), "%ld", (long)statfsInfo.f_bsize);
-                /* ʣfreeĿСֵӦı */
-                (void)snprintf_s(szFsFreeBlock, sizeof(szFsFreeBlock), sizeof(szFsFreeBlock), "%lu", statfsInfo.f_bfree);
-                /* ʹַ˷ʣСм㣬תΪKB */
-                (void)strMulti(szFsFreeBlock, szFsBlockSize, szFreeSize);
-                (void)unitTransfer(szFreeSize, UNIT_TRANSFER_CYCLE, szFreeSize);
+                /* ʣfreeĿÿĴСתΪKB */
+                ullFreeSize = unitTransfer((unsigned long long)statfsInfo.f_bfree * (unsigned long long)statfsInfo.f_bsize,
+                                           UNIT_TRANSFER_CYCLE);
+                nHasFree = 1;
             }
         }
 
         tmpDisk->st_rdev = statBuf.st_rdev;
         /* ͨgetInfoFromIDļϵͳ豸ţȡӦʵʿռСϢ */
-        (void)getInfoFromID(devMajorMinor, partNum, statBuf.st_rdev, NULL, szFsSize);
-        /* ȡļϵͳʵʿռȥļϵͳʣÿռ䣬ļϵͳʹÿռ(Ϊ˼ļϵͳʽռÿռ) */
-        nResult = strMinus(szFsSize, szFreeSize, tmpDisk->usage);
-        if (ERROR == nResult)
+        if (SUCC == getInfoFromID(devMajorMinor, partNum, statBuf.st_rdev, NULL, &ullFsSize))
         {
-            return ERROR;
+            /* ȡļϵͳʵʿռȥļϵͳʣÿռ䣬ļϵͳʹÿռ(Ϊ˼ļϵͳʽռÿռ)
+             * swap */
+            if (ullFsSize < ullFreeSize)
+            {
+                return ERROR;
+            }
+            tmpDisk->usage = ullFsSize - ullFreeSize;
         }
-        /* еλת󣬴ṹӦԱ */
-        nResult = unitTransfer(tmpDisk->usage, UNIT_TRANSFER_CYCLE, tmpDisk->usage);
-        if (ERROR == nResult)
+        else if (nHasFree)
         {
             return ERROR;
         }
+        /* еλת󣬴ṹӦԱ */
+        tmpDisk->usage = unitTransfer(tmpDisk->usage, UNIT_TRANSFER_CYCLE);
 
-        /* һЩʱַϢȫ */
-        memset_s(szFsBlockSize, MAX_STR_LEN, 0, sizeof(szFsBlockSize));
-        memset_s(szFreeSize, MAX_STR_LEN, 0, sizeof(szFreeSize));
-        memset_s(szFsFreeBlock, MAX_STR_LEN, 0, sizeof(szFsFreeBlock));
-        memset_s(szFsSize, MAX_STR_LEN, 0, sizeof(szFsSize));
+        ullFreeSize = 0;
+        ullFsSize = 0;
+        nHasFree = 0;
     }
     *pnMountNum = nMountedFsNum;
 
@@ -1387,7 +1339,7 @@ int getDiskNameFromPartName(const char *pPartName, char *pDiskName)
 int addDiskUsageToDevice(struct DeviceInfo *linuxDiskUsage,
                          int diskNum,
                          const char *partitionsName,
-                         char *partitionsUsage)
+                         unsigned long long partitionsUsage)
 {
     char szTmpPartition[MAX_NAME_LEN] = {0};
     int i;
@@ -1409,7 +1361,7 @@ int addDiskUsageToDevice(struct DeviceInfo *linuxDiskUsage,
         /* ͨԱȷ豸(ĩβ)Ƿһһ򽫷ʹϢۼӵʹÿռ */
         if (0 == strcmp(szTmpPartition, tmpUsage->phyDevName))
         {
-            (void)strAdd(tmpUsage->diskUsage, partitionsUsage, tmpUsage->diskUsage);
+            tmpUsage->diskUsage += partitionsUsage;
             break;
         }
     }
@@ -1420,7 +1372,7 @@ int addDiskUsageToDevice(struct DeviceInfo *linuxDiskUsage,
 /*****************************************************************************
  Function   : getDmType()
  Description: ȡļϵͳ
- Input      : char *szLine                              dmsetupȡ
+ Input      : int devID                                 ߼豸ţͨDM ioctlȡӳ
  Output     : char *pParentMajor                        ڵ豸
               char *pParentMinor                        ڵ豸
               int *pStripCnt                            ڵ
@@ -1430,23 +1382,12 @@ int addDiskUsageToDevice(struct DeviceInfo *linuxDiskUsage,
  *****************************************************************************/
 int getDmType(int devID, int *pDmType)
 {
-    char szCmd[64] = {0};
-    FILE *fpDmCmd = NULL;
+    PROC_VIEW view;
     char szLine[MAX_STR_LEN] = {0};
 
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "dmsetup table -j %d -m %d", major(devID), minor(devID));
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
+    /* ӳdmsetup tableʽͬȡһtarget */
+    if (dm_table_read(devID, &view) <= 0 || NULL == proc_view_gets(szLine, sizeof(szLine), &view))
     {
-        printf("openPipe error \n");
-        return ERROR;
-    }
-
-    /* ѭȡִнļָ */
-    if(NULL == fgets(szLine, sizeof(szLine), fpDmCmd))
-    {
-        (void)pclose(fpDmCmd);
-        fpDmCmd = NULL;
         return ERROR;
     }
 
@@ -1479,15 +1420,13 @@ int getDmType(int devID, int *pDmType)
         *pDmType = DM_UNKNOWN;
     }
 
-    (void)pclose(fpDmCmd);
-    fpDmCmd = NULL;
     return SUCC;
 }
 
 /*****************************************************************************
  Function   : getDmStripParentNode()
  Description: strip£ȡļϵͳĸڵ
- Input      : char *szLine                              dmsetupȡ
+ Input      : int devID                                 ߼豸
  Output     : char *pParentMajor                        ڵ豸
               char *pParentMinor                        ڵ豸
               int *pStripCnt                            ڵ
@@ -1497,28 +1436,16 @@ int getDmType(int devID, int *pDmType)
  *****************************************************************************/
 int getDmStripParentNode(int devID, struct DmInfo **pstDmInfo, int *pStripCnt)
 {
-    char szCmd[64] = {0};
-    FILE *fpDmCmd = NULL;
+    PROC_VIEW view;
     char szLine[MAX_STR_LEN] = {0};
     int i = 0;
     char *tmp = NULL;
     struct DmInfo *pDmInfo = NULL;
 
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "dmsetup table -j %d -m %d", major(devID), minor(devID));
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
-    {
-        return ERROR;
-    }
-
-    if(NULL == fgets(szLine, sizeof(szLine), fpDmCmd))
+    if (dm_table_read(devID, &view) <= 0 || NULL == proc_view_gets(szLine, sizeof(szLine), &view))
     {
-        (void)pclose(fpDmCmd);
-        fpDmCmd = NULL;
         return ERROR;
     }
-    (void)pclose(fpDmCmd);
-    fpDmCmd = NULL;
 
     if (sscanf_s(szLine, "%*d %*d %*s %d %*[^\n ]", pStripCnt) != 1)
     {
@@ -1579,29 +1506,15 @@ int getDmStripParentNode(int devID, struct DmInfo **pstDmInfo, int *pStripCnt)
  *****************************************************************************/
 int getDmLinearParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
 {
-    FILE *fpDmCmd = NULL;
-    char szCmd[128] = {0};
+    PROC_VIEW view;
     char szLine[MAX_STR_LEN] = {0};
     int i = 0;
     int nFlag = SUCC;
     struct DmInfo *pDmInfo = NULL;
 
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "dmsetup table -j %d -m %d | wc -l", major(devID), minor(devID));
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
-    {
-        return ERROR;
-    }
-
-    if (NULL == fgets(szLine, sizeof(szLine), fpDmCmd))
-    {
-        (void)pclose(fpDmCmd);
-        fpDmCmd = NULL;
-        return ERROR;
-    }
-    (void)pclose(fpDmCmd);
-
-    if (sscanf_s(szLine, "%d %*[^\n ]", pCnt) != 1)
+    /* ӳÿtargetһУڵ */
+    *pCnt = dm_table_read(devID, &view);
+    if (*pCnt <= 0)
     {
         return ERROR;
     }
@@ -1613,16 +1526,7 @@ int getDmLinearParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
     }
     (void)memset_s(pDmInfo, (*pCnt) * sizeof(struct DmInfo), 0, (*pCnt) * sizeof(struct DmInfo));
 
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "dmsetup table -j %d -m %d", major(devID), minor(devID));
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
-    {
-        free(pDmInfo);
-        pDmInfo = NULL;
-        return ERROR;
-    }
-
-    while (fgets(szLine, sizeof(szLine), fpDmCmd))
+    while (i < *pCnt && NULL != proc_view_gets(szLine, sizeof(szLine), &view))
     {
         if (sscanf_s(szLine, "%*d %lld %*s %d:%d %*[^\n ]", &pDmInfo[i].nSectorNum, &pDmInfo[i].nParentMajor, &pDmInfo[i].nParentMinor) != 3)
         {
@@ -1634,8 +1538,6 @@ int getDmLinearParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
         i++;
     }
 
-    (void)pclose(fpDmCmd);
-    fpDmCmd = NULL;
     *pstDmInfo = pDmInfo;
 
     return nFlag;
@@ -1644,7 +1546,7 @@ int getDmLinearParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
 /*****************************************************************************
  Function   : getDmCryptParentNode()
  Description: crypt£ȡļϵͳĸڵ
- Input      : char *szLine                              dmsetupȡ
+ Input      : int devID                                 ߼豸
  Output     : char *pParentMajor                        ڵ豸
               char *pParentMinor                        ڵ豸
               int *pStripCnt                            ڵ
@@ -1654,15 +1556,12 @@ int getDmLinearParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
  *****************************************************************************/
 int getDmCryptParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
 {
-    char szCmd[64] = {0};
-    FILE *fpDmCmd = NULL;
+    PROC_VIEW view;
     char szLine[MAX_STR_LEN] = {0};
     int i = 0;
     struct DmInfo *pDmInfo = NULL;
 
-    (void)snprintf_s(szCmd, sizeof(szCmd), sizeof(szCmd), "dmsetup table -j %d -m %d", major(devID), minor(devID));
-    fpDmCmd = openPipe(szCmd, "r");
-    if (NULL == fpDmCmd)
+    if (dm_table_read(devID, &view) < 0)
     {
         return ERROR;
     }
@@ -1670,28 +1569,21 @@ int getDmCryptParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
     pDmInfo = (struct DmInfo *)malloc(sizeof(struct DmInfo));
     if (NULL == pDmInfo)
     {
-        (void)pclose(fpDmCmd);
-        fpDmCmd = NULL;
         return ERROR;
     }
     (void)memset_s(pDmInfo, sizeof(struct DmInfo), 0, sizeof(struct DmInfo));
 
-    while (fgets(szLine, sizeof(szLine), fpDmCmd))
+    while (NULL != proc_view_gets(szLine, sizeof(szLine), &view))
     {
         if(i > 0 || sscanf_s(szLine, "%*d %*d %*s %*s %*s %*d %d:%d %*[^\n ]", &pDmInfo[i].nParentMajor, &pDmInfo[i].nParentMinor) != 2)
         {
             free(pDmInfo);
             pDmInfo = NULL;
-            (void)pclose(fpDmCmd);
-            fpDmCmd = NULL;
             return ERROR;
         }
         i++;
     }
 
-    (void)pclose(fpDmCmd);
-    fpDmCmd = NULL;
-
     /* ܸʽֻ1ڵ */
     *pCnt = 1;
     *pstDmInfo = pDmInfo;
@@ -1699,40 +1591,77 @@ int getDmCryptParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
 }
 
 /*****************************************************************************
- Function   : getDmParentNode()
- Description: ļϵͳ豸ţȡļϵͳĸڵ
- Input      : struct DevMajorMinor* devMajorMinor       /proc/partitions豸豸Žṹ
-              int partNum                               Ӧϵ
-              int devID                                 ļϵͳ豸
- Output     : char* parentName                          ڵ
+ Function   : getDmSlavesParentNode()
+ Description: ޷ͨ/dev/mapper/controlȡӳʱsysfsȡ߼²豸
+ Input      : int devID                                 ߼豸
+ Output     : struct DmInfo **pstDmInfo                 ڵ豸
+              int *pCnt                                 ڵ
  Return     : SUCC = success, ERROR = failure
- Other      : N/A
- History    : 2011.09.16, created this function.
+ Other      : sysfsûиεʹÿռ䰴²豸ƽ̯
  *****************************************************************************/
-int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *devMajorMinor, struct NumberCount numCnt, int devID, long long usage)
+int getDmSlavesParentNode(int devID, struct DmInfo **pstDmInfo, int *pCnt)
 {
-    char szRealName[MAX_NAME_LEN] = {0};
-    int nParentDevID = 0;
-    int nFlag = SUCC;
-    int nParentCnt = 0;
-    struct DmInfo *pstDmInfo = NULL;
+    DM_SLAVE stSlaves[MAX_DM_SLAVE_NUM];
+    struct DmInfo *pDmInfo = NULL;
     int i = 0;
-    char szUsage[64] = {0};
-    char szDiskName[MAX_NAME_LEN] = {0};
+
+    *pCnt = dm_slaves_read(devID, stSlaves, MAX_DM_SLAVE_NUM);
+    if (*pCnt <= 0)
+    {
+        return ERROR;
+    }
+
+    pDmInfo = (struct DmInfo *)malloc((*pCnt) * sizeof(struct DmInfo));
+    if (NULL == pDmInfo)
+    {
+        return ERROR;
+    }
+
+    for (i = 0; i < *pCnt; i++)
+    {
+        pDmInfo[i].nParentMajor = stSlaves[i].major;
+        pDmInfo[i].nParentMinor = stSlaves[i].minor;
+        pDmInfo[i].nSectorNum = (long long)stSlaves[i].sectors;
+    }
+
+    *pstDmInfo = pDmInfo;
+    return SUCC;
+}
+
+/*****************************************************************************
+ Function   : resolveDmParentNode()
+ Description: ȡ߼ӳȡӳͼڵ㣬˻
+ Input      : int devID                                 ߼豸
+ Output     : int *pDmType                              ӳ
+              struct DmInfo **pstDmInfo                 ڵϢ黺
+              int *pCnt                                 ڵ
+ Return     : SUCC = success, ERROR = failure
+ Other      : raidsnapshotmirrorݲ0ڵ㻺
+ *****************************************************************************/
+static int resolveDmParentNode(int devID, int *pDmType, struct DmInfo **pstDmInfo, int *pCnt)
+{
     int nDmType = 0;
-    long long lsubusage = 0L;
-    long long lpvSize = 0L;
+    int nParentCnt = 0;
+    struct DmInfo *pstDmInfoTmp = NULL;
 
     if(SUCC != getDmType(devID, &nDmType))
     {
-        return ERROR;
+        nDmType = DM_SLAVES;
     }
 
     switch(nDmType)
     {
+        case DM_SLAVES:
+        {
+            if(SUCC != getDmSlavesParentNode(devID, &pstDmInfoTmp, &nParentCnt))
+            {
+                return ERROR;
+            }
+            break;
+        }
         case DM_LINEAR:
         {
-            if(SUCC != getDmLinearParentNode(devID, &pstDmInfo, &nParentCnt))
+            if(SUCC != getDmLinearParentNode(devID, &pstDmInfoTmp, &nParentCnt))
             {
                 return ERROR;
             }
@@ -1740,7 +1669,7 @@ int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *dev
         }
         case DM_STRIPED:
         {
-            if(SUCC != getDmStripParentNode(devID, &pstDmInfo, &nParentCnt))
+            if(SUCC != getDmStripParentNode(devID, &pstDmInfoTmp, &nParentCnt))
             {
                 return ERROR;
             }
@@ -1748,7 +1677,7 @@ int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *dev
         }
         case DM_CRYPT:
         {
-            if(SUCC != getDmCryptParentNode(devID, &pstDmInfo, &nParentCnt))
+            if(SUCC != getDmCryptParentNode(devID, &pstDmInfoTmp, &nParentCnt))
             {
                 return ERROR;
             }
@@ -1759,15 +1688,65 @@ int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *dev
         case DM_MIRROR:
         default:
         {
-            /* ʱسɹ */
-            return SUCC;
+            /* ʱ */
+            break;
         }
     }
 
+    if (SUCC != addTopoDmNode(devID, nDmType, pstDmInfoTmp, nParentCnt))
+    {
+        free(pstDmInfoTmp);
+        return ERROR;
+    }
+
+    *pDmType = nDmType;
+    *pstDmInfo = pstDmInfoTmp;
+    *pCnt = nParentCnt;
+    return SUCC;
+}
+
+/*****************************************************************************
+ Function   : getDmParentNode()
+ Description: ļϵͳ豸ţȡļϵͳĸڵ
+ Input      : struct DevMajorMinor* devMajorMinor       /proc/partitions豸豸Žṹ
+              int partNum                               Ӧϵ
+              int devID                                 ļϵͳ豸
+ Output     : char* parentName                          ڵ
+ Return     : SUCC = success, ERROR = failure
+ Other      : N/A
+ History    : 2011.09.16, created this function.
+ *****************************************************************************/
+int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *devMajorMinor, struct NumberCount numCnt, int devID, long long usage)
+{
+    char szRealName[MAX_NAME_LEN] = {0};
+    int nParentDevID = 0;
+    int nFlag = SUCC;
+    int nParentCnt = 0;
+    struct DmInfo *pstDmInfo = NULL;
+    int i = 0;
+    char szDiskName[MAX_NAME_LEN] = {0};
+    int nDmType = 0;
+    long long lsubusage = 0L;
+    long long lpvSize = 0L;
+    struct TopoDmNode *pstNode = NULL;
+
+    /* ߼ĸڵѻʱֱʹãȡӳ뻺 */
+    pstNode = getTopoDmNode(devID);
+    if (NULL != pstNode)
+    {
+        nDmType = pstNode->nDmType;
+        nParentCnt = pstNode->nParentCnt;
+        pstDmInfo = pstNode->pstDmInfo;
+    }
+    else if (SUCC != resolveDmParentNode(devID, &nDmType, &pstDmInfo, &nParentCnt))
+    {
+        return ERROR;
+    }
+
     for (i = 0; i < nParentCnt && usage > 0; i++)
     {
-        /* nParentCnt=1黯ͬ */
-        if (DM_CRYPT == nDmType || DM_STRIPED == nDmType)
+        /* nParentCnt=1黯ͬsysfsе²豸ͬƽ̯ */
+        if (DM_CRYPT == nDmType || DM_STRIPED == nDmType || DM_SLAVES == nDmType)
         {
             lsubusage = usage / nParentCnt;
         }
@@ -1809,14 +1788,12 @@ int getDmParentNode(struct DeviceInfo *linuxDiskUsage, struct DevMajorMinor *dev
             if (0 != strlen(szRealName))
             {
                 /* ͨaddDiskUsageToDeviceķʹÿռۼӵӦĴ */
-                (void)snprintf_s(szUsage, sizeof(szUsage), sizeof(szUsage), "%lld", lsubusage);
-                (void)addDiskUsageToDevice(linuxDiskUsage, numCnt.diskNum, szRealName, szUsage);
+                (void)addDiskUsageToDevice(linuxDiskUsage, numCnt.diskNum, szRealName, (unsigned long long)lsubusage);
                 (void)memset_s(szRealName, MAX_NAME_LEN, 0, sizeof(szRealName));
             }
         }
     }
 
-    free(pstDmInfo);
     return nFlag;
 }
 
@@ -1846,7 +1823,7 @@ int getAllDeviceUsage(struct DevMajorMinor *devMajorMinor, struct DeviceInfo *li
     for (i = 0; i < numberCount.mountNum; i++)
     {
         tmpDisk = diskMap + i;
-        usage = atoll(tmpDisk->usage);
+        usage = (long long)tmpDisk->usage;
 
         /* mount¼ļϵͳdrbd豸ʱҪҵӦĸ豸 */
         if (NULL != strstr(tmpDisk->filesystem, "drbd"))
@@ -1862,9 +1839,9 @@ int getAllDeviceUsage(struct DevMajorMinor *devMajorMinor, struct DeviceInfo *li
             tmpDisk->st_rdev = statBuf.st_rdev;
         }
 
-        if (g_deviceMapperNum == major(tmpDisk->st_rdev))
+        if ((unsigned int)g_deviceMapperNum == major(tmpDisk->st_rdev))
         {
-            /* ͨdmsetupȡ߼Ӧ豸 */
+            /* ͨdevice-mapperӳȡ߼Ӧ豸 */
             nResult = getDmParentNode(linuxDiskUsage, devMajorMinor, numberCount, tmpDisk->st_rdev, usage);
             if (ERROR == nResult)
             {
@@ -1887,36 +1864,37 @@ int getAllDeviceUsage(struct DevMajorMinor *devMajorMinor, struct DeviceInfo *li
 }
 
 /*****************************************************************************
- Function   : freeSpace()
- Description: ͷṹ뵽Ŀռ
- Input      : N/A
- Output     : struct DevMajorMinor* devMajorMinor   豸豸Žṹ
-            struct DeviceInfo* linuxDiskUsage     Ƽʹÿռ䡢ܿռĽṹ
-            struct DiskInfo* diskMap              صӦļϵͳϢʹÿռĽṹ
- Return     : void
+ Function   : perfbinDiskUsage()
+ Description: дܼ¼ֵַ61̵
+ Input      : struct DeviceInfo* diskUsage   ̵ܿռʹÿռ
+              int nDiskNum                  ̸
+              ullTotalSize, ullTotalUsage   д̵ܿռʹÿռ(MB)
+ Output     : N/A
+ Return     : N/A
  Other      : N/A
  *****************************************************************************/
-void freeSpace(struct DevMajorMinor *devMajorMinor, struct DeviceInfo *linuxDiskUsage, struct DiskInfo *diskMap)
+static void perfbinDiskUsage(const struct DeviceInfo *diskUsage, int nDiskNum,
+                             unsigned long long ullTotalSize, unsigned long long ullTotalUsage)
 {
-    //lint -save -e438
-    if (devMajorMinor != NULL)
-    {
-        free(devMajorMinor);
-        devMajorMinor = NULL;
-    }
-
-    if (linuxDiskUsage != NULL)
-    {
-        free(linuxDiskUsage);
-        linuxDiskUsage = NULL;
-    }
+    unsigned char raw[PERFBIN_RAW_MAX];
+    PERFBIN_BUF buf;
+    size_t mark;
+    int i;
 
-    if (diskMap != NULL)
+    perfbin_buf_init(&buf, raw, sizeof(raw));
+    mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_DISK_TOTAL);
+    perfbin_put_uint(&buf, ullTotalSize);
+    perfbin_put_uint(&buf, ullTotalUsage);
+    perfbin_tlv_end(&buf, mark);
+    for (i = 0; i < nDiskNum; i++)
     {
-        free(diskMap);
-        diskMap = NULL;
+        mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_DISK);
+        perfbin_put_str(&buf, diskUsage[i].phyDevName);
+        perfbin_put_uint(&buf, diskUsage[i].deviceTotalSpace);
+        perfbin_put_uint(&buf, diskUsage[i].diskUsage);
+        perfbin_tlv_end(&buf, mark);
     }
-    //lint -restore
+    perfbin_section_set(PERFBIN_SECTION_DISK, &buf);
 }
 
 /*****************************************************************************
@@ -1929,16 +1907,18 @@ void freeSpace(struct DevMajorMinor *devMajorMinor, struct DeviceInfo *linuxDisk
  *****************************************************************************/
 int getDiskUsage(struct xs_handle *handle, char pszDiskUsage[][MAX_DISKUSAGE_LEN], int *row_num)
 {
-    /* 洢ܴ̿ռϢַ(λΪMB) */
-    char szTotalSize[MAX_DISKUSAGE_LEN] = {0};
-    /* 洢ʹÿռϢַ(λΪMB) */
-    char szTotalUsage[MAX_DISKUSAGE_LEN] = {0};
+    /* ܴ̿ռ(λΪMB) */
+    unsigned long long ullTotalSize = 0;
+    /* ʹÿռ(λΪMB) */
+    unsigned long long ullTotalUsage = 0;
     /* 洢ÿϢӵַ */
     char szUsageString[MAX_ROWS][MAX_DISKUSAGE_LEN] = {0};
-    struct DevMajorMinor *devMajorMinor;
-    struct DeviceInfo *linuxDiskUsage;
+    struct DeviceInfo *linuxDiskUsage = NULL;
     struct DiskInfo *diskMap = NULL;
     struct NumberCount numberCount = {0};
+    PROC_VIEW swapsView;
+    PROC_VIEW mountsView;
+    int nMapCapacity;
     int nSwapNum;
     int nResult = 0;
     int i;
@@ -1948,82 +1928,68 @@ int getDiskUsage(struct xs_handle *handle, char pszDiskUsage[][MAX_DISKUSAGE_LEN
 
     *row_num = 0;
 
-    devMajorMinor = (struct DevMajorMinor *)malloc(MAX_DISKUSAGE_LEN * sizeof(struct DevMajorMinor));
-    if (NULL == devMajorMinor)
-    {
-        return ERROR;
-    }
-    memset_s(devMajorMinor, 
-        MAX_DISKUSAGE_LEN * sizeof(struct DevMajorMinor), 
-        0, 
-        MAX_DISKUSAGE_LEN * sizeof(struct DevMajorMinor));
-
-    linuxDiskUsage = (struct DeviceInfo *)malloc(MAX_DISK_NUMBER * sizeof(struct DeviceInfo));
-    if (NULL == linuxDiskUsage)
-    {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
-        return ERROR;
-    }
-    memset_s(linuxDiskUsage, 
-        MAX_DISK_NUMBER * sizeof(struct DeviceInfo),
-        0, 
-        MAX_DISK_NUMBER * sizeof(struct DeviceInfo));
-
-    diskMap = (struct DiskInfo *)malloc(MAX_DISKUSAGE_LEN * sizeof(struct DiskInfo));
-    if (NULL == diskMap)
-    {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
-        return ERROR;
-    }
-    memset_s(diskMap, 
-        MAX_DISKUSAGE_LEN * sizeof(struct DiskInfo),
-        0, 
-        MAX_DISKUSAGE_LEN * sizeof(struct DiskInfo));
-
     /* Ӧdevice-mapper͵豸Ϊ0getDeviceMapperNumberȡ豸 */
     if (0 == g_deviceMapperNum)
     {
         nResult = getDeviceMapperNumber();
         if (ERROR == nResult)
         {
-            freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
             return ERROR;
         }
     }
 
     /*
-     * getPartitionsInfoȡ̣ԼӦĴܿռСKB豸Ϣ
-     * ȡӦ豸ռСfdiskӦϢ
+     * ˻ȡ̣ԼӦĴܿռСKB豸Ϣ
+     * ԼӦ豸ռСfdiskӦϢ仯ʱgetPartitionsInfoؽ
      */
-    nResult = getPartitionsInfo(handle, devMajorMinor, &numberCount.partNum, linuxDiskUsage, &numberCount.diskNum);
-    if (ERROR == nResult || 0 == numberCount.partNum || 0 == numberCount.diskNum)
+    nResult = refreshBlockTopology(handle);
+    if (ERROR == nResult)
     {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
         return ERROR;
     }
+    numberCount.partNum = g_blockTopo.partNum;
+    numberCount.diskNum = g_blockTopo.diskNum;
+
+    /* ȡڵ/proc/swaps/proc/mountsswapصĸᳬߵ֮ */
+    if (SUCC != proc_source_read(PROC_SWAPS, PROC_SOURCE_REFRESH, &swapsView)
+        || SUCC != proc_source_read(PROC_MOUNTS, PROC_SOURCE_REFRESH, &mountsView))
+    {
+        return ERROR;
+    }
+    nMapCapacity = proc_view_lines(&swapsView) + proc_view_lines(&mountsView);
+
+    linuxDiskUsage = (struct DeviceInfo *)arena_alloc(&g_diskArena, numberCount.diskNum * sizeof(struct DeviceInfo));
+    diskMap = (struct DiskInfo *)arena_alloc(&g_diskArena, nMapCapacity * sizeof(struct DiskInfo));
+    if (NULL == linuxDiskUsage || NULL == diskMap)
+    {
+        arena_reset(&g_diskArena);
+        return ERROR;
+    }
+    (void)memcpy_s(linuxDiskUsage, numberCount.diskNum * sizeof(struct DeviceInfo),
+                   g_blockTopo.disks, numberCount.diskNum * sizeof(struct DeviceInfo));
 
     /* getSwapInfoȡǰswapϢ */
-    nResult = getSwapInfo(diskMap, &numberCount.mountNum);
+    nResult = getSwapInfo(diskMap, &numberCount.mountNum, nMapCapacity);
     if (ERROR == nResult)
     {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
+        arena_reset(&g_diskArena);
         return ERROR;
     }
     nSwapNum = numberCount.mountNum;
 
     /* getDiskInfoȡǰصļϵͳص㣬豸ԼʹÿռϢ */
-    nResult = getDiskInfo(devMajorMinor, numberCount.partNum, diskMap, &numberCount.mountNum);
+    nResult = getDiskInfo(g_blockTopo.devMajorMinor, numberCount.partNum, diskMap, &numberCount.mountNum, nMapCapacity);
     if (ERROR == nResult || nSwapNum >= numberCount.mountNum)
     {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
+        arena_reset(&g_diskArena);
         return ERROR;
     }
 
-    /* getAllDeviceUsageͨȡĹصļϵͳʹϢҶӦĸ豸Ӧ̵ʹϢ */
-    nResult = getAllDeviceUsage(devMajorMinor, linuxDiskUsage, diskMap, numberCount);
+    /* getAllDeviceUsageػĸӹϵҶӦĸ豸Ӧ̵ʹϢ */
+    nResult = getAllDeviceUsage(g_blockTopo.devMajorMinor, linuxDiskUsage, diskMap, numberCount);
     if (ERROR == nResult)
     {
-        freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
+        arena_reset(&g_diskArena);
         return ERROR;
     }
 
@@ -2031,15 +1997,15 @@ int getDiskUsage(struct xs_handle *handle, char pszDiskUsage[][MAX_DISKUSAGE_LEN
     for (i = 0; i < numberCount.diskNum; i++)
     {
         /* ȡϢתΪַҼܿռС */
-        (void)strAdd(linuxDiskUsage[i].deviceTotalSpace, szTotalSize, szTotalSize);
-        (void)strAdd(linuxDiskUsage[i].diskUsage, szTotalUsage, szTotalUsage);
+        ullTotalSize += linuxDiskUsage[i].deviceTotalSpace;
+        ullTotalUsage += linuxDiskUsage[i].diskUsage;
         //ֻƴ61Ϣ(1+60)
         if(i <= MAX_DISKUSAGE_STRING_NUM) {
             *row_num = i / MAX_DISKUSAGE_NUM_PER_KEY;
             (void)snprintf_s(szUsageString[*row_num] + strlen(szUsageString[*row_num]), 
                             (MAX_DISKUSAGE_LEN - strlen(szUsageString[*row_num])), 
                             (MAX_DISKUSAGE_LEN - strlen(szUsageString[*row_num])), 
-                            "%s:%s:%s;",
+                            "%s:%llu:%llu;",
                             linuxDiskUsage[i].phyDevName, 
                             linuxDiskUsage[i].deviceTotalSpace, 
                             linuxDiskUsage[i].diskUsage);
@@ -2050,16 +2016,201 @@ int getDiskUsage(struct xs_handle *handle, char pszDiskUsage[][MAX_DISKUSAGE_LEN
     for (i = 0; i <= *row_num; i++) {
         if (0 == i)
             (void)snprintf_s(pszDiskUsage[i], MAX_DISKUSAGE_LEN, MAX_DISKUSAGE_LEN, 
-                    "0:%s:%s;%s", szTotalSize, szTotalUsage, szUsageString[i]);
+                    "0:%llu:%llu;%s", ullTotalSize, ullTotalUsage, szUsageString[i]);
         else
             (void)snprintf_s(pszDiskUsage[i], MAX_DISKUSAGE_LEN, MAX_DISKUSAGE_LEN, 
                     "%s", szUsageString[i]);
     }
 
-    freeSpace(devMajorMinor, linuxDiskUsage, diskMap);
+    if (perfbin_enabled())
+    {
+        perfbinDiskUsage(linuxDiskUsage, numberCount.diskNum, ullTotalSize, ullTotalUsage);
+    }
+
+    arena_reset(&g_diskArena);
+
+    return SUCC;
+}
+
+/* dfͳƵαļϵͳ */
+static const char *g_dummyFsTypes[] =
+{
+    "autofs", "proc", "subfs", "debugfs", "devpts", "fusectl", "fuse.portal", "mqueue",
+    "rpc_pipefs", "sysfs", "devfs", "kernfs", "ignore", "none", "rootfs", NULL
+};
+
+/* df -lΪļϵͳ */
+static const char *g_remoteFsTypes[] =
+{
+    "acfs", "afs", "coda", "auristorfs", "fhgfs", "gpfs", "ibrix", "ocfs2", "vxfs", NULL
+};
+
+static int isFsTypeInList(const char *pszType, const char **ppList)
+{
+    int i;
+
+    for (i = 0; NULL != ppList[i]; i++)
+    {
+        if (0 == strcmp(pszType, ppList[i]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*****************************************************************************
+ Function   : isLocalFs()
+ Description: df -lmP | grep -v tmpfs | grep -v shmĹжǷϱļϵͳ
+ Input      : const char *pszSource                 ļϵͳӦFilesystem
+              const char *pszMountPoint             ص
+              const char *pszType                   ļϵͳ
+ Output     : N/A
+ Return     : 1 = ϱ0 = ϱ
+ Other      : N/A
+ *****************************************************************************/
+static int isLocalFs(const char *pszSource, const char *pszMountPoint, const char *pszType)
+{
+    if (isFsTypeInList(pszType, g_dummyFsTypes) || isFsTypeInList(pszType, g_remoteFsTypes))
+    {
+        return 0;
+    }
+
+    /* host:/exportʽnfsȣԼ//server/shareʽcifs */
+    if (NULL != strchr(pszSource, ':') || 0 == strcmp(pszSource, "-hosts")
+        || ('/' == pszSource[0] && '/' == pszSource[1]
+            && (0 == strcmp(pszType, "smbfs") || 0 == strcmp(pszType, "smb3") || 0 == strcmp(pszType, "cifs"))))
+    {
+        return 0;
+    }
+
+    if (NULL != strstr(pszSource, "tmpfs") || NULL != strstr(pszSource, "shm")
+        || NULL != strstr(pszMountPoint, "tmpfs") || NULL != strstr(pszMountPoint, "shm"))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/*****************************************************************************
+ Function   : unescapeMountField()
+ Description: ԭmountinfoбתĿոƱмб(\040)
+ Input      : char *pszField                        mountinfoеֶ
+ Output     : char *pszField                        ԭֶ
+ Return     : void
+ Other      : N/A
+ *****************************************************************************/
+static void unescapeMountField(char *pszField)
+{
+    char *src = pszField;
+    char *dst = pszField;
+
+    while ('\0' != *src)
+    {
+        if ('\\' == src[0] && src[1] >= '0' && src[1] <= '3' && src[2] >= '0' && src[2] <= '7'
+            && src[3] >= '0' && src[3] <= '7')
+        {
+            *dst++ = (char)(((src[1] - '0') << 6) | ((src[2] - '0') << 3) | (src[3] - '0'));
+            src += 4;
+        }
+        else
+        {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+}
+
+/*****************************************************************************
+ Function   : getLocalFsUsage()
+ Description: /proc/self/mountinfoͨstatvfsȡļϵͳܴСôС
+              df -lmPһ£ȥαļϵͳļϵͳܿΪ0ļϵͳ
+              ͬһ豸ιֻͳƵһΣСMBȡ
+ Input      : int size                              pszListĴС
+ Output     : char *pszList                         "ļϵͳ:ܴС:ôС;"б
+ Return     : SUCC = success, ERROR = failure
+ Other      : N/A
+ *****************************************************************************/
+static int getLocalFsUsage(char *pszList, int size)
+{
+    PROC_VIEW view;
+    char szLine[MAX_STR_LEN] = {0};
+    char szMountPoint[MAX_STR_LEN] = {0};
+    char szSource[MAX_STR_LEN] = {0};
+    char szType[MAX_NAME_LEN] = {0};
+    unsigned int devMajor = 0;
+    unsigned int devMinor = 0;
+    dev_t fsDevs[MAX_LOCAL_FS_NUM];
+    int fsDevNum = 0;
+    struct statvfs stFs;
+    unsigned long long frsize = 0;
+    unsigned long long total = 0;
+    unsigned long long used = 0;
+    char *sep = NULL;
+    int pos = 0;
+    int len = 0;
+    int i = 0;
+
+    if (SUCC != proc_source_read(PROC_MOUNTINFO, PROC_SOURCE_REFRESH, &view))
+    {
+        return ERROR;
+    }
+
+    pszList[0] = '\0';
+    while (NULL != proc_view_gets(szLine, sizeof(szLine), &view))
+    {
+        /* 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue */
+        sep = strstr(szLine, " - ");
+        if (NULL == sep
+            || sscanf_s(szLine, "%*d %*d %u:%u %*s %s", &devMajor, &devMinor, szMountPoint, sizeof(szMountPoint)) != 3
+            || sscanf_s(sep + 3, "%s %s", szType, sizeof(szType), szSource, sizeof(szSource)) != 2)
+        {
+            continue;
+        }
+        unescapeMountField(szMountPoint);
+        unescapeMountField(szSource);
+
+        if (!isLocalFs(szSource, szMountPoint, szType))
+        {
+            continue;
+        }
+
+        for (i = 0; i < fsDevNum; i++)
+        {
+            if (fsDevs[i] == makedev(devMajor, devMinor))
+            {
+                break;
+            }
+        }
+        if (i < fsDevNum)
+        {
+            continue;
+        }
+
+        if (0 != statvfs(szMountPoint, &stFs) || 0 == stFs.f_blocks)
+        {
+            continue;
+        }
+        if (fsDevNum < MAX_LOCAL_FS_NUM)
+        {
+            fsDevs[fsDevNum++] = makedev(devMajor, devMinor);
+        }
+
+        frsize = stFs.f_frsize ? stFs.f_frsize : stFs.f_bsize;
+        total = ((unsigned long long)stFs.f_blocks * frsize + MEGATOBYTE - 1) / MEGATOBYTE;
+        used = ((unsigned long long)(stFs.f_blocks - stFs.f_bfree) * frsize + MEGATOBYTE - 1) / MEGATOBYTE;
+
+        len = snprintf_s(pszList + pos, size - pos, size - pos - 1, "%s:%llu:%llu;", szSource, total, used);
+        if (len < 0)
+        {
+            break;
+        }
+        pos += len;
+    }
 
     return SUCC;
 }
+
 /*****************************************************************************
  Function   : FilesystemUsage()
  Description: get Filesystemname list and its usage
@@ -2071,47 +2222,26 @@ int getDiskUsage(struct xs_handle *handle, char pszDiskUsage[][MAX_DISKUSAGE_LEN
  *****************************************************************************/
 int FilesystemUsage(struct xs_handle *handle)
 { 
-    FILE *file;
-    char buf[1056] = {0};
-    char filename[1024] = {0};
     char path[32] = {0};
     char value[MAX_FILENAMES_XENSTORLEN+1] = {0};
     char numbuf[32] = {0};
     int FileNameArrLen;
-    int size,used;
     int num;
     int exceedflag;
     int i;
-    /*ͻṩshellʽshellȡļϵͳƣܴСôС*/
-    file = openPipe("df -lmP | grep -v Filesystem | grep -v Used | grep -v tmpfs | grep -v shm","r");
-    if(NULL == file)
-    {
-       DEBUG_LOG("Failed to exec df -lmP shell command.");
-       (void)write_to_xenstore(handle, FILE_DATA_PATH, "error");
-       return ERROR;
-    }
+    /*df -lmPĽһ£ļϵͳƣܴСôС*/
     (void)memset_s(FilenameArr,MAX_FILENAMES_SIZE,0,MAX_FILENAMES_SIZE);
-    while(NULL != fgets(buf,sizeof(buf),file))
+    if(SUCC != getLocalFsUsage(FilenameArr, sizeof(FilenameArr)))
     {
-       (void)sscanf_s(buf,"%s %d %d",filename,sizeof(filename),&size,&used);
-       (void)snprintf_s(FilenameArr+strlen(FilenameArr),
-                        sizeof(FilenameArr) - strlen(FilenameArr),
-                        sizeof(FilenameArr) - strlen(FilenameArr),
-                        "%s:%d:%d;",filename,size,used);
+       DEBUG_LOG("Failed to read /proc/self/mountinfo.");
+       write_perf_to_xenstore(handle, FILE_DATA_PATH, "error", xb_write_first_flag);
+       return ERROR;
     }
-    (void)pclose(file);
     FileNameArrLen = strlen(FilenameArr);
 	num = FileNameArrLen / MAX_FILENAMES_XENSTORLEN;
 	exceedflag = FileNameArrLen % MAX_FILENAMES_XENSTORLEN;
     (void)snprintf_s(value, MAX_FILENAMES_XENSTORLEN, MAX_FILENAMES_XENSTORLEN, "%s", FilenameArr);
-    if(xb_write_first_flag == 0)
-    {
-       (void)write_to_xenstore(handle, FILE_DATA_PATH, value);
-    }
-    else
-    {
-        (void)write_weak_to_xenstore(handle, FILE_DATA_PATH, value);
-    }
+    write_perf_to_xenstore(handle, FILE_DATA_PATH, value, xb_write_first_flag);
     /*ٽֵnum+1;:33/32=1;1ֽڣҪд*/
     if(exceedflag)
     {
@@ -2123,24 +2253,10 @@ int FilesystemUsage(struct xs_handle *handle)
         (void)snprintf_s(path, sizeof(path), sizeof(path), FILE_DATA_EXTRA_PATH_PREFIX"%d", i); //filesystem_extra%d
         (void)snprintf_s(value, MAX_FILENAMES_XENSTORLEN, MAX_FILENAMES_XENSTORLEN,
                         "%s", FilenameArr+(MAX_FILENAMES_XENSTORLEN*i)); 
-	if(xb_write_first_flag == 0)
-	{
-            (void)write_to_xenstore(handle, path, value);
-	}
-	else
-	{
-	    (void)write_weak_to_xenstore(handle, path, value);
-	}
+        write_perf_to_xenstore(handle, path, value, xb_write_first_flag);
     }
     (void)snprintf_s(numbuf, sizeof(numbuf), sizeof(numbuf), "%d", num);
-    if(xb_write_first_flag == 0)
-    {
-        (void)write_to_xenstore(handle, FILE_NUM_PATH, numbuf);
-    }
-    else
-    {
-        (void)write_weak_to_xenstore(handle, FILE_NUM_PATH, numbuf);
-    }
+    write_perf_to_xenstore(handle, FILE_NUM_PATH, numbuf, xb_write_first_flag);
     return SUCC;
 }
 /*****************************************************************************
@@ -2168,6 +2284,10 @@ int diskworkctlmon(struct xs_handle *handle)
     {
         /*ʧдerror*/
         write_xs_disk(handle, xb_write_first_flag, szDiskUsage, 0);
+        if (perfbin_enabled())
+        {
+            perfbin_section_fail(PERFBIN_SECTION_DISK, PERFBIN_TLV_DISK);
+        }
         return ERROR;
     }
     else
@@ -2199,10 +2319,7 @@ void write_xs_disk(struct xs_handle *handle, int is_weak, char xs_value[][MAX_DI
             else
                 (void)snprintf_s(xs_path, MAX_DISKUSAGE_LEN, MAX_DISKUSAGE_LEN, "%s-%d", DISK_DATA_EXT_PATH, i);
 
-            if (is_weak)
-                write_weak_to_xenstore(handle, xs_path, "error");
-            else
-                write_to_xenstore(handle, xs_path, "error");
+            write_perf_to_xenstore(handle, xs_path, "error", is_weak);
         }
     } else {
         for (i = 0; i < row_num; i++) {
@@ -2211,17 +2328,11 @@ void write_xs_disk(struct xs_handle *handle, int is_weak, char xs_value[][MAX_DI
             else
                 (void)snprintf_s(xs_path, MAX_DISKUSAGE_LEN, MAX_DISKUSAGE_LEN, "%s-%d", DISK_DATA_EXT_PATH, i);
 
-            if (is_weak)
-                write_weak_to_xenstore(handle, xs_path, xs_value[i]);
-            else
-                write_to_xenstore(handle, xs_path, xs_value[i]); 
+            write_perf_to_xenstore(handle, xs_path, xs_value[i], is_weak);
         }
         for (; i < MAX_ROWS; i++) {
             (void)snprintf_s(xs_path, MAX_DISKUSAGE_LEN, MAX_DISKUSAGE_LEN, "%s-%d", DISK_DATA_EXT_PATH, i);
-            if (is_weak)
-                write_weak_to_xenstore(handle, xs_path, "0");
-            else
-                write_to_xenstore(handle, xs_path, "0");
+            write_perf_to_xenstore(handle, xs_path, "0", is_weak);
         }
     }
 }
@@ -0,0 +1,186 @@
+/*
+ * Bounds the memory the monitor keeps locked in guest RAM and reports it.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "procsrc.h"
+#include "xenstore_common.h"
+#include "footprint.h"
+#include <limits.h>
+#include <malloc.h>
+
+#ifndef M_ARENA_MAX
+#define M_ARENA_MAX             -8
+#endif
+
+/* deepest collector frame is below 64 KB, keep a wide margin for libc */
+#define FOOTPRINT_STACK_SIZE    (256 * 1024)
+#define FOOTPRINT_ARENA_MAX     1
+/* heap faulted in at start, covers the steady state of every collector */
+#define FOOTPRINT_HEAP_SIZE     (1024 * 1024)
+#define FOOTPRINT_HEAP_BLOCK    (64 * 1024)
+/* larger requests are mmap()ed and unmapped on free */
+#define FOOTPRINT_MMAP_THRESHOLD (128 * 1024)
+#define FOOTPRINT_LINE_LEN      128
+#define FOOTPRINT_VALUE_LEN     32
+#define DECIMAL                 10
+#define BYTES_PER_KB            1024ULL
+
+/*****************************************************************************
+Function   : footprint_init
+Description: limit the malloc arenas and fault in a fixed-size heap, so that
+             the locked heap does not grow and shrink with each sample
+Input      : None
+Output     : None
+Return     : None
+*****************************************************************************/
+void footprint_init(void)
+{
+#ifdef UVP_LOW_FOOTPRINT
+    char *blocks[FOOTPRINT_HEAP_SIZE / FOOTPRINT_HEAP_BLOCK] = {NULL};
+    unsigned int i;
+
+    /* glibc before 2.10 creates arenas on contention only and rejects the option */
+    if (1 != mallopt(M_ARENA_MAX, FOOTPRINT_ARENA_MAX))
+    {
+        ERR_LOG("Limit malloc arenas to %d failed.", FOOTPRINT_ARENA_MAX);
+    }
+    if (1 != mallopt(M_MMAP_THRESHOLD, FOOTPRINT_MMAP_THRESHOLD)
+        || 1 != mallopt(M_TRIM_THRESHOLD, 2 * FOOTPRINT_HEAP_SIZE))
+    {
+        ERR_LOG("Set malloc parameters failed.");
+        return;
+    }
+
+    /*
+     * Grow the heap in blocks below the mmap threshold and give them back;
+     * the free memory stays in the heap since it is below the trim threshold.
+     * mlockall() may have failed, so the pages are touched as well.
+     */
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        blocks[i] = (char *)malloc(FOOTPRINT_HEAP_BLOCK);
+        if (NULL == blocks[i])
+        {
+            ERR_LOG("Prefault heap failed after %u blocks.", i);
+            break;
+        }
+        (void)memset_s(blocks[i], FOOTPRINT_HEAP_BLOCK, 0, FOOTPRINT_HEAP_BLOCK);
+    }
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        free(blocks[i]);
+    }
+    INFO_LOG("Low footprint mode, heap %d bytes, thread stack %d bytes.",
+             FOOTPRINT_HEAP_SIZE, FOOTPRINT_STACK_SIZE);
+#endif
+}
+
+/*****************************************************************************
+Function   : footprint_thread_attr
+Description: give a monitor thread a small stack; every byte of a thread
+             stack is locked under mlockall
+Input      : attr -- initialized attributes of the thread to create
+Output     : attr
+Return     : None
+*****************************************************************************/
+void footprint_thread_attr(pthread_attr_t *attr)
+{
+#ifdef UVP_LOW_FOOTPRINT
+    size_t size = FOOTPRINT_STACK_SIZE;
+
+    if (size < PTHREAD_STACK_MIN)
+    {
+        size = PTHREAD_STACK_MIN;
+    }
+    if (0 != pthread_attr_setstacksize(attr, size))
+    {
+        ERR_LOG("Set thread stack size %lu failed.", (unsigned long)size);
+    }
+#endif
+}
+
+/*****************************************************************************
+Function   : footprint_status_kb
+Description: value of one "Name:   N kB" field of /proc/self/status
+Input      : view -- snapshot of /proc/self/status
+             name -- field name with the colon
+Output     : None
+Return     : the value in kB, 0 if the field is missing
+*****************************************************************************/
+static unsigned long long footprint_status_kb(PROC_VIEW *view, const char *name)
+{
+    char line[FOOTPRINT_LINE_LEN];
+    size_t len = strlen(name);
+
+    view->pos = 0;
+    while (NULL != proc_view_gets(line, sizeof(line), view))
+    {
+        if (0 == strncmp(line, name, len))
+        {
+            return strtoull(line + len, NULL, DECIMAL);
+        }
+    }
+    return 0;
+}
+
+/*****************************************************************************
+Function   : footprint_report
+Description: write the locked memory of the monitor to xenstore, so that
+             its cost in every guest can be measured
+Input      : handle -- xenstore handle
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int footprint_report(void *handle)
+{
+    PROC_VIEW view;
+    char value[FOOTPRINT_VALUE_LEN] = {0};
+    unsigned long long locked;
+
+    if (SUCC != proc_source_read(PROC_SELF_STATUS, PROC_SOURCE_REFRESH, &view))
+    {
+        return ERROR;
+    }
+    locked = footprint_status_kb(&view, "VmLck:");
+    if (0 == locked)
+    {
+        /* not locked, the resident set is what the guest pays */
+        locked = footprint_status_kb(&view, "VmRSS:");
+    }
+    (void)snprintf_s(value, sizeof(value), sizeof(value) - 1, "%llu", locked * BYTES_PER_KB);
+
+    write_perf_to_xenstore(handle, FOOTPRINT_RSS_PATH, value, xb_write_first_flag);
+    return SUCC;
+}
@@ -30,6 +30,7 @@
 
 
 #include "libxenctl.h"
+#include "perfbin.h"
 
 #define HOSTNAME_DATA_PATH  "control/uvp/hostname"
 #define MAX_HOSTNAME_LENGTH 256
@@ -62,6 +63,9 @@ Return     : ʧ
 int hostnameworkctlmon(struct xs_handle *handle)
 {
     char hostname[MAX_HOSTNAME_LENGTH] = { 0 };
+    unsigned char raw[MAX_HOSTNAME_LENGTH + 4];
+    PERFBIN_BUF buf;
+    size_t mark;
     int Ret = 0;
 
     if (NULL == handle)
@@ -71,13 +75,18 @@ int hostnameworkctlmon(struct xs_handle *handle)
 
     Ret = GetHostname( hostname, MAX_HOSTNAME_LENGTH );
 
-    if(xb_write_first_flag == 0)
+    write_perf_to_xenstore(handle, HOSTNAME_DATA_PATH, !Ret ? hostname : "error", xb_write_first_flag);
+    if (perfbin_enabled() && !Ret)
     {
-        (void)write_to_xenstore(handle, HOSTNAME_DATA_PATH, !Ret ? hostname : "error" );
+        perfbin_buf_init(&buf, raw, sizeof(raw));
+        mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_HOSTNAME);
+        perfbin_put_bytes(&buf, hostname, strlen(hostname));
+        perfbin_tlv_end(&buf, mark);
+        perfbin_section_set(PERFBIN_SECTION_HOSTNAME, &buf);
     }
-    else
+    else if (perfbin_enabled())
     {
-        (void)write_weak_to_xenstore(handle, HOSTNAME_DATA_PATH, !Ret ? hostname : "error" );
+        perfbin_section_fail(PERFBIN_SECTION_HOSTNAME, PERFBIN_TLV_HOSTNAME);
     }
 
     //(void)write_to_xenstore(handle, HOSTNAME_DATA_PATH, !Ret ? hostname : "error" );
@@ -0,0 +1,60 @@
+/*
+ * Bump allocator for scratch memory that lives for one collection cycle.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+typedef struct ARENA_CHUNK ARENA_CHUNK;
+
+typedef struct
+{
+    ARENA_CHUNK *chunks;        /* newest first */
+    size_t used;                /* bytes handed out since the last reset */
+    size_t hint;                /* size of the next first chunk */
+} ARENA;
+
+#define ARENA_INITIALIZER       {NULL, 0, 0}
+
+/*
+ * arena_alloc() returns zeroed memory that stays valid until the next
+ * arena_reset(). The arena only grows while a cycle runs; the reset keeps
+ * one chunk of the size the last cycle needed, so that a steady collector
+ * neither calls malloc() nor faults in new pages once it is warm. Under
+ * mlockall() this keeps the pinned scratch memory at the real demand.
+ */
+void *arena_alloc(ARENA *arena, size_t size);
+void arena_reset(ARENA *arena);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Reads device-mapper tables and block device slaves without dmsetup.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#ifndef _DEVMAPPER_H
+#define _DEVMAPPER_H
+
+#include "procsrc.h"
+
+#define DM_SLAVE_NAME_LEN       32
+
+/* one lower device of a block device, from /sys/dev/block/M:m/slaves */
+typedef struct
+{
+    char name[DM_SLAVE_NAME_LEN];
+    int major;
+    int minor;
+    unsigned long long sectors;
+} DM_SLAVE;
+
+/*
+ * dm_table_read() asks the kernel for the live table of a device-mapper
+ * device through /dev/mapper/control and returns it in the "dmsetup table"
+ * format, one target per line, "start length type params".  The view is
+ * valid until the next call.  Returns the number of targets or ERROR when
+ * the control node cannot be used; the caller may fall back to
+ * dm_slaves_read(), which only knows the lower devices.
+ */
+int dm_table_read(int devID, PROC_VIEW *view);
+int dm_slaves_read(int devID, DM_SLAVE *slaves, int max);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Bounds the memory the monitor keeps locked in guest RAM.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _FOOTPRINT_H
+#define _FOOTPRINT_H
+
+#include <pthread.h>
+
+/* memory the monitor has locked, or its resident set when it is not locked, in bytes */
+#define FOOTPRINT_RSS_PATH      "control/uvp/monitor/rss"
+
+/*
+ * The monitor runs under mlockall(MCL_CURRENT|MCL_FUTURE), so every thread
+ * stack, malloc arena and heap page it ever maps stays pinned in the guest.
+ * With UVP_LOW_FOOTPRINT footprint_init() limits malloc to one arena and
+ * faults in a fixed heap that is never trimmed, and footprint_thread_attr()
+ * gives the monitor threads a small stack instead of the 8 MB default.
+ */
+void footprint_init(void);
+void footprint_thread_attr(pthread_attr_t *attr);
+int footprint_report(void *handle);
+
+#endif
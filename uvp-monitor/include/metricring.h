@@ -0,0 +1,101 @@
+/*
+ * Metric ring in pages shared with dom0 through the grant table.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _METRICRING_H
+#define _METRICRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* provided by the xen-metrics driver: read() gives the grant refs, mmap() the pages */
+#define METRIC_RING_DEV         "/proc/xen/metrics"
+#define METRIC_RING_DEV_ALT     "/proc/xen_metrics"
+/* without the driver, a regular file at this path is mapped instead (for testing) */
+#define METRIC_RING_STANDIN     "/var/run/uvp-monitor-metrics"
+/* "version:page_size:ref0:ref1:ref2:ref3", written once the ring is ready */
+#define METRIC_RING_PATH        "control/uvp/metrics-ring"
+
+#define METRIC_RING_MAGIC       0x524d5655      /* "UVMR" */
+#define METRIC_RING_VERSION     1
+/*
+ * METRICS_PAGES of the driver, each of the guest's page size (sysconf), so
+ * the ring is larger on a guest with 64K pages
+ */
+#define METRIC_RING_PAGES       4
+#define METRIC_RING_HEADER_SIZE 64
+#define METRIC_RING_SLOTS       4
+#define METRIC_RING_SLOT_HEAD   16
+
+/*
+ * The pages start with METRIC_RING_HEADER, followed by slot_count slots
+ * of slot_size bytes, all fields little endian. Each slot holds one perf-bin record
+ * (see perfbin.h, not base64 encoded) of a collection cycle.
+ *
+ * The monitor is the only writer. To publish, it takes the slot after the
+ * newest one, makes its seq odd, fills it, makes seq even again and then
+ * increments head. A reader in dom0 does:
+ *
+ *   h = head; if h == 0 there is no record yet
+ *   slot = slots[(h - 1) % slot_count]
+ *   do { s = slot.seq; copy slot; } while (s is odd || slot.seq != s)
+ *
+ * A slot is rewritten only after slot_count - 1 newer records, so a reader
+ * of the newest record rarely has to retry.
+ */
+typedef struct
+{
+    uint32_t magic;                     /* METRIC_RING_MAGIC once the header is valid */
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    volatile uint32_t head;             /* records published so far */
+    uint8_t  reserved[METRIC_RING_HEADER_SIZE - 20];
+} METRIC_RING_HEADER;
+
+typedef struct
+{
+    volatile uint32_t seq;              /* odd while the slot is written */
+    uint32_t len;                       /* bytes of data in use */
+    uint64_t stamp;                     /* wall clock of the record, milliseconds */
+    uint8_t  data[];                    /* slot_size - METRIC_RING_SLOT_HEAD bytes */
+} METRIC_RING_SLOT;
+
+int metricring_open(void *handle);
+bool metricring_ready(void);
+void metricring_advertise(void *handle);
+void metricring_publish(const unsigned char *record, size_t len);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Per-interface traffic counters of uvp-monitor.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _NETDEV_H
+#define _NETDEV_H
+
+#include <net/if.h>
+
+typedef struct
+{
+    char ifname[IFNAMSIZ];
+    unsigned long long rx_bytes;
+    unsigned long long rx_packets;
+    unsigned long long rx_drop;
+    unsigned long long tx_bytes;
+    unsigned long long tx_packets;
+    unsigned long long tx_drop;
+} NET_DEV_STAT;
+
+/*
+ * One table per sample: netdev_table_refresh() refreshes the route netlink
+ * model (see rtnl.h) and takes its link counters or, failing that, parses
+ * /proc/net/dev once;
+ * the entries keep the ifindex order and are looked up by name.
+ */
+int netdev_table_refresh(void);
+int netdev_table_count(void);
+const NET_DEV_STAT *netdev_table_entry(int idx);
+const NET_DEV_STAT *netdev_table_lookup(const char *ifname);
+
+#endif
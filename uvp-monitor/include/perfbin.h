@@ -0,0 +1,109 @@
+/*
+ * Encodes the metrics of a collection cycle as a compact binary record.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _PERFBIN_H
+#define _PERFBIN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PERF_BIN_PATH           "control/uvp/perf-bin"
+
+/*
+ * control/uvp/perf-bin holds one base64 encoded record with the metrics of
+ * the last collection cycle, written while EXINFO_FLAG_PERF_BIN is set:
+ *
+ *   record := version(1 byte) flags(1 byte) tlv*
+ *   tlv    := type(1 byte) length(varint) value
+ *
+ * Integers in values are unsigned LEB128 varints, strings are a varint
+ * length followed by the bytes, addresses are a family byte (0, 4 or 6)
+ * followed by 0, 4 or 16 bytes. Unknown types are skipped by their length.
+ */
+#define PERFBIN_VERSION         1
+#define PERFBIN_FLAG_TRUNCATED  (1 << 0)    /* sections were left out to fit */
+
+/* xenstore payload limit minus the path, as base64 */
+#define PERFBIN_RAW_MAX         3048
+
+typedef enum
+{
+    PERFBIN_TLV_MEMORY = 1,     /* available total used buffers cached, KB */
+    PERFBIN_TLV_SWAP,           /* total used free, KB */
+    PERFBIN_TLV_CPU,            /* (cpu, usage in 1/100 %) per online cpu */
+    PERFBIN_TLV_DISK_TOTAL,     /* total used, MB */
+    PERFBIN_TLV_DISK,           /* name total used, MB; one per disk */
+    PERFBIN_TLV_NIC,            /* mac(6) up ip gateway tx_bytes rx_bytes tx_packets
+                                   rx_packets tx_drop rx_drop; one per address */
+    PERFBIN_TLV_HOSTNAME,       /* raw bytes */
+    PERFBIN_TLV_ERROR = 0xff    /* type of the tlv that failed this cycle */
+} PERFBIN_TLV;
+
+/* one section per collector, replaced whole each time it runs */
+typedef enum
+{
+    PERFBIN_SECTION_MEMORY = 0,
+    PERFBIN_SECTION_CPU,
+    PERFBIN_SECTION_DISK,
+    PERFBIN_SECTION_NETWORK,
+    PERFBIN_SECTION_HOSTNAME,
+    PERFBIN_SECTION_BUTT
+} PERFBIN_SECTION;
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    bool overflow;              /* a put did not fit, the buffer is unusable */
+} PERFBIN_BUF;
+
+bool perfbin_enabled(void);
+
+void perfbin_buf_init(PERFBIN_BUF *buf, unsigned char *data, size_t cap);
+size_t perfbin_tlv_begin(PERFBIN_BUF *buf, PERFBIN_TLV type);
+void perfbin_tlv_end(PERFBIN_BUF *buf, size_t mark);
+void perfbin_put_uint(PERFBIN_BUF *buf, unsigned long long value);
+void perfbin_put_str(PERFBIN_BUF *buf, const char *str);
+void perfbin_put_bytes(PERFBIN_BUF *buf, const void *bytes, size_t len);
+void perfbin_put_addr(PERFBIN_BUF *buf, const char *addr);
+void perfbin_put_mac(PERFBIN_BUF *buf, const char *mac);
+void perfbin_put_nic(PERFBIN_BUF *buf, const char *ifname, const char *mac, int up,
+                     const char *ip, const char *gateway);
+
+void perfbin_section_set(PERFBIN_SECTION section, const PERFBIN_BUF *buf);
+void perfbin_section_fail(PERFBIN_SECTION section, PERFBIN_TLV type);
+void perfbin_publish(void *handle);
+
+#endif
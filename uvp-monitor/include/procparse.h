@@ -0,0 +1,73 @@
+/*
+ * In-place field parser for /proc snapshots.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _PROCPARSE_H
+#define _PROCPARSE_H
+
+#include <pthread.h>
+#include "procsrc.h"
+
+#define PROC_KEYMAP_SLOTS       64      /* at most PROC_KEYMAP_SLOTS / 2 keys */
+
+/* one line of a snapshot, split at the first ':' or blank */
+typedef struct
+{
+    const char *key;
+    size_t key_len;
+    const char *pos;            /* value cursor, just after the key */
+    const char *end;            /* the newline or the end of the snapshot */
+} PROC_LINE;
+
+/*
+ * Collision-free hash of a fixed key set, so that each line is dispatched
+ * with one hash and one compare. Define it with PROC_KEYMAP_INITIALIZER;
+ * the seed is searched on first use.
+ */
+typedef struct
+{
+    const char *const *keys;
+    int num;
+    volatile int ready;
+    unsigned int seed;
+    signed char slot[PROC_KEYMAP_SLOTS];
+} PROC_KEYMAP;
+
+#define PROC_KEYMAP_INITIALIZER(keys) \
+    {(keys), (int)(sizeof(keys) / sizeof((keys)[0])), 0, 0, {0}}
+
+int proc_view_next_line(PROC_VIEW *view, PROC_LINE *line);
+unsigned long long proc_line_ull(PROC_LINE *line);
+int proc_keymap_find(PROC_KEYMAP *map, const char *key, size_t len);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Persistent /proc sources shared by the uvp-monitor collectors.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _PROCSRC_H
+#define _PROCSRC_H
+
+#include <stddef.h>
+
+/* refresh argument of proc_source_read() */
+#define PROC_SOURCE_CACHED      0   /* reuse the snapshot taken earlier in this sample */
+#define PROC_SOURCE_REFRESH     1   /* re-read the file with pread() */
+
+typedef enum
+{
+    PROC_STAT = 0,
+    PROC_MEMINFO,
+    PROC_NET_DEV,
+    PROC_PARTITIONS,
+    PROC_MOUNTS,
+    PROC_MOUNTINFO,
+    PROC_SWAPS,
+    PROC_SELF_STATUS,
+    PROC_VMSTAT,
+    PROC_PRESSURE_MEMORY,
+    PROC_SOURCE_BUTT
+} PROC_SOURCE_ID;
+
+/* read-only cursor over a snapshot; valid until the next refresh of the source */
+typedef struct
+{
+    const char *data;
+    size_t len;
+    size_t pos;
+} PROC_VIEW;
+
+/*
+ * The sources are owned by the collector thread: snapshots are shared
+ * between collectors of one sample and must not be used from other threads.
+ */
+int proc_source_read(PROC_SOURCE_ID id, int refresh, PROC_VIEW *view);
+char *proc_view_gets(char *line, int size, PROC_VIEW *view);
+int proc_view_lines(const PROC_VIEW *view);
+
+#endif
@@ -39,6 +39,12 @@ extern "C" {
 #define _PUBLIC_COMMON_H
 
 #include <syslog.h>
+#include <fcntl.h>
+
+/* glibc before 2.7 (RHEL5) has no O_CLOEXEC; those kernels ignore it anyway */
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
 
 extern void sys_log(const char* process, int Level, const char *func, int line, const char *format, ...);
 
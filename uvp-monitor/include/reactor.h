@@ -0,0 +1,86 @@
+/*
+ * epoll event loop shared by the monitor threads.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _REACTOR_H
+#define _REACTOR_H
+
+#include <stdbool.h>
+#include <features.h>
+
+/*
+ * timerfd, eventfd and signalfd came with glibc 2.8; older guests (RHEL5)
+ * build without them and use the polling and SIG_IGN fallbacks. Either
+ * macro may also be given on the command line.
+ */
+#if defined(__GLIBC_PREREQ) && !defined(HAVE_TIMERFD)
+#if __GLIBC_PREREQ(2, 8)
+#define HAVE_TIMERFD            1
+#endif
+#endif
+#if defined(__GLIBC_PREREQ) && !defined(HAVE_SIGNALFD)
+#if __GLIBC_PREREQ(2, 8)
+#define HAVE_SIGNALFD           1
+#endif
+#endif
+
+#define REACTOR_MAX_SOURCES     16
+
+/* called in the loop thread when fd is readable */
+typedef void (*REACTOR_FUNC)(int fd, void *arg);
+
+typedef struct
+{
+    int          fd;                    /* -1 for a free slot */
+    REACTOR_FUNC func;
+    void        *arg;
+} REACTOR_SOURCE;
+
+typedef struct
+{
+    int            epfd;
+    volatile bool  stop;
+    REACTOR_SOURCE sources[REACTOR_MAX_SOURCES];
+    /* optional, run once after the sources of each wake-up were handled */
+    REACTOR_FUNC   wake_end;
+    void          *wake_arg;
+} REACTOR;
+
+int reactor_init(REACTOR *reactor);
+int reactor_add(REACTOR *reactor, int fd, REACTOR_FUNC func, void *arg);
+void reactor_del(REACTOR *reactor, int fd);
+int reactor_run(REACTOR *reactor);
+void reactor_stop(REACTOR *reactor);
+void reactor_close(REACTOR *reactor);
+
+#endif
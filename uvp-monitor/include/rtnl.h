@@ -0,0 +1,100 @@
+/*
+ * Route netlink model of the guest interfaces used by uvp-monitor.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#ifndef _RTNL_H
+#define _RTNL_H
+
+#include <net/if.h>
+#include <linux/rtnetlink.h>
+
+#define RTNL_HWADDR_LEN     32
+#define RTNL_INADDR_LEN     16
+
+typedef struct
+{
+    int index;
+    char ifname[IFNAMSIZ];
+    unsigned int flags;
+    unsigned char hwaddr[RTNL_HWADDR_LEN];
+    int hwaddr_len;
+    int has_stats;
+    unsigned long long rx_bytes;
+    unsigned long long rx_packets;
+    unsigned long long rx_drop;
+    unsigned long long tx_bytes;
+    unsigned long long tx_packets;
+    unsigned long long tx_drop;
+} RTNL_LINK;
+
+typedef struct
+{
+    int index;
+    unsigned char family;
+    unsigned char prefixlen;
+    unsigned char scope;        /* RT_SCOPE_* */
+    unsigned char addr[RTNL_INADDR_LEN];
+    char label[IFNAMSIZ];       /* IPv4 only, e.g. eth0:1 */
+} RTNL_ADDR;
+
+typedef struct
+{
+    int oif;
+    unsigned char family;
+    unsigned char dst_len;
+    unsigned int priority;
+    unsigned char dst[RTNL_INADDR_LEN];
+    unsigned char gateway[RTNL_INADDR_LEN];
+} RTNL_ROUTE;
+
+/*
+ * rtnl_model_refresh() is called once per sample. The first call dumps
+ * links, addresses and the gateway routes of the main table and joins the
+ * RTNLGRP link, address and route groups; later calls only apply the queued
+ * events and sample the link counters. rtnl_model_generation() changes
+ * whenever anything but the counters changed. Callers fall back to ioctl
+ * and /proc when the model is not valid.
+ */
+int rtnl_model_refresh(void);
+int rtnl_model_valid(void);
+int rtnl_stats_valid(void);
+unsigned int rtnl_model_generation(void);
+int rtnl_link_count(void);
+const RTNL_LINK *rtnl_link_entry(int idx);
+const RTNL_LINK *rtnl_link_lookup(const char *ifname);
+int rtnl_addr_count(void);
+const RTNL_ADDR *rtnl_addr_entry(int idx);
+int rtnl_ipv4_addr(const char *label, char *buf, int size);
+int rtnl_gateway(int family, const char *ifname, char *buf, int size);
+void rtnl_format_hwaddr(const RTNL_LINK *link, char *buf, int size);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Collector scheduler of uvp-monitor.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+/* per-collector interval overrides, in seconds: control/uvp/collect_interval/<name> */
+#define COLLECT_INTERVAL_PATH   "control/uvp/collect_interval"
+
+#define COLLECT_INTERVAL_MIN    1
+#define COLLECT_INTERVAL_MAX    3600
+
+typedef struct
+{
+    const char *name;                   /* key under COLLECT_INTERVAL_PATH */
+    int (*func)(void *handle);          /* collector body */
+    unsigned int def_interval;          /* default interval, seconds */
+    volatile unsigned int interval;     /* current interval, seconds */
+    int timerfd;
+} COLLECTOR;
+
+void collect_interval_reload(void *handle);
+void collect_scheduler_run(void *handle);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Kernel uevent listener shared by the collectors that cache device topology.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#ifndef _UEVENT_H
+#define _UEVENT_H
+
+typedef enum
+{
+    UEVENT_BLOCK = 0,
+    UEVENT_CPU,
+    UEVENT_SUBSYS_BUTT
+} UEVENT_SUBSYS_ID;
+
+/*
+ * uevent_refresh() joins the kernel uevent group on first use and then
+ * drains the queued events, bumping the generation of every subsystem that
+ * reported one; a (re)opened socket or an overflowed queue bumps them all.
+ * It returns ERROR while no socket can be used, callers must then assume
+ * that anything may have changed.
+ */
+int uevent_refresh(void);
+unsigned int uevent_generation(UEVENT_SUBSYS_ID id);
+int uevent_wait(UEVENT_SUBSYS_ID id, unsigned int generation, int timeout_ms);
+
+#endif
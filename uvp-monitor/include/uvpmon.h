@@ -35,8 +35,6 @@ int uvpPopen(const char* pszCmd, char* pszBuffer, int size);
 void freePath(char *path1, char *path2, char *path3);
 int CheckArg(char* chCmdStr, char** pchCmdType, char** pchFileName,
             char** pchPara);
-int getFluxinfoLine(char *ifname, char *pline);
-int getVifData(char *pline, int nNumber, char *out);
 void uvp_unregwatch(void *phandle);
 long getfreedisk(char *path);
 int is_suse();
@@ -0,0 +1,55 @@
+/*
+ * Watch handler table of the monitor's watch loop.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _WATCHTABLE_H
+#define _WATCHTABLE_H
+
+/* read the watched key once and hand its value to the handler, NULL when missing */
+#define WATCH_FLAG_VALUE        (1 << 0)
+/* run on a worker of the key, borrowing a pooled connection per event */
+#define WATCH_FLAG_WORKER       (1 << 1)
+/* with WATCH_FLAG_WORKER: keep every event of a command key in order, not only the last */
+#define WATCH_FLAG_QUEUE        (1 << 2)
+
+/*
+ * path  -- the path of the event, the watched key or a node below it
+ * value -- value of the watched key with WATCH_FLAG_VALUE, else NULL;
+ *          it is freed after the handler returns
+ */
+typedef void (*WATCH_HANDLER)(void *handle, const char *path, const char *value);
+
+int watch_table_register(const char *path, WATCH_HANDLER handler, unsigned int flags);
+void watch_table_dispatch(void *handle, const char *path);
+
+#endif
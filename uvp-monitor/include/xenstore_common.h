@@ -71,6 +71,8 @@ extern "C" {
 #define SCSI_FEATURE_PATH "control/uvp/vscsi_feature"
 
 #define GUSET_OS_FEATURE "control/uvp/guest_feature"
+/* guest_featureλͼmonitorṩԣܼ¼control/uvp/perf-bin */
+#define GUEST_FEATURE_PERF_BIN 8
 
 
 /*չϢ·λ*/
@@ -84,6 +86,8 @@ extern "C" {
 #define EXINFO_FLAG_FILESYSTEM      (1<<1)  //ļϵͳϢ
 #define EXINFO_FLAG_GATEWAY         (1<<2)  //Ϣ
 #define EXINFO_FLAG_NET_LOSS        (1<<3)  //Ϣ
+#define EXINFO_FLAG_MEM_PRESSURE    (1<<4)  //ڴѹϢ
+#define EXINFO_FLAG_PERF_BIN        (1<<5)  //ܼ¼
 
 #define DISABLE_EXINFO 1
 #define ENABLE_EXINFO 0
@@ -99,14 +103,27 @@ long g_netinfo_value;
 long g_monitor_restart_value;
 
 char *read_from_xenstore (void *handle, char *path);
+/* called by read_children_from_xenstore for every child of a directory */
+typedef void (*XS_CHILD_FUNC)(const char *child, const char *value, void *arg);
+int read_children_from_xenstore(void *handle, const char *dir, const char *leaf,
+                                XS_CHILD_FUNC func, void *arg);
 void write_to_xenstore (void *handle, char *path, char *buf);
 void write_weak_to_xenstore (void *handle, char *path, char *buf);
+/* write_perf_to_xenstore rewrites an unchanged value after this many seconds */
+#define XS_WRITE_CACHE_REFRESH 300
+void write_perf_to_xenstore(void *handle, char *path, char *buf, int is_weak);
+void xenstore_write_cache_flush(void);
+void xenstore_batch_begin(void);
+void xenstore_batch_commit(void *handle);
+int xenstore_async_start(void);
 char **readWatch(void *handle);
 bool regwatch(void *handle, const char *path, const char *token);
 void *openxenstore(void);
 void closexenstore(void *handle);
+void *xenstore_pool_get(void *shared);
+void xenstore_pool_put(void *handle);
+void *xenstore_pool_renew(void *handle);
 
-int watch_listen(int xsfd);
 int condition(void);
 int getxsfileno(void *handle);
 
@@ -0,0 +1,65 @@
+/*
+ * Asynchronous pipelined xenstore writes.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+
+#ifndef _XSASYNC_H
+#define _XSASYNC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* the engine talks the xenstore wire protocol to the xenbus device itself */
+#define XSA_DEV                 "/dev/xen/xenbus"
+#define XSA_DEV_PROC            "/proc/xen/xenbus"
+
+/*
+ * A job is the set of keys of one collection cycle. The engine thread
+ * writes them in a transaction whose XS_WRITE requests are sent back to
+ * back and matched to their replies by req_id; when the transaction cannot
+ * be used it writes the keys without one, resending failed weak keys with
+ * a growing delay. The submitting thread never waits for a reply: each key
+ * is reported to the done function once its outcome is known.
+ */
+typedef struct xsa_job XSA_JOB;
+
+typedef void (*XSA_DONE_FUNC)(unsigned long tag, const char *path,
+                              const char *value, size_t len, bool written);
+
+int xsasync_start(XSA_DONE_FUNC done);
+bool xsasync_ready(void);
+XSA_JOB *xsasync_job_new(unsigned long tag);
+int xsasync_job_add(XSA_JOB *job, const char *path, const char *value, size_t len, int is_weak);
+void xsasync_job_free(XSA_JOB *job);
+void xsasync_submit(XSA_JOB *job);
+
+#endif
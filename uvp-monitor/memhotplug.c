@@ -0,0 +1,559 @@
+/*
+ * Onlines hot-added memory blocks as the kernel announces them, from a
+ * small pool of worker threads, and reports each burst to xenstore.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "xenstore_common.h"
+#include "securec.h"
+#include "footprint.h"
+#include "memhotplug.h"
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#define MEM_SYSFS_DIR           "/sys/devices/system/memory"
+#define MEM_BLOCK_PREFIX        "memory"
+#define MEM_UEVENT_ADD          "add@/devices/system/memory/memory"
+#define MEM_UEVENT_GROUP        1
+#define MEM_UEVENT_RCVBUF       (1024 * 1024)
+#define MEM_UEVENT_BUF_LEN      8192
+#define MEM_PATH_LEN            128
+#define MEM_STATE_LEN           32
+#define MEM_RESULT_LEN          96
+/* onlining threads; the kernel serializes the hotplug itself, more do not help */
+#define MEM_WORKERS             4
+/* blocks waiting for a worker; an overflow is recovered by a rescan */
+#define MEM_QUEUE_LEN           1024
+/* a burst is reported once the pool stayed idle this long */
+#define MEM_REPORT_DELAY_MS     100
+
+/* modes of mem_scan */
+#define MEM_SCAN_RECORD         0       /* only remember the blocks present */
+#define MEM_SCAN_NEW            1       /* and online the offline ones not seen before */
+#define MEM_SCAN_ALL            2       /* and online every offline one */
+
+#define MEM_ZONE_ONLINE         "online"
+#define MEM_ZONE_MOVABLE        "online_movable"
+#define MEM_ZONE_KERNEL         "online_kernel"
+
+typedef struct
+{
+    unsigned int    blocks[MEM_QUEUE_LEN];
+    unsigned int    head;
+    unsigned int    count;
+    unsigned int    busy;               /* workers onlining a block */
+    bool            overflow;
+    unsigned int    onlined;            /* of the burst being onlined */
+    unsigned int    failed;
+    long long       start_ms;
+    long long       end_ms;             /* last block of the burst done */
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+} MEM_POOL;
+
+static MEM_POOL g_mem_pool =
+{
+    {0}, 0, 0, 0, false, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+static const char * volatile g_mem_zone = MEM_ZONE_ONLINE;
+static bool g_mem_started = false;
+static char g_mem_uevent_buf[MEM_UEVENT_BUF_LEN + 1];
+/*
+ * bitmap of the blocks the listener has seen, used by the listener thread
+ * only: a block seen before and offline now was offlined on purpose
+ */
+static unsigned char *g_mem_seen = NULL;
+static unsigned int g_mem_seen_len = 0;
+
+static long long mem_now_ms(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*****************************************************************************
+Function   : memhotplug_set_zone
+Description: choose the zone of the blocks onlined from now on
+Input      : zone -- value of MEM_ONLINE_ZONE_PATH, NULL when missing
+Output     : None
+Return     : None
+*****************************************************************************/
+void memhotplug_set_zone(const char *zone)
+{
+    const char *state = MEM_ZONE_ONLINE;
+
+    if (NULL != zone && 0 == strcmp(zone, "movable"))
+    {
+        state = MEM_ZONE_MOVABLE;
+    }
+    else if (NULL != zone && 0 == strcmp(zone, "kernel"))
+    {
+        state = MEM_ZONE_KERNEL;
+    }
+    if (0 != strcmp(state, g_mem_zone))
+    {
+        INFO_LOG("Hot-added memory is onlined with %s.", state);
+        g_mem_zone = state;
+    }
+}
+
+/* mark a block as seen; true when it was already, or cannot be recorded */
+static bool mem_seen_test_and_set(unsigned int block)
+{
+    unsigned int byte = block / 8;
+    unsigned int len = 0;
+    unsigned char *seen = NULL;
+    bool was;
+
+    if (byte >= g_mem_seen_len)
+    {
+        len = (byte + 1) * 2;
+        seen = (unsigned char *)realloc(g_mem_seen, len);
+        if (NULL == seen)
+        {
+            return true;
+        }
+        (void)memset_s(seen + g_mem_seen_len, len - g_mem_seen_len, 0, len - g_mem_seen_len);
+        g_mem_seen = seen;
+        g_mem_seen_len = len;
+    }
+    was = 0 != (g_mem_seen[byte] & (1 << (block % 8)));
+    g_mem_seen[byte] |= (unsigned char)(1 << (block % 8));
+    return was;
+}
+
+/* read the state of a block into state; false when it cannot be read */
+static bool mem_block_state(unsigned int block, char *state, size_t size)
+{
+    char path[MEM_PATH_LEN] = {0};
+    ssize_t len;
+    int fd = -1;
+
+    (void)snprintf_s(path, sizeof(path), sizeof(path) - 1, "%s/%s%u/state",
+                     MEM_SYSFS_DIR, MEM_BLOCK_PREFIX, block);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    len = read(fd, state, size - 1);
+    (void)close(fd);
+    if (len <= 0)
+    {
+        return false;
+    }
+    state[len] = '\0';
+    return true;
+}
+
+/* queue one block for the workers, the caller holds the pool mutex */
+static void mem_queue_block(unsigned int block)
+{
+    MEM_POOL *pool = &g_mem_pool;
+
+    if (MEM_QUEUE_LEN == pool->count)
+    {
+        pool->overflow = true;
+        return;
+    }
+    if (0 == pool->count && 0 == pool->busy && 0 == pool->onlined && 0 == pool->failed)
+    {
+        pool->start_ms = mem_now_ms();
+    }
+    pool->blocks[(pool->head + pool->count) % MEM_QUEUE_LEN] = block;
+    pool->count++;
+    (void)pthread_cond_signal(&pool->cond);
+}
+
+/*****************************************************************************
+Function   : mem_block_online
+Description: online one block when it is offline; a zone the kernel refuses
+             for this block (an old kernel only takes online_movable for the
+             block next to the movable zone) falls back to the default zone.
+             A block onlined meanwhile by udev or the kernel's auto-online
+             also fails with EINVAL, and counts as onlined.
+Input      : block -- number of the memoryN directory
+Output     : None
+Return     : 1 onlined, 0 not offline, ERROR failed
+*****************************************************************************/
+static int mem_block_online(unsigned int block)
+{
+    char path[MEM_PATH_LEN] = {0};
+    char state[MEM_STATE_LEN] = {0};
+    const char *zone = g_mem_zone;
+    ssize_t len;
+    int fd = -1;
+    int ret = 1;
+    int err = 0;
+
+    (void)snprintf_s(path, sizeof(path), sizeof(path) - 1, "%s/%s%u/state",
+                     MEM_SYSFS_DIR, MEM_BLOCK_PREFIX, block);
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        /* removed again, or no hotplug support */
+        return ENOENT == errno ? 0 : ERROR;
+    }
+    len = read(fd, state, sizeof(state) - 1);
+    if (len <= 0 || 0 != strncmp(state, "offline", strlen("offline")))
+    {
+        (void)close(fd);
+        return 0;
+    }
+    if (write(fd, zone, strlen(zone)) < 0)
+    {
+        ret = ERROR;
+        err = errno;
+        if (EINVAL == err && mem_block_state(block, state, sizeof(state))
+            && 0 == strncmp(state, "online", strlen("online")))
+        {
+            (void)close(fd);
+            return 1;
+        }
+        errno = err;
+        if (EINVAL == errno && 0 != strcmp(zone, MEM_ZONE_ONLINE))
+        {
+            zone = MEM_ZONE_ONLINE;
+            (void)lseek(fd, 0, SEEK_SET);
+            if (write(fd, zone, strlen(zone)) >= 0)
+            {
+                ret = 1;
+            }
+        }
+        if (ERROR == ret)
+        {
+            ERR_LOG("Online memory block %u with %s failed, errno=%d.", block, zone, errno);
+        }
+    }
+    (void)close(fd);
+    return ret;
+}
+
+static void *mem_worker(void *arg)
+{
+    MEM_POOL *pool = &g_mem_pool;
+    unsigned int block;
+    int ret;
+
+    (void)arg;
+    (void)pthread_mutex_lock(&pool->mutex);
+    for (;;)
+    {
+        while (0 == pool->count)
+        {
+            (void)pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        block = pool->blocks[pool->head];
+        pool->head = (pool->head + 1) % MEM_QUEUE_LEN;
+        pool->count--;
+        pool->busy++;
+        (void)pthread_mutex_unlock(&pool->mutex);
+
+        ret = mem_block_online(block);
+
+        (void)pthread_mutex_lock(&pool->mutex);
+        pool->busy--;
+        pool->end_ms = mem_now_ms();
+        if (1 == ret)
+        {
+            pool->onlined++;
+        }
+        else if (ERROR == ret)
+        {
+            pool->failed++;
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+Function   : mem_scan
+Description: remember every block present and queue the offline ones the
+             mode asks for: after lost uevents only the blocks not seen
+             before, so a block offlined by the admin stays offline
+Input      : mode -- MEM_SCAN_RECORD, MEM_SCAN_NEW or MEM_SCAN_ALL
+Output     : None
+Return     : None
+*****************************************************************************/
+static void mem_scan(int mode)
+{
+    char state[MEM_STATE_LEN] = {0};
+    struct dirent *entry = NULL;
+    DIR *dir = NULL;
+    char *end = NULL;
+    unsigned long block;
+    bool seen;
+
+    dir = opendir(MEM_SYSFS_DIR);
+    if (NULL == dir)
+    {
+        return;
+    }
+    while (NULL != (entry = readdir(dir)))
+    {
+        if (0 != strncmp(entry->d_name, MEM_BLOCK_PREFIX, strlen(MEM_BLOCK_PREFIX)))
+        {
+            continue;
+        }
+        block = strtoul(entry->d_name + strlen(MEM_BLOCK_PREFIX), &end, 10);
+        if (end == entry->d_name + strlen(MEM_BLOCK_PREFIX) || '\0' != *end)
+        {
+            continue;
+        }
+        seen = mem_seen_test_and_set((unsigned int)block);
+        if (MEM_SCAN_RECORD == mode || (MEM_SCAN_NEW == mode && seen))
+        {
+            continue;
+        }
+        if (mem_block_state((unsigned int)block, state, sizeof(state))
+            && 0 == strncmp(state, "offline", strlen("offline")))
+        {
+            (void)pthread_mutex_lock(&g_mem_pool.mutex);
+            mem_queue_block((unsigned int)block);
+            (void)pthread_mutex_unlock(&g_mem_pool.mutex);
+        }
+    }
+    (void)closedir(dir);
+}
+
+static int mem_uevent_socket(void)
+{
+    struct sockaddr_nl local;
+    int rcvbuf = MEM_UEVENT_RCVBUF;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+    {
+        ERR_LOG("Failed to open uevent netlink socket, errno=%d.", errno);
+        return ERROR;
+    }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    (void)memset_s(&local, sizeof(local), 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = MEM_UEVENT_GROUP;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+    {
+        ERR_LOG("Failed to bind uevent netlink socket, errno=%d.", errno);
+        (void)close(fd);
+        return ERROR;
+    }
+    return fd;
+}
+
+/* queue the block of an "add@/devices/system/memory/memoryN" uevent */
+static void mem_uevent(int fd)
+{
+    struct sockaddr_nl sender;
+    socklen_t addrlen = sizeof(sender);
+    unsigned long block;
+    char *end = NULL;
+    ssize_t len;
+
+    len = recvfrom(fd, g_mem_uevent_buf, MEM_UEVENT_BUF_LEN, MSG_DONTWAIT,
+                   (struct sockaddr *)&sender, &addrlen);
+    if (len < 0)
+    {
+        if (ENOBUFS == errno)
+        {
+            INFO_LOG("Uevents overflowed, rescan the memory blocks.");
+            mem_scan(MEM_SCAN_NEW);
+        }
+        return;
+    }
+    /* only the kernel announces memory */
+    if (0 != sender.nl_pid)
+    {
+        return;
+    }
+    g_mem_uevent_buf[len] = '\0';
+    if (0 != strncmp(g_mem_uevent_buf, MEM_UEVENT_ADD, strlen(MEM_UEVENT_ADD)))
+    {
+        return;
+    }
+    block = strtoul(g_mem_uevent_buf + strlen(MEM_UEVENT_ADD), &end, 10);
+    if (end == g_mem_uevent_buf + strlen(MEM_UEVENT_ADD) || '\0' != *end)
+    {
+        return;
+    }
+    (void)mem_seen_test_and_set((unsigned int)block);
+    (void)pthread_mutex_lock(&g_mem_pool.mutex);
+    mem_queue_block((unsigned int)block);
+    (void)pthread_mutex_unlock(&g_mem_pool.mutex);
+}
+
+/*****************************************************************************
+Function   : mem_report
+Description: once the pool is idle, report the finished burst to xenstore
+             and rescan when the queue overflowed during it
+Input      : handle -- xenstore handle
+Output     : None
+Return     : true while a burst is still being onlined
+*****************************************************************************/
+static bool mem_report(void *handle)
+{
+    MEM_POOL *pool = &g_mem_pool;
+    char result[MEM_RESULT_LEN] = {0};
+    unsigned int onlined, failed;
+    long long elapsed;
+    bool overflow;
+
+    (void)pthread_mutex_lock(&pool->mutex);
+    if (0 != pool->count || 0 != pool->busy)
+    {
+        (void)pthread_mutex_unlock(&pool->mutex);
+        return true;
+    }
+    onlined = pool->onlined;
+    failed = pool->failed;
+    overflow = pool->overflow;
+    elapsed = pool->end_ms - pool->start_ms;
+    pool->onlined = 0;
+    pool->failed = 0;
+    pool->overflow = false;
+    (void)pthread_mutex_unlock(&pool->mutex);
+
+    if (overflow)
+    {
+        mem_scan(MEM_SCAN_NEW);
+    }
+    if (0 == onlined && 0 == failed)
+    {
+        return overflow;
+    }
+    INFO_LOG("Onlined %u hot-added memory blocks in %lld ms, %u failed.", onlined, elapsed, failed);
+    (void)snprintf_s(result, sizeof(result), sizeof(result) - 1,
+                     "onlined=%u failed=%u elapsed_ms=%lld", onlined, failed, elapsed);
+    write_to_xenstore(handle, MEM_ONLINE_RESULT_PATH, result);
+    return overflow;
+}
+
+/*****************************************************************************
+Function   : mem_listener
+Description: queue every block the kernel adds; while a burst is onlined,
+             wake up every MEM_REPORT_DELAY_MS to report it once it is done.
+             The blocks already offline at start are only onlined when the
+             host set MEM_ONLINE_ZONE_PATH: the monitor is restarted by its
+             watchdog too, and must not undo an admin's offline.
+Input      : shared -- xenstore handle of the watch loop
+Output     : None
+Return     : None
+*****************************************************************************/
+static void *mem_listener(void *shared)
+{
+    void *handle = xenstore_pool_get(shared);
+    char *zone = NULL;
+    struct pollfd pfd;
+    bool pending;
+    int fd;
+
+    zone = read_from_xenstore(handle, MEM_ONLINE_ZONE_PATH);
+    memhotplug_set_zone(zone);
+
+    /* bound before the scan, so a block added meanwhile is not missed */
+    fd = mem_uevent_socket();
+    mem_scan(NULL != zone ? MEM_SCAN_ALL : MEM_SCAN_RECORD);
+    free(zone);
+    pending = true;
+
+    for (;;)
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        /* without uevents only the blocks found at start can be onlined */
+        if (fd < 0 && !pending)
+        {
+            break;
+        }
+        if (poll(&pfd, fd < 0 ? 0 : 1, pending ? MEM_REPORT_DELAY_MS : -1) > 0)
+        {
+            mem_uevent(fd);
+            pending = true;
+            continue;
+        }
+        handle = xenstore_pool_renew(handle);
+        pending = mem_report(handle);
+    }
+    xenstore_pool_put(handle);
+    return NULL;
+}
+
+/*****************************************************************************
+Function   : memhotplug_start
+Description: start the listener and the onlining workers, once
+Input      : handle -- xenstore handle of the watch loop
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int memhotplug_start(void *handle)
+{
+    pthread_attr_t attr;
+    pthread_t thread_id;
+    int workers = 0;
+    int i;
+
+    if (g_mem_started || 0 != access(MEM_SYSFS_DIR, F_OK))
+    {
+        return g_mem_started ? SUCC : ERROR;
+    }
+
+    (void)pthread_attr_init(&attr);
+    (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    footprint_thread_attr(&attr);
+    for (i = 0; i < MEM_WORKERS; i++)
+    {
+        if (0 == pthread_create(&thread_id, &attr, mem_worker, NULL))
+        {
+            workers++;
+        }
+    }
+    if (0 == workers || 0 != pthread_create(&thread_id, &attr, mem_listener, handle))
+    {
+        ERR_LOG("Create memory hotplug threads failed, errno=%d.", errno);
+        (void)pthread_attr_destroy(&attr);
+        return ERROR;
+    }
+    (void)pthread_attr_destroy(&attr);
+    g_mem_started = true;
+    return SUCC;
+}
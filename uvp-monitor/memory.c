@@ -32,28 +32,149 @@
 #include "libxenctl.h"
 #include "securec.h"
 #include "uvpmon.h"
+#include "procparse.h"
+#include "perfbin.h"
 
-#define PROC_MEMINFO "/proc/meminfo"
 #define MEM_DATA_PATH  "control/uvp/memory"
 #define SWAP_MEM_DATA_PATH  "control/uvp/mem_swap"
+#define MEM_PRESSURE_PATH  "control/uvp/mem_pressure"
 #define TMP_BUFFER_SIZE 255
-#define DECIMAL 10
+#define PSI_AVG_NUM 3
+#define PSI_VALUE_LEN 16
+
+/* control/uvp/memoryĸֶΣλKB */
+typedef enum
+{
+    MEM_FIELD_AVAILABLE = 0,
+    MEM_FIELD_TOTAL,
+    MEM_FIELD_USED,
+    MEM_FIELD_BUFFERS,
+    MEM_FIELD_CACHED,
+    MEM_FIELD_BUTT
+} MEM_FIELD;
+
+/* the /proc/meminfo fields used, indexed by MEMINFO_KEY */
+typedef enum
+{
+    MEMINFO_MEM_TOTAL = 0,
+    MEMINFO_MEM_FREE,
+    MEMINFO_MEM_AVAILABLE,
+    MEMINFO_BUFFERS,
+    MEMINFO_CACHED,
+    MEMINFO_SWAP_CACHED,
+    MEMINFO_SWAP_TOTAL,
+    MEMINFO_SWAP_FREE,
+    MEMINFO_SRECLAIMABLE,
+    MEMINFO_NFS_UNSTABLE
+} MEMINFO_KEY;
+
+static const char *const g_meminfo_keys[] =
+{
+    "MemTotal",
+    "MemFree",
+    "MemAvailable",
+    "Buffers",
+    "Cached",
+    "SwapCached",
+    "SwapTotal",
+    "SwapFree",
+    "SReclaimable",
+    "NFS_Unstable",
+};
+
+static PROC_KEYMAP g_meminfo_keymap = PROC_KEYMAP_INITIALIZER(g_meminfo_keys);
+
+/* the /proc/vmstat counters reported as deltas in MEM_PRESSURE_PATH */
+typedef enum
+{
+    VMSTAT_PGMAJFAULT = 0,
+    VMSTAT_PSWPIN,
+    VMSTAT_PSWPOUT,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_WORKINGSET_REFAULT,
+    VMSTAT_COUNTER_BUTT
+} VMSTAT_COUNTER;
+
+/* newer kernels split allocstall per zone and workingset_refault per lru, the parts are summed */
+static const char *const g_vmstat_keys[] =
+{
+    "pgmajfault",
+    "pswpin",
+    "pswpout",
+    "allocstall",
+    "allocstall_dma",
+    "allocstall_dma32",
+    "allocstall_normal",
+    "allocstall_movable",
+    "workingset_refault",
+    "workingset_refault_anon",
+    "workingset_refault_file",
+};
+
+/* indexed like g_vmstat_keys */
+static const VMSTAT_COUNTER g_vmstat_counters[] =
+{
+    VMSTAT_PGMAJFAULT,
+    VMSTAT_PSWPIN,
+    VMSTAT_PSWPOUT,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_WORKINGSET_REFAULT,
+    VMSTAT_WORKINGSET_REFAULT,
+    VMSTAT_WORKINGSET_REFAULT,
+};
+
+static PROC_KEYMAP g_vmstat_keymap = PROC_KEYMAP_INITIALIZER(g_vmstat_keys);
+
+/* counters of the previous sample */
+static unsigned long long g_vmstat_prev[VMSTAT_COUNTER_BUTT];
+static int g_vmstat_first = 1;
+
+/*****************************************************************************
+Function   : PerfbinMemory
+Description: ڴswapϢдܼ¼λKB
+Input       :mem : MEM_FIELD˳ڴϢ
+             swap_total, swap_free : swap
+Output     : None
+Return     : None
+*****************************************************************************/
+static void PerfbinMemory(const unsigned long mem[MEM_FIELD_BUTT], unsigned long swap_total, unsigned long swap_free)
+{
+    unsigned char raw[64];
+    PERFBIN_BUF buf;
+    size_t mark;
+    int i;
+
+    perfbin_buf_init(&buf, raw, sizeof(raw));
+    mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_MEMORY);
+    for (i = 0; i < MEM_FIELD_BUTT; i++)
+    {
+        perfbin_put_uint(&buf, mem[i]);
+    }
+    perfbin_tlv_end(&buf, mark);
+    mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_SWAP);
+    perfbin_put_uint(&buf, swap_total);
+    perfbin_put_uint(&buf, swap_total - swap_free);
+    perfbin_put_uint(&buf, swap_free);
+    perfbin_tlv_end(&buf, mark);
+    perfbin_section_set(PERFBIN_SECTION_MEMORY, &buf);
+}
 
 /*****************************************************************************
 Function   : GetMMUseRatio
 Description:  memory
-Input       :meminfoļ·
 Input       :char size
 Output     :˳򱣴ڴڴڴʹڴbuffer
             ڴcacheԼswapswapʹswapλKB
 Return     : memory
 *****************************************************************************/
-int GetMMUseRatio(const char *mem_file, char *meminfo_buf, int size, char *swap_meminfo_buf)
+int GetMMUseRatio(char *meminfo_buf, int size, char *swap_meminfo_buf)
 {
-    FILE *file;
-    char tmp_buffer[TMP_BUFFER_SIZE + 1];
-    char *start = NULL;
-    char *start_swap = NULL;
+    PROC_VIEW view;
+    PROC_LINE line;
     int MemAvailable_flag = 0;
     unsigned long ulMemTotal = 0L;
     unsigned long ulMemFree = 0L;
@@ -65,11 +186,11 @@ int GetMMUseRatio(const char *mem_file, char *meminfo_buf, int size, char *swap_
     unsigned long ulMemNFSUnstable = 0L;
     unsigned long ulSwapTotal = 0L;
     unsigned long ulSwapFree = 0L;
+    unsigned long mem[MEM_FIELD_BUTT] = {0};
     
     int iRetLen = 0;
 
-    file = fopen(mem_file, "r");
-    if (NULL == file)
+    if (SUCC != proc_source_read(PROC_MEMINFO, PROC_SOURCE_REFRESH, &view))
     {
         //	LogPrint("Unable to open %s, errno: %d\n", PROC_MEMINFO, errno);
 
@@ -77,135 +198,225 @@ int GetMMUseRatio(const char *mem_file, char *meminfo_buf, int size, char *swap_
         (void)strncpy_s(swap_meminfo_buf, size+1, ERR_STR, size);
         meminfo_buf[size] = '\0';
         swap_meminfo_buf[size] = '\0';
+        if (perfbin_enabled())
+        {
+            perfbin_section_fail(PERFBIN_SECTION_MEMORY, PERFBIN_TLV_MEMORY);
+        }
 
         return ERROR;
         //lint -save -e438
     }
 
-    while (NULL != fgets(tmp_buffer, TMP_BUFFER_SIZE, file))
+    while (proc_view_next_line(&view, &line))
     {
-        /*get total memory*/
-        start = strstr(tmp_buffer, "MemTotal:");
-
-        if ( NULL != start )
-        {
-            start = start + strlen("MemTotal:");
-            /*lMemTotal = atol(start);*/
-            ulMemTotal = strtoul(start, NULL, DECIMAL);
-        }
-        /*get free memory*/
-        start = strstr(tmp_buffer, "MemFree:");
-        if ( NULL != start )
+        switch (proc_keymap_find(&g_meminfo_keymap, line.key, line.key_len))
         {
-            start = start + strlen("MemFree:");
-            /*lMemFree = atol(start);*/
-            ulMemFree = strtoul(start, NULL, DECIMAL);
-        }
-        /*get MemAvailable memory*/
-        start = strstr(tmp_buffer, "MemAvailable:");
-        if ( NULL != start )
-        {
-            start = start + strlen("MemAvailable:");
-            /*lMemFree = atol(start);*/
-            ulMemAvailable = strtoul(start, NULL, DECIMAL);
-            MemAvailable_flag = 1;
+            case MEMINFO_MEM_TOTAL:
+                ulMemTotal = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_MEM_FREE:
+                ulMemFree = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_MEM_AVAILABLE:
+                ulMemAvailable = (unsigned long)proc_line_ull(&line);
+                MemAvailable_flag = 1;
+                break;
+            case MEMINFO_BUFFERS:
+                ulMemBuffers = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_CACHED:
+                ulMemCached = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_SWAP_CACHED:
+                ulMemSwapCached = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_SWAP_TOTAL:
+                ulSwapTotal = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_SWAP_FREE:
+                ulSwapFree = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_SRECLAIMABLE:
+                ulMemSReclaimable = (unsigned long)proc_line_ull(&line);
+                break;
+            case MEMINFO_NFS_UNSTABLE:
+                ulMemNFSUnstable = (unsigned long)proc_line_ull(&line);
+                break;
+            default:
+                break;
         }
+    }
 
-        /*get buffers memory*/
-        start = strstr(tmp_buffer, "Buffers:");
-        if ( NULL != start )
+    if(MemAvailable_flag)
+    {
+        mem[MEM_FIELD_AVAILABLE] = ulMemAvailable;
+        mem[MEM_FIELD_USED] = ulMemTotal - ulMemAvailable;
+    }
+    else
+    {
+        if(is_suse())
         {
-            start = start + strlen("Buffers:");
-            ulMemBuffers = strtoul(start, NULL, DECIMAL);
+            mem[MEM_FIELD_AVAILABLE] = ulMemFree + ulMemBuffers + ulMemCached + ulMemSwapCached
+                                       + ulMemSReclaimable + ulMemNFSUnstable;
         }
-        /*get cached memory*/
-        start = strstr(tmp_buffer, "Cached:");
-        if ( NULL != start )
+        else
         {
-            if(0 == strncmp(tmp_buffer, "Cached:", 7))
-            {
-                start = start + strlen("Cached:");
-                ulMemCached = strtoul(start, NULL, DECIMAL);
-            }
+            mem[MEM_FIELD_AVAILABLE] = ulMemFree + ulMemBuffers + ulMemCached;
         }
-        /*get SwapCached memory*/
-        start = strstr(tmp_buffer, "SwapCached:");
-        if ( NULL != start )
+        mem[MEM_FIELD_USED] = ulMemTotal - ulMemFree;
+    }
+    mem[MEM_FIELD_TOTAL] = ulMemTotal;
+    mem[MEM_FIELD_BUFFERS] = ulMemBuffers;
+    mem[MEM_FIELD_CACHED] = ulMemCached;
+
+    iRetLen = snprintf_s(meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu:%lu:%lu",
+                mem[MEM_FIELD_AVAILABLE],
+                mem[MEM_FIELD_TOTAL],
+                mem[MEM_FIELD_USED],
+                mem[MEM_FIELD_BUFFERS],
+                mem[MEM_FIELD_CACHED]);
+    meminfo_buf[iRetLen] = '\0';
+
+    iRetLen = snprintf_s(swap_meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu",
+                    ulSwapTotal,
+                    ulSwapTotal - ulSwapFree,
+                    ulSwapFree);
+    swap_meminfo_buf[iRetLen] = '\0';
+
+    if (perfbin_enabled())
+    {
+        PerfbinMemory(mem, ulSwapTotal, ulSwapFree);
+    }
+    
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : GetPsiAverages
+Description: ȡ/proc/pressure/memorysomefullavg10avg60avg300
+Input       :None
+Output     :avg : Ϊsome3ƽֵfull3ƽֵں˲֧PSIʱΪ"-1"
+Return     : None
+*****************************************************************************/
+static void GetPsiAverages(char avg[][PSI_VALUE_LEN])
+{
+    static const char *const names[PSI_AVG_NUM] = {"avg10", "avg60", "avg300"};
+    PROC_VIEW view;
+    PROC_LINE line;
+    const char *name = NULL;
+    const char *value = NULL;
+    size_t name_len;
+    int base;
+    int i;
+
+    for (i = 0; i < 2 * PSI_AVG_NUM; i++)
+    {
+        (void)strncpy_s(avg[i], PSI_VALUE_LEN, "-1", 2);
+    }
+    /* PSI needs linux 4.20 and psi=1 */
+    if (SUCC != proc_source_read(PROC_PRESSURE_MEMORY, PROC_SOURCE_REFRESH, &view))
+    {
+        return;
+    }
+
+    /* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+    while (proc_view_next_line(&view, &line))
+    {
+        if (4 == line.key_len && 0 == strncmp(line.key, "some", 4))
         {
-            start = start + strlen("SwapCached:");
-            ulMemSwapCached = strtoul(start, NULL, DECIMAL);
+            base = 0;
         }
-        /*get swap total*/
-        start = strstr(tmp_buffer, "SwapTotal:");
-        if ( NULL != start )
+        else if (4 == line.key_len && 0 == strncmp(line.key, "full", 4))
         {
-            start = start + strlen("SwapTotal:");
-            ulSwapTotal = strtoul(start, NULL, DECIMAL);
+            base = PSI_AVG_NUM;
         }
-        /*get swap free*/
-        start = strstr(tmp_buffer, "SwapFree:");
-        if ( NULL != start )
+        else
         {
-            start = start + strlen("SwapFree:");
-            ulSwapFree = strtoul(start, NULL, DECIMAL);
+            continue;
         }
-        /*get SReclaiable memory*/
-        start = strstr(tmp_buffer, "SReclaimable:");
-        if ( NULL != start )
-        {
-            start = start + strlen("SReclaimable:");
-            ulMemSReclaimable = strtoul(start, NULL, DECIMAL);
-        }      
-        /*get NFSUnstable memory*/
-        start = strstr(tmp_buffer, "NFS_Unstable:");
-        if ( NULL != start )
+
+        while (line.pos < line.end)
         {
-            start = start + strlen("NFS_Unstable:");
-            ulMemNFSUnstable = strtoul(start, NULL, DECIMAL);
-            break;
+            while (line.pos < line.end && ' ' == *line.pos)
+            {
+                line.pos++;
+            }
+            name = line.pos;
+            while (line.pos < line.end && '=' != *line.pos && ' ' != *line.pos)
+            {
+                line.pos++;
+            }
+            name_len = (size_t)(line.pos - name);
+            if (line.pos >= line.end || '=' != *line.pos)
+            {
+                continue;
+            }
+            value = ++line.pos;
+            while (line.pos < line.end && ' ' != *line.pos)
+            {
+                line.pos++;
+            }
+            for (i = 0; i < PSI_AVG_NUM; i++)
+            {
+                if (strlen(names[i]) == name_len && 0 == strncmp(name, names[i], name_len)
+                    && (size_t)(line.pos - value) < PSI_VALUE_LEN)
+                {
+                    (void)strncpy_s(avg[base + i], PSI_VALUE_LEN, value, (size_t)(line.pos - value));
+                }
+            }
         }
-
     }
+}
 
-    (void)fclose(file);
-    if(MemAvailable_flag)
+/*****************************************************************************
+Function   : GetMemPressure
+Description: ڴѹϢPSIsomefullƽֵԼϴβ
+             pgmajfaultpswpinpswpoutallocstallworkingset_refault
+Input       :size : bufferС
+Output     :pressure_buf : some_avg10:some_avg60:some_avg300:full_avg10:full_avg60:
+            full_avg300:pgmajfault:pswpin:pswpout:allocstall:workingset_refault
+Return     : SUCC or ERROR
+*****************************************************************************/
+int GetMemPressure(char *pressure_buf, int size)
+{
+    PROC_VIEW view;
+    PROC_LINE line;
+    char avg[2 * PSI_AVG_NUM][PSI_VALUE_LEN];
+    unsigned long long counters[VMSTAT_COUNTER_BUTT] = {0};
+    unsigned long long delta[VMSTAT_COUNTER_BUTT] = {0};
+    int idx;
+    int i;
+
+    if (SUCC != proc_source_read(PROC_VMSTAT, PROC_SOURCE_REFRESH, &view))
     {
-        iRetLen = snprintf_s(meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu:%lu:%lu",
-                    ulMemAvailable,
-                    ulMemTotal,
-                    ulMemTotal - ulMemAvailable,
-                    ulMemBuffers,
-                    ulMemCached);
+        return ERROR;
     }
-    else
+    while (proc_view_next_line(&view, &line))
     {
-        if(is_suse())
+        idx = proc_keymap_find(&g_vmstat_keymap, line.key, line.key_len);
+        if (idx >= 0)
         {
-            iRetLen = snprintf_s(meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu:%lu:%lu", 
-                        ulMemFree + ulMemBuffers + ulMemCached + ulMemSwapCached + ulMemSReclaimable + ulMemNFSUnstable,
-                        ulMemTotal,
-                        ulMemTotal - ulMemFree,
-                        ulMemBuffers,
-                        ulMemCached);
+            counters[g_vmstat_counters[idx]] += proc_line_ull(&line);
         }
-        else
+    }
+
+    /* ״βûǰֵΪ0ʱͬΪ0 */
+    for (i = 0; i < VMSTAT_COUNTER_BUTT; i++)
+    {
+        if (!g_vmstat_first && counters[i] >= g_vmstat_prev[i])
         {
-            iRetLen = snprintf_s(meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu:%lu:%lu",
-                        ulMemFree + ulMemBuffers + ulMemCached,
-                        ulMemTotal,
-                        ulMemTotal - ulMemFree,
-                        ulMemBuffers,
-                        ulMemCached);
+            delta[i] = counters[i] - g_vmstat_prev[i];
         }
+        g_vmstat_prev[i] = counters[i];
     }
-    meminfo_buf[iRetLen] = '\0';
+    g_vmstat_first = 0;
 
-    iRetLen = snprintf_s(swap_meminfo_buf, size - 1, size - 1, "%lu:%lu:%lu",
-                    ulSwapTotal,
-                    ulSwapTotal - ulSwapFree,
-                    ulSwapFree);
-    swap_meminfo_buf[iRetLen] = '\0';
-    
+    GetPsiAverages(avg);
+
+    (void)snprintf_s(pressure_buf, size, size - 1, "%s:%s:%s:%s:%s:%s:%llu:%llu:%llu:%llu:%llu",
+                     avg[0], avg[1], avg[2], avg[3], avg[4], avg[5],
+                     delta[VMSTAT_PGMAJFAULT], delta[VMSTAT_PSWPIN], delta[VMSTAT_PSWPOUT],
+                     delta[VMSTAT_ALLOCSTALL], delta[VMSTAT_WORKINGSET_REFAULT]);
     return SUCC;
 }
 
@@ -220,23 +431,27 @@ int memoryworkctlmon(struct xs_handle *handle)
 {
     char tmp_buffer[TMP_BUFFER_SIZE + 1];
     char tmp_swap_buffer[TMP_BUFFER_SIZE + 1];
+    char tmp_pressure_buffer[TMP_BUFFER_SIZE + 1] = {0};
 
     if (NULL == handle)
     {
         return -1;
     }
 
-    (void)GetMMUseRatio(PROC_MEMINFO, tmp_buffer, TMP_BUFFER_SIZE, tmp_swap_buffer);
-
-    if(xb_write_first_flag == 0)
+    (void)GetMMUseRatio(tmp_buffer, TMP_BUFFER_SIZE, tmp_swap_buffer);
+    if (g_exinfo_flag_value & EXINFO_FLAG_MEM_PRESSURE)
     {
-        write_to_xenstore(handle, MEM_DATA_PATH, tmp_buffer);
-        write_to_xenstore(handle, SWAP_MEM_DATA_PATH, tmp_swap_buffer);
+        if (SUCC != GetMemPressure(tmp_pressure_buffer, sizeof(tmp_pressure_buffer)))
+        {
+            (void)strncpy_s(tmp_pressure_buffer, sizeof(tmp_pressure_buffer), ERR_STR, strlen(ERR_STR));
+        }
     }
-    else
+
+    write_perf_to_xenstore(handle, MEM_DATA_PATH, tmp_buffer, xb_write_first_flag);
+    write_perf_to_xenstore(handle, SWAP_MEM_DATA_PATH, tmp_swap_buffer, xb_write_first_flag);
+    if (g_exinfo_flag_value & EXINFO_FLAG_MEM_PRESSURE)
     {
-        write_weak_to_xenstore(handle, MEM_DATA_PATH, tmp_buffer);
-        write_weak_to_xenstore(handle, SWAP_MEM_DATA_PATH, tmp_swap_buffer);
+        write_perf_to_xenstore(handle, MEM_PRESSURE_PATH, tmp_pressure_buffer, xb_write_first_flag);
     }
 
     //write_to_xenstore(handle, MEM_DATA_PATH, tmp_buffer);
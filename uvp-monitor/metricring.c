@@ -0,0 +1,280 @@
+/*
+ * Metric ring in pages shared with dom0 through the grant table.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "xenstore_common.h"
+#include "metricring.h"
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define METRIC_RING_REFS_LEN    128
+#define METRIC_RING_VALUE_LEN   128
+#define MSEC_PER_SEC            1000
+#define NSEC_PER_MSEC           1000000
+#define DECIMAL                 10
+
+static unsigned char *g_metric_ring = NULL;
+static size_t g_metric_size = 0;
+static size_t g_metric_slot_size = 0;
+static long g_metric_page_size = 0;
+static unsigned long g_metric_refs[METRIC_RING_PAGES];
+/*
+ * The ring is opened and written only by the collector thread, so it is not
+ * locked. The watch loop only re-advertises the refs after a restore; they
+ * are complete before g_metric_granted is set.
+ */
+static bool g_metric_granted = false;
+
+static METRIC_RING_HEADER *metricring_header(void)
+{
+    return (METRIC_RING_HEADER *)g_metric_ring;
+}
+
+static METRIC_RING_SLOT *metricring_slot(uint32_t idx)
+{
+    return (METRIC_RING_SLOT *)(g_metric_ring + METRIC_RING_HEADER_SIZE
+                                + (size_t)(idx % METRIC_RING_SLOTS) * g_metric_slot_size);
+}
+
+/*****************************************************************************
+Function   : metricring_read_refs
+Description: read the grant references of the shared pages from the driver
+Input      : fd -- the opened driver entry
+Output     : g_metric_refs
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int metricring_read_refs(int fd)
+{
+    char refs[METRIC_RING_REFS_LEN] = {0};
+    char *pos = refs;
+    char *end = NULL;
+    ssize_t len;
+    int i;
+
+    len = read(fd, refs, sizeof(refs) - 1);
+    if (len <= 0)
+    {
+        ERR_LOG("Read metric ring refs failed, errno=%d.", errno);
+        return ERROR;
+    }
+    for (i = 0; i < METRIC_RING_PAGES; i++)
+    {
+        g_metric_refs[i] = strtoul(pos, &end, DECIMAL);
+        if (end == pos)
+        {
+            ERR_LOG("Metric ring refs \"%s\" are incomplete.", refs);
+            return ERROR;
+        }
+        pos = end;
+    }
+    return SUCC;
+}
+
+/* map the driver pages, or the stand-in file when the driver is not loaded */
+static int metricring_map(void)
+{
+    struct stat st;
+    void *area = NULL;
+    int fd;
+
+    /* the driver shares METRIC_RING_PAGES of its PAGE_SIZE */
+    g_metric_page_size = sysconf(_SC_PAGESIZE);
+    if (g_metric_page_size <= 0)
+    {
+        ERR_LOG("Get page size failed, errno=%d.", errno);
+        return ERROR;
+    }
+    g_metric_size = (size_t)g_metric_page_size * METRIC_RING_PAGES;
+    /* slots start 8-byte aligned */
+    g_metric_slot_size = ((g_metric_size - METRIC_RING_HEADER_SIZE) / METRIC_RING_SLOTS) & ~(size_t)7;
+
+    fd = open(METRIC_RING_DEV, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fd = open(METRIC_RING_DEV_ALT, O_RDWR | O_CLOEXEC);
+    }
+    if (fd >= 0)
+    {
+        if (SUCC != metricring_read_refs(fd))
+        {
+            (void)close(fd);
+            return ERROR;
+        }
+        __sync_synchronize();
+        g_metric_granted = true;
+    }
+    else
+    {
+        if (0 != stat(METRIC_RING_STANDIN, &st) || !S_ISREG(st.st_mode))
+        {
+            return ERROR;
+        }
+        fd = open(METRIC_RING_STANDIN, O_RDWR | O_CLOEXEC);
+        if (fd < 0 || 0 != ftruncate(fd, (off_t)g_metric_size))
+        {
+            ERR_LOG("Open metric ring stand-in failed, errno=%d.", errno);
+            if (fd >= 0)
+            {
+                (void)close(fd);
+            }
+            return ERROR;
+        }
+        INFO_LOG("Metric ring is mapped from %s.", METRIC_RING_STANDIN);
+    }
+
+    area = mmap(NULL, g_metric_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (MAP_FAILED == area)
+    {
+        ERR_LOG("Map metric ring failed, errno=%d.", errno);
+        g_metric_granted = false;
+        return ERROR;
+    }
+    g_metric_ring = (unsigned char *)area;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : metricring_open
+Description: map the shared pages, set up the ring header and advertise the
+             grant references in METRIC_RING_PATH. Without the xen-metrics
+             driver (and without the stand-in file) the ring stays closed and
+             the monitor only uses xenstore.
+Input      : handle -- xenstore handle
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int metricring_open(void *handle)
+{
+    METRIC_RING_HEADER *header = NULL;
+    uint32_t head = 0;
+
+    if (NULL != g_metric_ring)
+    {
+        return SUCC;
+    }
+    if (SUCC != metricring_map())
+    {
+        return ERROR;
+    }
+
+    header = metricring_header();
+    /* a restarted monitor keeps counting, so head never goes back for a reader */
+    if (METRIC_RING_MAGIC == header->magic && METRIC_RING_VERSION == header->version)
+    {
+        head = header->head;
+    }
+    header->magic = 0;
+    __sync_synchronize();
+    header->version = METRIC_RING_VERSION;
+    header->header_size = METRIC_RING_HEADER_SIZE;
+    header->slot_size = (uint32_t)g_metric_slot_size;
+    header->slot_count = METRIC_RING_SLOTS;
+    header->head = head;
+    __sync_synchronize();
+    header->magic = METRIC_RING_MAGIC;
+
+    metricring_advertise(handle);
+    return SUCC;
+}
+
+bool metricring_ready(void)
+{
+    return NULL != g_metric_ring;
+}
+
+/*****************************************************************************
+Function   : metricring_advertise
+Description: write the ring version and grant references to METRIC_RING_PATH;
+             again after migration, when the xenstore tree is new
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+void metricring_advertise(void *handle)
+{
+    char value[METRIC_RING_VALUE_LEN] = {0};
+    int len;
+    int i;
+
+    if (!g_metric_granted)
+    {
+        return;
+    }
+    len = snprintf_s(value, sizeof(value), sizeof(value) - 1, "%d:%ld",
+                     METRIC_RING_VERSION, g_metric_page_size);
+    for (i = 0; i < METRIC_RING_PAGES && len > 0; i++)
+    {
+        len += snprintf_s(value + len, sizeof(value) - len, sizeof(value) - len - 1,
+                          ":%lu", g_metric_refs[i]);
+    }
+    write_to_xenstore(handle, METRIC_RING_PATH, value);
+}
+
+/*****************************************************************************
+Function   : metricring_publish
+Description: put one record into the next slot of the ring
+Input      : record -- the record
+             len    -- length of the record, at most the slot data size
+Output     : None
+Return     : None
+*****************************************************************************/
+void metricring_publish(const unsigned char *record, size_t len)
+{
+    METRIC_RING_HEADER *header = NULL;
+    METRIC_RING_SLOT *slot = NULL;
+    struct timespec ts;
+
+    if (NULL == g_metric_ring || len > g_metric_slot_size - METRIC_RING_SLOT_HEAD)
+    {
+        return;
+    }
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+    header = metricring_header();
+    slot = metricring_slot(header->head);
+    /* odd even if a previous writer died half way */
+    slot->seq |= 1;
+    __sync_synchronize();
+    (void)memcpy_s(slot->data, g_metric_slot_size - METRIC_RING_SLOT_HEAD, record, len);
+    slot->len = (uint32_t)len;
+    slot->stamp = (uint64_t)ts.tv_sec * MSEC_PER_SEC + (uint64_t)ts.tv_nsec / NSEC_PER_MSEC;
+    __sync_synchronize();
+    slot->seq++;
+    __sync_synchronize();
+    header->head++;
+}
@@ -0,0 +1,304 @@
+/*
+ * Builds a table of interface counters keyed by interface name once per
+ * sample, from route netlink link stats or from /proc/net/dev.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "procsrc.h"
+#include "netdev.h"
+#include "rtnl.h"
+#include <ctype.h>
+
+#define NET_DEV_LINE_LEN        512
+#define NET_DEV_INIT_NUM        16
+#define NET_DEV_HASH_MIN        64
+#define DECIMAL                 10
+
+typedef struct
+{
+    NET_DEV_STAT *entries;      /* in ifindex order */
+    int count;
+    int capacity;
+    int *index;                 /* open addressing over entries, -1 is empty */
+    unsigned int index_size;    /* power of two, at least twice count */
+} NET_DEV_TABLE;
+
+static NET_DEV_TABLE g_netdev_table = {NULL, 0, 0, NULL, 0};
+
+static unsigned int netdev_hash(const char *name)
+{
+    unsigned int hash = 2166136261U;
+
+    while ('\0' != *name)
+    {
+        hash = (hash ^ (unsigned char)*name++) * 16777619U;
+    }
+    return hash;
+}
+
+static int netdev_table_reserve(NET_DEV_TABLE *table, int count)
+{
+    NET_DEV_STAT *entries = NULL;
+    int capacity = table->capacity ? table->capacity : NET_DEV_INIT_NUM;
+
+    if (count <= table->capacity)
+    {
+        return SUCC;
+    }
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    entries = (NET_DEV_STAT *)realloc(table->entries, capacity * sizeof(NET_DEV_STAT));
+    if (NULL == entries)
+    {
+        return ERROR;
+    }
+    table->entries = entries;
+    table->capacity = capacity;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : netdev_table_index
+Description: rebuild the name index after the entries were parsed
+Input      : table -- the interface table
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int netdev_table_index(NET_DEV_TABLE *table)
+{
+    unsigned int size = NET_DEV_HASH_MIN;
+    unsigned int slot;
+    int *index = NULL;
+    int i;
+
+    while (size < 2 * (unsigned int)table->count)
+    {
+        size *= 2;
+    }
+    if (size != table->index_size)
+    {
+        index = (int *)realloc(table->index, size * sizeof(int));
+        if (NULL == index)
+        {
+            return ERROR;
+        }
+        table->index = index;
+        table->index_size = size;
+    }
+    (void)memset_s(table->index, size * sizeof(int), 0xff, size * sizeof(int));
+
+    for (i = 0; i < table->count; i++)
+    {
+        slot = netdev_hash(table->entries[i].ifname) & (size - 1);
+        while (table->index[slot] >= 0)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        table->index[slot] = i;
+    }
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : netdev_parse_line
+Description: parse one interface line of /proc/net/dev,
+             "  eth0: rx_bytes rx_packets errs drop ... tx_bytes tx_packets errs drop ..."
+Input      : line -- the line
+Output     : stat -- the counters
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int netdev_parse_line(char *line, NET_DEV_STAT *stat)
+{
+    unsigned long long value[12];
+    char *name = line;
+    char *p = NULL;
+    int i;
+
+    while (isspace((unsigned char)*name))
+    {
+        name++;
+    }
+    p = strchr(name, ':');
+    if (NULL == p || p == name || p - name >= IFNAMSIZ)
+    {
+        return ERROR;
+    }
+    *p++ = '\0';
+
+    for (i = 0; i < 12; i++)
+    {
+        value[i] = strtoull(p, &p, DECIMAL);
+    }
+
+    (void)strncpy_s(stat->ifname, IFNAMSIZ, name, IFNAMSIZ - 1);
+    stat->rx_bytes = value[0];
+    stat->rx_packets = value[1];
+    stat->rx_drop = value[3];
+    stat->tx_bytes = value[8];
+    stat->tx_packets = value[9];
+    stat->tx_drop = value[11];
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : netdev_table_load_rtnl
+Description: fill the table from the link stats of the route netlink model
+Input      : table -- the interface table
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int netdev_table_load_rtnl(NET_DEV_TABLE *table)
+{
+    const RTNL_LINK *link = NULL;
+    NET_DEV_STAT *stat = NULL;
+    int i;
+
+    if (SUCC != netdev_table_reserve(table, rtnl_link_count()))
+    {
+        return ERROR;
+    }
+    for (i = 0; i < rtnl_link_count(); i++)
+    {
+        link = rtnl_link_entry(i);
+        stat = &table->entries[table->count++];
+        (void)strncpy_s(stat->ifname, IFNAMSIZ, link->ifname, IFNAMSIZ - 1);
+        stat->rx_bytes = link->rx_bytes;
+        stat->rx_packets = link->rx_packets;
+        stat->rx_drop = link->rx_drop;
+        stat->tx_bytes = link->tx_bytes;
+        stat->tx_packets = link->tx_packets;
+        stat->tx_drop = link->tx_drop;
+    }
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : netdev_table_refresh
+Description: take the route netlink counters of this sample, or a
+             /proc/net/dev snapshot if netlink is not usable, and rebuild
+             the table
+Input      : None
+Output     : None
+Return     : number of interfaces, or ERROR
+*****************************************************************************/
+int netdev_table_refresh(void)
+{
+    NET_DEV_TABLE *table = &g_netdev_table;
+    char line[NET_DEV_LINE_LEN];
+    PROC_VIEW view;
+
+    table->count = 0;
+    /* brings the addresses and routes of this sample up to date as well */
+    if (SUCC == rtnl_model_refresh() && rtnl_stats_valid())
+    {
+        if (SUCC != netdev_table_load_rtnl(table) || SUCC != netdev_table_index(table))
+        {
+            table->count = 0;
+            return ERROR;
+        }
+        return table->count;
+    }
+
+    if (SUCC != proc_source_read(PROC_NET_DEV, PROC_SOURCE_REFRESH, &view))
+    {
+        DEBUG_LOG("Failed to read /proc/net/dev.");
+        return ERROR;
+    }
+
+    /* skip the two header lines */
+    (void)proc_view_gets(line, sizeof(line), &view);
+    (void)proc_view_gets(line, sizeof(line), &view);
+    while (NULL != proc_view_gets(line, sizeof(line), &view))
+    {
+        if (SUCC != netdev_table_reserve(table, table->count + 1))
+        {
+            break;
+        }
+        if (SUCC == netdev_parse_line(line, &table->entries[table->count]))
+        {
+            table->count++;
+        }
+    }
+
+    if (SUCC != netdev_table_index(table))
+    {
+        table->count = 0;
+        return ERROR;
+    }
+    return table->count;
+}
+
+int netdev_table_count(void)
+{
+    return g_netdev_table.count;
+}
+
+const NET_DEV_STAT *netdev_table_entry(int idx)
+{
+    if (idx < 0 || idx >= g_netdev_table.count)
+    {
+        return NULL;
+    }
+    return &g_netdev_table.entries[idx];
+}
+
+/*****************************************************************************
+Function   : netdev_table_lookup
+Description: find the counters of an interface in the current table
+Input      : ifname -- the interface name
+Output     : None
+Return     : the counters, or NULL if the interface is not listed
+*****************************************************************************/
+const NET_DEV_STAT *netdev_table_lookup(const char *ifname)
+{
+    NET_DEV_TABLE *table = &g_netdev_table;
+    unsigned int slot;
+    int idx;
+
+    if (NULL == ifname || 0 == table->count)
+    {
+        return NULL;
+    }
+    slot = netdev_hash(ifname) & (table->index_size - 1);
+    while ((idx = table->index[slot]) >= 0)
+    {
+        if (0 == strcmp(table->entries[idx].ifname, ifname))
+        {
+            return &table->entries[idx];
+        }
+        slot = (slot + 1) & (table->index_size - 1);
+    }
+    return NULL;
+}
@@ -33,6 +33,9 @@
 #include "libxenctl.h"
 #include "public_common.h"
 #include "securec.h"
+#include "netdev.h"
+#include "rtnl.h"
+#include "perfbin.h"
 #include <ifaddrs.h>
 #include <netdb.h>
 #include <errno.h>
@@ -95,6 +98,10 @@ typedef struct
 
 /*all ipv4/6 info value*/
 IPV6_VIF_INFO gtNicIpv6Info;
+/*netlink model generation the records of gtNicIpv6Info were built from*/
+static int g_ipv6_cache_valid = 0;
+static unsigned int g_ipv6_cache_generation = 0;
+static int g_ipv6_cache_gateway = 0;
 /*filter ipv4/6 info Result value*/
 IPV6_VIF_INFO gtNicIpv6InfoResult;
 //added end
@@ -102,11 +109,8 @@ IPV6_VIF_INFO gtNicIpv6InfoResult;
 extern FILE *opendevfile(const char *path);
 extern int openNetSocket(void);
 extern void NetworkDestroy(int sktd);
-extern char *GetVifName(char **namep, char *p);
 extern int GetVifFlag(int skt, const char *ifname);
-extern int getVifData(char *pline, int nNumber, char *out);
 extern FILE *openPipe(const char *pszCommand, const char *pszType);
-extern int getFluxinfoLine(char *ifname, char *pline);
 
 /*****************************************************************************
 Function   : GetIpv6NetFlag
@@ -254,12 +258,21 @@ Return     :
 void GetIpv6VifMac(int skt, const char *ifname)
 {
     struct ifreq ifrequest;
+    const RTNL_LINK *link = NULL;
 
     if (NULL == ifname)
     {
         return ;
     }
 
+    link = rtnl_link_lookup(ifname);
+    if (NULL != link)
+    {
+        rtnl_format_hwaddr(link, gtNicIpv6Info.info[gtNicIpv6Info.count].mac,
+                           sizeof(gtNicIpv6Info.info[gtNicIpv6Info.count].mac));
+        return ;
+    }
+
     strncpy_s(ifrequest.ifr_name, IFNAMSIZ, ifname, IFNAMSIZ-1);
     ifrequest.ifr_name[IFNAMSIZ - 1] = '\0';
 
@@ -282,134 +295,62 @@ void GetIpv6VifMac(int skt, const char *ifname)
 }
 
 /*****************************************************************************
-Function   : GetIpv6Flux
-Description: get Ipv4/6 Flux
-Input       : None
-Output     : None
-Return     : 
+Function   : FillIpv6Flux
+Description: fill the Flux of one Ipv4/6 record
+Input       : ifname -- the NIC name, an alias uses the counters of its NIC
+Output     : info   -- the Ipv4/6 record
+Return     : SUCC or ERROR
 *****************************************************************************/
-int GetIpv6Flux(int skt,char *ifname)
+static int FillIpv6Flux(IPV6_VIF_DATA *info, const char *ifname)
 {
-    char Sent[PACKAGE_LENGTH] = {0};
-    char Recived[PACKAGE_LENGTH] = {0};
-    char SentPkt[PACKAGE_LENGTH] = {0};
-    char RecivedPkt[PACKAGE_LENGTH] = {0};
-    char SentPktDrop[PACKAGE_LENGTH] = {0};
-    char RecivedPktDrop[PACKAGE_LENGTH] = {0};
-    char *ptmp = NULL;
-    /*get flux info line*/
-    char fluxline[255] = {0};
-    /* get vifname info line*/
-    char *vifline = NULL;
-    size_t linelen = 0;
-    char *foundStr = NULL;
-    FILE *file;
-    char *path="/proc/net/dev";
-    char *namebuf = NULL;
+    char basename[IFNAMSIZ] = {0};
+    const NET_DEV_STAT *stat = NULL;
     char *p = NULL;
-    int ifnamelen = 0;
 
-    
-    if(NULL == (file = opendevfile(path)))
-    {
-        DEBUG_LOG("Failed to open /proc/net/dev.");
-        return ERROR;
-    }
-    if (NULL == ifname)//for pclint warning
-    {
-        DEBUG_LOG("ifname is NULL.");
-        fclose(file);
-        return ERROR;
-    }
-    
     /*multi ip: such as eth0:0, you should match eth0 flux*/
-    if (getline(&vifline, &linelen, file) == -1 /* eat line */
-        || getline(&vifline, &linelen, file) == -1) {}
-    while (getline(&vifline, &linelen, file) != -1)
-    {
-        (void)GetVifName(&namebuf, vifline);
-        ifnamelen = strlen(namebuf);
-        /*consider this scene: such as ifname = "eth10:0" namebuf="eth1"  and ifname = "eth1:0" namebuf="eth1"*/
-        if(NULL != strstr(ifname,namebuf) && NULL != strstr(ifname,":"))
-         {
-                p = ifname + ifnamelen;
-                if(':' == *p)
-                {
-                    ifname = namebuf;
-                    break;
-                }
-         }
-         
-    } 
-    
-    /*get flux line*/
-    if (ERROR == getFluxinfoLine(ifname, fluxline))
-    {
-        strncpy_s(gtNicIpv6Info.info[gtNicIpv6Info.count].tp, IPV6_FLUX_LEN, ERR_STR, strlen(ERR_STR));
-        gtNicIpv6Info.info[gtNicIpv6Info.count].tp[strlen(ERR_STR)] = '\0';
-        DEBUG_LOG("getFluxinfoLine failed, ifname=%s.", ifname);
-        fclose(file);
-        return ERROR;
-    }
-
-    if(0 == strlen(fluxline))
+    (void)strncpy_s(basename, sizeof(basename), ifname, sizeof(basename) - 1);
+    p = strchr(basename, ':');
+    if (NULL != p)
     {
-        DEBUG_LOG("Line is NULL.");
-        fclose(file);
-        return ERROR;
+        *p = '\0';
     }
 
-    foundStr = strstr(fluxline, ifname);
-    if (NULL == foundStr)
+    /*counters of the table refreshed by GetIpv6Info in this sample*/
+    stat = netdev_table_lookup(basename);
+    if (NULL == stat)
     {
-        DEBUG_LOG("foundStr is NULL, fluxline=%s, ifname=%s.", fluxline, ifname);
-        fclose(file);
+        strncpy_s(info->tp, IPV6_FLUX_LEN, ERR_STR, strlen(ERR_STR));
+        DEBUG_LOG("%s is not in /proc/net/dev.", ifname);
         return ERROR;
     }
-    /*get first data*/
-    ptmp = foundStr + strlen(ifname) + 1;
 
+    (void)snprintf_s(info->tp, sizeof(info->tp), sizeof(info->tp), 
+                    "%llu:%llu", stat->tx_bytes, stat->rx_bytes);
+    (void)snprintf_s(info->packs, sizeof(info->packs), sizeof(info->packs), 
+                    "%llu:%llu", stat->tx_packets, stat->rx_packets);
 
-    if (NULL == ptmp)
-    {
-        DEBUG_LOG("ptmp is NULL.");
-        fclose(file);
-        return ERROR;
-    }
+    /*networkloss*/
+    info->sentdrop = (long)stat->tx_drop;
+    info->recievedrop = (long)stat->rx_drop;
+    return SUCC;
+}
 
-    /*get each column data info*/
-    if(ERROR == getVifData(ptmp, 1, Recived)
-            || ERROR ==  getVifData(ptmp, 2, RecivedPkt)
-        || ERROR == getVifData(ptmp, 4, RecivedPktDrop)
-            || ERROR == getVifData(ptmp, 9, Sent)
-            || ERROR == getVifData(ptmp, 10, SentPkt)
-            || ERROR == getVifData(ptmp, 12, SentPktDrop))
+/*****************************************************************************
+Function   : GetIpv6Flux
+Description: get Ipv4/6 Flux
+Input       : None
+Output     : None
+Return     : 
+*****************************************************************************/
+int GetIpv6Flux(int skt,char *ifname)
+{
+    if (NULL == ifname)//for pclint warning
     {
-        DEBUG_LOG("getVifData is ERROR.");
-        fclose(file);
+        DEBUG_LOG("ifname is NULL.");
         return ERROR;
     }
 
-    (void)snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].tp, 
-                    sizeof(gtNicIpv6Info.info[gtNicIpv6Info.count].tp), 
-                    sizeof(gtNicIpv6Info.info[gtNicIpv6Info.count].tp), 
-                    "%s:%s", 
-                    Sent, Recived);
-    gtNicIpv6Info.info[gtNicIpv6Info.count].tp[strlen(Sent) + strlen(Recived) + 1] = '\0';
-
-    (void)snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].packs, 
-                    sizeof(gtNicIpv6Info.info[gtNicIpv6Info.count].packs), 
-                    sizeof(gtNicIpv6Info.info[gtNicIpv6Info.count].packs), 
-                    "%s:%s",
-                    SentPkt, RecivedPkt);
-    gtNicIpv6Info.info[gtNicIpv6Info.count].packs[strlen(SentPkt) + strlen(RecivedPkt) + 1] = '\0';
-    
-    /*networkloss*/
-    (void)sscanf_s(SentPktDrop,"%ld", &gtNicIpv6Info.info[gtNicIpv6Info.count].sentdrop);
-    (void)sscanf_s(RecivedPktDrop,"%ld",&gtNicIpv6Info.info[gtNicIpv6Info.count].recievedrop);
-    fclose(file);
-    free(vifline);
-    return SUCC;
+    return FillIpv6Flux(&gtNicIpv6Info.info[gtNicIpv6Info.count], ifname);
 }
 
 /*****************************************************************************
@@ -461,6 +402,18 @@ int GetIpv4VifGateway(int skt, const char *ifname)
         return ERROR;
     }
 
+    /*route netlink model of this sample answers without forking route*/
+    if (rtnl_model_valid())
+    {
+        if (SUCC != rtnl_gateway(AF_INET, ifname, pszGateway, sizeof(pszGateway)))
+        {
+            pszGateway[0] = '0';
+            pszGateway[1] = '\0';
+        }
+        (void)strncpy_s(gtNicIpv6Info.info[gtNicIpv6Info.count].gateway, IPV6_ADDR_LEN, pszGateway, strlen(pszGateway));
+        return SUCC;
+    }
+
     (void)memset_s(pathBuf, MAX_NICINFO_LENGTH, 0, MAX_NICINFO_LENGTH);
     /*exec shell command to get ipv4 route gataway info*/
     (void)snprintf_s(pathBuf, MAX_NICINFO_LENGTH, MAX_NICINFO_LENGTH,
@@ -494,7 +447,7 @@ int GetIpv4VifGateway(int skt, const char *ifname)
 int GetIpv6VifGateway(int skt, const char *ifname)
 {
     char pathBuf[MAX_NICINFO_LENGTH] = {0};
-    char pszGateway[VIF_NAME_LENGTH] = {0};
+    char pszGateway[IPV6_ADDR_LEN] = {0};
     char pszGatewayBuf[VIF_NAME_LENGTH] = {0};
     FILE *iRet;
 
@@ -508,6 +461,17 @@ int GetIpv6VifGateway(int skt, const char *ifname)
         return ERROR;
     }
 
+    if (rtnl_model_valid())
+    {
+        if (SUCC != rtnl_gateway(AF_INET6, ifname, pszGateway, sizeof(pszGateway)))
+        {
+            pszGateway[0] = '0';
+            pszGateway[1] = '\0';
+        }
+        (void)strncpy_s(gtNicIpv6Info.info[gtNicIpv6Info.count].gateway, IPV6_ADDR_LEN, pszGateway, strlen(pszGateway));
+        return SUCC;
+    }
+
     (void)memset_s(pathBuf, MAX_NICINFO_LENGTH, 0, MAX_NICINFO_LENGTH);
      /*exec shell command to get ipv6 route gataway info*/
     (void)snprintf_s(pathBuf, MAX_NICINFO_LENGTH, MAX_NICINFO_LENGTH,
@@ -538,6 +502,30 @@ int GetIpv6VifGateway(int skt, const char *ifname)
     return SUCC;
 }
 
+/*****************************************************************************
+Function   : AddIpv4VifInfo
+Description: fill one ipv4 record of ifname
+Input       : None
+Output     : None
+Return     : the record count
+*****************************************************************************/
+static int AddIpv4VifInfo(int skt, int num, char *ifname, const char *address)
+{
+    snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ifname, VIF_NAME_LENGTH, VIF_NAME_LENGTH, "%s", ifname);
+    GetIpv6VifMac(skt,ifname);
+    gtNicIpv6Info.info[gtNicIpv6Info.count].ipversionflag = 4;
+    snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ipaddr, IPV6_ADDR_LEN, IPV6_ADDR_LEN, "%s", address);
+
+    GetIpv4VifGateway(skt, ifname);
+
+    GetIpv6Flux(skt,ifname);
+    GetIpv6NetFlag(skt,ifname);
+
+    num++;
+    gtNicIpv6Info.count = num;
+    return num;
+}
+
 /*****************************************************************************
 Function   : GetIpv4VifIp
 Description: get Ipv4 ip info
@@ -548,9 +536,26 @@ Return     :
 int GetIpv4VifIp(int skt, int num, char *ifname)
 {
     struct ifaddrs *ifaddr, *ifa;
+    const RTNL_ADDR *addr = NULL;
     int ret;
+    int i;
     char address[IPV6_ADDR_LEN];
 
+    /*addresses of the route netlink dump, labels match alias names*/
+    if (rtnl_model_valid())
+    {
+        for (i = 0; i < rtnl_addr_count(); i++)
+        {
+            addr = rtnl_addr_entry(i);
+            if (AF_INET != addr->family || 0 != strcmp(addr->label, ifname))
+                continue;
+            if (NULL == inet_ntop(AF_INET, addr->addr, address, sizeof(address)))
+                continue;
+            num = AddIpv4VifInfo(skt, num, ifname, address);
+        }
+        return gtNicIpv6Info.count;
+    }
+
     if (getifaddrs(&ifaddr) == -1)
     {
         ERR_LOG("Call getifaddrs failed, errno=%d", errno);
@@ -573,18 +578,7 @@ int GetIpv4VifIp(int skt, int num, char *ifname)
 
         if((NULL != ifa->ifa_name) && (strcmp(ifa->ifa_name,ifname) == 0) && (AF_INET == ifa->ifa_addr->sa_family))
         {
-            snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ifname, VIF_NAME_LENGTH, VIF_NAME_LENGTH, "%s", ifname);
-            GetIpv6VifMac(skt,ifname);
-            gtNicIpv6Info.info[gtNicIpv6Info.count].ipversionflag = 4;
-            snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ipaddr, IPV6_ADDR_LEN, IPV6_ADDR_LEN, "%s", address);
-
-            GetIpv4VifGateway(skt, ifname);
-
-            GetIpv6Flux(skt,ifname);
-            GetIpv6NetFlag(skt,ifname);
-
-            num++;
-            gtNicIpv6Info.count = num;
+            num = AddIpv4VifInfo(skt, num, ifname, address);
         }
     }
 
@@ -692,6 +686,41 @@ int Inet6Input(int type, char *bufp, struct sockaddr *sap)
     return (Inet6Resolve(bufp, (struct sockaddr_in6 *) sap));
 }
 
+/*****************************************************************************
+Function   : AddIpv6VifInfo
+Description: fill one ipv6 record of vifname
+Input       : None
+Output     : None
+Return     : the record count
+*****************************************************************************/
+static int AddIpv6VifInfo(int skt, int num, char *vifname, const char *address)
+{
+    snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ifname, VIF_NAME_LENGTH, VIF_NAME_LENGTH, "%s", vifname);
+    snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ipaddr, IPV6_ADDR_LEN, IPV6_ADDR_LEN,
+                "%s", address);
+
+    GetIpv6VifMac(skt,vifname);
+
+    /*gw info has switch function*/
+    if(g_exinfo_flag_value & EXINFO_FLAG_GATEWAY)
+    {
+        GetIpv6VifGateway(skt,vifname);
+    }
+    else
+    {
+        (void)strncpy_s(gtNicIpv6Info.info[gtNicIpv6Info.count].gateway,
+            IPV6_ADDR_LEN,
+            "0", 
+            strlen("0"));
+    }
+    gtNicIpv6Info.info[gtNicIpv6Info.count].ipversionflag = 6;
+    GetIpv6Flux(skt,vifname);
+    GetIpv6NetFlag(skt,vifname);
+    num++;
+    gtNicIpv6Info.count = num;
+    return num;
+}
+
 /*****************************************************************************
 Function   : GetIpv6VifIp
 Description: get Ipv6 ip info
@@ -711,6 +740,9 @@ int GetIpv6VifIp(int skt,int num, char *vifname)
    int plen, scope, dad_status, if_idx;
    struct sockaddr_in6 sap;
    char *abbreviationIpv6 = NULL;
+   const RTNL_LINK *link = NULL;
+   const RTNL_ADDR *addr = NULL;
+   int i;
 
 
    if(NULL == vifname)
@@ -718,6 +750,28 @@ int GetIpv6VifIp(int skt,int num, char *vifname)
            return ERROR;
    }
 
+   /*addresses of the route netlink dump; host scope is the loopback one
+     /proc/net/if_inet6 filters out, alias names have no ipv6 address*/
+   if(rtnl_model_valid())
+   {
+        link = rtnl_link_lookup(vifname);
+        if(NULL == link || 0 != strcmp(link->ifname, vifname))
+        {
+            return gtNicIpv6Info.count;
+        }
+        for(i = 0; i < rtnl_addr_count(); i++)
+        {
+            addr = rtnl_addr_entry(i);
+            if(AF_INET6 != addr->family || link->index != addr->index
+               || RT_SCOPE_HOST == addr->scope || RT_SCOPE_NOWHERE == addr->scope)
+                continue;
+            if(NULL == inet_ntop(AF_INET6, addr->addr, addr6, sizeof(addr6)))
+                continue;
+            num = AddIpv6VifInfo(skt, num, vifname, addr6);
+        }
+        return gtNicIpv6Info.count;
+   }
+
    /*if no support ipv6, return error*/
    if(0 != access(path,F_OK))
    {
@@ -744,35 +798,13 @@ int GetIpv6VifIp(int skt,int num, char *vifname)
         /*do not modify strcmp -> strncmp*/
         if(0 == strcmp(devname,vifname) && (scope == 0 || scope == IPV6_ADDR_LINKLOCAL || scope == IPV6_ADDR_SITELOCAL || scope == IPV6_ADDR_COMPATv4))
         {
-            snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ifname, VIF_NAME_LENGTH, VIF_NAME_LENGTH, "%s", vifname);
             snprintf_s(addr6, IPV6_ADDR_LEN, IPV6_ADDR_LEN, "%s:%s:%s:%s:%s:%s:%s:%s",
                             addr6p[0], addr6p[1], addr6p[2], addr6p[3],
                             addr6p[4], addr6p[5], addr6p[6], addr6p[7]);
             /*abbreviation Ipv6 info*/
             Inet6Input(1, addr6, (struct sockaddr *) &sap);
             abbreviationIpv6 = Inet6Sprint((struct sockaddr *) &sap, 1);
-            snprintf_s(gtNicIpv6Info.info[gtNicIpv6Info.count].ipaddr, IPV6_ADDR_LEN, IPV6_ADDR_LEN,
-                        "%s", abbreviationIpv6);
-            
-            GetIpv6VifMac(skt,vifname);
-
-            /*gw info has switch function*/
-            if(g_exinfo_flag_value & EXINFO_FLAG_GATEWAY)
-            {
-                GetIpv6VifGateway(skt,vifname);
-            }
-            else
-            {
-                (void)strncpy_s(gtNicIpv6Info.info[gtNicIpv6Info.count].gateway,
-                    IPV6_ADDR_LEN,
-                    "0", 
-                    strlen("0"));
-            }
-            gtNicIpv6Info.info[gtNicIpv6Info.count].ipversionflag = 6;
-            GetIpv6Flux(skt,vifname);
-            GetIpv6NetFlag(skt,vifname);
-            num++;
-            gtNicIpv6Info.count = num;
+            num = AddIpv6VifInfo(skt, num, vifname, abbreviationIpv6);
         }
     }
    fclose(file);
@@ -792,10 +824,6 @@ int GetIpv6Info()
     struct ifconf ifconfigure;
     struct ifreq *ifreqIdx;
     struct ifreq *ifreq;
-    char *path="/proc/net/dev";
-    FILE *file;
-    char *line = NULL;
-    size_t linelen = 0;
     char namebuf[16] = {0};
     char buf[4096] = {0};
     int uNICCount = 0;
@@ -805,91 +833,126 @@ int GetIpv6Info()
     int lastcount = 0;
     int getipv6flag = 0;
     int vifnameLen = 0;
+    int devnum = 0;
+    int devidx = 0;
     int skt;
 
     
     ifconfigure.ifc_len = 4096;
     ifconfigure.ifc_buf = buf;
-    
+
+    /*refresh the counters and the netlink model once per sample, GetIpv6Flux looks counters up by name*/
+    devnum = netdev_table_refresh();
+    if(ERROR == devnum)
+    {
+        memset_s(&gtNicIpv6Info, sizeof(gtNicIpv6Info), 0, sizeof(gtNicIpv6Info));
+        g_ipv6_cache_valid = 0;
+        DEBUG_LOG("Failed to read /proc/net/dev.");
+        return ERROR;
+    }
+
+    /*links, addresses and routes unchanged: keep the records, refresh the flux only*/
+    if(g_ipv6_cache_valid && rtnl_model_valid()
+       && g_ipv6_cache_generation == rtnl_model_generation()
+       && g_ipv6_cache_gateway == (g_exinfo_flag_value & EXINFO_FLAG_GATEWAY))
+    {
+        for(i = 0; i < gtNicIpv6Info.count; i++)
+        {
+            /*down interfaces carry no flux*/
+            if('\0' != gtNicIpv6Info.info[i].tp[0])
+            {
+                (void)FillIpv6Flux(&gtNicIpv6Info.info[i], gtNicIpv6Info.info[i].ifname);
+            }
+        }
+        return gtNicIpv6Info.count;
+    }
+
     skt = openNetSocket(); 
     if (ERROR == skt)
     {
+        g_ipv6_cache_valid = 0;
         DEBUG_LOG("Failed to openNetSocket.");
         return ERROR;
     }
     memset_s(&gtNicIpv6Info, sizeof(gtNicIpv6Info), 0, sizeof(gtNicIpv6Info)); 
 
-
-    /*ioctl interface: interface has ipv4 and its status is up*/
-    if(!ioctl(skt, SIOCGIFCONF, (char *) &ifconfigure))
+    /*interfaces having ipv4: labels of the netlink addresses, else SIOCGIFCONF*/
+    if(rtnl_model_valid())
+    {
+        uNICCount = rtnl_addr_count();
+    }
+    else if(!ioctl(skt, SIOCGIFCONF, (char *) &ifconfigure))
     {
-        ifreq = (struct ifreq *)buf;
         uNICCount = ifconfigure.ifc_len / (int)sizeof(struct ifreq);
-        for(i=0; i<uNICCount; i++)
+    }
+    ifreq = (struct ifreq *)buf;
+    for(i=0; i<uNICCount; i++)
+    {
+        int nicRepeatFlag = 0;
+        int j = 0;
+        memset_s(namebuf, 16, 0, 16);
+        if(rtnl_model_valid())
         {
-            int nicRepeatFlag = 0;
-            int j = 0;
-            ifreqIdx = ifreq + i;
-            memset_s(namebuf, 16, 0, 16);
-            (void)snprintf_s(namebuf, sizeof(namebuf), sizeof(namebuf), "%s", ifreqIdx->ifr_name);
-
-            for(j = 0; num > 0 && j < num; j++)
-            {
-                /*do not modify strcmp -> strncmp*/
-                if(0 == strcmp(namebuf, gtNicIpv6Info.info[j].ifname))
-                {
-                    nicRepeatFlag = 1;
-                    break;
-                }
-            }
-
-            vifnameLen = strlen(namebuf);
-            if(nicRepeatFlag || 0 == strncmp(namebuf,"lo",vifnameLen) || 0 == strncmp(namebuf,"sit0",vifnameLen))
+            const RTNL_ADDR *addr = rtnl_addr_entry(i);
+            if(AF_INET != addr->family)
             {
                 continue;
             }
+            (void)snprintf_s(namebuf, sizeof(namebuf), sizeof(namebuf), "%s", addr->label);
+        }
+        else
+        {
+            ifreqIdx = ifreq + i;
+            (void)snprintf_s(namebuf, sizeof(namebuf), sizeof(namebuf), "%s", ifreqIdx->ifr_name);
+        }
 
-            /*get ipv4 info */
-            if(UPFLAG == GetVifFlag(skt, namebuf))
+        for(j = 0; num > 0 && j < num; j++)
+        {
+            /*do not modify strcmp -> strncmp*/
+            if(0 == strcmp(namebuf, gtNicIpv6Info.info[j].ifname))
             {
-                getipv6flag = GetIpv4VifIp(skt,num,namebuf);
-                if(ERROR != getipv6flag)
-                {
-                    num = getipv6flag;
-                }
-
-                if(num >= IPV6_NIC_MAX)
-                    break;
+                nicRepeatFlag = 1;
+                break;
             }
+        }
 
-            /*get ipv6 info, /proc/net/if_inet6: the interface status is up */
-            getipv6flag = GetIpv6VifIp(skt,num,namebuf);
+        vifnameLen = strlen(namebuf);
+        if(nicRepeatFlag || 0 == strncmp(namebuf,"lo",vifnameLen) || 0 == strncmp(namebuf,"sit0",vifnameLen))
+        {
+            continue;
+        }
+
+        /*get ipv4 info */
+        if(UPFLAG == GetVifFlag(skt, namebuf))
+        {
+            getipv6flag = GetIpv4VifIp(skt,num,namebuf);
             if(ERROR != getipv6flag)
             {
-               num = getipv6flag;
+                num = getipv6flag;
             }
 
             if(num >= IPV6_NIC_MAX)
-                  break;
+                break;
+        }
 
+        /*get ipv6 info, /proc/net/if_inet6: the interface status is up */
+        getipv6flag = GetIpv6VifIp(skt,num,namebuf);
+        if(ERROR != getipv6flag)
+        {
+           num = getipv6flag;
         }
+
+        if(num >= IPV6_NIC_MAX)
+              break;
+
     }
     
     /*patch interface by query /proc/net/dev*/ 
-   if(NULL == (file = opendevfile(path)))
-    {
-        NetworkDestroy(skt);
-        DEBUG_LOG("Failed to open /proc/net/dev.");
-        return ERROR;
-    }
-    
-   if(getline(&line, &linelen, file) == -1 /* eat line */
-        || getline(&line, &linelen, file) == -1) {}
-   while (getline(&line, &linelen, file) != -1)
+   for (devidx = 0; devidx < devnum; devidx++)
     {
+        char vifname[IFNAMSIZ];
         novifnameFlag = 0;
-        char *vifname;
-        (void)GetVifName(&vifname, line);
+        (void)strncpy_s(vifname, sizeof(vifname), netdev_table_entry(devidx)->ifname, sizeof(vifname) - 1);
         vifnameLen = strlen(vifname);
         if(0 == strncmp(vifname,"lo",vifnameLen) || 0== strncmp(vifname,"sit0",vifnameLen))
         {
@@ -963,9 +1026,12 @@ int GetIpv6Info()
 
         }
     }
-   fclose(file);
-   free(line);
    NetworkDestroy(skt);
+
+   /*only records built from the netlink model can be kept for the next sample*/
+   g_ipv6_cache_valid = rtnl_model_valid();
+   g_ipv6_cache_generation = rtnl_model_generation();
+   g_ipv6_cache_gateway = g_exinfo_flag_value & EXINFO_FLAG_GATEWAY;
    return gtNicIpv6Info.count; 
 }
 
@@ -995,15 +1061,32 @@ void Ipv6PrintInfo(void * handle)
             (void)snprintf_s(vif_path, NETINFO_PATH_LEN, NETINFO_PATH_LEN, "%s_%u", IPV6_VIF_DATA_PATH, i);
         }
 
-        if(xb_write_first_flag == 0)
-        {
-            (void)write_to_xenstore(handle, vif_path, ArrRetNet[i]);
-        }
-        else
-        {
-            (void)write_weak_to_xenstore(handle, vif_path, ArrRetNet[i]);
-        }
+        write_perf_to_xenstore(handle, vif_path, ArrRetNet[i], xb_write_first_flag);
+    }
+}
+
+/*****************************************************************************
+Function   : PerfbinIpv6Info
+Description: put every ipv4/6 record of gtNicIpv6Info into the binary
+             performance record, without the XENSTORE_COUNT key limit
+Input       : num -- the record count
+Output     : None
+Return     : 
+*****************************************************************************/
+static void PerfbinIpv6Info(int num)
+{
+    unsigned char raw[PERFBIN_RAW_MAX];
+    PERFBIN_BUF buf;
+    int i;
+
+    perfbin_buf_init(&buf, raw, sizeof(raw));
+    for (i = 0; i < num; i++)
+    {
+        perfbin_put_nic(&buf, gtNicIpv6Info.info[i].ifname, gtNicIpv6Info.info[i].mac,
+                        gtNicIpv6Info.info[i].netstatusflag, gtNicIpv6Info.info[i].ipaddr,
+                        trim(gtNicIpv6Info.info[i].gateway));
     }
+    perfbin_section_set(PERFBIN_SECTION_NETWORK, &buf);
 }
 
 /*****************************************************************************
@@ -1034,15 +1117,23 @@ void NetinfoNetworkctlmon(void *handle)
    
    if (ERROR == num)
    {
-        write_to_xenstore(handle, IPV6_VIF_DATA_PATH, "error");
+        write_perf_to_xenstore(handle, IPV6_VIF_DATA_PATH, "error", xb_write_first_flag);
+        if (perfbin_enabled())
+        {
+            perfbin_section_fail(PERFBIN_SECTION_NETWORK, PERFBIN_TLV_NIC);
+        }
         DEBUG_LOG("Num is ERROR.");
         return;
    }
+   if (perfbin_enabled())
+   {
+        PerfbinIpv6Info(num);
+   }
    
    if (0 == num)
    {
         Ipv6PrintInfo(handle);
-        write_to_xenstore(handle, IPV6_VIF_DATA_PATH, "0");
+        write_perf_to_xenstore(handle, IPV6_VIF_DATA_PATH, "0", xb_write_first_flag);
         return;
    }
    
@@ -1126,19 +1217,9 @@ void NetinfoNetworkctlmon(void *handle)
         (void)snprintf_s(NetworkLoss, sizeof(NetworkLoss), sizeof(NetworkLoss), "%ld:%ld",sumrecievedrop, sumsentdrop);
    }
    
-   if(xb_write_first_flag == 0)
-   {
-        if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
-        {
-           write_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss);
-        }
-   }
-   else
+   if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
    {
-        if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
-        {
-           write_weak_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss);
-        }
+        write_perf_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss, xb_write_first_flag);
    }
    return ;
 }
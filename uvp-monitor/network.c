@@ -35,6 +35,9 @@
 #include "securec.h"
 #include <ctype.h>
 #include "uvpmon.h"
+#include "netdev.h"
+#include "rtnl.h"
+#include "perfbin.h"
 #include <errno.h>
 
 #define NIC_MAX  15
@@ -69,6 +72,11 @@ typedef struct
 
 VIF_INFO gtNicInfo;
 
+/* gtNicInfoַ·ɲӦnetlinkģͰ汾 */
+static int g_vif_cache_valid = 0;
+static unsigned int g_vif_cache_generation = 0;
+static int g_vif_cache_gateway = 0;
+
 #define MAC_NAME_LENGTH 18
 #define VIF_NAME_LENGTH 16
 VIF_INFO gtNicInfo_bond;
@@ -190,6 +198,18 @@ int GetVifGateway(int skt, const char *ifname)
         return ERROR;
     }
 
+    /*route netlink model of this sample answers without forking route*/
+    if (rtnl_model_valid())
+    {
+        if (SUCC != rtnl_gateway(AF_INET, ifname, pszGateway, sizeof(pszGateway)))
+        {
+            pszGateway[0] = '0';
+            pszGateway[1] = '\0';
+        }
+        (void)strncpy_s(gtNicInfo.info[gtNicInfo.count].gateway, 16, pszGateway, strlen(pszGateway));
+        return SUCC;
+    }
+
     /*ƴʱṩshellͨroute -nȡϢ*/
     (void)snprintf_s(pathBuf, MAX_NICINFO_LENGTH,  MAX_NICINFO_LENGTH,
                     "route -n | grep -i \"%s$\" | grep UG | awk '{print $2}'", ifname);
@@ -226,11 +246,18 @@ Return     : SUCC or ERROR
 int GetVifFlag(int skt, const char *ifname)
 {
     struct ifreq  ifreq;
+    const RTNL_LINK *link = NULL;
 
     if (NULL == ifname)
     {
         return ERROR;
     }
+
+    link = rtnl_link_lookup(ifname);
+    if (NULL != link)
+    {
+        return (link->flags & IFF_UP) ? UPFLAG : DOWNFLAG;
+    }
     (void)strncpy_s(ifreq.ifr_name, IFNAMSIZ, ifname, IFNAMSIZ-1);
     ifreq.ifr_name[IFNAMSIZ - 1] = '\0';
 
@@ -257,6 +284,18 @@ int GetVifIp(int skt, const char *ifname)
 {
     struct ifreq ifrequest;
     struct sockaddr_in *pAddr;
+    const RTNL_LINK *link = NULL;
+
+    link = rtnl_link_lookup(ifname);
+    if (NULL != link)
+    {
+        if (!(link->flags & IFF_UP))
+        {
+            return ERROR;
+        }
+        return rtnl_ipv4_addr(ifname, gtNicInfo.info[gtNicInfo.count].ip,
+                              sizeof(gtNicInfo.info[gtNicInfo.count].ip));
+    }
 
     (void)strncpy_s(ifrequest.ifr_name, IFNAMSIZ, ifname, IFNAMSIZ-1);
     ifrequest.ifr_name[IFNAMSIZ - 1] = '\0';
@@ -286,183 +325,51 @@ int GetVifIp(int skt, const char *ifname)
 
 
 /*****************************************************************************
-Function   : GetFlux
-Description: get the NIC ThroughPut
+Function   : FillVifFlux
+Description: fill the ThroughPut of one NIC record
 Input       :ifname   -- the NIC name
-Output     : None
-Return     : success : return ThroughPut string,  fail : return error or disconnected
+Output     : info     -- the NIC record
+Return     : SUCC or ERROR
 *****************************************************************************/
-int GetFlux(int skt, char *ifname)
+static int FillVifFlux(VIF_DATA *info, const char *ifname)
 {
+    const NET_DEV_STAT *stat = NULL;
 
-    char Sent[31] = {0};
-    char Recived[31] = {0};
-    char SentPkt[31] = {0};
-    char RecivedPkt[31] = {0};
-    char SentPktDrop[31] = {0};
-    char RecivedPktDrop[31] = {0};
-    char *ptmp = NULL;
-    char line[255] = {0};
-    char *foundStr = NULL;
-
-    if (NULL == ifname)//for pclint warning
+    /* ȡԱֲɼ */
+    stat = netdev_table_lookup(ifname);
+    if (NULL == stat)
     {
-    	DEBUG_LOG("ifname is NULL.");
+        strncpy_s(info->tp, sizeof(info->tp), ERR_STR, strlen(ERR_STR));
+        DEBUG_LOG("%s is not in /proc/net/dev.", ifname);
         return ERROR;
     }
 
-    if (ERROR == getFluxinfoLine(ifname, line))
-    {
-        strncpy_s(gtNicInfo.info[gtNicInfo.count].tp, 64, ERR_STR, strlen(ERR_STR));
-        gtNicInfo.info[gtNicInfo.count].tp[strlen(ERR_STR)] = '\0';
-        DEBUG_LOG("getFluxinfoLine is ERROR.");
-        return ERROR;
-    }
-
-    if(0 == strlen(line))
-    {
-    	DEBUG_LOG("Line is NULL.");
-        return ERROR;
-    }
-
-    foundStr = strstr(line, ifname);
-    if (NULL == foundStr)
-    {
-    	DEBUG_LOG("foundStr is NULL, line=%s, ifname=%s.", line, ifname);
-        return ERROR;
-    }
-    /*ҵһ*/
-    ptmp = foundStr + strlen(ifname) + 1;
-
-
-    if (NULL == ptmp)
-    {
-    	DEBUG_LOG("ptmp is NULL.");
-        return ERROR;
-    }
-
-    /*ҵһ͵ھֱǽͷ*/
-    if(ERROR == getVifData(ptmp, 1, Recived)
-            || ERROR ==  getVifData(ptmp, 2, RecivedPkt)
-	    || ERROR == getVifData(ptmp, 4, RecivedPktDrop)
-            || ERROR == getVifData(ptmp, 9, Sent)
-            || ERROR == getVifData(ptmp, 10, SentPkt)
-            || ERROR == getVifData(ptmp, 12, SentPktDrop))
-    {
-    	DEBUG_LOG("getVifData is ERROR.");
-        return ERROR;
-    }
-
-    (void)snprintf_s(gtNicInfo.info[gtNicInfo.count].tp, 
-                        sizeof(gtNicInfo.info[gtNicInfo.count].tp), 
-                        sizeof(gtNicInfo.info[gtNicInfo.count].tp), 
-                        "%s:%s", Sent, Recived);
-    gtNicInfo.info[gtNicInfo.count].tp[strlen(Sent) + strlen(Recived) + 1] = '\0';
-
-    (void)snprintf_s(gtNicInfo.info[gtNicInfo.count].packs, 
-        sizeof(gtNicInfo.info[gtNicInfo.count].packs), 
-        sizeof(gtNicInfo.info[gtNicInfo.count].packs), 
-        "%s:%s", SentPkt, RecivedPkt);
-    gtNicInfo.info[gtNicInfo.count].packs[strlen(SentPkt) + strlen(RecivedPkt) + 1] = '\0';
-    (void)sscanf_s(SentPktDrop,"%ld", &gtNicInfo.info[gtNicInfo.count].sentdrop);
-    (void)sscanf_s(RecivedPktDrop,"%ld",&gtNicInfo.info[gtNicInfo.count].recievedrop);
+    (void)snprintf_s(info->tp, sizeof(info->tp), sizeof(info->tp), 
+                        "%llu:%llu", stat->tx_bytes, stat->rx_bytes);
+    (void)snprintf_s(info->packs, sizeof(info->packs), sizeof(info->packs), 
+                        "%llu:%llu", stat->tx_packets, stat->rx_packets);
+    info->sentdrop = (long)stat->tx_drop;
+    info->recievedrop = (long)stat->rx_drop;
 
     return SUCC;
 }
 
 /*****************************************************************************
-Function   : getData
-Description: õÿϢ
-Input       :pline:ݵһ
-Output     : out ݵֵ
-Return     :
-*****************************************************************************/
-int getVifData(char *pline, int nNumber, char *out)
-{
-    char *ptr = NULL;
-    int i;
-
-    if(NULL == pline || NULL == out)
-    {
-    	DEBUG_LOG("pline=%p out=%p.", pline, out);
-        return ERROR;
-    }
-
-    for(i = 1; (0 != *pline) && (i <= nNumber); i++)
-    {
-        /*ȥո*/
-        while(*pline == ' ')
-        {
-            pline++;
-        }
-
-        /*Ҹո״γֵλãһеĿͷ*/
-        ptr = strchr(pline, ' ');
-        if(NULL == ptr)
-        {
-        	DEBUG_LOG("ptr is NULL.");
-            return ERROR;
-        }
-        /*ҵѽյ*/
-        if ((i == nNumber) && (NULL != ptr))
-        {
-            strncpy_s(out, ptr - pline + 1, pline, ptr - pline);
-        }
-        pline = ptr;
-    }
-
-    return SUCC;
-}
-/*****************************************************************************
-Function   : getFluxinfoLine
-Description: õļķҪҵ
+Function   : GetFlux
+Description: get the NIC ThroughPut
 Input       :ifname   -- the NIC name
-Output     : pline: зbuffer
-Return     : success :
-                fail :
+Output     : None
+Return     : success : return ThroughPut string,  fail : return error or disconnected
 *****************************************************************************/
-int getFluxinfoLine(char *ifname, char *pline)
+int GetFlux(int skt, const char *ifname)
 {
-    char *path = "/proc/net/dev";
-    FILE *file = NULL;
-    char *begin = NULL;
-    int len = 0;
-
-    if(NULL == ifname || NULL == pline)
-    {
-    	DEBUG_LOG("pline=%p ifname=%p.", pline, ifname);
-        return ERROR;
-    }
-
-    if(NULL == (file = opendevfile(path)))
+    if (NULL == ifname)//for pclint warning
     {
-    	DEBUG_LOG("Failed to open /proc/net/dev.");
+    	DEBUG_LOG("ifname is NULL.");
         return ERROR;
     }
 
-    len = strlen(ifname);
-
-    while (fgets(pline, 255, file))
-    {
-        begin = pline;
-        //ȥո
-        while (' ' == *begin)  begin++;
-        //ҵƥ˳
-        if (0 == strncmp(begin, ifname, len))
-        {
-            if (':' == *(begin + len)  )
-            {
-                break;
-            }
-        }
-
-        //pline
-        memset_s(pline, 255, 0, 255);
-    }
-
-    fclose(file);
-
-    return SUCC;
+    return FillVifFlux(&gtNicInfo.info[gtNicInfo.count], ifname);
 }
 
 /*****************************************************************************
@@ -489,12 +396,25 @@ Return     : None
 void GetVifMac(int skt, const char *ifname)
 {
     struct ifreq ifrequest;
+    const RTNL_LINK *link = NULL;
 
     if (NULL == ifname)
     {
         return ;
     }
 
+    link = rtnl_link_lookup(ifname);
+    if (NULL != link)
+    {
+        rtnl_format_hwaddr(link, gtNicInfo.info[gtNicInfo.count].mac,
+                           sizeof(gtNicInfo.info[gtNicInfo.count].mac));
+        (void)snprintf_s(gtNicInfo.info[gtNicInfo.count].ifname, 
+                        sizeof(gtNicInfo.info[gtNicInfo.count].ifname),
+                        sizeof(gtNicInfo.info[gtNicInfo.count].ifname),
+                        "%s", ifname);
+        return ;
+    }
+
     strncpy_s(ifrequest.ifr_name, IFNAMSIZ, ifname, IFNAMSIZ-1);
     ifrequest.ifr_name[IFNAMSIZ - 1] = '\0';
 
@@ -532,17 +452,42 @@ int GetVifInfo()
 {
 	/* ifconfͨнӿϢ */
 	//struct ifconf ifconfigure;
-	char *path="/proc/net/dev";
-	FILE *file;
-	char *line = NULL;
-	size_t linelen = 0;
 	//char buf[4096];
 	int num = 0;
+	int devnum;
+	int i;
 	int skt;
 
+	/*  control device which name is NIC, ֲɼˢһnetlinkģ */
+	devnum = netdev_table_refresh();
+	if(ERROR == devnum)
+	{
+		memset_s(&gtNicInfo, sizeof(gtNicInfo), 0, sizeof(gtNicInfo));
+		g_vif_cache_valid = 0;
+		DEBUG_LOG("Failed to read /proc/net/dev.");
+		return ERROR;
+	}
+
+	/* ַ·ɶûб仯ʱϴεĽֻˢ */
+	if (g_vif_cache_valid && rtnl_model_valid()
+		&& g_vif_cache_generation == rtnl_model_generation()
+		&& g_vif_cache_gateway == (g_exinfo_flag_value & EXINFO_FLAG_GATEWAY))
+	{
+		for (i = 0; i < gtNicInfo.count; i++)
+		{
+			/* ֻupϢ */
+			if ('\0' != gtNicInfo.info[i].ip[0])
+			{
+				(void)FillVifFlux(&gtNicInfo.info[i], gtNicInfo.info[i].ifname);
+			}
+		}
+		return gtNicInfo.count;
+	}
+
 	skt = openNetSocket();
 	if (ERROR == skt)
 	{
+		g_vif_cache_valid = 0;
 		DEBUG_LOG("Failed to openNetSocket.");
 		return ERROR;
 	}
@@ -553,24 +498,10 @@ int GetVifInfo()
 
 	memset_s(&gtNicInfo, sizeof(gtNicInfo), 0, sizeof(gtNicInfo));
 
-	/*  control device which name is NIC */
-	if(NULL == (file = opendevfile(path)))
+	/*/proc/net/devе˳*/
+	for(i = 0; i < devnum; i++)
 	{
-		NetworkDestroy(skt);
-		DEBUG_LOG("Failed to open /proc/net/dev.");
-		return ERROR;
-	}
-	/*ȥ/proc/net/devļǰ(ͷϢ)*/
-	if (getline(&line, &linelen, file) == -1 /* eat line */
-	|| getline(&line, &linelen, file) == -1) 
-	{
-		DEBUG_LOG("Remove /proc/net/dev head.");
-	}
-	/*бʣµıϢ*/
-	while(getline(&line, &linelen, file) != -1)
-	{
-		char *namebuf;
-		(void)GetVifName(&namebuf, line);
+		const char *namebuf = netdev_table_entry(i)->ifname;
 		/*info bond*/
 		if (NULL != strstr(namebuf, "bond"))
 		{
@@ -630,13 +561,40 @@ int GetVifInfo()
 			break;
 		}     
 	}
-	fclose(file);
-	free(line);
 	NetworkDestroy(skt);
+
+	/* ֻnetlinkģάĽ´ */
+	g_vif_cache_valid = rtnl_model_valid();
+	g_vif_cache_generation = rtnl_model_generation();
+	g_vif_cache_gateway = g_exinfo_flag_value & EXINFO_FLAG_GATEWAY;
 	return gtNicInfo.count;
 }
 
 
+/*****************************************************************************
+Function   : PerfbinVifInfo
+Description: gtNicInfoеϢдܼ¼VIF_MAXֵּ
+Input       :num   -- 
+Output     : None
+Return     : None
+*****************************************************************************/
+static void PerfbinVifInfo(int num)
+{
+	unsigned char raw[PERFBIN_RAW_MAX];
+	PERFBIN_BUF buf;
+	int i;
+
+	perfbin_buf_init(&buf, raw, sizeof(raw));
+	for (i = 0; i < num; i++)
+	{
+		/* ֵַһ£IPַΪup */
+		perfbin_put_nic(&buf, gtNicInfo.info[i].ifname, gtNicInfo.info[i].mac,
+		                0 != strlen(gtNicInfo.info[i].ip),
+		                gtNicInfo.info[i].ip, trim(gtNicInfo.info[i].gateway));
+	}
+	perfbin_section_set(PERFBIN_SECTION_NETWORK, &buf);
+}
+
 /*****************************************************************************
 Function   : networkctlmon
 Description: 繦ܴ
@@ -660,16 +618,24 @@ void networkctlmon(void *handle)
 	num = GetVifInfo();
 	if (ERROR == num)
 	{
-		write_to_xenstore(handle, VIF_DATA_PATH, "error");
-		write_to_xenstore(handle, VIFEXTRA_DATA_PATH, "error");
+		write_perf_to_xenstore(handle, VIF_DATA_PATH, "error", xb_write_first_flag);
+		write_perf_to_xenstore(handle, VIFEXTRA_DATA_PATH, "error", xb_write_first_flag);
+		if (perfbin_enabled())
+		{
+			perfbin_section_fail(PERFBIN_SECTION_NETWORK, PERFBIN_TLV_NIC);
+		}
 		DEBUG_LOG("Num is ERROR.");
 		return;
 	}
+	if (perfbin_enabled())
+	{
+		PerfbinVifInfo(num);
+	}
 	/* xenstoreдַ0 */
 	if (0 == num)
 	{
-		write_to_xenstore(handle, VIF_DATA_PATH, "0");
-		write_to_xenstore(handle, VIFEXTRA_DATA_PATH, "0");
+		write_perf_to_xenstore(handle, VIF_DATA_PATH, "0", xb_write_first_flag);
+		write_perf_to_xenstore(handle, VIFEXTRA_DATA_PATH, "0", xb_write_first_flag);
 		return;
 	}
 
@@ -760,39 +726,20 @@ void networkctlmon(void *handle)
 		(void)snprintf_s(NetworkLoss, sizeof(NetworkLoss), sizeof(NetworkLoss), "%ld:%ld",sumrecievedrop, sumsentdrop);
 	}
 
-	if(xb_write_first_flag == 0)
+	write_perf_to_xenstore(handle, VIF_DATA_PATH, ArrRet, xb_write_first_flag);
+	/*ĿСڵ7ĳ£ڶֵϢ0*/
+	if (VIF_MAX >= num)
 	{
-		write_to_xenstore(handle, VIF_DATA_PATH, ArrRet);
-		/*ĿСڵ7ĳ£ڶֵϢ0*/
-		if (VIF_MAX >= num)
-		{
-			write_to_xenstore(handle, VIFEXTRA_DATA_PATH, "0");
-		}
-		/*Ŀ7ĳ£ڶֵϢд7ֵϢ*/
-		else
-		{
-			write_to_xenstore(handle, VIFEXTRA_DATA_PATH, ArrRet1);
-		}
-		if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
-		{
-			write_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss);
-		}
+		write_perf_to_xenstore(handle, VIFEXTRA_DATA_PATH, "0", xb_write_first_flag);
 	}
+	/*Ŀ7ĳ£ڶֵϢд7ֵϢ*/
 	else
 	{
-		write_weak_to_xenstore(handle, VIF_DATA_PATH, ArrRet);
-		if (VIF_MAX >= num)
-		{
-			write_weak_to_xenstore(handle, VIFEXTRA_DATA_PATH, "0");
-		}
-		else
-		{
-			write_weak_to_xenstore(handle, VIFEXTRA_DATA_PATH, ArrRet1);
-		}
-		if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
-		{
-			write_weak_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss);
-		}
+		write_perf_to_xenstore(handle, VIFEXTRA_DATA_PATH, ArrRet1, xb_write_first_flag);
+	}
+	if(g_exinfo_flag_value & EXINFO_FLAG_NET_LOSS)
+	{
+		write_perf_to_xenstore(handle, VIF_DROP_PATH, NetworkLoss, xb_write_first_flag);
 	}
 	return;
 }
@@ -0,0 +1,365 @@
+/*
+ * Encodes the metrics of a collection cycle as a compact binary record.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "xenstore_common.h"
+#include "perfbin.h"
+#include "netdev.h"
+#include "metricring.h"
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#define PERFBIN_HEADER_LEN      2
+#define PERFBIN_TEXT_MAX        (((PERFBIN_RAW_MAX + 2) / 3) * 4)
+#define PERFBIN_MAC_LEN         6
+#define PERFBIN_IPV4_LEN        4
+#define PERFBIN_IPV6_LEN        16
+#define VARINT_MORE             0x80
+#define VARINT_MASK             0x7f
+#define VARINT_SHIFT            7
+
+typedef struct
+{
+    unsigned char data[PERFBIN_RAW_MAX];
+    size_t len;
+    bool truncated;             /* the collector output did not fit */
+} PERFBIN_STORE;
+
+static PERFBIN_STORE g_perfbin_sections[PERFBIN_SECTION_BUTT];
+static bool g_perfbin_dirty = false;
+static pthread_mutex_t g_perfbin_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char g_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* the record is built for xenstore when the host asks for it, and for the metric ring */
+bool perfbin_enabled(void)
+{
+    return 0 != (g_exinfo_flag_value & EXINFO_FLAG_PERF_BIN) || metricring_ready();
+}
+
+void perfbin_buf_init(PERFBIN_BUF *buf, unsigned char *data, size_t cap)
+{
+    buf->data = data;
+    buf->len = 0;
+    buf->cap = cap;
+    buf->overflow = false;
+}
+
+void perfbin_put_bytes(PERFBIN_BUF *buf, const void *bytes, size_t len)
+{
+    if (buf->overflow || len > buf->cap - buf->len)
+    {
+        buf->overflow = true;
+        return;
+    }
+    if (0 != len)
+    {
+        (void)memcpy_s(buf->data + buf->len, buf->cap - buf->len, bytes, len);
+    }
+    buf->len += len;
+}
+
+void perfbin_put_uint(PERFBIN_BUF *buf, unsigned long long value)
+{
+    unsigned char bytes[10];
+    size_t n = 0;
+
+    do
+    {
+        bytes[n] = (unsigned char)(value & VARINT_MASK);
+        value >>= VARINT_SHIFT;
+        if (0 != value)
+        {
+            bytes[n] |= VARINT_MORE;
+        }
+        n++;
+    } while (0 != value);
+    perfbin_put_bytes(buf, bytes, n);
+}
+
+void perfbin_put_str(PERFBIN_BUF *buf, const char *str)
+{
+    size_t len = (NULL == str) ? 0 : strlen(str);
+
+    perfbin_put_uint(buf, len);
+    perfbin_put_bytes(buf, str, len);
+}
+
+/*****************************************************************************
+Function   : perfbin_put_addr
+Description: put an IPv4 or IPv6 address in text form as family byte and the
+             address bytes; an empty or unparsable address is family 0
+Input      : buf  -- the record buffer
+             addr -- the address, may be NULL
+Output     : None
+Return     : None
+*****************************************************************************/
+void perfbin_put_addr(PERFBIN_BUF *buf, const char *addr)
+{
+    unsigned char bytes[PERFBIN_IPV6_LEN];
+    unsigned char family = 0;
+
+    if (NULL != addr && 1 == inet_pton(AF_INET, addr, bytes))
+    {
+        family = 4;
+        perfbin_put_bytes(buf, &family, 1);
+        perfbin_put_bytes(buf, bytes, PERFBIN_IPV4_LEN);
+    }
+    else if (NULL != addr && 1 == inet_pton(AF_INET6, addr, bytes))
+    {
+        family = 6;
+        perfbin_put_bytes(buf, &family, 1);
+        perfbin_put_bytes(buf, bytes, PERFBIN_IPV6_LEN);
+    }
+    else
+    {
+        perfbin_put_bytes(buf, &family, 1);
+    }
+}
+
+/* put a "xx:xx:xx:xx:xx:xx" mac as 6 bytes, zeros when it does not parse */
+void perfbin_put_mac(PERFBIN_BUF *buf, const char *mac)
+{
+    unsigned int octet[PERFBIN_MAC_LEN] = {0};
+    unsigned char bytes[PERFBIN_MAC_LEN] = {0};
+    int i;
+
+    if (NULL != mac && PERFBIN_MAC_LEN == sscanf_s(mac, "%2x:%2x:%2x:%2x:%2x:%2x",
+        &octet[0], &octet[1], &octet[2], &octet[3], &octet[4], &octet[5]))
+    {
+        for (i = 0; i < PERFBIN_MAC_LEN; i++)
+        {
+            bytes[i] = (unsigned char)octet[i];
+        }
+    }
+    perfbin_put_bytes(buf, bytes, PERFBIN_MAC_LEN);
+}
+
+/*****************************************************************************
+Function   : perfbin_put_nic
+Description: put one PERFBIN_TLV_NIC; the counters come from the netdev table
+             of this sample, they are 0 when the NIC is not in it
+Input      : buf     -- the record buffer
+             ifname  -- the NIC name
+             mac     -- the NIC mac in text form
+             up      -- the NIC is up
+             ip      -- the address, may be empty
+             gateway -- the gateway, may be empty
+Output     : None
+Return     : None
+*****************************************************************************/
+void perfbin_put_nic(PERFBIN_BUF *buf, const char *ifname, const char *mac, int up,
+                     const char *ip, const char *gateway)
+{
+    const NET_DEV_STAT *stat = netdev_table_lookup(ifname);
+    unsigned char state = up ? 1 : 0;
+    size_t mark;
+
+    mark = perfbin_tlv_begin(buf, PERFBIN_TLV_NIC);
+    perfbin_put_mac(buf, mac);
+    perfbin_put_bytes(buf, &state, 1);
+    perfbin_put_addr(buf, ip);
+    perfbin_put_addr(buf, gateway);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->tx_bytes);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->rx_bytes);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->tx_packets);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->rx_packets);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->tx_drop);
+    perfbin_put_uint(buf, (NULL == stat) ? 0 : stat->rx_drop);
+    perfbin_tlv_end(buf, mark);
+}
+
+/*****************************************************************************
+Function   : perfbin_tlv_begin
+Description: start a tlv; its length is filled in by perfbin_tlv_end
+Input      : buf  -- the record buffer
+             type -- the tlv type
+Output     : None
+Return     : mark to pass to perfbin_tlv_end
+*****************************************************************************/
+size_t perfbin_tlv_begin(PERFBIN_BUF *buf, PERFBIN_TLV type)
+{
+    unsigned char head[2] = {(unsigned char)type, 0};
+
+    perfbin_put_bytes(buf, head, sizeof(head));
+    return buf->len - 1;
+}
+
+void perfbin_tlv_end(PERFBIN_BUF *buf, size_t mark)
+{
+    size_t len;
+
+    if (buf->overflow)
+    {
+        return;
+    }
+    len = buf->len - mark - 1;
+    if (len <= VARINT_MASK)
+    {
+        buf->data[mark] = (unsigned char)len;
+        return;
+    }
+    /* values are below 16K, a long one takes a second length byte */
+    if (len > (VARINT_MASK << VARINT_SHIFT | VARINT_MASK) || buf->len >= buf->cap)
+    {
+        buf->overflow = true;
+        return;
+    }
+    (void)memmove_s(buf->data + mark + 2, buf->cap - mark - 2, buf->data + mark + 1, len);
+    buf->data[mark] = (unsigned char)((len & VARINT_MASK) | VARINT_MORE);
+    buf->data[mark + 1] = (unsigned char)(len >> VARINT_SHIFT);
+    buf->len++;
+}
+
+/*****************************************************************************
+Function   : perfbin_section_set
+Description: replace the section of a collector with its output of this cycle
+Input      : section -- the collector section
+             buf     -- the tlvs built by the collector
+Output     : None
+Return     : None
+*****************************************************************************/
+void perfbin_section_set(PERFBIN_SECTION section, const PERFBIN_BUF *buf)
+{
+    PERFBIN_STORE *store = &g_perfbin_sections[section];
+
+    (void)pthread_mutex_lock(&g_perfbin_mutex);
+    store->truncated = buf->overflow || buf->len > sizeof(store->data);
+    store->len = store->truncated ? 0 : buf->len;
+    if (0 != store->len)
+    {
+        (void)memcpy_s(store->data, sizeof(store->data), buf->data, buf->len);
+    }
+    g_perfbin_dirty = true;
+    (void)pthread_mutex_unlock(&g_perfbin_mutex);
+}
+
+/* replace a section with an error tlv naming the metric that failed */
+void perfbin_section_fail(PERFBIN_SECTION section, PERFBIN_TLV type)
+{
+    unsigned char raw[4];
+    unsigned char failed = (unsigned char)type;
+    PERFBIN_BUF buf;
+    size_t mark;
+
+    perfbin_buf_init(&buf, raw, sizeof(raw));
+    mark = perfbin_tlv_begin(&buf, PERFBIN_TLV_ERROR);
+    perfbin_put_bytes(&buf, &failed, 1);
+    perfbin_tlv_end(&buf, mark);
+    perfbin_section_set(section, &buf);
+}
+
+static size_t perfbin_base64(const unsigned char *raw, size_t len, char *text)
+{
+    size_t i;
+    size_t n = 0;
+    unsigned int v;
+
+    for (i = 0; i + 2 < len; i += 3)
+    {
+        v = (unsigned int)raw[i] << 16 | (unsigned int)raw[i + 1] << 8 | raw[i + 2];
+        text[n++] = g_base64[(v >> 18) & 0x3f];
+        text[n++] = g_base64[(v >> 12) & 0x3f];
+        text[n++] = g_base64[(v >> 6) & 0x3f];
+        text[n++] = g_base64[v & 0x3f];
+    }
+    if (i < len)
+    {
+        v = (unsigned int)raw[i] << 16 | ((i + 1 < len) ? (unsigned int)raw[i + 1] << 8 : 0);
+        text[n++] = g_base64[(v >> 18) & 0x3f];
+        text[n++] = g_base64[(v >> 12) & 0x3f];
+        text[n++] = (i + 1 < len) ? g_base64[(v >> 6) & 0x3f] : '=';
+        text[n++] = '=';
+    }
+    text[n] = '\0';
+    return n;
+}
+
+/*****************************************************************************
+Function   : perfbin_publish
+Description: publish the sections of every collector as one record, to the
+             metric ring when it is open and to PERF_BIN_PATH when the host
+             asked for it; called at the end of a collection cycle, before
+             the batch is committed, so the record goes out with the cycle
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+void perfbin_publish(void *handle)
+{
+    unsigned char raw[PERFBIN_RAW_MAX];
+    char text[PERFBIN_TEXT_MAX + 1];
+    PERFBIN_STORE *store = NULL;
+    size_t len = PERFBIN_HEADER_LEN;
+    int i;
+
+    if (!perfbin_enabled())
+    {
+        return;
+    }
+
+    (void)pthread_mutex_lock(&g_perfbin_mutex);
+    if (!g_perfbin_dirty)
+    {
+        (void)pthread_mutex_unlock(&g_perfbin_mutex);
+        return;
+    }
+    raw[0] = PERFBIN_VERSION;
+    raw[1] = 0;
+    for (i = 0; i < PERFBIN_SECTION_BUTT; i++)
+    {
+        store = &g_perfbin_sections[i];
+        if (store->truncated || store->len > sizeof(raw) - len)
+        {
+            raw[1] |= PERFBIN_FLAG_TRUNCATED;
+            continue;
+        }
+        if (0 != store->len)
+        {
+            (void)memcpy_s(raw + len, sizeof(raw) - len, store->data, store->len);
+            len += store->len;
+        }
+    }
+    g_perfbin_dirty = false;
+    (void)pthread_mutex_unlock(&g_perfbin_mutex);
+
+    metricring_publish(raw, len);
+    if (g_exinfo_flag_value & EXINFO_FLAG_PERF_BIN)
+    {
+        (void)perfbin_base64(raw, len, text);
+        write_perf_to_xenstore(handle, PERF_BIN_PATH, text, xb_write_first_flag);
+    }
+}
@@ -0,0 +1,274 @@
+/*
+ * In-place field parser for /proc snapshots.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "procparse.h"
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define PROC_KEY_HASH_CHARS     4
+#define PROC_KEY_SEED_MAX       4096
+#define PROC_SWAR_DIGITS        8
+
+static pthread_mutex_t g_proc_keymap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************
+Function   : proc_find_newline
+Description: find the next newline, 16 bytes at a time with SSE2
+Input      : pos -- start of the search
+             end -- end of the snapshot
+Output     : None
+Return     : the newline, or end
+*****************************************************************************/
+static const char *proc_find_newline(const char *pos, const char *end)
+{
+    const char *found = NULL;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    int mask;
+
+    while (end - pos >= (ptrdiff_t)sizeof(__m128i))
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)pos), newline));
+        if (0 != mask)
+        {
+            return pos + __builtin_ctz((unsigned int)mask);
+        }
+        pos += sizeof(__m128i);
+    }
+#endif
+    found = (const char *)memchr(pos, '\n', (size_t)(end - pos));
+    return (NULL == found) ? end : found;
+}
+
+/*****************************************************************************
+Function   : proc_view_next_line
+Description: split the next line of a snapshot into its key and value,
+             without copying it
+Input      : view -- cursor, advanced past the line
+Output     : line -- key and value cursor of the line
+Return     : 1, or 0 at the end of the snapshot
+*****************************************************************************/
+int proc_view_next_line(PROC_VIEW *view, PROC_LINE *line)
+{
+    const char *start = NULL;
+    const char *end = NULL;
+    const char *pos = NULL;
+
+    if (view->pos >= view->len)
+    {
+        return 0;
+    }
+
+    start = view->data + view->pos;
+    end = proc_find_newline(start, view->data + view->len);
+    view->pos = (size_t)(end - view->data);
+    if (view->pos < view->len)
+    {
+        view->pos++;
+    }
+
+    for (pos = start; pos < end && ':' != *pos && ' ' != *pos && '\t' != *pos; pos++)
+    {
+        ;
+    }
+    line->key = start;
+    line->key_len = (size_t)(pos - start);
+    line->pos = (pos < end && ':' == *pos) ? pos + 1 : pos;
+    line->end = end;
+    return 1;
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+/*****************************************************************************
+Function   : proc_swar_digits
+Description: check that 8 bytes, first byte lowest, are all decimal digits,
+             and convert them in three multiply steps
+Input      : chunk -- the bytes
+Output     : value -- the number
+Return     : 1 if all 8 are digits, else 0
+*****************************************************************************/
+static int proc_swar_digits(uint64_t chunk, uint64_t *value)
+{
+    if (0x3030303030303030ULL != (chunk & 0xF0F0F0F0F0F0F0F0ULL)
+        || 0x3030303030303030ULL != ((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL))
+    {
+        return 0;
+    }
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFULL;
+    *value = chunk;
+    return 1;
+}
+#endif
+
+/*****************************************************************************
+Function   : proc_line_ull
+Description: parse the next unsigned decimal of a line, skipping blanks;
+             8 digits at a time where the byte order allows
+Input      : line -- value cursor, advanced past the number
+Output     : None
+Return     : the number, 0 if there is none
+*****************************************************************************/
+unsigned long long proc_line_ull(PROC_LINE *line)
+{
+    const char *pos = line->pos;
+    unsigned long long value = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    uint64_t chunk;
+    uint64_t digits;
+#endif
+
+    while (pos < line->end && (' ' == *pos || '\t' == *pos))
+    {
+        pos++;
+    }
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    while (line->end - pos >= PROC_SWAR_DIGITS)
+    {
+        (void)memcpy_s(&chunk, sizeof(chunk), pos, sizeof(chunk));
+        if (!proc_swar_digits(chunk, &digits))
+        {
+            break;
+        }
+        value = value * 100000000ULL + digits;
+        pos += PROC_SWAR_DIGITS;
+    }
+#endif
+    while (pos < line->end && (unsigned char)(*pos - '0') < 10)
+    {
+        value = value * 10 + (unsigned long long)(*pos - '0');
+        pos++;
+    }
+    line->pos = pos;
+    return value;
+}
+
+static unsigned int proc_key_hash(const char *key, size_t len, unsigned int seed)
+{
+    unsigned int hash = seed ^ (unsigned int)len;
+    size_t i;
+
+    for (i = 0; i < len && i < PROC_KEY_HASH_CHARS; i++)
+    {
+        hash = hash * 31 + (unsigned char)key[i];
+    }
+    if (len > 0)
+    {
+        hash = hash * 31 + (unsigned char)key[len - 1];
+    }
+    hash ^= hash >> 7;
+    return hash & (PROC_KEYMAP_SLOTS - 1);
+}
+
+/*****************************************************************************
+Function   : proc_keymap_build
+Description: search a seed for which no two keys share a slot
+Input      : map -- the key map
+Output     : map
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int proc_keymap_build(PROC_KEYMAP *map)
+{
+    unsigned int seed;
+    unsigned int slot;
+    int i;
+
+    if (map->num > PROC_KEYMAP_SLOTS / 2)
+    {
+        return ERROR;
+    }
+    for (seed = 1; seed < PROC_KEY_SEED_MAX; seed++)
+    {
+        (void)memset_s(map->slot, sizeof(map->slot), -1, sizeof(map->slot));
+        for (i = 0; i < map->num; i++)
+        {
+            slot = proc_key_hash(map->keys[i], strlen(map->keys[i]), seed);
+            if (map->slot[slot] >= 0)
+            {
+                break;
+            }
+            map->slot[slot] = (signed char)i;
+        }
+        if (i == map->num)
+        {
+            map->seed = seed;
+            return SUCC;
+        }
+    }
+    return ERROR;
+}
+
+/*****************************************************************************
+Function   : proc_keymap_find
+Description: look a key up in a key map
+Input      : map -- the key map, built on first use
+             key -- the key, not NUL terminated
+             len -- length of the key
+Output     : None
+Return     : index of the key in the key set, or -1
+*****************************************************************************/
+int proc_keymap_find(PROC_KEYMAP *map, const char *key, size_t len)
+{
+    int idx;
+
+    if (!map->ready)
+    {
+        (void)pthread_mutex_lock(&g_proc_keymap_mutex);
+        if (!map->ready)
+        {
+            if (SUCC != proc_keymap_build(map))
+            {
+                (void)pthread_mutex_unlock(&g_proc_keymap_mutex);
+                ERR_LOG("No perfect hash for %d keys.", map->num);
+                return -1;
+            }
+            __sync_synchronize();
+            map->ready = 1;
+        }
+        (void)pthread_mutex_unlock(&g_proc_keymap_mutex);
+    }
+
+    idx = map->slot[proc_key_hash(key, len, map->seed)];
+    if (idx < 0 || 0 != strncmp(map->keys[idx], key, len) || '\0' != map->keys[idx][len])
+    {
+        return -1;
+    }
+    return idx;
+}
@@ -0,0 +1,255 @@
+/*
+ * Keeps the /proc files read by the collectors open and re-reads them
+ * with pread() into reusable buffers.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "procsrc.h"
+
+#define PROC_SOURCE_INIT_SIZE   4096
+#define PROC_SOURCE_MAX_SIZE    (4 * 1024 * 1024)
+
+typedef struct
+{
+    const char *path;
+    int fd;
+    char *buf;
+    size_t size;        /* bytes allocated for buf */
+    size_t len;         /* bytes of the last snapshot */
+} PROC_SOURCE;
+
+/*
+ * indexed by PROC_SOURCE_ID; not locked: the collectors, the only readers,
+ * all run on the one collector thread of collect_scheduler_run
+ */
+static PROC_SOURCE g_proc_sources[PROC_SOURCE_BUTT] =
+{
+    {"/proc/stat",           -1, NULL, 0, 0},
+    {"/proc/meminfo",        -1, NULL, 0, 0},
+    {"/proc/net/dev",        -1, NULL, 0, 0},
+    {"/proc/partitions",     -1, NULL, 0, 0},
+    {"/proc/mounts",         -1, NULL, 0, 0},
+    {"/proc/self/mountinfo", -1, NULL, 0, 0},
+    {"/proc/swaps",          -1, NULL, 0, 0},
+    {"/proc/self/status",    -1, NULL, 0, 0},
+    {"/proc/vmstat",         -1, NULL, 0, 0},
+    {"/proc/pressure/memory", -1, NULL, 0, 0},
+};
+
+static int proc_source_open(PROC_SOURCE *src)
+{
+    int flag;
+
+    src->fd = open(src->path, O_RDONLY);
+    if (src->fd < 0)
+    {
+        DEBUG_LOG("Failed to open %s, errno=%d.", src->path, errno);
+        return ERROR;
+    }
+    flag = fcntl(src->fd, F_GETFD);
+    (void)fcntl(src->fd, F_SETFD, flag | FD_CLOEXEC);
+    return SUCC;
+}
+
+static int proc_source_grow(PROC_SOURCE *src)
+{
+    size_t size = (0 == src->size) ? PROC_SOURCE_INIT_SIZE : src->size * 2;
+    char *buf = NULL;
+
+    if (size > PROC_SOURCE_MAX_SIZE)
+    {
+        ERR_LOG("%s is larger than %d bytes.", src->path, PROC_SOURCE_MAX_SIZE);
+        return ERROR;
+    }
+    buf = (char *)realloc(src->buf, size);
+    if (NULL == buf)
+    {
+        return ERROR;
+    }
+    src->buf = buf;
+    src->size = size;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : proc_source_load
+Description: take a new snapshot of a source; the fd is reopened once if the
+             read fails, e.g. after the file went stale
+Input      : src -- the source
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int proc_source_load(PROC_SOURCE *src)
+{
+    ssize_t n;
+    int retry;
+
+    for (retry = 0; retry < 2; retry++)
+    {
+        if (src->fd < 0 && SUCC != proc_source_open(src))
+        {
+            return ERROR;
+        }
+
+        src->len = 0;
+        for (;;)
+        {
+            if (src->len + 1 >= src->size && SUCC != proc_source_grow(src))
+            {
+                src->len = 0;
+                return ERROR;
+            }
+            n = pread(src->fd, src->buf + src->len, src->size - src->len - 1, (off_t)src->len);
+            if (n < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                break;
+            }
+            if (0 == n)
+            {
+                src->buf[src->len] = '\0';
+                return SUCC;
+            }
+            src->len += (size_t)n;
+        }
+
+        DEBUG_LOG("Failed to read %s, errno=%d, reopen it.", src->path, errno);
+        (void)close(src->fd);
+        src->fd = -1;
+        src->len = 0;
+    }
+    return ERROR;
+}
+
+/*****************************************************************************
+Function   : proc_source_read
+Description: get a view over the snapshot of a /proc file
+Input      : id      -- the source
+             refresh -- PROC_SOURCE_REFRESH to re-read the file,
+                        PROC_SOURCE_CACHED to reuse the last snapshot
+Output     : view    -- cursor at the start of the snapshot
+Return     : SUCC or ERROR
+*****************************************************************************/
+int proc_source_read(PROC_SOURCE_ID id, int refresh, PROC_VIEW *view)
+{
+    PROC_SOURCE *src = NULL;
+
+    if (id >= PROC_SOURCE_BUTT || NULL == view)
+    {
+        return ERROR;
+    }
+    src = &g_proc_sources[id];
+
+    if ((PROC_SOURCE_REFRESH == refresh || 0 == src->len)
+        && SUCC != proc_source_load(src))
+    {
+        return ERROR;
+    }
+
+    view->data = src->buf;
+    view->len = src->len;
+    view->pos = 0;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : proc_view_gets
+Description: fgets() over a snapshot: copy the next line, newline included,
+             truncated to size - 1 bytes
+Input      : size -- size of line
+             view -- cursor, advanced past the copied bytes
+Output     : line -- NUL terminated line
+Return     : line, or NULL at the end of the snapshot
+*****************************************************************************/
+char *proc_view_gets(char *line, int size, PROC_VIEW *view)
+{
+    const char *start = NULL;
+    const char *end = NULL;
+    size_t avail;
+
+    if (NULL == line || size <= 0 || NULL == view || view->pos >= view->len)
+    {
+        return NULL;
+    }
+
+    start = view->data + view->pos;
+    avail = view->len - view->pos;
+    if (avail > (size_t)size - 1)
+    {
+        avail = (size_t)size - 1;
+    }
+    end = (const char *)memchr(start, '\n', avail);
+    if (NULL != end)
+    {
+        avail = (size_t)(end - start) + 1;
+    }
+
+    (void)memcpy_s(line, (size_t)size, start, avail);
+    line[avail] = '\0';
+    view->pos += avail;
+    return line;
+}
+
+/*****************************************************************************
+Function   : proc_view_lines
+Description: count the lines of a snapshot, a last line without newline
+             included; used to size tables before parsing
+Input      : view -- the snapshot
+Output     : None
+Return     : number of lines
+*****************************************************************************/
+int proc_view_lines(const PROC_VIEW *view)
+{
+    const char *pos = view->data;
+    const char *end = view->data + view->len;
+    int lines = 0;
+
+    while (pos < end)
+    {
+        pos = (const char *)memchr(pos, '\n', (size_t)(end - pos));
+        if (NULL == pos)
+        {
+            break;
+        }
+        pos++;
+        lines++;
+    }
+    if (view->len > 0 && '\n' != view->data[view->len - 1])
+    {
+        lines++;
+    }
+    return lines;
+}
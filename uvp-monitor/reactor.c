@@ -0,0 +1,183 @@
+/*
+ * epoll event loop shared by the monitor threads.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "reactor.h"
+#include <sys/epoll.h>
+
+/*****************************************************************************
+Function   : reactor_init
+Description: create the epoll instance of a loop
+Input      : reactor -- the loop
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int reactor_init(REACTOR *reactor)
+{
+    int i;
+
+    (void)memset_s(reactor, sizeof(REACTOR), 0, sizeof(REACTOR));
+    for (i = 0; i < REACTOR_MAX_SOURCES; i++)
+    {
+        reactor->sources[i].fd = -1;
+    }
+    reactor->epfd = epoll_create(REACTOR_MAX_SOURCES);
+    if (reactor->epfd < 0)
+    {
+        ERR_LOG("epoll_create failed, errno=%d.", errno);
+        return ERROR;
+    }
+    (void)fcntl(reactor->epfd, F_SETFD, FD_CLOEXEC);
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : reactor_add
+Description: call func(fd, arg) from the loop whenever fd is readable
+Input      : reactor -- the loop
+             fd      -- the descriptor, level triggered
+             func    -- handler
+             arg     -- handler argument
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int reactor_add(REACTOR *reactor, int fd, REACTOR_FUNC func, void *arg)
+{
+    struct epoll_event ev;
+    int i;
+
+    if (fd < 0 || NULL == func)
+    {
+        return ERROR;
+    }
+    for (i = 0; i < REACTOR_MAX_SOURCES; i++)
+    {
+        if (reactor->sources[i].fd < 0)
+        {
+            break;
+        }
+    }
+    if (REACTOR_MAX_SOURCES == i)
+    {
+        ERR_LOG("No room for fd %d in the event loop.", fd);
+        return ERROR;
+    }
+
+    (void)memset_s(&ev, sizeof(ev), 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)i;
+    if (0 != epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev))
+    {
+        ERR_LOG("Add fd %d to the event loop failed, errno=%d.", fd, errno);
+        return ERROR;
+    }
+    reactor->sources[i].fd = fd;
+    reactor->sources[i].func = func;
+    reactor->sources[i].arg = arg;
+    return SUCC;
+}
+
+/* stop watching fd; may be called from a handler, fd is not closed */
+void reactor_del(REACTOR *reactor, int fd)
+{
+    int i;
+
+    for (i = 0; i < REACTOR_MAX_SOURCES; i++)
+    {
+        if (fd >= 0 && reactor->sources[i].fd == fd)
+        {
+            (void)epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, fd, NULL);
+            reactor->sources[i].fd = -1;
+        }
+    }
+}
+
+/*****************************************************************************
+Function   : reactor_run
+Description: dispatch readable descriptors until reactor_stop is called from
+             a handler
+Input      : reactor -- the loop
+Output     : None
+Return     : SUCC when stopped, ERROR when epoll failed
+*****************************************************************************/
+int reactor_run(REACTOR *reactor)
+{
+    struct epoll_event events[REACTOR_MAX_SOURCES];
+    REACTOR_SOURCE *source = NULL;
+    int n, k;
+
+    while (!reactor->stop)
+    {
+        n = epoll_wait(reactor->epfd, events, REACTOR_MAX_SOURCES, -1);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            ERR_LOG("epoll_wait failed, errno=%d.", errno);
+            return ERROR;
+        }
+        for (k = 0; k < n && !reactor->stop; k++)
+        {
+            source = &reactor->sources[events[k].data.u32];
+            /* an earlier handler of this wake-up may have removed it */
+            if (source->fd >= 0)
+            {
+                source->func(source->fd, source->arg);
+            }
+        }
+        if (NULL != reactor->wake_end)
+        {
+            reactor->wake_end(-1, reactor->wake_arg);
+        }
+    }
+    return SUCC;
+}
+
+void reactor_stop(REACTOR *reactor)
+{
+    reactor->stop = true;
+}
+
+/* close the epoll instance; the descriptors of the sources stay open */
+void reactor_close(REACTOR *reactor)
+{
+    if (reactor->epfd >= 0)
+    {
+        (void)close(reactor->epfd);
+        reactor->epfd = -1;
+    }
+}
@@ -0,0 +1,1282 @@
+/*
+ * Keeps a route netlink model of links, addresses and routes, loaded by
+ * one dump and then maintained from RTNLGRP events, so the network
+ * collectors need neither ioctl nor route(8).
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "rtnl.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/version.h>
+
+/*
+ * build_tools compiles on the guest itself, against headers as old as
+ * 2.6.18. IFLA_STATS64 (2.6.35) is an enum without a macro, so mark it
+ * the way rtnetlink.h marks RTM_GETSTATS (4.7); without either, counters
+ * come from the link dump and the 32-bit IFLA_STATS.
+ */
+#if !defined(IFLA_STATS64) && LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 35)
+#define IFLA_STATS64 IFLA_STATS64
+#endif
+
+#define RTNL_RECV_BUF_LEN       32768
+#define RTNL_EVENT_RCVBUF       (256 * 1024)
+#define RTNL_INIT_NUM           16
+#define RTNL_DUMP_RETRY         2
+#define RTNL_RECV_TIMEOUT       2
+#define RTNL_EVENT_GROUPS       (RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR \
+                                 | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE)
+
+typedef struct
+{
+    RTNL_LINK *links;           /* sorted by ifindex */
+    int link_count;
+    int link_capacity;
+    RTNL_ADDR *addrs;
+    int addr_count;
+    int addr_capacity;
+    RTNL_ROUTE *routes;         /* unicast routes with a gateway, main table */
+    int route_count;
+    int route_capacity;
+    int valid;
+    int stats_valid;            /* counters of this sample were read */
+    unsigned int generation;    /* bumped whenever links, addresses or routes change */
+} RTNL_MODEL;
+
+typedef int (*RTNL_PARSER)(struct nlmsghdr *nlh);
+typedef int (*RTNL_ROUTE_VISITOR)(const RTNL_ROUTE *route);
+
+/* the model belongs to the collector thread, like the /proc sources */
+static RTNL_MODEL g_rtnl_model;
+static int g_rtnl_fd = -1;
+static int g_rtnl_event_fd = -1;
+#ifdef RTM_GETSTATS
+static int g_rtnl_getstats_failed = 0;
+#endif
+static unsigned int g_rtnl_seq = 0;
+static long g_rtnl_buf[RTNL_RECV_BUF_LEN / sizeof(long)];
+
+static int rtnl_reserve(void **array, int *capacity, int count, size_t size)
+{
+    void *grown = NULL;
+    int newcap = *capacity ? *capacity : RTNL_INIT_NUM;
+
+    if (count <= *capacity)
+    {
+        return SUCC;
+    }
+    while (newcap < count)
+    {
+        newcap *= 2;
+    }
+    grown = realloc(*array, newcap * size);
+    if (NULL == grown)
+    {
+        return ERROR;
+    }
+    *array = grown;
+    *capacity = newcap;
+    return SUCC;
+}
+
+static void rtnl_remove(void *array, int *count, int idx, size_t size)
+{
+    char *base = (char *)array;
+
+    if (idx < *count - 1)
+    {
+        (void)memmove_s(base + idx * size, (*count - idx) * size,
+                        base + (idx + 1) * size, (*count - idx - 1) * size);
+    }
+    (*count)--;
+}
+
+static void rtnl_close(int *fd)
+{
+    if (*fd >= 0)
+    {
+        (void)close(*fd);
+        *fd = -1;
+    }
+}
+
+/*****************************************************************************
+Function   : rtnl_socket
+Description: open and bind a route netlink socket
+Input      : groups -- multicast groups to join, 0 for a request socket
+Output     : None
+Return     : the socket, or ERROR
+*****************************************************************************/
+static int rtnl_socket(unsigned int groups)
+{
+    struct sockaddr_nl local;
+    struct timeval timeout = {RTNL_RECV_TIMEOUT, 0};
+    int rcvbuf = RTNL_EVENT_RCVBUF;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (fd < 0)
+    {
+        DEBUG_LOG("Failed to open route netlink socket, errno=%d.", errno);
+        return ERROR;
+    }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (0 == groups)
+    {
+        /* never let a lost reply stall the collector thread */
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    else
+    {
+        /* events are drained once per sample, room for a burst avoids a resync */
+        (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    (void)memset_s(&local, sizeof(local), 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = groups;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+    {
+        DEBUG_LOG("Failed to bind route netlink socket, errno=%d.", errno);
+        (void)close(fd);
+        return ERROR;
+    }
+    return fd;
+}
+
+static void rtnl_copy_name(char *name, const struct rtattr *rta)
+{
+    size_t len = RTA_PAYLOAD(rta);
+
+    if (len > IFNAMSIZ - 1)
+    {
+        len = IFNAMSIZ - 1;
+    }
+    (void)memcpy_s(name, IFNAMSIZ, RTA_DATA(rta), len);
+    name[len] = '\0';
+}
+
+static void rtnl_copy_inaddr(unsigned char *addr, const struct rtattr *rta)
+{
+    size_t len = RTA_PAYLOAD(rta);
+
+    if (len > RTNL_INADDR_LEN)
+    {
+        len = RTNL_INADDR_LEN;
+    }
+    (void)memcpy_s(addr, RTNL_INADDR_LEN, RTA_DATA(rta), len);
+}
+
+static void rtnl_copy_counters(RTNL_LINK *dst, const RTNL_LINK *src)
+{
+    dst->rx_bytes = src->rx_bytes;
+    dst->rx_packets = src->rx_packets;
+    dst->rx_drop = src->rx_drop;
+    dst->tx_bytes = src->tx_bytes;
+    dst->tx_packets = src->tx_packets;
+    dst->tx_drop = src->tx_drop;
+    dst->has_stats = src->has_stats;
+}
+
+#ifdef IFLA_STATS64
+static void rtnl_copy_stats64(RTNL_LINK *link, const struct rtattr *rta)
+{
+    struct rtnl_link_stats64 stats64;
+
+    if (RTA_PAYLOAD(rta) < sizeof(stats64))
+    {
+        return;
+    }
+    /* the attribute is only 4-byte aligned */
+    (void)memcpy_s(&stats64, sizeof(stats64), RTA_DATA(rta), sizeof(stats64));
+    /* same drop columns as /proc/net/dev */
+    link->rx_bytes = stats64.rx_bytes;
+    link->rx_packets = stats64.rx_packets;
+    link->rx_drop = stats64.rx_dropped + stats64.rx_missed_errors;
+    link->tx_bytes = stats64.tx_bytes;
+    link->tx_packets = stats64.tx_packets;
+    link->tx_drop = stats64.tx_dropped;
+    link->has_stats = 1;
+}
+#endif
+
+/*****************************************************************************
+Function   : rtnl_read_link
+Description: decode one RTM_NEWLINK or RTM_DELLINK message
+Input      : nlh  -- the netlink message
+Output     : link -- the link
+Return     : SUCC, or ERROR if the message carries no link
+*****************************************************************************/
+static int rtnl_read_link(struct nlmsghdr *nlh, RTNL_LINK *link)
+{
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    struct rtattr *rta = NULL;
+    struct rtnl_link_stats stats;
+    int len = (int)IFLA_PAYLOAD(nlh);
+#ifdef IFLA_STATS64
+    int has_stats64 = 0;
+#endif
+
+    if (len < 0)
+    {
+        return ERROR;
+    }
+
+    (void)memset_s(link, sizeof(RTNL_LINK), 0, sizeof(RTNL_LINK));
+    link->index = ifi->ifi_index;
+    link->flags = ifi->ifi_flags;
+
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        switch (rta->rta_type)
+        {
+            case IFLA_IFNAME:
+                rtnl_copy_name(link->ifname, rta);
+                break;
+            case IFLA_ADDRESS:
+                link->hwaddr_len = (int)RTA_PAYLOAD(rta);
+                if (link->hwaddr_len > RTNL_HWADDR_LEN)
+                {
+                    link->hwaddr_len = RTNL_HWADDR_LEN;
+                }
+                (void)memcpy_s(link->hwaddr, RTNL_HWADDR_LEN, RTA_DATA(rta), link->hwaddr_len);
+                break;
+#ifdef IFLA_STATS64
+            case IFLA_STATS64:
+                rtnl_copy_stats64(link, rta);
+                has_stats64 = link->has_stats;
+                break;
+#endif
+            case IFLA_STATS:
+#ifdef IFLA_STATS64
+                if (has_stats64)
+                {
+                    break;
+                }
+#endif
+                if (RTA_PAYLOAD(rta) < sizeof(stats))
+                {
+                    break;
+                }
+                (void)memcpy_s(&stats, sizeof(stats), RTA_DATA(rta), sizeof(stats));
+                link->rx_bytes = stats.rx_bytes;
+                link->rx_packets = stats.rx_packets;
+                link->rx_drop = (unsigned long long)stats.rx_dropped + stats.rx_missed_errors;
+                link->tx_bytes = stats.tx_bytes;
+                link->tx_packets = stats.tx_packets;
+                link->tx_drop = stats.tx_dropped;
+                link->has_stats = 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return ('\0' != link->ifname[0] || RTM_DELLINK == nlh->nlmsg_type) ? SUCC : ERROR;
+}
+
+/*****************************************************************************
+Function   : rtnl_read_addr
+Description: decode one RTM_NEWADDR or RTM_DELADDR message
+Input      : nlh  -- the netlink message
+Output     : addr -- the address
+Return     : SUCC, or ERROR if the message carries no IPv4/IPv6 address
+*****************************************************************************/
+static int rtnl_read_addr(struct nlmsghdr *nlh, RTNL_ADDR *addr)
+{
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+    struct rtattr *rta = NULL;
+    int len = (int)IFA_PAYLOAD(nlh);
+    int has_local = 0;
+    int has_addr = 0;
+
+    if (len < 0 || (AF_INET != ifa->ifa_family && AF_INET6 != ifa->ifa_family))
+    {
+        return ERROR;
+    }
+
+    (void)memset_s(addr, sizeof(RTNL_ADDR), 0, sizeof(RTNL_ADDR));
+    addr->index = (int)ifa->ifa_index;
+    addr->family = ifa->ifa_family;
+    addr->prefixlen = ifa->ifa_prefixlen;
+    addr->scope = ifa->ifa_scope;
+
+    for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        switch (rta->rta_type)
+        {
+            case IFA_LOCAL:
+                /* on point-to-point links IFA_ADDRESS is the peer */
+                rtnl_copy_inaddr(addr->addr, rta);
+                has_local = 1;
+                break;
+            case IFA_ADDRESS:
+                if (!has_local)
+                {
+                    rtnl_copy_inaddr(addr->addr, rta);
+                }
+                has_addr = 1;
+                break;
+            case IFA_LABEL:
+                rtnl_copy_name(addr->label, rta);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return (has_local || has_addr) ? SUCC : ERROR;
+}
+
+/*****************************************************************************
+Function   : rtnl_read_route
+Description: hand every gateway hop of one RTM_NEWROUTE or RTM_DELROUTE
+             message to visit, i.e. the lines route -n would flag UG
+Input      : nlh   -- the netlink message
+             visit -- handler of each gateway route
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int rtnl_read_route(struct nlmsghdr *nlh, RTNL_ROUTE_VISITOR visit)
+{
+    struct rtmsg *rtm = (struct rtmsg *)NLMSG_DATA(nlh);
+    struct rtattr *rta = NULL;
+    struct rtattr *multipath = NULL;
+    struct rtattr *nhrta = NULL;
+    struct rtnexthop *rtnh = NULL;
+    RTNL_ROUTE route;
+    unsigned int table = rtm->rtm_table;
+    int has_gateway = 0;
+    int len = (int)RTM_PAYLOAD(nlh);
+    int nhlen = 0;
+    int attrlen = 0;
+
+    if (len < 0 || RTN_UNICAST != rtm->rtm_type
+        || (AF_INET != rtm->rtm_family && AF_INET6 != rtm->rtm_family))
+    {
+        return SUCC;
+    }
+
+    (void)memset_s(&route, sizeof(route), 0, sizeof(route));
+    route.family = rtm->rtm_family;
+    route.dst_len = rtm->rtm_dst_len;
+    for (rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        switch (rta->rta_type)
+        {
+            case RTA_TABLE:
+                table = *(unsigned int *)RTA_DATA(rta);
+                break;
+            case RTA_DST:
+                rtnl_copy_inaddr(route.dst, rta);
+                break;
+            case RTA_OIF:
+                route.oif = *(int *)RTA_DATA(rta);
+                break;
+            case RTA_PRIORITY:
+                route.priority = *(unsigned int *)RTA_DATA(rta);
+                break;
+            case RTA_GATEWAY:
+                rtnl_copy_inaddr(route.gateway, rta);
+                has_gateway = 1;
+                break;
+            case RTA_MULTIPATH:
+                multipath = rta;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (RT_TABLE_MAIN != table)
+    {
+        return SUCC;
+    }
+    if (has_gateway && 0 != route.oif)
+    {
+        return visit(&route);
+    }
+    if (NULL == multipath)
+    {
+        return SUCC;
+    }
+
+    /* every hop of an ECMP route counts as a gateway of its device */
+    rtnh = (struct rtnexthop *)RTA_DATA(multipath);
+    nhlen = (int)RTA_PAYLOAD(multipath);
+    while (nhlen >= (int)sizeof(struct rtnexthop) && rtnh->rtnh_len <= nhlen
+           && rtnh->rtnh_len >= sizeof(struct rtnexthop))
+    {
+        attrlen = rtnh->rtnh_len - sizeof(struct rtnexthop);
+        for (nhrta = RTNH_DATA(rtnh); RTA_OK(nhrta, attrlen); nhrta = RTA_NEXT(nhrta, attrlen))
+        {
+            if (RTA_GATEWAY != nhrta->rta_type)
+            {
+                continue;
+            }
+            route.oif = rtnh->rtnh_ifindex;
+            rtnl_copy_inaddr(route.gateway, nhrta);
+            if (SUCC != visit(&route))
+            {
+                return ERROR;
+            }
+        }
+        nhlen -= RTNH_ALIGN(rtnh->rtnh_len);
+        rtnh = RTNH_NEXT(rtnh);
+    }
+    return SUCC;
+}
+
+static int rtnl_find_link(int index)
+{
+    int i;
+
+    for (i = 0; i < g_rtnl_model.link_count; i++)
+    {
+        if (g_rtnl_model.links[i].index == index)
+        {
+            return i;
+        }
+    }
+    return ERROR;
+}
+
+static int rtnl_find_addr(const RTNL_ADDR *addr)
+{
+    const RTNL_ADDR *entry = NULL;
+    int i;
+
+    for (i = 0; i < g_rtnl_model.addr_count; i++)
+    {
+        entry = &g_rtnl_model.addrs[i];
+        if (entry->index == addr->index && entry->family == addr->family
+            && entry->prefixlen == addr->prefixlen
+            && 0 == memcmp(entry->addr, addr->addr, RTNL_INADDR_LEN))
+        {
+            return i;
+        }
+    }
+    return ERROR;
+}
+
+/* same destination and metric, i.e. the route an NLM_F_REPLACE overwrites */
+static int rtnl_same_dst(const RTNL_ROUTE *left, const RTNL_ROUTE *right)
+{
+    return left->family == right->family && left->dst_len == right->dst_len
+        && left->priority == right->priority
+        && 0 == memcmp(left->dst, right->dst, RTNL_INADDR_LEN);
+}
+
+static int rtnl_find_route(const RTNL_ROUTE *route)
+{
+    const RTNL_ROUTE *entry = NULL;
+    int i;
+
+    for (i = 0; i < g_rtnl_model.route_count; i++)
+    {
+        entry = &g_rtnl_model.routes[i];
+        if (rtnl_same_dst(entry, route) && entry->oif == route->oif
+            && 0 == memcmp(entry->gateway, route->gateway, RTNL_INADDR_LEN))
+        {
+            return i;
+        }
+    }
+    return ERROR;
+}
+
+static int rtnl_append_route(const RTNL_ROUTE *route)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+
+    if (SUCC != rtnl_reserve((void **)&model->routes, &model->route_capacity,
+                             model->route_count + 1, sizeof(RTNL_ROUTE)))
+    {
+        return ERROR;
+    }
+    model->routes[model->route_count++] = *route;
+    return SUCC;
+}
+
+static int rtnl_insert_route(const RTNL_ROUTE *route)
+{
+    if (ERROR != rtnl_find_route(route))
+    {
+        return SUCC;
+    }
+    g_rtnl_model.generation++;
+    return rtnl_append_route(route);
+}
+
+static int rtnl_delete_route(const RTNL_ROUTE *route)
+{
+    int idx = rtnl_find_route(route);
+
+    if (ERROR != idx)
+    {
+        rtnl_remove(g_rtnl_model.routes, &g_rtnl_model.route_count, idx, sizeof(RTNL_ROUTE));
+        g_rtnl_model.generation++;
+    }
+    return SUCC;
+}
+
+static int rtnl_replace_route(const RTNL_ROUTE *route)
+{
+    int i;
+
+    for (i = g_rtnl_model.route_count - 1; i >= 0; i--)
+    {
+        if (rtnl_same_dst(&g_rtnl_model.routes[i], route))
+        {
+            rtnl_remove(g_rtnl_model.routes, &g_rtnl_model.route_count, i, sizeof(RTNL_ROUTE));
+            g_rtnl_model.generation++;
+        }
+    }
+    return SUCC;
+}
+
+static int rtnl_parse_link(struct nlmsghdr *nlh)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+
+    if (RTM_NEWLINK != nlh->nlmsg_type)
+    {
+        return SUCC;
+    }
+    if (SUCC != rtnl_reserve((void **)&model->links, &model->link_capacity,
+                             model->link_count + 1, sizeof(RTNL_LINK)))
+    {
+        return ERROR;
+    }
+    if (SUCC == rtnl_read_link(nlh, &model->links[model->link_count]))
+    {
+        model->link_count++;
+    }
+    return SUCC;
+}
+
+static int rtnl_parse_addr(struct nlmsghdr *nlh)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+
+    if (RTM_NEWADDR != nlh->nlmsg_type)
+    {
+        return SUCC;
+    }
+    if (SUCC != rtnl_reserve((void **)&model->addrs, &model->addr_capacity,
+                             model->addr_count + 1, sizeof(RTNL_ADDR)))
+    {
+        return ERROR;
+    }
+    if (SUCC == rtnl_read_addr(nlh, &model->addrs[model->addr_count]))
+    {
+        model->addr_count++;
+    }
+    return SUCC;
+}
+
+static int rtnl_parse_route(struct nlmsghdr *nlh)
+{
+    if (RTM_NEWROUTE != nlh->nlmsg_type)
+    {
+        return SUCC;
+    }
+    return rtnl_read_route(nlh, rtnl_append_route);
+}
+
+/*****************************************************************************
+Function   : rtnl_parse_stats
+Description: store the counters of one RTM_NEWSTATS or RTM_NEWLINK reply in
+             the link with the same ifindex
+Input      : nlh -- the netlink message
+Output     : None
+Return     : SUCC
+*****************************************************************************/
+static int rtnl_parse_stats(struct nlmsghdr *nlh)
+{
+    RTNL_LINK link;
+#ifdef RTM_GETSTATS
+    struct if_stats_msg *ifsm = NULL;
+    struct rtattr *rta = NULL;
+    int len = 0;
+#endif
+    int idx;
+
+    if (RTM_NEWLINK == nlh->nlmsg_type)
+    {
+        if (SUCC == rtnl_read_link(nlh, &link) && ERROR != (idx = rtnl_find_link(link.index)))
+        {
+            rtnl_copy_counters(&g_rtnl_model.links[idx], &link);
+        }
+        return SUCC;
+    }
+#ifdef RTM_GETSTATS
+    if (RTM_NEWSTATS != nlh->nlmsg_type)
+    {
+        return SUCC;
+    }
+
+    ifsm = (struct if_stats_msg *)NLMSG_DATA(nlh);
+    len = (int)NLMSG_PAYLOAD(nlh, sizeof(struct if_stats_msg));
+    idx = rtnl_find_link((int)ifsm->ifindex);
+    if (ERROR == idx || len < 0)
+    {
+        return SUCC;
+    }
+    for (rta = (struct rtattr *)((char *)ifsm + NLMSG_ALIGN(sizeof(struct if_stats_msg)));
+         RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        if (IFLA_STATS_LINK_64 == rta->rta_type)
+        {
+            rtnl_copy_stats64(&g_rtnl_model.links[idx], rta);
+        }
+    }
+#endif
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : rtnl_dump
+Description: send one dump request and feed every reply message to parser
+Input      : type     -- RTM_GETLINK, RTM_GETADDR, RTM_GETROUTE or RTM_GETSTATS
+             body     -- the family header of the request
+             body_len -- size of body
+             parser   -- handler of each reply message
+Output     : None
+Return     : SUCC, or ERROR if the dump failed or was interrupted
+*****************************************************************************/
+static int rtnl_dump(int type, const void *body, size_t body_len, RTNL_PARSER parser)
+{
+    struct
+    {
+        struct nlmsghdr nlh;
+        char body[NLMSG_ALIGN(sizeof(struct ifinfomsg))];
+    } req;
+    struct sockaddr_nl kernel;
+    struct nlmsghdr *nlh = NULL;
+    unsigned int seq = ++g_rtnl_seq;
+    ssize_t len;
+
+    (void)memset_s(&req, sizeof(req), 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(body_len);
+    req.nlh.nlmsg_type = type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = seq;
+    (void)memcpy_s(req.body, sizeof(req.body), body, body_len);
+
+    (void)memset_s(&kernel, sizeof(kernel), 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(g_rtnl_fd, &req, req.nlh.nlmsg_len, 0,
+               (struct sockaddr *)&kernel, sizeof(kernel)) < 0)
+    {
+        DEBUG_LOG("Failed to send netlink dump %d, errno=%d.", type, errno);
+        return ERROR;
+    }
+
+    for (;;)
+    {
+        len = recv(g_rtnl_fd, g_rtnl_buf, sizeof(g_rtnl_buf), MSG_TRUNC);
+        if (len < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (len <= 0 || len > (ssize_t)sizeof(g_rtnl_buf))
+        {
+            DEBUG_LOG("Failed to receive netlink dump %d, len=%d, errno=%d.", type, (int)len, errno);
+            return ERROR;
+        }
+
+        for (nlh = (struct nlmsghdr *)g_rtnl_buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+        {
+            if (nlh->nlmsg_seq != seq)
+            {
+                continue;
+            }
+            if (nlh->nlmsg_flags & NLM_F_DUMP_INTR)
+            {
+                /* the tables changed under the dump, the caller starts over */
+                return ERROR;
+            }
+            if (NLMSG_DONE == nlh->nlmsg_type)
+            {
+                return SUCC;
+            }
+            if (NLMSG_ERROR == nlh->nlmsg_type || SUCC != parser(nlh))
+            {
+                return ERROR;
+            }
+        }
+    }
+}
+
+static int rtnl_link_compare(const void *left, const void *right)
+{
+    return ((const RTNL_LINK *)left)->index - ((const RTNL_LINK *)right)->index;
+}
+
+/*****************************************************************************
+Function   : rtnl_model_load
+Description: dump links, addresses and routes into a new model
+Input      : None
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int rtnl_model_load(void)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+    struct ifinfomsg ifi;
+    struct ifaddrmsg ifa;
+    struct rtmsg rtm;
+    int retry;
+
+    (void)memset_s(&ifi, sizeof(ifi), 0, sizeof(ifi));
+    (void)memset_s(&ifa, sizeof(ifa), 0, sizeof(ifa));
+    (void)memset_s(&rtm, sizeof(rtm), 0, sizeof(rtm));
+    for (retry = 0; retry < RTNL_DUMP_RETRY; retry++)
+    {
+        if (g_rtnl_fd < 0 && ERROR == (g_rtnl_fd = rtnl_socket(0)))
+        {
+            return ERROR;
+        }
+
+        model->link_count = 0;
+        model->addr_count = 0;
+        model->route_count = 0;
+        if (SUCC == rtnl_dump(RTM_GETLINK, &ifi, sizeof(ifi), rtnl_parse_link)
+            && SUCC == rtnl_dump(RTM_GETADDR, &ifa, sizeof(ifa), rtnl_parse_addr)
+            && SUCC == rtnl_dump(RTM_GETROUTE, &rtm, sizeof(rtm), rtnl_parse_route))
+        {
+            /* same order as /proc/net/dev */
+            qsort(model->links, model->link_count, sizeof(RTNL_LINK), rtnl_link_compare);
+            /* the dump carried the counters of this sample */
+            model->stats_valid = 1;
+            return SUCC;
+        }
+
+        /* a half-read dump cannot be resynchronised, use a new socket */
+        rtnl_close(&g_rtnl_fd);
+    }
+    return ERROR;
+}
+
+/*****************************************************************************
+Function   : rtnl_apply_link
+Description: apply one link event; a removed link takes its addresses and
+             routes with it
+Input      : nlh -- the netlink message
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int rtnl_apply_link(struct nlmsghdr *nlh)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+    RTNL_LINK link;
+    int idx;
+    int i;
+
+    if (SUCC != rtnl_read_link(nlh, &link))
+    {
+        return SUCC;
+    }
+    idx = rtnl_find_link(link.index);
+
+    if (RTM_DELLINK == nlh->nlmsg_type)
+    {
+        if (ERROR == idx)
+        {
+            return SUCC;
+        }
+        rtnl_remove(model->links, &model->link_count, idx, sizeof(RTNL_LINK));
+        for (i = model->addr_count - 1; i >= 0; i--)
+        {
+            if (model->addrs[i].index == link.index)
+            {
+                rtnl_remove(model->addrs, &model->addr_count, i, sizeof(RTNL_ADDR));
+            }
+        }
+        for (i = model->route_count - 1; i >= 0; i--)
+        {
+            if (model->routes[i].oif == link.index)
+            {
+                rtnl_remove(model->routes, &model->route_count, i, sizeof(RTNL_ROUTE));
+            }
+        }
+        model->generation++;
+        return SUCC;
+    }
+
+    if (ERROR != idx)
+    {
+        /* counters are sampled separately, they are no change */
+        rtnl_copy_counters(&link, &model->links[idx]);
+        if (0 != memcmp(&model->links[idx], &link, sizeof(RTNL_LINK)))
+        {
+            model->links[idx] = link;
+            model->generation++;
+        }
+        return SUCC;
+    }
+
+    if (SUCC != rtnl_reserve((void **)&model->links, &model->link_capacity,
+                             model->link_count + 1, sizeof(RTNL_LINK)))
+    {
+        return ERROR;
+    }
+    /* keep the ifindex order */
+    for (idx = model->link_count; idx > 0 && model->links[idx - 1].index > link.index; idx--)
+    {
+        model->links[idx] = model->links[idx - 1];
+    }
+    model->links[idx] = link;
+    model->link_count++;
+    model->generation++;
+    return SUCC;
+}
+
+static int rtnl_apply_addr(struct nlmsghdr *nlh)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+    RTNL_ADDR addr;
+    int idx;
+
+    if (SUCC != rtnl_read_addr(nlh, &addr))
+    {
+        return SUCC;
+    }
+    idx = rtnl_find_addr(&addr);
+
+    if (RTM_DELADDR == nlh->nlmsg_type)
+    {
+        if (ERROR != idx)
+        {
+            rtnl_remove(model->addrs, &model->addr_count, idx, sizeof(RTNL_ADDR));
+            model->generation++;
+        }
+        return SUCC;
+    }
+
+    if (ERROR != idx)
+    {
+        if (model->addrs[idx].scope != addr.scope || 0 != strcmp(model->addrs[idx].label, addr.label))
+        {
+            model->addrs[idx] = addr;
+            model->generation++;
+        }
+        return SUCC;
+    }
+    if (SUCC != rtnl_reserve((void **)&model->addrs, &model->addr_capacity,
+                             model->addr_count + 1, sizeof(RTNL_ADDR)))
+    {
+        return ERROR;
+    }
+    model->addrs[model->addr_count++] = addr;
+    model->generation++;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : rtnl_event_drain
+Description: apply every queued RTNLGRP event to the model
+Input      : None
+Output     : None
+Return     : SUCC, or ERROR if events were lost and the model needs a dump
+*****************************************************************************/
+static int rtnl_event_drain(int *routes_stale)
+{
+    struct nlmsghdr *nlh = NULL;
+    unsigned int generation = g_rtnl_model.generation;
+    int ret = SUCC;
+    ssize_t len;
+
+    for (;;)
+    {
+        len = recv(g_rtnl_event_fd, g_rtnl_buf, sizeof(g_rtnl_buf), MSG_TRUNC);
+        if (len < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+            {
+                return ret;
+            }
+            if (ENOBUFS == errno)
+            {
+                /* the queue overflowed, keep draining and reload afterwards */
+                INFO_LOG("Route netlink events overflowed, reload the model.");
+                ret = ERROR;
+                continue;
+            }
+            DEBUG_LOG("Failed to receive netlink events, errno=%d.", errno);
+            rtnl_close(&g_rtnl_event_fd);
+            return ERROR;
+        }
+        if (len > (ssize_t)sizeof(g_rtnl_buf))
+        {
+            ret = ERROR;
+            continue;
+        }
+
+        for (nlh = (struct nlmsghdr *)g_rtnl_buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+        {
+            if (ERROR == ret)
+            {
+                break;
+            }
+            switch (nlh->nlmsg_type)
+            {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                    ret = rtnl_apply_link(nlh);
+                    break;
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                    ret = rtnl_apply_addr(nlh);
+                    break;
+                case RTM_NEWROUTE:
+                    if (nlh->nlmsg_flags & NLM_F_REPLACE)
+                    {
+                        ret = rtnl_read_route(nlh, rtnl_replace_route);
+                    }
+                    if (SUCC == ret)
+                    {
+                        ret = rtnl_read_route(nlh, rtnl_insert_route);
+                    }
+                    break;
+                case RTM_DELROUTE:
+                    ret = rtnl_read_route(nlh, rtnl_delete_route);
+                    break;
+                default:
+                    break;
+            }
+            /*
+             * IPv4 flushes the routes of a downed link or a removed address
+             * without RTM_DELROUTE, so such a change reloads the routes
+             */
+            if (generation != g_rtnl_model.generation && RTM_NEWROUTE != nlh->nlmsg_type
+                && RTM_DELROUTE != nlh->nlmsg_type)
+            {
+                *routes_stale = 1;
+            }
+            generation = g_rtnl_model.generation;
+        }
+    }
+}
+
+static int rtnl_routes_reload(void)
+{
+    struct rtmsg rtm;
+
+    (void)memset_s(&rtm, sizeof(rtm), 0, sizeof(rtm));
+    g_rtnl_model.route_count = 0;
+    if (SUCC != rtnl_dump(RTM_GETROUTE, &rtm, sizeof(rtm), rtnl_parse_route))
+    {
+        rtnl_close(&g_rtnl_fd);
+        return ERROR;
+    }
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : rtnl_stats_refresh
+Description: sample the link counters with RTM_GETSTATS, or with a link dump
+             on kernels or headers without it
+Input      : None
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+static int rtnl_stats_refresh(void)
+{
+#ifdef RTM_GETSTATS
+    struct if_stats_msg ifsm;
+#endif
+    struct ifinfomsg ifi;
+    int i;
+
+    for (i = 0; i < g_rtnl_model.link_count; i++)
+    {
+        g_rtnl_model.links[i].has_stats = 0;
+    }
+
+#ifdef RTM_GETSTATS
+    if (!g_rtnl_getstats_failed)
+    {
+        (void)memset_s(&ifsm, sizeof(ifsm), 0, sizeof(ifsm));
+        ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+        if (SUCC == rtnl_dump(RTM_GETSTATS, &ifsm, sizeof(ifsm), rtnl_parse_stats))
+        {
+            return SUCC;
+        }
+        INFO_LOG("RTM_GETSTATS is not usable, sample counters by link dump.");
+        g_rtnl_getstats_failed = 1;
+        rtnl_close(&g_rtnl_fd);
+        if (ERROR == (g_rtnl_fd = rtnl_socket(0)))
+        {
+            return ERROR;
+        }
+    }
+#endif
+
+    (void)memset_s(&ifi, sizeof(ifi), 0, sizeof(ifi));
+    if (SUCC != rtnl_dump(RTM_GETLINK, &ifi, sizeof(ifi), rtnl_parse_stats))
+    {
+        rtnl_close(&g_rtnl_fd);
+        return ERROR;
+    }
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : rtnl_model_refresh
+Description: bring the model up to date for a new sample: apply the queued
+             events, or dump everything when there is no event stream or it
+             lost events, then sample the link counters
+Input      : None
+Output     : None
+Return     : SUCC or ERROR; the model is invalid after ERROR
+*****************************************************************************/
+int rtnl_model_refresh(void)
+{
+    RTNL_MODEL *model = &g_rtnl_model;
+    int routes_stale = 0;
+
+    model->stats_valid = 0;
+    if (g_rtnl_fd < 0 && ERROR == (g_rtnl_fd = rtnl_socket(0)))
+    {
+        model->valid = 0;
+        return ERROR;
+    }
+
+    if (model->valid && g_rtnl_event_fd >= 0 && SUCC == rtnl_event_drain(&routes_stale)
+        && (!routes_stale || SUCC == rtnl_routes_reload()))
+    {
+        model->stats_valid = (SUCC == rtnl_stats_refresh());
+        return SUCC;
+    }
+
+    /* subscribe before the dump so no change falls between the two */
+    if (g_rtnl_event_fd < 0)
+    {
+        g_rtnl_event_fd = rtnl_socket(RTNL_EVENT_GROUPS);
+    }
+    model->valid = 0;
+    model->generation++;
+    if (SUCC != rtnl_model_load())
+    {
+        DEBUG_LOG("Failed to dump route netlink, fall back to ioctl.");
+        return ERROR;
+    }
+    model->valid = 1;
+    return SUCC;
+}
+
+int rtnl_model_valid(void)
+{
+    return g_rtnl_model.valid;
+}
+
+int rtnl_stats_valid(void)
+{
+    return g_rtnl_model.valid && g_rtnl_model.stats_valid;
+}
+
+unsigned int rtnl_model_generation(void)
+{
+    return g_rtnl_model.generation;
+}
+
+int rtnl_link_count(void)
+{
+    return g_rtnl_model.valid ? g_rtnl_model.link_count : 0;
+}
+
+const RTNL_LINK *rtnl_link_entry(int idx)
+{
+    if (!g_rtnl_model.valid || idx < 0 || idx >= g_rtnl_model.link_count)
+    {
+        return NULL;
+    }
+    return &g_rtnl_model.links[idx];
+}
+
+static const RTNL_LINK *rtnl_link_find(const char *ifname, size_t len)
+{
+    int i;
+
+    if (!g_rtnl_model.valid || 0 == len || len >= IFNAMSIZ)
+    {
+        return NULL;
+    }
+    for (i = 0; i < g_rtnl_model.link_count; i++)
+    {
+        if (0 == strncmp(g_rtnl_model.links[i].ifname, ifname, len)
+            && '\0' == g_rtnl_model.links[i].ifname[len])
+        {
+            return &g_rtnl_model.links[i];
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+Function   : rtnl_link_lookup
+Description: find a link by name; an alias label such as eth0:1 resolves to
+             its link, the way SIOCGIFFLAGS and SIOCGIFHWADDR do
+Input      : ifname -- the interface name
+Output     : None
+Return     : the link, or NULL
+*****************************************************************************/
+const RTNL_LINK *rtnl_link_lookup(const char *ifname)
+{
+    const char *colon = NULL;
+
+    if (NULL == ifname)
+    {
+        return NULL;
+    }
+    colon = strchr(ifname, ':');
+    return rtnl_link_find(ifname, (NULL != colon) ? (size_t)(colon - ifname) : strlen(ifname));
+}
+
+int rtnl_addr_count(void)
+{
+    return g_rtnl_model.valid ? g_rtnl_model.addr_count : 0;
+}
+
+const RTNL_ADDR *rtnl_addr_entry(int idx)
+{
+    if (!g_rtnl_model.valid || idx < 0 || idx >= g_rtnl_model.addr_count)
+    {
+        return NULL;
+    }
+    return &g_rtnl_model.addrs[idx];
+}
+
+/*****************************************************************************
+Function   : rtnl_ipv4_addr
+Description: the primary IPv4 address of a label, as SIOCGIFADDR reports it
+Input      : label -- the interface name or alias label
+             size  -- size of buf
+Output     : buf   -- the dotted address
+Return     : SUCC or ERROR
+*****************************************************************************/
+int rtnl_ipv4_addr(const char *label, char *buf, int size)
+{
+    const RTNL_ADDR *addr = NULL;
+    int i;
+
+    if (NULL == label || NULL == buf)
+    {
+        return ERROR;
+    }
+    for (i = 0; i < rtnl_addr_count(); i++)
+    {
+        addr = &g_rtnl_model.addrs[i];
+        if (AF_INET == addr->family && 0 == strcmp(addr->label, label))
+        {
+            return (NULL != inet_ntop(AF_INET, addr->addr, buf, (socklen_t)size)) ? SUCC : ERROR;
+        }
+    }
+    return ERROR;
+}
+
+/*****************************************************************************
+Function   : rtnl_gateway
+Description: the gateway of an interface: its default route if there is one,
+             else its first gateway route
+Input      : family -- AF_INET or AF_INET6
+             ifname -- the interface name, alias labels have no routes
+             size   -- size of buf
+Output     : buf    -- the gateway address
+Return     : SUCC, or ERROR if the interface has no gateway
+*****************************************************************************/
+int rtnl_gateway(int family, const char *ifname, char *buf, int size)
+{
+    const RTNL_LINK *link = NULL;
+    const RTNL_ROUTE *route = NULL;
+    const RTNL_ROUTE *best = NULL;
+    char address[INET6_ADDRSTRLEN] = {0};
+    int i;
+
+    if (NULL == ifname || NULL == buf)
+    {
+        return ERROR;
+    }
+    link = rtnl_link_find(ifname, strlen(ifname));
+    if (NULL == link)
+    {
+        return ERROR;
+    }
+
+    for (i = 0; i < g_rtnl_model.route_count; i++)
+    {
+        route = &g_rtnl_model.routes[i];
+        if (family != route->family || link->index != route->oif)
+        {
+            continue;
+        }
+        if (NULL == best
+            || (0 == route->dst_len && (0 != best->dst_len || route->priority < best->priority)))
+        {
+            best = route;
+        }
+    }
+
+    if (NULL == best || NULL == inet_ntop(family, best->gateway, address, sizeof(address)))
+    {
+        return ERROR;
+    }
+    return (EOK == strncpy_s(buf, size, address, strlen(address))) ? SUCC : ERROR;
+}
+
+/*****************************************************************************
+Function   : rtnl_format_hwaddr
+Description: print the MAC address of a link like SIOCGIFHWADDR users do
+Input      : link -- the link
+             size -- size of buf
+Output     : buf  -- xx:xx:xx:xx:xx:xx
+Return     : None
+*****************************************************************************/
+void rtnl_format_hwaddr(const RTNL_LINK *link, char *buf, int size)
+{
+    (void)snprintf_s(buf, size, size - 1, "%02x:%02x:%02x:%02x:%02x:%02x",
+                     link->hwaddr[0], link->hwaddr[1], link->hwaddr[2],
+                     link->hwaddr[3], link->hwaddr[4], link->hwaddr[5]);
+}
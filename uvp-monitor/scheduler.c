@@ -0,0 +1,399 @@
+/*
+ * Schedules the performance collectors of uvp-monitor with per-collector
+ * intervals, so that cheap collectors run often and expensive ones rarely.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "scheduler.h"
+#include "footprint.h"
+#include "perfbin.h"
+#include "reactor.h"
+#include <stdint.h>
+#include <time.h>
+#ifdef HAVE_TIMERFD
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#endif
+
+#define COLLECT_PATH_LEN        128
+#define COLLECT_JITTER_DIVISOR  10      /* re-arm jitter is +-1/10 of the interval */
+#define COLLECT_FALLBACK_TICK   1
+#define MSEC_PER_SEC            1000
+#define NSEC_PER_MSEC           1000000
+#define DECIMAL                 10
+
+static int collect_network(void *handle)
+{
+    if (1 == g_netinfo_value)
+    {
+        NetinfoNetworkctlmon(handle);
+    }
+    else
+    {
+        networkctlmon(handle);
+    }
+    return SUCC;
+}
+
+static int collect_memory(void *handle)
+{
+    return memoryworkctlmon(handle);
+}
+
+static int collect_disk(void *handle)
+{
+    return diskworkctlmon(handle);
+}
+
+static int collect_hostname(void *handle)
+{
+    return hostnameworkctlmon(handle);
+}
+
+static int collect_cpu(void *handle)
+{
+    if (ERROR == cpuworkctlmon(handle))
+    {
+        write_perf_to_xenstore(handle, CPU_DATA_PATH, "error", xb_write_first_flag);
+        return ERROR;
+    }
+    return SUCC;
+}
+
+static int collect_footprint(void *handle)
+{
+    return footprint_report(handle);
+}
+
+static COLLECTOR g_collectors[] =
+{
+    {"network",   collect_network,   5,  5, -1},
+    {"memory",    collect_memory,    5,  5, -1},
+    {"disk",      collect_disk,      30, 30, -1},
+    {"hostname",  collect_hostname,  30, 30, -1},
+    {"cpu",       collect_cpu,       30, 30, -1},
+    {"footprint", collect_footprint, 60, 60, -1},
+};
+
+#define COLLECTOR_NUM   (sizeof(g_collectors) / sizeof(g_collectors[0]))
+
+static unsigned int g_collect_seed = 0;
+/* connection of the collector thread, renewed when it breaks */
+static void *g_collect_handle = NULL;
+#ifdef HAVE_TIMERFD
+/* eventfd used by the watch thread to make the scheduler re-arm its timers */
+static int g_collect_wakefd = -1;
+/* timers of the collectors, served on the collector thread */
+static REACTOR g_collect_reactor;
+#endif
+
+/*****************************************************************************
+Function   : collect_seed_init
+Description: seed the jitter generator, mixing in the domain id so that guests
+             started at the same moment still drift apart
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+static void collect_seed_init(void *handle)
+{
+    char *domid = NULL;
+
+    g_collect_seed = (unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16);
+    domid = read_from_xenstore(handle, "domid");
+    if (NULL != domid)
+    {
+        g_collect_seed ^= (unsigned int)strtoul(domid, NULL, DECIMAL) * 2654435761U;
+        free(domid);
+    }
+}
+
+#ifdef HAVE_TIMERFD
+/*****************************************************************************
+Function   : collect_first_delay
+Description: delay of the first run after (re)arming, a random phase within
+             one interval
+Input      : interval -- collector interval, seconds
+Output     : None
+Return     : delay in milliseconds
+*****************************************************************************/
+static unsigned int collect_first_delay(unsigned int interval)
+{
+    return 1 + (unsigned int)rand_r(&g_collect_seed) % (interval * MSEC_PER_SEC);
+}
+
+/*****************************************************************************
+Function   : collect_next_delay
+Description: delay of the next run, the interval plus or minus a small jitter
+Input      : interval -- collector interval, seconds
+Output     : None
+Return     : delay in milliseconds
+*****************************************************************************/
+static unsigned int collect_next_delay(unsigned int interval)
+{
+    unsigned int msec = interval * MSEC_PER_SEC;
+    unsigned int span = msec / COLLECT_JITTER_DIVISOR;
+
+    if (0 == span)
+    {
+        return msec;
+    }
+    return msec - span + (unsigned int)rand_r(&g_collect_seed) % (2 * span + 1);
+}
+
+static int collect_arm(int timerfd, unsigned int msec)
+{
+    struct itimerspec its;
+
+    (void)memset_s(&its, sizeof(its), 0, sizeof(its));
+    its.it_value.tv_sec = msec / MSEC_PER_SEC;
+    its.it_value.tv_nsec = (long)(msec % MSEC_PER_SEC) * NSEC_PER_MSEC;
+    return timerfd_settime(timerfd, 0, &its, NULL);
+}
+#endif
+
+/*****************************************************************************
+Function   : collect_interval_reload
+Description: read the per-collector intervals from xenstore; a missing or
+             invalid key falls back to the built-in default
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+void collect_interval_reload(void *handle)
+{
+    char path[COLLECT_PATH_LEN] = {0};
+    char *value = NULL;
+    unsigned long interval = 0;
+    unsigned int i;
+    int changed = 0;
+#ifdef HAVE_TIMERFD
+    uint64_t one = 1;
+#endif
+
+    for (i = 0; i < COLLECTOR_NUM; i++)
+    {
+        interval = g_collectors[i].def_interval;
+        (void)snprintf_s(path, sizeof(path), sizeof(path), "%s/%s",
+                         COLLECT_INTERVAL_PATH, g_collectors[i].name);
+        value = read_from_xenstore(handle, path);
+        if (NULL != value)
+        {
+            interval = strtoul(value, NULL, DECIMAL);
+            if (interval < COLLECT_INTERVAL_MIN || interval > COLLECT_INTERVAL_MAX)
+            {
+                ERR_LOG("Invalid %s interval %s, use default %u.", g_collectors[i].name,
+                        value, g_collectors[i].def_interval);
+                interval = g_collectors[i].def_interval;
+            }
+            free(value);
+            value = NULL;
+        }
+        if (interval != g_collectors[i].interval)
+        {
+            INFO_LOG("Collector %s interval %u -> %lu seconds.", g_collectors[i].name,
+                     g_collectors[i].interval, interval);
+            g_collectors[i].interval = (unsigned int)interval;
+            changed = 1;
+        }
+    }
+
+#ifdef HAVE_TIMERFD
+    if (changed && g_collect_wakefd >= 0)
+    {
+        (void)write(g_collect_wakefd, &one, sizeof(one));
+    }
+#else
+    /* the polling fallback reads the new intervals on its next tick */
+    (void)changed;
+#endif
+}
+
+/*****************************************************************************
+Function   : collect_scheduler_fallback
+Description: one-second polling loop, used when timerfd/epoll is unavailable
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+static void collect_scheduler_fallback(void *handle)
+{
+    unsigned int elapsed[COLLECTOR_NUM] = {0};
+    unsigned int i;
+
+    while (SUCC == condition())
+    {
+        (void)sleep(COLLECT_FALLBACK_TICK);
+        handle = xenstore_pool_renew(handle);
+        xenstore_batch_begin();
+        for (i = 0; i < COLLECTOR_NUM; i++)
+        {
+            elapsed[i] += COLLECT_FALLBACK_TICK;
+            if (elapsed[i] < g_collectors[i].interval)
+            {
+                continue;
+            }
+            elapsed[i] = 0;
+            if (!g_disable_exinfo_value)
+            {
+                (void)g_collectors[i].func(handle);
+            }
+        }
+        perfbin_publish(handle);
+        xenstore_batch_commit(handle);
+    }
+}
+
+#ifdef HAVE_TIMERFD
+static void collect_scheduler_close(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < COLLECTOR_NUM; i++)
+    {
+        if (g_collectors[i].timerfd >= 0)
+        {
+            (void)close(g_collectors[i].timerfd);
+            g_collectors[i].timerfd = -1;
+        }
+    }
+    if (g_collect_wakefd >= 0)
+    {
+        (void)close(g_collect_wakefd);
+        g_collect_wakefd = -1;
+    }
+    reactor_close(&g_collect_reactor);
+}
+
+/* a collector's timer expired: run it into the batch of this wake-up */
+static void collect_timer_event(int fd, void *arg)
+{
+    COLLECTOR *c = (COLLECTOR *)arg;
+    uint64_t count = 0;
+
+    (void)read(fd, &count, sizeof(count));
+    /* the collectors woken together publish their keys in one transaction */
+    xenstore_batch_begin();
+    if (!g_disable_exinfo_value)
+    {
+        (void)c->func(g_collect_handle);
+    }
+    (void)collect_arm(fd, collect_next_delay(c->interval));
+}
+
+/* intervals changed, restart every timer with a new phase */
+static void collect_wake_event(int fd, void *arg)
+{
+    uint64_t count = 0;
+    unsigned int i;
+
+    (void)arg;
+    (void)read(fd, &count, sizeof(count));
+    for (i = 0; i < COLLECTOR_NUM; i++)
+    {
+        (void)collect_arm(g_collectors[i].timerfd,
+                          collect_first_delay(g_collectors[i].interval));
+    }
+}
+
+static void collect_wake_end(int fd, void *arg)
+{
+    (void)fd;
+    (void)arg;
+    perfbin_publish(g_collect_handle);
+    xenstore_batch_commit(g_collect_handle);
+    g_collect_handle = xenstore_pool_renew(g_collect_handle);
+}
+
+static int collect_scheduler_open(void)
+{
+    unsigned int i;
+
+    if (SUCC != reactor_init(&g_collect_reactor))
+    {
+        return ERROR;
+    }
+    g_collect_reactor.wake_end = collect_wake_end;
+
+    for (i = 0; i < COLLECTOR_NUM; i++)
+    {
+        g_collectors[i].timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+        if (g_collectors[i].timerfd < 0
+            || SUCC != reactor_add(&g_collect_reactor, g_collectors[i].timerfd,
+                                   collect_timer_event, &g_collectors[i])
+            || 0 != collect_arm(g_collectors[i].timerfd, collect_first_delay(g_collectors[i].interval)))
+        {
+            ERR_LOG("Create timer of collector %s failed, errno=%d.", g_collectors[i].name, errno);
+            collect_scheduler_close();
+            return ERROR;
+        }
+    }
+
+    g_collect_wakefd = eventfd(0, 0);
+    if (g_collect_wakefd < 0
+        || SUCC != reactor_add(&g_collect_reactor, g_collect_wakefd, collect_wake_event, NULL))
+    {
+        ERR_LOG("Create scheduler eventfd failed, errno=%d.", errno);
+        collect_scheduler_close();
+        return ERROR;
+    }
+    return SUCC;
+}
+#endif
+
+/*****************************************************************************
+Function   : collect_scheduler_run
+Description: run every collector on its own timer, re-armed with jitter after
+             each run; never returns unless the event loop breaks
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+void collect_scheduler_run(void *handle)
+{
+    collect_seed_init(handle);
+    collect_interval_reload(handle);
+    g_collect_handle = handle;
+
+#ifdef HAVE_TIMERFD
+    if (SUCC != collect_scheduler_open())
+    {
+        collect_scheduler_fallback(g_collect_handle);
+        return;
+    }
+    (void)reactor_run(&g_collect_reactor);
+
+    collect_scheduler_close();
+#endif
+    collect_scheduler_fallback(g_collect_handle);
+}
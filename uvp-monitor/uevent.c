@@ -0,0 +1,243 @@
+/*
+ * Listens to kernel uevents over netlink and keeps a change counter per
+ * subsystem, so that cached device topology is rebuilt only when the
+ * kernel reported a change.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "uevent.h"
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#define UEVENT_KERNEL_GROUP     1
+#define UEVENT_RCVBUF           (256 * 1024)
+#define UEVENT_BUF_LEN          8192
+#define UEVENT_SUBSYS_KEY       "SUBSYSTEM="
+
+/* indexed by UEVENT_SUBSYS_ID */
+static const char *g_uevent_subsys[UEVENT_SUBSYS_BUTT] =
+{
+    "block",
+    "cpu",
+};
+
+static unsigned int g_uevent_generation[UEVENT_SUBSYS_BUTT];
+static int g_uevent_fd = -1;
+static char g_uevent_buf[UEVENT_BUF_LEN + 1];
+static pthread_mutex_t g_uevent_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int uevent_socket(void)
+{
+    struct sockaddr_nl local;
+    int rcvbuf = UEVENT_RCVBUF;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+    {
+        DEBUG_LOG("Failed to open uevent netlink socket, errno=%d.", errno);
+        return ERROR;
+    }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    (void)memset_s(&local, sizeof(local), 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = UEVENT_KERNEL_GROUP;
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+    {
+        DEBUG_LOG("Failed to bind uevent netlink socket, errno=%d.", errno);
+        (void)close(fd);
+        return ERROR;
+    }
+    return fd;
+}
+
+static void uevent_bump_all(void)
+{
+    int i;
+
+    for (i = 0; i < UEVENT_SUBSYS_BUTT; i++)
+    {
+        g_uevent_generation[i]++;
+    }
+}
+
+/*****************************************************************************
+Function   : uevent_parse
+Description: bump the generation of the subsystem of one kernel uevent,
+             "add@/devices/...\0ACTION=add\0DEVPATH=...\0SUBSYSTEM=block\0..."
+Input      : buf -- the message, NUL terminated
+             len -- length of the message
+Output     : None
+Return     : None
+*****************************************************************************/
+static void uevent_parse(const char *buf, size_t len)
+{
+    size_t pos = 0;
+    int i;
+
+    while (pos < len)
+    {
+        if (0 == strncmp(buf + pos, UEVENT_SUBSYS_KEY, strlen(UEVENT_SUBSYS_KEY)))
+        {
+            for (i = 0; i < UEVENT_SUBSYS_BUTT; i++)
+            {
+                if (0 == strcmp(buf + pos + strlen(UEVENT_SUBSYS_KEY), g_uevent_subsys[i]))
+                {
+                    g_uevent_generation[i]++;
+                }
+            }
+            return;
+        }
+        pos += strlen(buf + pos) + 1;
+    }
+}
+
+/*****************************************************************************
+Function   : uevent_refresh
+Description: drain the queued kernel uevents
+Input      : None
+Output     : None
+Return     : SUCC, or ERROR if no uevent socket is available
+*****************************************************************************/
+int uevent_refresh(void)
+{
+    struct sockaddr_nl sender;
+    socklen_t addrlen;
+    ssize_t len;
+    int ret = SUCC;
+
+    (void)pthread_mutex_lock(&g_uevent_mutex);
+    if (g_uevent_fd < 0)
+    {
+        g_uevent_fd = uevent_socket();
+        if (g_uevent_fd < 0)
+        {
+            (void)pthread_mutex_unlock(&g_uevent_mutex);
+            return ERROR;
+        }
+        /* whatever happened before the socket was bound is unknown */
+        uevent_bump_all();
+    }
+
+    for (;;)
+    {
+        addrlen = sizeof(sender);
+        len = recvfrom(g_uevent_fd, g_uevent_buf, UEVENT_BUF_LEN, 0, (struct sockaddr *)&sender, &addrlen);
+        if (len < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+            {
+                break;
+            }
+            if (ENOBUFS == errno)
+            {
+                INFO_LOG("Uevents overflowed, drop the cached topology.");
+                uevent_bump_all();
+                continue;
+            }
+            DEBUG_LOG("Failed to receive uevents, errno=%d.", errno);
+            (void)close(g_uevent_fd);
+            g_uevent_fd = -1;
+            ret = ERROR;
+            break;
+        }
+        /* only the kernel may invalidate the caches */
+        if (0 != sender.nl_pid)
+        {
+            continue;
+        }
+        g_uevent_buf[len] = '\0';
+        uevent_parse(g_uevent_buf, (size_t)len);
+    }
+    (void)pthread_mutex_unlock(&g_uevent_mutex);
+    return ret;
+}
+
+unsigned int uevent_generation(UEVENT_SUBSYS_ID id)
+{
+    unsigned int generation;
+
+    (void)pthread_mutex_lock(&g_uevent_mutex);
+    generation = g_uevent_generation[id];
+    (void)pthread_mutex_unlock(&g_uevent_mutex);
+    return generation;
+}
+
+/*****************************************************************************
+Function   : uevent_wait
+Description: sleep until the generation of a subsystem moves past the given
+             one; the socket is shared with uevent_refresh callers of other
+             threads, which may drain an event first, so one wait never
+             sleeps longer than timeout_ms
+Input      : id         -- the subsystem
+             generation -- the generation the caller has already seen
+             timeout_ms -- longest sleep
+Output     : None
+Return     : SUCC if the generation moved, ERROR on timeout
+*****************************************************************************/
+int uevent_wait(UEVENT_SUBSYS_ID id, unsigned int generation, int timeout_ms)
+{
+    struct pollfd pfd;
+    int fd;
+
+    if (SUCC == uevent_refresh() && generation != uevent_generation(id))
+    {
+        return SUCC;
+    }
+
+    (void)pthread_mutex_lock(&g_uevent_mutex);
+    fd = g_uevent_fd;
+    (void)pthread_mutex_unlock(&g_uevent_mutex);
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    /* without a socket this degrades to a plain sleep */
+    if (poll(&pfd, fd < 0 ? 0 : 1, timeout_ms) <= 0)
+    {
+        return ERROR;
+    }
+    (void)uevent_refresh();
+    return generation != uevent_generation(id) ? SUCC : ERROR;
+}
@@ -0,0 +1,295 @@
+/*
+ * Watch handler table of the monitor's watch loop.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "xenstore_common.h"
+#include "footprint.h"
+#include "watchtable.h"
+#include <pthread.h>
+
+#define WATCH_BUCKETS   32
+/* events of a WATCH_FLAG_QUEUE key kept while its handler is busy */
+#define WATCH_QUEUE_MAX 64
+
+/* an event waiting for the worker of its key */
+typedef struct watch_work
+{
+    struct watch_work *next;
+    char        *path;
+    char        *value;
+} WATCH_WORK;
+
+typedef struct watch_entry
+{
+    struct watch_entry *next;
+    char          *path;
+    WATCH_HANDLER  handler;
+    unsigned int   flags;
+    /* WATCH_FLAG_WORKER only: the key's own worker and its pending events */
+    bool           worker_started;
+    void          *shared;
+    WATCH_WORK    *pending;
+    WATCH_WORK   **pending_tail;
+    unsigned int   pending_count;
+    pthread_cond_t cond;
+} WATCH_ENTRY;
+
+static WATCH_ENTRY *g_watch_table[WATCH_BUCKETS];
+/* guards the pending events of every key */
+static pthread_mutex_t g_watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a over len bytes of path */
+static unsigned int watch_hash(const char *path, size_t len)
+{
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)path[i]) * 16777619u;
+    }
+    return hash % WATCH_BUCKETS;
+}
+
+static WATCH_ENTRY *watch_lookup(const char *path, size_t len)
+{
+    WATCH_ENTRY *entry = NULL;
+
+    for (entry = g_watch_table[watch_hash(path, len)]; NULL != entry; entry = entry->next)
+    {
+        if (0 == strncmp(entry->path, path, len) && '\0' == entry->path[len])
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+Function   : watch_table_register
+Description: bind the handler of a watched key; registering a key again
+             replaces its handler. The xenstore watch itself is still set by
+             regwatch.
+Input      : path    -- the watched key
+             handler -- called for every event of the key or a node below it
+             flags   -- WATCH_FLAG_*
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int watch_table_register(const char *path, WATCH_HANDLER handler, unsigned int flags)
+{
+    WATCH_ENTRY *entry = NULL;
+    unsigned int bucket;
+
+    if (NULL == path || NULL == handler)
+    {
+        return ERROR;
+    }
+    entry = watch_lookup(path, strlen(path));
+    if (NULL == entry)
+    {
+        entry = (WATCH_ENTRY *)calloc(1, sizeof(WATCH_ENTRY));
+        if (NULL == entry || NULL == (entry->path = strdup(path)))
+        {
+            ERR_LOG("Register watch handler of %s failed, no memory.", path);
+            free(entry);
+            return ERROR;
+        }
+        (void)pthread_cond_init(&entry->cond, NULL);
+        entry->pending_tail = &entry->pending;
+        bucket = watch_hash(path, strlen(path));
+        entry->next = g_watch_table[bucket];
+        g_watch_table[bucket] = entry;
+    }
+    entry->handler = handler;
+    entry->flags = flags;
+    return SUCC;
+}
+
+static void watch_work_free(WATCH_WORK *work)
+{
+    free(work->path);
+    free(work->value);
+    free(work);
+}
+
+/*
+ * runs the handler of one key, so a slow key never delays the others; the
+ * pooled connection is only held while the handler runs, an idle worker
+ * must not keep one of the few pool slots
+ */
+static void *watch_worker(void *arg)
+{
+    WATCH_ENTRY *entry = (WATCH_ENTRY *)arg;
+    void *handle = NULL;
+    WATCH_WORK *work = NULL;
+
+    for (;;)
+    {
+        (void)pthread_mutex_lock(&g_watch_mutex);
+        while (NULL == entry->pending)
+        {
+            (void)pthread_cond_wait(&entry->cond, &g_watch_mutex);
+        }
+        work = entry->pending;
+        entry->pending = work->next;
+        if (NULL == entry->pending)
+        {
+            entry->pending_tail = &entry->pending;
+        }
+        entry->pending_count--;
+        (void)pthread_mutex_unlock(&g_watch_mutex);
+
+        handle = xenstore_pool_get(entry->shared);
+        entry->handler(handle, work->path, work->value);
+        xenstore_pool_put(handle);
+        watch_work_free(work);
+    }
+    return NULL;
+}
+
+/*
+ * hand an event to the worker of its key, which is started with the first
+ * one. While an event of a state key is still pending, only its value is
+ * refreshed; the events of a WATCH_FLAG_QUEUE key are all kept in order.
+ */
+static void watch_queue(void *handle, WATCH_ENTRY *entry, const char *path, char *value)
+{
+    WATCH_WORK *work = NULL;
+    pthread_attr_t attr;
+    pthread_t thread_id;
+    int ret;
+
+    (void)pthread_mutex_lock(&g_watch_mutex);
+    if (NULL != (work = entry->pending) && !(entry->flags & WATCH_FLAG_QUEUE))
+    {
+        free(work->value);
+        work->value = value;
+        (void)pthread_mutex_unlock(&g_watch_mutex);
+        return;
+    }
+    if (entry->pending_count >= WATCH_QUEUE_MAX)
+    {
+        (void)pthread_mutex_unlock(&g_watch_mutex);
+        ERR_LOG("Too many watch events of %s pending, drop %s.", entry->path, path);
+        free(value);
+        return;
+    }
+    (void)pthread_mutex_unlock(&g_watch_mutex);
+
+    work = (WATCH_WORK *)malloc(sizeof(WATCH_WORK));
+    if (NULL == work || NULL == (work->path = strdup(path)))
+    {
+        ERR_LOG("Queue watch event of %s failed, no memory.", path);
+        free(work);
+        free(value);
+        return;
+    }
+    work->next = NULL;
+    work->value = value;
+
+    if (!entry->worker_started)
+    {
+        entry->shared = handle;
+        (void)pthread_attr_init(&attr);
+        (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        footprint_thread_attr(&attr);
+        ret = pthread_create(&thread_id, &attr, watch_worker, entry);
+        (void)pthread_attr_destroy(&attr);
+        if (0 != ret)
+        {
+            /* run it here rather than lose the event */
+            ERR_LOG("Create watch worker of %s failed, ret=%d.", entry->path, ret);
+            entry->handler(handle, work->path, work->value);
+            watch_work_free(work);
+            return;
+        }
+        entry->worker_started = true;
+    }
+
+    (void)pthread_mutex_lock(&g_watch_mutex);
+    *entry->pending_tail = work;
+    entry->pending_tail = &work->next;
+    entry->pending_count++;
+    (void)pthread_cond_signal(&entry->cond);
+    (void)pthread_mutex_unlock(&g_watch_mutex);
+}
+
+/*****************************************************************************
+Function   : watch_table_dispatch
+Description: run the handler of a fired watch. The path is looked up as is,
+             then without its last components, so an event of a node below
+             a watched key reaches the key's handler. Handlers registered
+             with WATCH_FLAG_WORKER only get queued, so the watch loop is
+             free for the next event at once.
+Input      : handle -- xenstore handle of the watch loop
+             path   -- path of the event
+Output     : None
+Return     : None
+*****************************************************************************/
+void watch_table_dispatch(void *handle, const char *path)
+{
+    WATCH_ENTRY *entry = NULL;
+    char *value = NULL;
+    size_t len;
+
+    if (NULL == path)
+    {
+        return;
+    }
+    for (len = strlen(path); len > 0; len--)
+    {
+        if (('\0' == path[len] || '/' == path[len]) && NULL != (entry = watch_lookup(path, len)))
+        {
+            break;
+        }
+    }
+    if (NULL == entry)
+    {
+        return;
+    }
+
+    if (entry->flags & WATCH_FLAG_VALUE)
+    {
+        value = read_from_xenstore(handle, entry->path);
+    }
+    if (entry->flags & WATCH_FLAG_WORKER)
+    {
+        watch_queue(handle, entry, path, value);
+        return;
+    }
+    entry->handler(handle, path, value);
+    free(value);
+}
@@ -42,6 +42,17 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include "uvpmon.h"
+#include "scheduler.h"
+#include "footprint.h"
+#include "perfbin.h"
+#include "metricring.h"
+#include "watchtable.h"
+#include "memhotplug.h"
+#include "reactor.h"
+#include <signal.h>
+#ifdef HAVE_SIGNALFD
+#include <sys/signalfd.h>
+#endif
 #include <sys/time.h>
 #include <time.h>
 #include <syslog.h>
@@ -185,6 +196,21 @@ struct Freezearg
     FsMountList *mounts;
 };
 
+/* ӽյSIGTERM˳룬̾ݴ˲ӽ */
+#define MONITOR_EXIT_TERM   15
+
+/* ӽ̵߳¼ѭ˳ԭ */
+#define MONITOR_STOP_NONE   0
+#define MONITOR_STOP_PARENT 1
+#define MONITOR_STOP_TERM   2
+static REACTOR g_monitor_reactor;
+static int g_monitor_stop = MONITOR_STOP_NONE;
+/* ͨxenstore */
+static void *g_tools_handle = NULL;
+
+/* ļϵͳɴ洢ռֵwatchͽⶳ */
+static FsMountList g_freeze_mounts = QTAILQ_HEAD_INITIALIZER(g_freeze_mounts);
+
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 #define LOG_BUF_LEN 256
@@ -276,6 +302,16 @@ void write_vrm_flag(void *phandle)
     }
 }
 
+/* ܼ¼ϵͳ޹أmonitorGuestOSFeatureûиOSʱҲҪд */
+static void write_guest_feature(void *handle, unsigned long feature)
+{
+    char value[SHELL_BUFFER] = {0};
+
+    (void)snprintf_s(value, SHELL_BUFFER, SHELL_BUFFER - 1, "%lu", feature | GUEST_FEATURE_PERF_BIN);
+    INFO_LOG("Guest feature is %s.", value);
+    write_to_xenstore(handle, GUSET_OS_FEATURE, value);
+}
+
 void set_guest_feature(void *handle)
 {
     int ret = 0;
@@ -288,6 +324,7 @@ void set_guest_feature(void *handle)
         || 0 != access("/etc/.uvp-monitor/CurrentOS", R_OK))
     {
         ERR_LOG("Get Guest Feature, Can't read cfg files, errno=%d", errno);
+        write_guest_feature(handle, 0);
         return;
     }
 
@@ -295,12 +332,14 @@ void set_guest_feature(void *handle)
     if(0 != ret)
     {
         ERR_LOG("Failed to call uvpPopen 1, output=%s ret=%d.", feature_str, ret);
+        write_guest_feature(handle, 0);
         return;
     }
     //Get name form CurrentOS error,maybe "NULL"
     if(0 == strlen(feature_str))
     {
         INFO_LOG("Get name form cfg error.");
+        write_guest_feature(handle, 0);
         return;
     }
 
@@ -308,22 +347,22 @@ void set_guest_feature(void *handle)
     if (0 != ret)
     {
         ERR_LOG("Failed to call uvpPopen 2, output=%s ret=%d.", feature_str, ret);
+        write_guest_feature(handle, 0);
         return;
     }
     //grep from GuestOSFeature maybe NULL
     if (0 == strlen(feature_str))
     {
         INFO_LOG("Get guest feature failed.");
+        write_guest_feature(handle, 0);
     }
     else
     {
-		INFO_LOG("Guest feature is %s.", feature_str);
-        write_to_xenstore(handle, GUSET_OS_FEATURE, trim(feature_str));
+        write_guest_feature(handle, strtoul(trim(feature_str), NULL, 10));
     }
     return;
 }
 
-
 void SetPvDriverVer(void *handle)
 {
     FILE *pFileVer = NULL;
@@ -608,6 +647,8 @@ void uvp_regwatch(void *phandle)
     (void)regwatch(phandle, REBOND_SRIOV, "0");
     (void)regwatch(phandle, EXINFO_FLAG_PATH, "exinfo_token");
     (void)regwatch(phandle, DISABLE_EXINFO_PATH, "exinfo_token");
+    (void)regwatch(phandle, COLLECT_INTERVAL_PATH, "0");
+    (void)regwatch(phandle, MEM_ONLINE_ZONE_PATH, "0");
     /* write cpu hotplug feature if cpu support hotplug */
     iIsHotplug = SetCpuHotplugFeature(phandle);
     if (iIsHotplug == XEN_SUCC)
@@ -649,6 +690,8 @@ void uvp_unregwatch(void *phandle)
     (void)xs_unwatch(phandle, REBOND_SRIOV, "0");
     (void)xs_unwatch(phandle, EXINFO_FLAG_PATH, "exinfo_token");
     (void)xs_unwatch(phandle, DISABLE_EXINFO_PATH, "exinfo_token");
+    (void)xs_unwatch(phandle, COLLECT_INTERVAL_PATH, "0");
+    (void)xs_unwatch(phandle, MEM_ONLINE_ZONE_PATH, "0");
     /* write cpu hotplug feature if cpu support hotplug */
     iIsHotplug = SetCpuHotplugFeature(phandle);
     if (iIsHotplug == XEN_SUCC)
@@ -710,38 +753,24 @@ void write_vmstate_flag(void *phandle, char *vm_state)
 }
 /*****************************************************************************
 Function   : do_unplugdisk
- Description:
+ Description: umount the disk named by the unplug-disk key before it goes
  Input      : handle -- xenstore file handle
+              path   -- the watched path
+              value  -- the disk name
  Output     : None
  Return     : None
 *****************************************************************************/
-void *do_unplugdisk(void* handle)
+static void do_unplugdisk(void *handle, const char *path, const char *value)
 {
     char  pszCommand[SHELL_BUFFER] = {0};
-    char  chUnplugPath[SHELL_BUFFER] = {0};
-    char  *pchUnplugDiskName = NULL;
-    //int iRet = -1;
-    char pszBuff[SHELL_BUFFER] = {0};
-    (void)memset(chUnplugPath, 0, SHELL_BUFFER);
-    (void)snprintf(chUnplugPath, sizeof(chUnplugPath), "%s", UVP_UNPLUG_DISK);
-    pchUnplugDiskName = read_from_xenstore(handle, chUnplugPath);
-    if (NULL != pchUnplugDiskName && strstr(pchUnplugDiskName, "xvd") != NULL)
-    {
-        (void)memset(pszCommand, 0, SHELL_BUFFER);
-        (void)memset(pszBuff, 0, SHELL_BUFFER);
-        (void)snprintf(pszCommand, SHELL_BUFFER, "pvumount.sh %s", pchUnplugDiskName);
-        (void)system(pszCommand);
-        /*if (0 != iRet)
-        {
-            ERR_LOG("unplug disk: call uvpPopen pszCommand=%s Fail ret = %d \n", pszCommand, iRet);
-        }*/
-    }
-    if (NULL != pchUnplugDiskName)
+
+    (void)handle;
+    (void)path;
+    if (NULL != value && strstr(value, "xvd") != NULL)
     {
-        free(pchUnplugDiskName);
-        pchUnplugDiskName = NULL;
+        (void)snprintf(pszCommand, SHELL_BUFFER, "pvumount.sh %s", value);
+        (void)system(pszCommand);
     }
-    return pchUnplugDiskName;
 }
 /*****************************************************************************
  Function   : SetScsiFeature
@@ -815,6 +844,7 @@ void do_watch_functions(void *handle)
 {
     if(!g_disable_exinfo_value)
     {
+        xenstore_batch_begin();
     	if(1 == g_netinfo_value)
     		NetinfoNetworkctlmon( handle );
     	else
@@ -824,35 +854,10 @@ void do_watch_functions(void *handle)
         (void)hostnameworkctlmon( handle );
         if (ERROR == cpuworkctlmon( handle ))
         {
-            write_to_xenstore(handle, CPU_DATA_PATH, "error");
+            write_perf_to_xenstore(handle, CPU_DATA_PATH, "error", xb_write_first_flag);
         }
-    }
-    return;
-}
-
-void do_watch_functions_delay(void *handle)
-{
-    static unsigned int i = 0;
-
-    (void)sleep(5);
-    if( !g_disable_exinfo_value )
-    {
-      if(1 == g_netinfo_value)
-      	  NetinfoNetworkctlmon(handle);
-      else
-      	  networkctlmon( handle );
-      (void)memoryworkctlmon( handle );
-      i++;
-      if ( 6 == i)
-      {
-          (void)diskworkctlmon( handle );
-          (void)hostnameworkctlmon( handle );
-          if (ERROR == cpuworkctlmon( handle ))
-          {
-            write_to_xenstore(handle, CPU_DATA_PATH, "error");
-          }
-          i = 0;
-      }
+        perfbin_publish(handle);
+        xenstore_batch_commit(handle);
     }
     return;
 }
@@ -875,34 +880,6 @@ Return     : None
 }*/
 
 
-/*****************************************************************************
-Function   : watch_listen
-Description: 豸select¼
-Input       :xsfd : ļ
-Output     : None
-Return     : SUCC : 5ڶȡtrue
-*****************************************************************************/
-int watch_listen(int xsfd)
-{
-    fd_set   set;
-    struct timeval tv = {.tv_sec = 5, .tv_usec = 0};
-
-	/*lint -e530 */
-    FD_ZERO(&set);
-    FD_SET((unsigned int)xsfd, (fd_set *)&set);
-	/*lint +e530 */
-
-    /* selectֵҪ1 */
-    if ((select((unsigned int)(xsfd + 1), &set, NULL, NULL, &tv) > 0 )
-            && FD_ISSET((unsigned int)xsfd, &set))
-    {
-        return SUCC;
-    }
-
-    return ERROR;
-
-}
-
 /*****************************************************************************
 Function   : condition
 Description: whileѭж
@@ -944,7 +921,8 @@ void IsSupportStorageSnapshotcheck (void *handle)
 
 /*****************************************************************************
  Function   : timing_monitor
- Description: watch domU's extended-information per 5 seconds
+ Description: write domU's extended-information once, then hand the
+              collectors over to the interval scheduler
  Input      : handle -- xenstore file handle
  Output     : None
  Return     : None
@@ -955,10 +933,18 @@ void *timing_monitor(void *handle)
 	char  UpgradeOldVerInfo[VER_SIZE]= {0};
 	FILE  *UpgradeOldVerFile = NULL;
 
+    /* the collectors keep a connection of their own, apart from the watch loop */
+    handle = xenstore_pool_get(handle);
+
     (void)sleep(5);
     InitBond();
     (void)netbond();
 
+    /* before the first cycle, so its record already goes to the ring */
+    (void)metricring_open(handle);
+    /* cycles are published without waiting for xenstore replies */
+    (void)xenstore_async_start();
+
     //һдxentoreдɹ
     xb_write_first_flag = 0;
     do_watch_functions(handle);
@@ -1015,10 +1001,8 @@ void *timing_monitor(void *handle)
         write_pvops_flag(handle, "1");
     }
 
-    while(SUCC == condition())
-    {
-        do_watch_functions_delay(handle);
-    }
+    collect_scheduler_run(handle);
+    xenstore_pool_put(handle);
     return NULL;
 }
 
@@ -1308,9 +1292,10 @@ void *do_time_thaw(void *arg)
     rev_arg = (struct Freezearg *)arg;
 
     mounts = rev_arg->mounts;
-    handle = rev_arg->handle;
     (void)sleep(10);
+    handle = xenstore_pool_get(rev_arg->handle);
     do_cache_thaw(handle, mounts);
+    xenstore_pool_put(handle);
     if(arg)
     {
         free(arg);
@@ -1345,6 +1330,7 @@ int wait_for_thaw(void *handle, FsMountList *mounts)
     }
     pthread_attr_init (&attr);
     pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    footprint_thread_attr(&attr);
     arg->handle = handle;
     arg->mounts = mounts;
 
@@ -1373,8 +1359,11 @@ void *write_heartbeat(void *handle)
     //ñ־λʾд߳
     heartbeat_thread_exist_flag = 1;
     char heartbeat[HEART_BEAT_BUF_LEN] = {0};
+    /* a write behind a busy watch loop would make the heartbeat late */
+    handle = xenstore_pool_get(handle);
     while( 0 < heartbeatrate)
     {
+        handle = xenstore_pool_renew(handle);
         if (9999 > heartbeatnum)
         {
             heartbeatnum = heartbeatnum + 1;
@@ -1396,6 +1385,7 @@ void *write_heartbeat(void *handle)
 
         (void)sleep(heartbeatrate);
     }
+    xenstore_pool_put(handle);
 
     heartbeat_thread_exist_flag = 0;
     (void)pthread_mutex_unlock(&heartbeat_mutex);
@@ -1420,6 +1410,7 @@ int create_write_heartbeat_thread(void *handle)
 
    (void)pthread_attr_init (&attr);
    (void)pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    footprint_thread_attr(&attr);
 
     thread = pthread_create(&thread_id, &attr, write_heartbeat, handle);
     if (strcmp(strerror(thread), "Success") != 0)
@@ -1486,6 +1477,10 @@ void do_complete_restore_watch(void *handle)
     char  hib_migrate[SHELL_BUFFER] = {0};
     char  *hib_migrate_buffer = "cat /etc/.uvp-monitor/hibernate_migrate_flag.ini";
 
+    /* the xenstore tree may be new after migration, rewrite every perf key */
+    xenstore_write_cache_flush();
+    /* the new host has not seen the ring advertisement */
+    metricring_advertise(handle);
     /*set ipv6 info value*/
     set_netinfo_flag(handle);
     /* ֧һԿд־λ */
@@ -1688,28 +1683,35 @@ static int uvpexecl(const char* pszCmd)
     return nRet;
 }
 
-void *do_guestcmd_watch(void *handle)
+/*****************************************************************************
+Function   : do_guestcmd_watch
+Description: run the guest command written to OS_CMD_XS_PATH and report its
+             result; runs on the watch worker
+Input      : handle    -- xenstore handle
+             path      -- the watched path
+             guest_cmd -- the command
+Output     : None
+Return     : None
+*****************************************************************************/
+static void do_guestcmd_watch(void *handle, const char *path, const char *guest_cmd)
 {
     char *pchCmdType=NULL;
     char *pchFileName=NULL;
     char *pchPara=NULL;
-    char *guest_cmd = NULL;
     char chCmdStr[BUFFER_SIZE]={0};
     char pszCommand[SHELL_BUFFER] = {0};
     int  iRet = 0;   
     
-    guest_cmd = read_from_xenstore(handle, OS_CMD_XS_PATH);
+    (void)path;
     /* ֵΪʱִ */
     if( NULL == guest_cmd )
     {
         ERR_LOG("read_from_xenstore error, guest_cmd is NULL.");
-        return NULL;
+        return;
     }
     if( !strcmp(guest_cmd, " "))
     {
-        free(guest_cmd);
-        guest_cmd = NULL;
-        return NULL;
+        return;
     }  
     /* ɾϢ*/
     write_to_xenstore(handle, OS_CMD_XS_PATH, " ");   
@@ -1738,13 +1740,6 @@ void *do_guestcmd_watch(void *handle)
         (void)snprintf_s(chret, BUFFER_SIZE, BUFFER_SIZE, "%d", iRet);
         write_to_xenstore(handle, CMD_RESULT_XS_PATH, chret);
     }
-    
-    if(NULL != guest_cmd)
-    {
-        free(guest_cmd);
-        guest_cmd = NULL;
-    }
-    return NULL;
 }
 
 int CheckArg(char* chCmdStr, char** pchCmdType, char** pchFileName, 
@@ -1858,234 +1853,232 @@ int CheckArg(char* chCmdStr, char** pchCmdType, char** pchFileName,
     return ARG_CHECK_OK;
 }
 
+/* Ϊdo_watch_procиwatchֵĴwatch_table_setupע */
+static void watch_static_info(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    write_to_xenstore(handle, UVP_TOOLS_FLAG, "1");
+    set_tools_version(handle);
+    SetPvDriverVer(handle);
+    write_tools_result(handle);
+
+    //ԭ̬ѯ̬Ϣֻڿʱдһ
+    (void)SetCpuHotplugFeature(handle);
+    SetScsiFeature(handle);
+}
+
+static void watch_mountiso(void *handle, const char *path, const char *value)
+{
+    if (NULL != value)
+    {
+        doUpgrade(handle, (char *)path);
+    }
+}
+
+static void watch_cpu_hotplug(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    do_cpu_hotplug_watch(handle);
+}
+
+static void watch_complete_restore(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    do_complete_restore_watch(handle);
+}
+
+static void watch_driver_resume(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    do_driver_resume_watch(handle);
+}
+
+static void watch_migrate_flag(void *handle, const char *path, const char *value)
+{
+    (void)handle;
+    (void)path;
+    if ((NULL != value) && (0 == strcmp(value, "1")))
+    {
+        hibernate_migrate_flag = 1;
+
+         /* ñmonitorʧЧдļ  */
+        (void)deal_hib_migrate_flag_file(hibernate_migrate_flag);
+    }
+}
+
+/*before hot-migrate*/
+static void watch_release_bond(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    if ((NULL != value) && (0 == strcmp(value, "1")))
+    {
+        (void)releasenetbond(handle);
+    }
+}
+
+/*after hot-migrate*/
+static void watch_rebond(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    if ((NULL != value) && (0 == strcmp(value, "1")))
+    {
+        (void)rebondnet(handle);
+    }
+}
+
+static void watch_exinfo_flag(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    do_exinfo_flag_watch(handle);
+}
+
+static void watch_disable_exinfo(void *handle, const char *path, const char *value)
+{
+    (void)handle;
+    (void)path;
+    if ((NULL != value) && (value[0] == '0' || value[0] == '1'))
+    {
+        g_disable_exinfo_value = strtol(value, NULL, 10);
+    }
+}
+
+static void watch_collect_interval(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    collect_interval_reload(handle);
+}
+
+static void watch_mem_online_zone(void *handle, const char *path, const char *value)
+{
+    (void)handle;
+    (void)path;
+    memhotplug_set_zone(value);
+}
+
+static void watch_storage_snapshot(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    /* ֵ״̬Ϊ1ʱˢݿ⼰ļϵͳ沢ݿ⼰ļϵͳ */
+    if ((NULL != value) && (0 == strcmp(value, "1")))
+    {
+        write_to_xenstore(handle, IOMIRROR_SNAPSHOT_FLAG, "1");
+        if (guest_cache_freeze(&g_freeze_mounts) < 0)
+        {
+            ERR_LOG("guest_cache_freeze failed!");
+            write_to_xenstore(handle, IOMIRROR_SNAPSHOT_FLAG, "-1");
+            free_fs_mount_list(&g_freeze_mounts);
+        }
+        else
+        {
+            INFO_LOG("guest_cache_freeze success!");
+            write_to_xenstore(handle, STORAGE_SNAPSHOT_FLAG, "2");
+            /* gfreezeflag=1 ʾѾ */
+            gfreezeflag = 1;
+            /* ̵߳ȴ10sԷⶳ */
+            wait_for_thaw(handle, &g_freeze_mounts);
+        }
+    }
+    /* ֵ״̬Ϊ3ʱⶳļϵͳ */
+    if ((NULL != value) && (0 == strcmp(value, "3")))
+    {
+        /* ڶʱȥⶳ */
+        do_cache_thaw(handle, &g_freeze_mounts);
+    }
+}
+
+static void watch_heartbeat_rate(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    (void)value;
+    do_heartbeat_watch(handle);
+}
+
+static void watch_healthcheck(void *handle, const char *path, const char *value)
+{
+    (void)path;
+    if ((NULL != value) && (0 == strcmp(value, "check")))
+    {
+        (void)do_healthcheck(handle);
+    }
+}
+
 /*****************************************************************************
-Function   : do_watch_proc
-Description: watch¼
-Input       :handle : xenstoreľ
+Function   : watch_table_setup
+Description: bind the handlers of the keys watched by uvp_regwatch. The
+             migration and freeze keys are handled in the watch loop; the
+             slow handlers (shell scripts, health check, guest commands) run
+             each on a worker of its own, so they never delay a migration
+             event nor wait behind one another. Disk unplug and guest
+             command events are queued, the others coalesce.
+             The upgrade stays in the loop, it unregisters the watches of the
+             loop's handle.
+Input      : None
 Output     : None
 Return     : None
 *****************************************************************************/
-void do_watch_proc(void *handle)
+static void watch_table_setup(void)
+{
+    (void)watch_table_register(PVDRIVER_STATIC_INFO_PATH, watch_static_info, WATCH_FLAG_WORKER);
+    (void)watch_table_register(UVP_MOUNTISO_PATH, watch_mountiso, WATCH_FLAG_VALUE);
+    (void)watch_table_register(CPU_HOTPLUG_SIGNAL, watch_cpu_hotplug, WATCH_FLAG_WORKER);
+    (void)watch_table_register(COMPLETE_RESTORE, watch_complete_restore, 0);
+    (void)watch_table_register(DRIVER_RESUME_FLAG, watch_driver_resume, 0);
+    (void)watch_table_register(MIGRATE_FLAG, watch_migrate_flag, WATCH_FLAG_VALUE);
+    (void)watch_table_register(RELEASE_BOND, watch_release_bond, WATCH_FLAG_VALUE);
+    (void)watch_table_register(REBOND_SRIOV, watch_rebond, WATCH_FLAG_VALUE);
+    (void)watch_table_register(EXINFO_FLAG_PATH, watch_exinfo_flag, 0);
+    (void)watch_table_register(DISABLE_EXINFO_PATH, watch_disable_exinfo, WATCH_FLAG_VALUE);
+    (void)watch_table_register(COLLECT_INTERVAL_PATH, watch_collect_interval, 0);
+    (void)watch_table_register(MEM_ONLINE_ZONE_PATH, watch_mem_online_zone, WATCH_FLAG_VALUE);
+    (void)watch_table_register(STORAGE_SNAPSHOT_FLAG, watch_storage_snapshot, WATCH_FLAG_VALUE);
+    (void)watch_table_register(XS_HEART_BEAT_RATE, watch_heartbeat_rate, 0);
+    (void)watch_table_register(UVP_UNPLUG_DISK, do_unplugdisk,
+                               WATCH_FLAG_VALUE | WATCH_FLAG_WORKER | WATCH_FLAG_QUEUE);
+    (void)watch_table_register(HEALTH_CHECK_PATH, watch_healthcheck, WATCH_FLAG_VALUE | WATCH_FLAG_WORKER);
+    (void)watch_table_register(OS_CMD_XS_PATH, do_guestcmd_watch,
+                               WATCH_FLAG_VALUE | WATCH_FLAG_WORKER | WATCH_FLAG_QUEUE);
+}
+
+/* watchϵ¼ѭ */
+static void monitor_watch_event(int fd, void *handle)
 {
     char  **vec;
-    int   xsfd = -1;
-    char  pszCommand[SHELL_BUFFER] = {0};
-    char  pszCommand_mig[100] = {0};
-    char  *migrate_start = NULL;
-    char  *release_bond = NULL;
-    char  *rebond = NULL;
-    char  *upgradeflag = NULL;
-    char  *disableInfo_flag = NULL;
-    char  *healthstate = NULL;
-    char  *storage_snapshot_flag = NULL;
-    FsMountList mounts;
-    QTAILQ_INIT(&mounts);
-
-    pthread_t th_watch = 0;
-    int iThread = -1;
-    pthread_attr_t attr;
 
-    xsfd = getxsfileno(handle);
-    if ((int) - 1 == xsfd)
+    (void)fd;
+    vec = readWatch(handle);
+    if (!vec)
     {
         return;
     }
+    watch_table_dispatch(handle, vec[XS_WATCH_PATH]);
+    free(vec);
+    vec = NULL;
+}
 
-    while (SUCC == condition())
-    {
-        if (SUCC == watch_listen(xsfd))
-        {
-            vec = readWatch(handle);
-            if (!vec)
-            {
-                continue;
-            }
-
-            if (strstr(*vec, PVDRIVER_STATIC_INFO_PATH))
-            {
-                write_to_xenstore(handle, UVP_TOOLS_FLAG, "1");
-                set_tools_version(handle);
-                SetPvDriverVer(handle);
-                write_tools_result(handle);
-
-                //ԭ̬ѯ̬Ϣֻڿʱдһ
-                (void)SetCpuHotplugFeature(handle);
-                SetScsiFeature(handle);
-            }
-            else if (strstr(*vec, UVP_MOUNTISO_PATH))
-            {
-            	upgradeflag = read_from_xenstore(handle, UVP_MOUNTISO_PATH);
-			    if(NULL != upgradeflag)
-				{
-					free(upgradeflag);
-				    doUpgrade(handle, vec[XS_WATCH_PATH]);
-				}
-            }
-            else if (NULL != strstr(*vec, CPU_HOTPLUG_SIGNAL))
-            {
-                do_cpu_hotplug_watch(handle);
-            }
-            else if ( NULL != strstr(*vec, COMPLETE_RESTORE))
-            {
-                do_complete_restore_watch(handle);
-            }
-            else if ( NULL != strstr(*vec, DRIVER_RESUME_FLAG))
-            {
-                do_driver_resume_watch(handle);
-            }
-            else if ( NULL != strstr(*vec, MIGRATE_FLAG))
-            {
-                (void)memset_s(pszCommand_mig, 100, 0, 100);
-                (void)snprintf_s(pszCommand_mig, sizeof(pszCommand_mig), sizeof(pszCommand_mig), "%s", MIGRATE_FLAG);
-                migrate_start = read_from_xenstore(handle, pszCommand_mig);
-                if((NULL != migrate_start) && (0 == strcmp(migrate_start, "1")))
-                {
-                    hibernate_migrate_flag = 1;
-
-                     /* ñmonitorʧЧдļ  */
-                    (void)deal_hib_migrate_flag_file(hibernate_migrate_flag);
-                }
-                if(NULL != migrate_start)
-                {
-                    free(migrate_start);
-                }
-            }
-            /*before hot-migrate*/
-            else if ( NULL != strstr(*vec, RELEASE_BOND))
-            {
-                //Ϊעwacth  ʱһΣΪ˷ֹ monitor ʱִжÿִ֮Ҫ
-                // xenstore ļֵֹʱ˶
-                (void)memset_s(pszCommand_mig, 100, 0, 100);
-                (void)snprintf_s(pszCommand_mig, sizeof(pszCommand_mig), sizeof(pszCommand_mig), "%s", RELEASE_BOND);
-                release_bond = read_from_xenstore(handle, pszCommand_mig);
-                if((NULL != release_bond) && (0 == strcmp(release_bond, "1")))
-                {
-                    (void)releasenetbond(handle);
-                }
-                if(NULL != release_bond)
-                {
-                    free(release_bond);
-                }
-            }
-            /*after hot-migrate*/
-            else if ( NULL != strstr(*vec, REBOND_SRIOV))
-            {
-                (void)memset_s(pszCommand_mig, 100, 0, 100);
-                (void)snprintf_s(pszCommand_mig, sizeof(pszCommand_mig), sizeof(pszCommand_mig), "%s", REBOND_SRIOV);
-                rebond = read_from_xenstore(handle, pszCommand_mig);
-                if((NULL != rebond) && (0 == strcmp(rebond, "1")))
-                {
-                    (void)rebondnet(handle);
-                }
-                if(NULL != rebond)
-                {
-                    free(rebond);
-                }
-            }
-            else if ( NULL != strstr(*vec, EXINFO_FLAG_PATH))
-            {
-                do_exinfo_flag_watch(handle);
-            }
-            else if (NULL != strstr(*vec, DISABLE_EXINFO_PATH))
-            {
-                (void)memset_s(pszCommand_mig, 100, 0, 100);
-                (void)snprintf_s(pszCommand_mig, sizeof(pszCommand_mig), sizeof(pszCommand_mig), "%s", DISABLE_EXINFO_PATH);
-                disableInfo_flag = read_from_xenstore(handle, pszCommand_mig);
-                if ((NULL != disableInfo_flag) && (disableInfo_flag[0] == '0' || disableInfo_flag[0] == '1'))
-                {
-                    g_disable_exinfo_value = strtol(disableInfo_flag, NULL, 10);
-                }
-                if (NULL != disableInfo_flag)
-                {
-                    free(disableInfo_flag);
-                    disableInfo_flag = NULL;
-                }
-            }
-            else if (NULL != strstr(*vec, STORAGE_SNAPSHOT_FLAG))
-            {
-                (void)snprintf_s(pszCommand_mig, sizeof(pszCommand_mig), sizeof(pszCommand_mig), "%s", STORAGE_SNAPSHOT_FLAG);
-                storage_snapshot_flag = read_from_xenstore(handle, pszCommand_mig);
-                /* ֵ״̬Ϊ1ʱˢݿ⼰ļϵͳ沢ݿ⼰ļϵͳ */
-                if ((NULL != storage_snapshot_flag) && (0 == strcmp(storage_snapshot_flag, "1")))
-                {
-                    write_to_xenstore(handle, IOMIRROR_SNAPSHOT_FLAG, "1");
-                    if (guest_cache_freeze(&mounts) < 0)
-                    {
-                        ERR_LOG("guest_cache_freeze failed!");
-                        write_to_xenstore(handle, IOMIRROR_SNAPSHOT_FLAG, "-1");
-                        free_fs_mount_list(&mounts);
-                    }
-                    else
-                    {
-                        INFO_LOG("guest_cache_freeze success!");
-                        write_to_xenstore(handle, STORAGE_SNAPSHOT_FLAG, "2");
-                        /* gfreezeflag=1 ʾѾ */
-                        gfreezeflag = 1;
-                        /* ̵߳ȴ10sԷⶳ */
-                        wait_for_thaw(handle, &mounts);
-                    }
-                }
-                /* ֵ״̬Ϊ3ʱⶳļϵͳ */
-                if ((NULL != storage_snapshot_flag) && (0 == strcmp(storage_snapshot_flag, "3")))
-                {
-                    /* ڶʱȥⶳ */
-                    do_cache_thaw(handle, &mounts);
-                }
-                if ( NULL != storage_snapshot_flag )
-                {
-                    free(storage_snapshot_flag);
-                }
-            }
-            else if (NULL != strstr(*vec, XS_HEART_BEAT_RATE))
-            {
-                do_heartbeat_watch(handle);
-            }
-            else if (NULL != strstr(*vec, UVP_UNPLUG_DISK))
-            {
-                 pthread_attr_init (&attr);
-                 pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-                 iThread = pthread_create(&th_watch, &attr, do_unplugdisk, (void*)handle);
-                 if (strcmp(strerror(iThread), "Success") != 0)
-                 {
-                    pthread_attr_destroy (&attr);
-                    ERR_LOG("Unplug disk thread create failed!");
-                 }
-                 pthread_attr_destroy (&attr);
-            }
-            else if (NULL != strstr(*vec, HEALTH_CHECK_PATH))
-            {
-            	(void)memset_s(pszCommand, SHELL_BUFFER, 0, SHELL_BUFFER);
-                (void)snprintf_s(pszCommand, sizeof(pszCommand), sizeof(pszCommand), "%s", HEALTH_CHECK_PATH);
+/*****************************************************************************
+Function   : do_watch_proc
+Description: watch¼watchӼѭ
+Input       :handle : xenstoreľ
+Output     : None
+Return     : SUCC or ERROR
+*****************************************************************************/
+int do_watch_proc(void *handle)
+{
+    int   xsfd = -1;
 
-                healthstate = read_from_xenstore(handle, pszCommand);
-                if((NULL != healthstate) && (0 == strcmp(healthstate, "check")))
-                {
-                    (void)do_healthcheck(handle);
-                }
-                if( NULL != healthstate )
-                {
-                    free(healthstate);
-                }
-            }
-            else if ( NULL != strstr(*vec, OS_CMD_XS_PATH))
-            {
-                (void)pthread_attr_init (&attr);
-                (void)pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
-                iThread = pthread_create(&th_watch, &attr, do_guestcmd_watch, (void*)handle);
-                if (strcmp(strerror(iThread), "Success") != 0)
-                {
-                   (void)pthread_attr_destroy (&attr);
-                   ERR_LOG("Create guestcmd thread failed!");
-                }
-                (void)pthread_attr_destroy (&attr);
-            }
-            free(vec);
-            vec = NULL;
-        }
+    xsfd = getxsfileno(handle);
+    if ((int) - 1 == xsfd)
+    {
+        return ERROR;
     }
-    close(xsfd);
-    return ;
-
+    watch_table_setup();
+    return reactor_add(&g_monitor_reactor, xsfd, monitor_watch_event, handle);
 }
 
 /*****************************************************************************
@@ -2112,92 +2105,61 @@ Function   : do_deamon_model
 Description: عģ飬watch¼
 Input       :None
 Output     : None
-Return     : None
+Return     : SUCC or ERROR
 *****************************************************************************/
-void do_deamon_model(void *handle)
+int do_deamon_model(void *handle)
 {
     /* עܼصwatch */
     uvp_regwatch(handle);
     /* дpvdriver־ */
     //write_service_flag(handle, "true");
     /* ȡܼ */
-    do_watch_proc(handle);
-    /* ͷxenstore */
-    ReleaseEnvironment(handle);
+    return do_watch_proc(handle);
 }
 
-
-/*****************************************************************************
-Function   : do_monitoring
-Description:ܼ
-Input       :handle xenstore
-Return     : None
-*****************************************************************************/
-void *do_monitoring(void *handle)
+/* monitorǰٴͨwatch */
+static void tools_watch_release(void)
 {
-    if (NULL == handle)
+    if (NULL == g_tools_handle || g_monitor_restart_value != 1)
     {
-        return NULL;
+        return;
     }
-
-    /* ģ鴦 */
-    do_deamon_model(handle);
-    return NULL;
+    INFO_LOG("Condition upgrade pv unwatch.");
+    (void)xs_unwatch(g_tools_handle, UVP_VERSION_INFO , "uvptoken");
+    (void)xs_unwatch(g_tools_handle, UVP_TIP_MESSAGE , "uvptoken");
+    reactor_del(&g_monitor_reactor, getxsfileno(g_tools_handle));
+    xs_daemon_close(g_tools_handle);
+    g_tools_handle = NULL;
 }
+
 /*****************************************************************************
 Function   : do_tools_watch_proc
-Description: watch¼
-Input       :handle : xenstoreľ
+Description: ͨwatch¼ѭ
+Input       :fd : watch, handle : xenstoreľ
 Output     : None
 Return     : None
 *****************************************************************************/
-void do_tools_watch_proc(void *handle)
+static void do_tools_watch_proc(int fd, void *handle)
 {
     char **toolsvec;
-    int toolsxsfd = -1;
-
-    toolsxsfd = getxsfileno(handle);
 
-    if ((int) - 1 == toolsxsfd)
+    (void)fd;
+    toolsvec = readWatch(handle);
+    if (NULL != toolsvec)
     {
-        return;
-    }
-
-
-    while (SUCC == condition())
-    {
-        if (SUCC == watch_listen(toolsxsfd))
+        if (strstr(*toolsvec, UVP_VERSION_INFO))
         {
-            toolsvec = readWatch(handle);
-            if (!toolsvec)
-            {
-                continue;
-            }
-
-            if (strstr(*toolsvec, UVP_VERSION_INFO))
-            {
-                set_tools_version(handle);
-            }
-            else if (strstr(*toolsvec, UVP_TIP_MESSAGE))
-            {
-                set_tip_message(handle);
-            }
-
-            free(toolsvec);
-            toolsvec = NULL;
-
+            set_tools_version(handle);
         }
-        if(g_monitor_restart_value == 1)
+        else if (strstr(*toolsvec, UVP_TIP_MESSAGE))
         {
-            INFO_LOG("Condition upgrade pv unwatch.");
-            (void)xs_unwatch(handle, UVP_VERSION_INFO , "uvptoken");
-            (void)xs_unwatch(handle, UVP_TIP_MESSAGE , "uvptoken");
-            break;
+            set_tip_message(handle);
         }
-    }
-    close(toolsxsfd);
-    return ;
 
+        free(toolsvec);
+        toolsvec = NULL;
+    }
+    tools_watch_release();
 }
 
 /*****************************************************************************
@@ -2223,17 +2185,17 @@ void do_cp_version_files()
 }
 /*****************************************************************************
 Function   : do_tools_monitoring
-Description: ͨس
-Input       :handle xenstore
+Description: ͨس򣺵xenstoreӣwatchѭ
+Input       :None
 Return     : None
 *****************************************************************************/
-void *do_tools_monitoring(void *arg)
+void do_tools_monitoring(void)
 {
     void *thandle = NULL;
     thandle = openxenstore();
     if (NULL == thandle)
     {
-        return NULL;
+        return;
     }
     (void)regwatch(thandle, UVP_VERSION_INFO , "uvptoken");
 
@@ -2246,13 +2208,117 @@ void *do_tools_monitoring(void *arg)
     /* 汾ŵ/var/run */
     do_cp_version_files();
 
-    do_tools_watch_proc(thandle);
+    if (SUCC != reactor_add(&g_monitor_reactor, getxsfileno(thandle), do_tools_watch_proc, thandle))
+    {
+        xs_daemon_close(thandle);
+        return;
+    }
+    g_tools_handle = thandle;
+}
 
-    xs_daemon_close(thandle);
-//    free(thandle);
+/* ˳ʱܵ˶EOF */
+static void monitor_parent_event(int fd, void *arg)
+{
+    char buf;
+    ssize_t n;
 
-    return NULL;
+    (void)arg;
+    n = read(fd, &buf, 1);
+    if (0 == n || (n < 0 && EINTR != errno && EAGAIN != errno))
+    {
+        g_monitor_stop = MONITOR_STOP_PARENT;
+        reactor_stop(&g_monitor_reactor);
+    }
 }
+
+#ifdef HAVE_SIGNALFD
+static void monitor_signal_event(int fd, void *arg)
+{
+    struct signalfd_siginfo info;
+
+    (void)arg;
+    if (sizeof(info) == read(fd, &info, sizeof(info)) && SIGTERM == info.ssi_signo)
+    {
+        g_monitor_stop = MONITOR_STOP_TERM;
+        reactor_stop(&g_monitor_reactor);
+    }
+}
+#endif
+
+/* signalfdʱԭSIGTERM */
+static void monitor_ignore_sigterm(sigset_t *sigs)
+{
+    struct sigaction sig;
+
+    /*write monitor-service-flag "false" after stop uvp-monitor service*/
+    memset_s(&sig, sizeof(sig), 0, sizeof(sig));
+    sig.sa_handler= SIG_IGN;
+    sig.sa_flags = SA_RESTART;
+    sigaction(SIGTERM, &sig, NULL);
+    (void)pthread_sigmask(SIG_UNBLOCK, sigs, NULL);
+}
+
+/*****************************************************************************
+Function   : monitor_main_loop
+Description: ӽ̵߳¼ѭxenstore watchͨwatchSIGTERM
+             signalfd͸̹ܵͬһepollдȡԭ
+             do_monitoringdo_tools_monitoring̺߳SIGTERMSIG_IGN
+             ɼԼreactor߳(scheduler.c)Ĳɼ
+             watchforkĸΪӽ̵ĿŹ
+             ؼʾmonitor˳
+Input       :handle : xenstoreľ
+             parentfd : 븸֮ܵĶ
+             sigs : ߳εSIGTERM
+Output     : None
+Return     : None
+*****************************************************************************/
+static void monitor_main_loop(void *handle, int parentfd, sigset_t *sigs)
+{
+#ifdef HAVE_SIGNALFD
+    int sigfd = -1;
+#endif
+
+    if (SUCC != reactor_init(&g_monitor_reactor))
+    {
+        ReleaseEnvironment(handle);
+        exit(1);
+    }
+#ifdef HAVE_SIGNALFD
+    sigfd = signalfd(-1, sigs, SFD_CLOEXEC);
+    if (sigfd < 0 || SUCC != reactor_add(&g_monitor_reactor, sigfd, monitor_signal_event, NULL))
+    {
+        ERR_LOG("Create signalfd failed, errno=%d, ignore SIGTERM.", errno);
+        monitor_ignore_sigterm(sigs);
+    }
+#else
+    monitor_ignore_sigterm(sigs);
+#endif
+    if (SUCC != reactor_add(&g_monitor_reactor, parentfd, monitor_parent_event, NULL)
+        || SUCC != do_deamon_model(handle))
+    {
+        ReleaseEnvironment(handle);
+        exit(1);
+    }
+    do_tools_monitoring();
+
+    (void)reactor_run(&g_monitor_reactor);
+    if (MONITOR_STOP_TERM == g_monitor_stop)
+    {
+        INFO_LOG("The uvp-monitor is stopped by SIGTERM.");
+        ReleaseEnvironment(handle);
+        exit(MONITOR_EXIT_TERM);
+    }
+    if (MONITOR_STOP_PARENT == g_monitor_stop)
+    {
+        ERR_LOG("The parent has dead, the uvp-monitor exits.");
+        ReleaseEnvironment(handle);
+        (void)kill(getpid(), SIGKILL);
+    }
+    ERR_LOG("The event loop failed, the uvp-monitor exits.");
+    ReleaseEnvironment(handle);
+    exit(1);
+}
+
 /*****************************************************************************
 Function   : init_daemon
 Description:ӽ̺͸̵Ľڼؽ̱killʱxenstoreд־λ
@@ -2261,16 +2327,14 @@ Return     : None
 void init_daemon()
 {
     int iRet;
-    int iStatus, iThread, tThread, mThread, sThread;
+    int iStatus, mThread, sThread;
     pid_t cpid, wpid;
     pid_t pipes[2];
-    pthread_t pthread_id;
-    pthread_t tthread_id;
     pthread_t mthread_id;
     pthread_attr_t attr;
     char  *timeFlag = NULL;
     pthread_t sthread_id;
-    char buf;
+    sigset_t sigterm;
     void *handle;
     g_disable_exinfo_value = 0;
     g_exinfo_flag_value = 0;
@@ -2299,13 +2363,13 @@ again:
     /*ӽ̵*/
     else if( 0 == cpid )
     {
-        /*write monitor-service-flag "false" after stop uvp-monitor service*/
-        struct sigaction sig;
-        memset_s(&sig, sizeof(sig), 0, sizeof(sig));
-        sig.sa_handler= SIG_IGN;
-        sig.sa_flags = SA_RESTART;
-        sigaction(SIGTERM, &sig, NULL);
-        /*end */
+        /* SIGTERMѭsignalfdգ֮󴴽̶̳߳д */
+        (void)sigemptyset(&sigterm);
+        (void)sigaddset(&sigterm, SIGTERM);
+        (void)pthread_sigmask(SIG_BLOCK, &sigterm, NULL);
+
+        /* ڴеĶѺ߳ջֻӽԤȷ */
+        footprint_init();
 
         handle = openxenstore();
         if (NULL == handle)
@@ -2322,6 +2386,7 @@ again:
 
         pthread_attr_init(&attr);
         pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+        footprint_thread_attr(&attr);
 
 #ifdef NOT_USE_PV_UPGRADE
         write_to_xenstore(handle, XS_NOT_USE_PV_UPGRADE, "true");
@@ -2331,25 +2396,6 @@ again:
         INFO_LOG("Provide UVP tools upgrade ability.");
 #endif
 
-        //do_monitoring߳
-        iThread = pthread_create(&pthread_id, &attr, do_monitoring, (void *)handle);
-        if (strcmp(strerror(iThread), "Success") != 0)
-        {
-            DEBUG_LOG("Create do_monitoring fail, iThread=%d.", iThread);
-            pthread_attr_destroy (&attr);
-            exit(1);
-        }
-
-        //do_tools_monitoring߳
-        tThread = pthread_create(&tthread_id, &attr, do_tools_monitoring, NULL);
-
-        if (strcmp(strerror(tThread), "Success") != 0)
-        {
-            DEBUG_LOG("Create do_tools_monitoring fail, tThread=%d.", tThread);
-            pthread_attr_destroy (&attr);
-            exit(1);
-        }
-
         //¿߳ڶʱ5xenstoreдϵͳչϢ
         mThread = pthread_create(&mthread_id, &attr, timing_monitor, (void *)handle);
         if (strcmp(strerror(mThread), "Success") != 0)
@@ -2364,21 +2410,12 @@ again:
             }
         }
         pthread_attr_destroy (&attr);
+        /* ڴȲmonitorֱonlineڴ */
+        (void)memhotplug_start(handle);
         /*رչܵд*/
         close(pipes[1]);
-        iRet = read(pipes[0], &buf, 1);
-
-        if(0 == iRet)
-        {
-            ERR_LOG("The parent has dead, the uvp-monitor exits.");
-            ReleaseEnvironment(handle);
-            (void)kill(getpid(), SIGKILL);
-        }
-        if(g_monitor_restart_value == 1)
-        {
-            ERR_LOG("Upgrade pv free son process handle.");
-            ReleaseEnvironment(handle);
-        }
+        /* watchͨ˳̵߳¼ѭУٷ */
+        monitor_main_loop(handle, pipes[0], &sigterm);
     }
     /*̵*/
     else
@@ -2407,6 +2444,12 @@ wait_again:
         closexenstore(handle);
         handle = NULL;
         close(pipes[1]);
+        if (WIFEXITED(iStatus) && MONITOR_EXIT_TERM == WEXITSTATUS(iStatus))
+        {
+            /* ӽյSIGTERM˳ֹͣ */
+            INFO_LOG("The uvp-monitor %d is stopped, do not restart it.", wpid);
+            exit(0);
+        }
         sleep(1);
         if (WIFEXITED(iStatus))
             ERR_LOG("The uvp-monitor %d exits with status %d.", wpid, WEXITSTATUS(iStatus));
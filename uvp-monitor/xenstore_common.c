@@ -31,8 +31,80 @@
 
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include "xenstore_common.h"
 #include "public_common.h"
+#include "securec.h"
+#include "arena.h"
+#include "xsasync.h"
+
+/* buckets of the last-written value cache used by write_perf_to_xenstore */
+#define XS_CACHE_BUCKETS 64
+/* commits of a batch that may be restarted because of EAGAIN */
+#define XS_BATCH_RETRY   5
+/* longest dir/child/leaf path of read_children_from_xenstore */
+#define XS_CHILD_PATH_LEN 256
+/*
+ * connections kept for the threads besides the watch loop: timing_monitor,
+ * write_heartbeat and the memory hotplug listener hold one for life, the
+ * workers of the five WATCH_FLAG_WORKER keys borrow one per event
+ */
+#define XS_POOL_SIZE     8
+
+typedef struct xs_cache_entry
+{
+    struct xs_cache_entry *next;
+    char   *path;
+    char   *value;
+    size_t  len;
+    time_t  stamp;
+} XS_CACHE_ENTRY;
+
+typedef struct xs_batch_item
+{
+    struct xs_batch_item *next;
+    char   *path;
+    char   *value;
+    size_t  len;
+    int     is_weak;
+    bool    written;
+} XS_BATCH_ITEM;
+
+/* keys staged between xenstore_batch_begin and xenstore_batch_commit */
+typedef struct
+{
+    bool           open;
+    pthread_t      owner;
+    XS_BATCH_ITEM *head;
+    XS_BATCH_ITEM **tail;
+    unsigned int   count;
+    ARENA          arena;
+} XS_BATCH;
+
+static XS_CACHE_ENTRY *g_xs_cache[XS_CACHE_BUCKETS];
+static pthread_mutex_t g_xs_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* bumped by a flush, so a late reply of the async engine does not refill the cache */
+static unsigned long g_xs_cache_gen = 0;
+static XS_BATCH g_xs_batch = {false, 0, NULL, NULL, 0, ARENA_INITIALIZER};
+
+/*
+ * The handle of openxenstore() in the monitor process belongs to the watch
+ * loop. Other threads take a pooled connection, so a slow collector or a
+ * shell command never holds the watch loop behind its requests.
+ */
+typedef struct
+{
+    struct xs_handle *head;
+    bool   busy;
+    bool   broken;
+} XS_POOL_CONN;
+
+static XS_POOL_CONN g_xs_pool[XS_POOL_SIZE];
+static struct xs_handle *g_xs_pool_shared = NULL;
+static pthread_mutex_t g_xs_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool xs_pool_mark_broken(struct xs_handle *head);
 
 static int get_fd_from_handle(struct xs_handle * handle)
 {
@@ -50,16 +122,11 @@ buf  -- Ҫд
 Output     : None
 Return     : None
 *****************************************************************************/
-void write_to_xenstore (void *handle, char *path, char *buf)
+static bool xs_write_once(struct xs_handle *head, char *path, char *buf)
 {
     bool err;
-    struct xs_handle *head;
     int fd_pre = -1, fd_aft = -1;
-    if(NULL == handle || NULL == path || NULL == buf || 0 == strlen(buf))
-    {
-        return ;
-    }
-    head = (struct xs_handle *)handle;
+
     fd_pre = get_fd_from_handle(head);
     err = xs_write(head, XBT_NULL, path, &buf[0], strlen(buf));
     fd_aft = get_fd_from_handle(head);
@@ -67,9 +134,21 @@ void write_to_xenstore (void *handle, char *path, char *buf)
     {
         ERR_LOG("Write %s %s failed, errno is %d, fd_pre is %d, fd_aft is %d.", \
                 path, buf, errno, fd_pre, fd_aft);
+        if (fd_aft < 0)
+        {
+            (void)xs_pool_mark_broken(head);
+        }
     }
-    else
-        return;
+    return err;
+}
+
+void write_to_xenstore (void *handle, char *path, char *buf)
+{
+    if(NULL == handle || NULL == path || NULL == buf || 0 == strlen(buf))
+    {
+        return ;
+    }
+    (void)xs_write_once((struct xs_handle *)handle, path, buf);
 }
 
 /*****************************************************************************
@@ -81,17 +160,12 @@ buf  -- Ҫд
 Output     : None
 Return     : None
 *****************************************************************************/
-void write_weak_to_xenstore (void *handle, char *path, char *buf)
+static bool xs_write_retry(struct xs_handle *head, char *path, char *buf)
 {
     bool ret = 0;
-    struct xs_handle *head;
     int retry_times = 0;
     int fd_pre = -1, fd_aft = -1;
-    if(NULL == handle || NULL == path || NULL == buf || 0 == strlen(buf))
-    {
-        return ;
-    }
-    head = (struct xs_handle *)handle;
+
     fd_pre = get_fd_from_handle(head);
     //дxenstoreʧܽ
     do
@@ -110,10 +184,447 @@ void write_weak_to_xenstore (void *handle, char *path, char *buf)
         fd_aft = get_fd_from_handle(head);
         ERR_LOG("Write %s %s failed, errno is %d, fd_pre is %d, fd_aft is %d.", \
                 path, buf, errno, fd_pre, fd_aft);
+        if (fd_aft < 0)
+        {
+            (void)xs_pool_mark_broken(head);
+        }
+        return false;
+    }
+    return true;
+}
+
+void write_weak_to_xenstore (void *handle, char *path, char *buf)
+{
+    if(NULL == handle || NULL == path || NULL == buf || 0 == strlen(buf))
+    {
+        return ;
+    }
+    (void)xs_write_retry((struct xs_handle *)handle, path, buf);
+}
+
+static unsigned int xs_cache_hash(const char *path)
+{
+    unsigned int hash = 2166136261u;
+
+    while ('\0' != *path)
+    {
+        hash = (hash ^ (unsigned char)*path++) * 16777619u;
+    }
+    return hash % XS_CACHE_BUCKETS;
+}
+
+static time_t xs_cache_now(void)
+{
+    struct timespec ts;
+
+    if (0 != clock_gettime(CLOCK_MONOTONIC, &ts))
+    {
+        return 0;
+    }
+    return ts.tv_sec;
+}
+
+static XS_CACHE_ENTRY **xs_cache_lookup(const char *path)
+{
+    XS_CACHE_ENTRY **pos = &g_xs_cache[xs_cache_hash(path)];
+
+    while (NULL != *pos && 0 != strcmp((*pos)->path, path))
+    {
+        pos = &(*pos)->next;
+    }
+    return pos;
+}
+
+static void xs_cache_free(XS_CACHE_ENTRY *entry)
+{
+    free(entry->path);
+    free(entry->value);
+    free(entry);
+}
+
+/* remember buf as the value of path; on allocation failure the entry is just dropped */
+static void xs_cache_store(const char *path, const char *buf, size_t len, time_t now)
+{
+    XS_CACHE_ENTRY **pos = xs_cache_lookup(path);
+    XS_CACHE_ENTRY *entry = *pos;
+    char *value = NULL;
+
+    value = (char *)malloc(len + 1);
+    if (NULL != value)
+    {
+        (void)memcpy_s(value, len + 1, buf, len + 1);
+    }
+    if (NULL == entry)
+    {
+        if (NULL == value)
+        {
+            return;
+        }
+        entry = (XS_CACHE_ENTRY *)calloc(1, sizeof(XS_CACHE_ENTRY));
+        if (NULL == entry || NULL == (entry->path = strdup(path)))
+        {
+            free(entry);
+            free(value);
+            return;
+        }
+        *pos = entry;
+    }
+    else if (NULL == value)
+    {
+        *pos = entry->next;
+        xs_cache_free(entry);
+        return;
+    }
+    free(entry->value);
+    entry->value = value;
+    entry->len = len;
+    entry->stamp = now;
+}
+
+/* forget the key after a failed write, so that its next value is written */
+static void xs_cache_forget(const char *path)
+{
+    XS_CACHE_ENTRY **pos = xs_cache_lookup(path);
+    XS_CACHE_ENTRY *entry = NULL;
+
+    if (NULL != (entry = *pos))
+    {
+        *pos = entry->next;
+        xs_cache_free(entry);
+    }
+}
+
+static bool xs_cache_fresh(const char *path, const char *buf, size_t len, time_t now)
+{
+    XS_CACHE_ENTRY *entry = *xs_cache_lookup(path);
+
+    return NULL != entry && entry->len == len && 0 == memcmp(entry->value, buf, len)
+           && now - entry->stamp < XS_WRITE_CACHE_REFRESH;
+}
+
+/* stage path=buf in the open batch, the last value of a key wins */
+static void xs_batch_stage(const char *path, const char *buf, size_t len, int is_weak, time_t now)
+{
+    XS_BATCH_ITEM *item = NULL;
+    char *value = NULL;
+
+    for (item = g_xs_batch.head; NULL != item; item = item->next)
+    {
+        if (0 == strcmp(item->path, path))
+        {
+            break;
+        }
+    }
+    if (NULL == item)
+    {
+        if (xs_cache_fresh(path, buf, len, now))
+        {
+            return;
+        }
+        item = (XS_BATCH_ITEM *)arena_alloc(&g_xs_batch.arena, sizeof(XS_BATCH_ITEM));
+        if (NULL == item || NULL == (item->path = (char *)arena_alloc(&g_xs_batch.arena, strlen(path) + 1)))
+        {
+            ERR_LOG("Stage %s failed, no memory.", path);
+            return;
+        }
+        (void)memcpy_s(item->path, strlen(path) + 1, path, strlen(path) + 1);
+        *g_xs_batch.tail = item;
+        g_xs_batch.tail = &item->next;
+        g_xs_batch.count++;
+    }
+    else if (item->len >= len)
+    {
+        value = item->value;
+    }
+    if (NULL == value && NULL == (value = (char *)arena_alloc(&g_xs_batch.arena, len + 1)))
+    {
+        ERR_LOG("Stage %s failed, no memory.", path);
         return;
     }
+    (void)memcpy_s(value, len + 1, buf, len + 1);
+    item->value = value;
+    item->len = len;
+    item->is_weak |= is_weak;
+}
+
+/*****************************************************************************
+Function   : write_perf_to_xenstore
+Description: write a periodically sampled value into xenstore, skipping the
+             write when the same value was the last one handed to xenstore
+             for the key. The value is remembered when the write is issued,
+             not when it is acknowledged, so a change back to an earlier
+             value is never mistaken for a duplicate. A value that has not
+             changed is still rewritten every XS_WRITE_CACHE_REFRESH seconds,
+             and a failed write drops the key from the cache so the next
+             cycle writes it again.
+Input      : handle  -- xenstore handle
+             path    -- the xenstore path
+             buf     -- the value to write
+             is_weak -- retry like write_weak_to_xenstore
+Output     : None
+Return     : None
+*****************************************************************************/
+void write_perf_to_xenstore(void *handle, char *path, char *buf, int is_weak)
+{
+    size_t len = 0;
+    time_t now = 0;
+    bool ret = false;
+
+    if(NULL == handle || NULL == path || NULL == buf || 0 == strlen(buf))
+    {
+        return ;
+    }
+    len = strlen(buf);
+    now = xs_cache_now();
+
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    if (g_xs_batch.open && pthread_equal(g_xs_batch.owner, pthread_self()))
+    {
+        xs_batch_stage(path, buf, len, is_weak, now);
+        (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+        return;
+    }
+    if (xs_cache_fresh(path, buf, len, now))
+    {
+        (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+        return;
+    }
+    xs_cache_store(path, buf, len, now);
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+
+    /* the lock is not held across xs_write, a weak write may sleep between retries */
+    if (is_weak)
+    {
+        ret = xs_write_retry((struct xs_handle *)handle, path, buf);
+    }
     else
+    {
+        ret = xs_write_once((struct xs_handle *)handle, path, buf);
+    }
+
+    if (!ret)
+    {
+        (void)pthread_mutex_lock(&g_xs_cache_mutex);
+        xs_cache_forget(path);
+        (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+    }
+}
+
+/*****************************************************************************
+Function   : xenstore_batch_begin
+Description: start a collection cycle on the calling thread; until
+             xenstore_batch_commit, its write_perf_to_xenstore calls only
+             stage the changed keys. Writes of other threads are not batched.
+Input      : None
+Output     : None
+Return     : None
+*****************************************************************************/
+void xenstore_batch_begin(void)
+{
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    if (!g_xs_batch.open)
+    {
+        g_xs_batch.open = true;
+        g_xs_batch.owner = pthread_self();
+        g_xs_batch.head = NULL;
+        g_xs_batch.tail = &g_xs_batch.head;
+        g_xs_batch.count = 0;
+    }
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+}
+
+/* write every staged key in one transaction, restarted while it ends with EAGAIN */
+static bool xs_batch_transaction(struct xs_handle *head, XS_BATCH_ITEM *items)
+{
+    XS_BATCH_ITEM *item = NULL;
+    xs_transaction_t t;
+    int retry_times;
+
+    for (retry_times = 0; retry_times < XS_BATCH_RETRY; retry_times++)
+    {
+        t = xs_transaction_start(head);
+        if (XBT_NULL == t)
+        {
+            ERR_LOG("Start transaction failed, errno is %d.", errno);
+            return false;
+        }
+        for (item = items; NULL != item; item = item->next)
+        {
+            if (!xs_write(head, t, item->path, item->value, item->len))
+            {
+                ERR_LOG("Write %s in transaction failed, errno is %d.", item->path, errno);
+                (void)xs_transaction_end(head, t, true);
+                return false;
+            }
+        }
+        if (xs_transaction_end(head, t, false))
+        {
+            return true;
+        }
+        if (EAGAIN != errno)
+        {
+            ERR_LOG("End transaction failed, errno is %d.", errno);
+            return false;
+        }
+    }
+    ERR_LOG("Transaction still conflicts after %d tries.", XS_BATCH_RETRY);
+    return false;
+}
+
+/*
+ * called from the async engine once the outcome of a key is known; the value
+ * was cached at submit time, so only a failure has anything to undo
+ */
+static void xs_batch_done(unsigned long tag, const char *path, const char *value,
+                          size_t len, bool written)
+{
+    (void)value;
+    (void)len;
+    if (written)
+    {
         return;
+    }
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    if (tag == g_xs_cache_gen)
+    {
+        xs_cache_forget(path);
+    }
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+}
+
+/* hand the staged keys to the async engine; false when they must be written here */
+static bool xs_batch_submit(XS_BATCH_ITEM *items, unsigned long gen)
+{
+    XS_BATCH_ITEM *item = NULL;
+    XSA_JOB *job = NULL;
+
+    if (!xsasync_ready() || NULL == (job = xsasync_job_new(gen)))
+    {
+        return false;
+    }
+    for (item = items; NULL != item; item = item->next)
+    {
+        if (XEN_SUCC != xsasync_job_add(job, item->path, item->value, item->len, item->is_weak))
+        {
+            xsasync_job_free(job);
+            return false;
+        }
+    }
+    xsasync_submit(job);
+    return true;
+}
+
+/*****************************************************************************
+Function   : xenstore_async_start
+Description: let xenstore_batch_commit hand its keys to the async engine
+             instead of waiting for every reply
+Input      : None
+Output     : None
+Return     : SUCC, or ERROR when commits stay synchronous
+*****************************************************************************/
+int xenstore_async_start(void)
+{
+    return xsasync_start(xs_batch_done);
+}
+
+/*****************************************************************************
+Function   : xenstore_batch_commit
+Description: publish the keys staged since xenstore_batch_begin in a single
+             transaction, so that dom0 sees the whole cycle at once. When the
+             transaction cannot be used the keys are written one by one.
+             With the async engine running the keys are only queued, and
+             the cache learns the outcome from the engine.
+Input      : handle -- xenstore handle
+Output     : None
+Return     : None
+*****************************************************************************/
+void xenstore_batch_commit(void *handle)
+{
+    XS_BATCH_ITEM *items = NULL;
+    XS_BATCH_ITEM *item = NULL;
+    unsigned long gen = 0;
+    time_t now = 0;
+    bool committed = false;
+
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    if (!g_xs_batch.open || !pthread_equal(g_xs_batch.owner, pthread_self()))
+    {
+        (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+        return;
+    }
+    items = g_xs_batch.head;
+    gen = g_xs_cache_gen;
+    /* cache what is about to be written before it can be acknowledged */
+    if (NULL != handle)
+    {
+        now = xs_cache_now();
+        for (item = items; NULL != item; item = item->next)
+        {
+            xs_cache_store(item->path, item->value, item->len, now);
+        }
+    }
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+
+    /*
+     * the batch stays open while it is written, so no other thread can begin
+     * one and allocate from the arena before the reset below
+     */
+    if (NULL != items && NULL != handle && !xs_batch_submit(items, gen))
+    {
+        committed = (1 == g_xs_batch.count)
+                    ? false : xs_batch_transaction((struct xs_handle *)handle, items);
+        for (item = items; NULL != item; item = item->next)
+        {
+            if (committed)
+                item->written = true;
+            else if (item->is_weak)
+                item->written = xs_write_retry((struct xs_handle *)handle, item->path, item->value);
+            else
+                item->written = xs_write_once((struct xs_handle *)handle, item->path, item->value);
+        }
+
+        (void)pthread_mutex_lock(&g_xs_cache_mutex);
+        for (item = items; NULL != item; item = item->next)
+        {
+            if (!item->written && gen == g_xs_cache_gen)
+            {
+                xs_cache_forget(item->path);
+            }
+        }
+        (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+    }
+
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    arena_reset(&g_xs_batch.arena);
+    g_xs_batch.open = false;
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
+}
+
+/*****************************************************************************
+Function   : xenstore_write_cache_flush
+Description: forget every value remembered by write_perf_to_xenstore, so the
+             next cycle rewrites all keys. Called after migration or restore,
+             when the xenstore tree of the domain may have been rebuilt.
+Input      : None
+Output     : None
+Return     : None
+*****************************************************************************/
+void xenstore_write_cache_flush(void)
+{
+    XS_CACHE_ENTRY *entry = NULL;
+    int i;
+
+    (void)pthread_mutex_lock(&g_xs_cache_mutex);
+    g_xs_cache_gen++;
+    for (i = 0; i < XS_CACHE_BUCKETS; i++)
+    {
+        while (NULL != (entry = g_xs_cache[i]))
+        {
+            g_xs_cache[i] = entry->next;
+            xs_cache_free(entry);
+        }
+    }
+    (void)pthread_mutex_unlock(&g_xs_cache_mutex);
 }
 
 /*****************************************************************************
@@ -143,7 +654,8 @@ char *read_from_xenstore (void *handle, char *path)
     {
         ERR_LOG("Read %s failed, errno is %d, fd_pre is %d, fd_aft is %d.", \
                 path, errno, fd_pre, fd_aft);
-        if(fd_aft < 0)
+        /* a pooled connection is replaced, only the watch loop's one is fatal */
+        if(fd_aft < 0 && !xs_pool_mark_broken(head))
         {
             exit(1);
         }
@@ -152,6 +664,75 @@ char *read_from_xenstore (void *handle, char *path)
     return buf;
 }
 
+/*****************************************************************************
+Function   : read_children_from_xenstore
+Description: list dir and read the leaf key of every child, e.g. every
+             cpu/<N>/availability, inside one transaction so that the values
+             are one consistent snapshot; the transaction only reads and is
+             aborted at the end, so it never has to be restarted
+Input      : handle -- xenstore handle
+             dir    -- the parent path
+             leaf   -- the key under each child
+             func   -- called with the child name and its value, NULL when the
+                       child has no such key
+             arg    -- argument of func
+Output     : None
+Return     : number of children, XEN_FAIL if dir cannot be listed
+*****************************************************************************/
+int read_children_from_xenstore(void *handle, const char *dir, const char *leaf,
+                                XS_CHILD_FUNC func, void *arg)
+{
+    struct xs_handle *head = (struct xs_handle *)handle;
+    char path[XS_CHILD_PATH_LEN];
+    char **names = NULL;
+    char *value = NULL;
+    unsigned int num = 0;
+    unsigned int len = 0;
+    unsigned int i;
+    xs_transaction_t t;
+
+    if (NULL == head || NULL == dir || NULL == leaf || NULL == func)
+    {
+        return XEN_FAIL;
+    }
+
+    t = xs_transaction_start(head);
+    names = xs_directory(head, t, dir, &num);
+    if (NULL == names)
+    {
+        if (ENOENT != errno)
+        {
+            ERR_LOG("List %s failed, errno is %d.", dir, errno);
+        }
+        if (XBT_NULL != t)
+        {
+            (void)xs_transaction_end(head, t, true);
+        }
+        /* a pooled connection is replaced, only the watch loop's one is fatal */
+        if (get_fd_from_handle(head) < 0 && !xs_pool_mark_broken(head))
+        {
+            exit(1);
+        }
+        return XEN_FAIL;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        (void)snprintf_s(path, sizeof(path), sizeof(path) - 1, "%s/%s/%s", dir, names[i], leaf);
+        value = (char *)xs_read(head, t, path, &len);
+        func(names[i], value, arg);
+        free(value);
+        value = NULL;
+    }
+    free(names);
+
+    if (XBT_NULL != t)
+    {
+        (void)xs_transaction_end(head, t, true);
+    }
+    return (int)num;
+}
+
 /*****************************************************************************
 Function   : regwatch
 Description: xenstoreעwatch
@@ -219,6 +800,149 @@ void closexenstore(void *handle)
     return;
 }
 
+/* the pool slot of a connection; called with g_xs_pool_mutex held */
+static XS_POOL_CONN *xs_pool_lookup(struct xs_handle *head)
+{
+    int i;
+
+    for (i = 0; i < XS_POOL_SIZE; i++)
+    {
+        if (NULL != head && g_xs_pool[i].head == head)
+        {
+            return &g_xs_pool[i];
+        }
+    }
+    return NULL;
+}
+
+/* true when head is pooled; it is closed once its thread gives it back */
+static bool xs_pool_mark_broken(struct xs_handle *head)
+{
+    XS_POOL_CONN *conn = NULL;
+
+    (void)pthread_mutex_lock(&g_xs_pool_mutex);
+    conn = xs_pool_lookup(head);
+    if (NULL != conn)
+    {
+        conn->broken = true;
+    }
+    (void)pthread_mutex_unlock(&g_xs_pool_mutex);
+    return NULL != conn;
+}
+
+/*****************************************************************************
+Function   : xenstore_pool_get
+Description: take a connection of the pool for the calling thread, opening
+             one when no idle connection is left. With the pool exhausted or
+             xenstore not opening, the thread shares the handle of the
+             watch loop as before.
+Input      : shared -- handle of openxenstore() owned by the watch loop
+Output     : None
+Return     : the connection to use; give it back with xenstore_pool_put
+*****************************************************************************/
+void *xenstore_pool_get(void *shared)
+{
+    XS_POOL_CONN *conn = NULL;
+    int i;
+
+    (void)pthread_mutex_lock(&g_xs_pool_mutex);
+    if (NULL != shared)
+    {
+        g_xs_pool_shared = (struct xs_handle *)shared;
+    }
+    for (i = 0; i < XS_POOL_SIZE; i++)
+    {
+        if (NULL != g_xs_pool[i].head && !g_xs_pool[i].busy && !g_xs_pool[i].broken)
+        {
+            conn = &g_xs_pool[i];
+            break;
+        }
+        if (NULL == conn && NULL == g_xs_pool[i].head)
+        {
+            conn = &g_xs_pool[i];
+        }
+    }
+    if (NULL != conn && NULL == conn->head)
+    {
+        conn->head = (struct xs_handle *)openxenstore();
+        conn->broken = false;
+        if (NULL == conn->head)
+        {
+            ERR_LOG("Open pooled xenstore connection failed, errno=%d.", errno);
+            conn = NULL;
+        }
+    }
+    if (NULL == conn)
+    {
+        (void)pthread_mutex_unlock(&g_xs_pool_mutex);
+        return g_xs_pool_shared;
+    }
+    conn->busy = true;
+    (void)pthread_mutex_unlock(&g_xs_pool_mutex);
+    return conn->head;
+}
+
+/*****************************************************************************
+Function   : xenstore_pool_put
+Description: give a connection of xenstore_pool_get back to the pool; a
+             broken one is closed. The shared handle is left alone.
+Input      : handle -- the connection
+Output     : None
+Return     : None
+*****************************************************************************/
+void xenstore_pool_put(void *handle)
+{
+    XS_POOL_CONN *conn = NULL;
+    struct xs_handle *closing = NULL;
+
+    (void)pthread_mutex_lock(&g_xs_pool_mutex);
+    conn = xs_pool_lookup((struct xs_handle *)handle);
+    if (NULL != conn)
+    {
+        if (conn->broken)
+        {
+            closing = conn->head;
+            conn->head = NULL;
+            conn->broken = false;
+        }
+        conn->busy = false;
+    }
+    (void)pthread_mutex_unlock(&g_xs_pool_mutex);
+
+    if (NULL != closing)
+    {
+        xs_daemon_close(closing);
+    }
+}
+
+/*****************************************************************************
+Function   : xenstore_pool_renew
+Description: for threads that hold a connection for their whole life: swap a
+             broken connection for a new one, where the shared handle used to
+             exit the process
+Input      : handle -- the connection held by the thread
+Output     : None
+Return     : the connection to go on with
+*****************************************************************************/
+void *xenstore_pool_renew(void *handle)
+{
+    XS_POOL_CONN *conn = NULL;
+    bool broken = false;
+
+    (void)pthread_mutex_lock(&g_xs_pool_mutex);
+    conn = xs_pool_lookup((struct xs_handle *)handle);
+    broken = (NULL != conn && conn->broken);
+    (void)pthread_mutex_unlock(&g_xs_pool_mutex);
+
+    if (!broken)
+    {
+        return handle;
+    }
+    INFO_LOG("Pooled xenstore connection broke, open a new one.");
+    xenstore_pool_put(handle);
+    return xenstore_pool_get(NULL);
+}
+
 /*****************************************************************************
 Function   : getxsfileno
 Description: ȡxenstoreļ
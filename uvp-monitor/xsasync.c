@@ -0,0 +1,602 @@
+/*
+ * Asynchronous pipelined xenstore writes on the xenbus device.
+ *
+ * Copyright 2016, Huawei Tech. Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation; or, when distributed
+ * separately from the Linux kernel or incorporated into other
+ * software packages, subject to the following license:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this source file (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+
+
+#include "libxenctl.h"
+#include "public_common.h"
+#include "securec.h"
+#include "xs_wire.h"
+#include "footprint.h"
+#include "xsasync.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#define XSA_WINDOW              32      /* requests in flight on the connection */
+#define XSA_QUEUE_MAX           8       /* jobs waiting for the engine */
+#define XSA_TX_RETRY            5       /* transaction restarts because of EAGAIN */
+#define XSA_RETRY               3       /* resends of a failed weak key */
+#define XSA_BACKOFF_MS          100     /* delay before the first resend, doubled after */
+#define XSA_REPLY_TIMEOUT_MS    5000
+#define XSA_ERR_LEN             16
+#define USEC_PER_MSEC           1000
+#define DECIMAL                 10
+
+typedef struct xsa_req
+{
+    struct xsa_req *next;
+    uint32_t req_id;
+    int      is_weak;
+    bool     pending;       /* to be sent in this pass */
+    bool     inflight;      /* sent, reply not read yet */
+    bool     written;
+    char     err[XSA_ERR_LEN];
+    size_t   path_len;
+    size_t   len;
+    char     data[1];       /* path, nul, value, nul */
+} XSA_REQ;
+
+struct xsa_job
+{
+    struct xsa_job *next;
+    unsigned long tag;
+    XSA_REQ *head;
+    XSA_REQ **tail;
+    unsigned int count;
+};
+
+static int g_xsa_fd = -1;
+static bool g_xsa_started = false;
+static bool g_xsa_ready = false;
+static uint32_t g_xsa_req_id = 0;
+static XSA_DONE_FUNC g_xsa_done = NULL;
+static XSA_JOB *g_xsa_queue = NULL;
+static XSA_JOB **g_xsa_queue_tail = &g_xsa_queue;
+static unsigned int g_xsa_queued = 0;
+static pthread_mutex_t g_xsa_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_xsa_cond = PTHREAD_COND_INITIALIZER;
+/* only the engine thread touches the connection and these buffers */
+static char g_xsa_msg[sizeof(struct xsd_sockmsg) + XENSTORE_PAYLOAD_MAX];
+static char g_xsa_reply[XENSTORE_PAYLOAD_MAX + 1];
+
+static int xsa_connect(void)
+{
+    if (g_xsa_fd >= 0)
+    {
+        return SUCC;
+    }
+    g_xsa_fd = open(XSA_DEV, O_RDWR | O_CLOEXEC);
+    if (g_xsa_fd < 0)
+    {
+        g_xsa_fd = open(XSA_DEV_PROC, O_RDWR | O_CLOEXEC);
+    }
+    return g_xsa_fd < 0 ? ERROR : SUCC;
+}
+
+/* a request without its reply leaves the connection out of step, start over */
+static void xsa_disconnect(void)
+{
+    if (g_xsa_fd >= 0)
+    {
+        (void)close(g_xsa_fd);
+        g_xsa_fd = -1;
+    }
+}
+
+static int xsa_send(uint32_t type, uint32_t req_id, uint32_t tx_id, const char *data, size_t len)
+{
+    struct xsd_sockmsg msg;
+    size_t total = sizeof(msg) + len;
+    size_t done = 0;
+    ssize_t n;
+
+    msg.type = type;
+    msg.req_id = req_id;
+    msg.tx_id = tx_id;
+    msg.len = (uint32_t)len;
+    (void)memcpy_s(g_xsa_msg, sizeof(g_xsa_msg), &msg, sizeof(msg));
+    (void)memcpy_s(g_xsa_msg + sizeof(msg), sizeof(g_xsa_msg) - sizeof(msg), data, len);
+
+    while (done < total)
+    {
+        n = write(g_xsa_fd, g_xsa_msg + done, total - done);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ERR_LOG("Send xenstore request failed, errno=%d.", errno);
+            xsa_disconnect();
+            return ERROR;
+        }
+        done += (size_t)n;
+    }
+    return SUCC;
+}
+
+/* read exactly len bytes, giving up when xenstore stays silent */
+static int xsa_read_full(void *buf, size_t len)
+{
+    struct pollfd pfd;
+    size_t got = 0;
+    ssize_t n;
+    int ret;
+
+    while (got < len)
+    {
+        pfd.fd = g_xsa_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, XSA_REPLY_TIMEOUT_MS);
+        if (ret < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            ERR_LOG("Wait for xenstore reply failed, ret=%d, errno=%d.", ret, errno);
+            return ERROR;
+        }
+        n = read(g_xsa_fd, (char *)buf + got, len - got);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ERR_LOG("Read xenstore reply failed, errno=%d.", errno);
+            return ERROR;
+        }
+        got += (size_t)n;
+    }
+    return SUCC;
+}
+
+/* next reply into msg and g_xsa_reply; watch events are not ours */
+static int xsa_recv(struct xsd_sockmsg *msg)
+{
+    do
+    {
+        if (SUCC != xsa_read_full(msg, sizeof(*msg)) || msg->len > XENSTORE_PAYLOAD_MAX
+            || SUCC != xsa_read_full(g_xsa_reply, msg->len))
+        {
+            xsa_disconnect();
+            return ERROR;
+        }
+        g_xsa_reply[msg->len] = '\0';
+    } while (XS_WATCH_EVENT == msg->type);
+    return SUCC;
+}
+
+/* one request and its reply; the reply type goes to type, its text to g_xsa_reply */
+static int xsa_call(uint32_t msg_type, uint32_t tx_id, const char *data, size_t len, uint32_t *type)
+{
+    struct xsd_sockmsg msg;
+    uint32_t req_id = ++g_xsa_req_id;
+
+    if (SUCC != xsa_send(msg_type, req_id, tx_id, data, len))
+    {
+        return ERROR;
+    }
+    do
+    {
+        if (SUCC != xsa_recv(&msg))
+        {
+            return ERROR;
+        }
+    } while (msg.req_id != req_id);
+    *type = msg.type;
+    return SUCC;
+}
+
+/*****************************************************************************
+Function   : xsa_write_all
+Description: send the XS_WRITE of every pending key back to back, at most
+             XSA_WINDOW in flight, and match the replies by req_id
+Input      : reqs  -- keys of the job
+             tx_id -- transaction of the writes, 0 for none
+Output     : written and err of each pending key
+Return     : SUCC, or ERROR when the connection broke
+*****************************************************************************/
+static int xsa_write_all(XSA_REQ *reqs, uint32_t tx_id)
+{
+    struct xsd_sockmsg msg;
+    XSA_REQ *next = reqs;
+    XSA_REQ *req = NULL;
+    unsigned int inflight = 0;
+
+    for (req = reqs; NULL != req; req = req->next)
+    {
+        req->inflight = false;
+    }
+    for (;;)
+    {
+        for (; NULL != next && inflight < XSA_WINDOW; next = next->next)
+        {
+            if (!next->pending)
+            {
+                continue;
+            }
+            next->req_id = ++g_xsa_req_id;
+            if (SUCC != xsa_send(XS_WRITE, next->req_id, tx_id, next->data,
+                                 next->path_len + 1 + next->len))
+            {
+                return ERROR;
+            }
+            next->inflight = true;
+            inflight++;
+        }
+        if (0 == inflight)
+        {
+            return SUCC;
+        }
+
+        if (SUCC != xsa_recv(&msg))
+        {
+            return ERROR;
+        }
+        for (req = reqs; NULL != req; req = req->next)
+        {
+            if (req->inflight && req->req_id == msg.req_id)
+            {
+                break;
+            }
+        }
+        if (NULL == req)
+        {
+            continue;
+        }
+        req->inflight = false;
+        inflight--;
+        req->written = (XS_ERROR != msg.type);
+        if (!req->written)
+        {
+            (void)strncpy_s(req->err, sizeof(req->err), g_xsa_reply, sizeof(req->err) - 1);
+        }
+    }
+}
+
+static void xsa_reset(XSA_JOB *job)
+{
+    XSA_REQ *req = NULL;
+
+    for (req = job->head; NULL != req; req = req->next)
+    {
+        req->pending = true;
+        req->written = false;
+        (void)strncpy_s(req->err, sizeof(req->err), "EIO", sizeof(req->err) - 1);
+    }
+}
+
+/* write the whole job in one transaction, restarted while it ends with EAGAIN */
+static bool xsa_transaction(XSA_JOB *job)
+{
+    XSA_REQ *req = NULL;
+    XSA_REQ *failed = NULL;
+    uint32_t type = 0;
+    uint32_t tx_id;
+    int retry_times;
+
+    for (retry_times = 0; retry_times < XSA_TX_RETRY; retry_times++)
+    {
+        if (SUCC != xsa_call(XS_TRANSACTION_START, 0, "", 1, &type))
+        {
+            return false;
+        }
+        if (XS_ERROR == type)
+        {
+            ERR_LOG("Start transaction failed, %s.", g_xsa_reply);
+            return false;
+        }
+        tx_id = (uint32_t)strtoul(g_xsa_reply, NULL, DECIMAL);
+
+        xsa_reset(job);
+        if (SUCC != xsa_write_all(job->head, tx_id))
+        {
+            return false;
+        }
+        for (failed = NULL, req = job->head; NULL != req && NULL == failed; req = req->next)
+        {
+            failed = req->written ? NULL : req;
+        }
+        if (SUCC != xsa_call(XS_TRANSACTION_END, tx_id, (NULL == failed) ? "T" : "F", 2, &type))
+        {
+            return false;
+        }
+        if (NULL != failed)
+        {
+            ERR_LOG("Write %s in transaction failed, %s.", failed->data, failed->err);
+            return false;
+        }
+        if (XS_ERROR != type)
+        {
+            return true;
+        }
+        if (0 != strcmp(g_xsa_reply, "EAGAIN"))
+        {
+            ERR_LOG("End transaction failed, %s.", g_xsa_reply);
+            return false;
+        }
+    }
+    ERR_LOG("Transaction still conflicts after %d tries.", XSA_TX_RETRY);
+    return false;
+}
+
+/* write the keys without a transaction, resending failed weak keys with backoff */
+static void xsa_write_plain(XSA_JOB *job)
+{
+    XSA_REQ *req = NULL;
+    unsigned int backoff = XSA_BACKOFF_MS;
+    bool again = false;
+    int tries = 0;
+
+    xsa_reset(job);
+    for (;;)
+    {
+        if (SUCC == xsa_connect())
+        {
+            (void)xsa_write_all(job->head, 0);
+        }
+
+        again = false;
+        for (req = job->head; NULL != req; req = req->next)
+        {
+            req->pending = !req->written && req->is_weak && tries < XSA_RETRY;
+            again |= req->pending;
+        }
+        if (!again)
+        {
+            break;
+        }
+        (void)usleep(backoff * USEC_PER_MSEC);
+        backoff *= 2;
+        tries++;
+    }
+
+    for (req = job->head; NULL != req; req = req->next)
+    {
+        if (!req->written)
+        {
+            ERR_LOG("Write %s %s failed, %s.", req->data, req->data + req->path_len + 1, req->err);
+        }
+    }
+}
+
+static void xsa_report(XSA_JOB *job, bool dropped)
+{
+    XSA_REQ *req = NULL;
+
+    for (req = job->head; NULL != req; req = req->next)
+    {
+        g_xsa_done(job->tag, req->data, req->data + req->path_len + 1, req->len,
+                   !dropped && req->written);
+    }
+}
+
+static void *xsa_engine(void *arg)
+{
+    XSA_JOB *job = NULL;
+
+    (void)arg;
+    for (;;)
+    {
+        (void)pthread_mutex_lock(&g_xsa_mutex);
+        while (NULL == g_xsa_queue)
+        {
+            (void)pthread_cond_wait(&g_xsa_cond, &g_xsa_mutex);
+        }
+        job = g_xsa_queue;
+        g_xsa_queue = job->next;
+        if (NULL == g_xsa_queue)
+        {
+            g_xsa_queue_tail = &g_xsa_queue;
+        }
+        g_xsa_queued--;
+        (void)pthread_mutex_unlock(&g_xsa_mutex);
+
+        if (job->count > 1 && SUCC == xsa_connect() && xsa_transaction(job))
+        {
+            /* committed, written is set for every key */
+        }
+        else
+        {
+            xsa_write_plain(job);
+        }
+        if (SUCC != xsa_connect())
+        {
+            ERR_LOG("Lost the xenbus device, xenstore writes become synchronous.");
+            g_xsa_ready = false;
+        }
+        xsa_report(job, false);
+        xsasync_job_free(job);
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+Function   : xsasync_start
+Description: open the xenbus device and start the engine thread
+Input      : done -- called from the engine thread with the outcome of
+                     every key submitted
+Output     : None
+Return     : SUCC, or ERROR when writes have to stay synchronous
+*****************************************************************************/
+int xsasync_start(XSA_DONE_FUNC done)
+{
+    pthread_attr_t attr;
+    pthread_t thread_id;
+    int ret;
+
+    if (g_xsa_started)
+    {
+        return g_xsa_ready ? SUCC : ERROR;
+    }
+    if (NULL == done || SUCC != xsa_connect())
+    {
+        INFO_LOG("No xenbus device, xenstore writes stay synchronous.");
+        return ERROR;
+    }
+    g_xsa_done = done;
+
+    (void)pthread_attr_init(&attr);
+    (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    footprint_thread_attr(&attr);
+    ret = pthread_create(&thread_id, &attr, xsa_engine, NULL);
+    (void)pthread_attr_destroy(&attr);
+    if (0 != ret)
+    {
+        ERR_LOG("Create xenstore write engine failed, ret=%d.", ret);
+        xsa_disconnect();
+        return ERROR;
+    }
+    g_xsa_started = true;
+    g_xsa_ready = true;
+    return SUCC;
+}
+
+bool xsasync_ready(void)
+{
+    return g_xsa_ready;
+}
+
+XSA_JOB *xsasync_job_new(unsigned long tag)
+{
+    XSA_JOB *job = (XSA_JOB *)malloc(sizeof(XSA_JOB));
+
+    if (NULL == job)
+    {
+        return NULL;
+    }
+    job->next = NULL;
+    job->tag = tag;
+    job->head = NULL;
+    job->tail = &job->head;
+    job->count = 0;
+    return job;
+}
+
+/*****************************************************************************
+Function   : xsasync_job_add
+Description: append path=value to a job, copying both
+Input      : job     -- the job
+             path    -- the xenstore path
+             value   -- the value, len bytes
+             is_weak -- resend when the write fails
+Output     : None
+Return     : SUCC, or ERROR when the key does not fit one request
+*****************************************************************************/
+int xsasync_job_add(XSA_JOB *job, const char *path, const char *value, size_t len, int is_weak)
+{
+    size_t path_len = strlen(path);
+    XSA_REQ *req = NULL;
+
+    if (path_len + 1 + len > XENSTORE_PAYLOAD_MAX)
+    {
+        ERR_LOG("Write %s is too long for one request.", path);
+        return ERROR;
+    }
+    req = (XSA_REQ *)malloc(sizeof(XSA_REQ) + path_len + len + 1);
+    if (NULL == req)
+    {
+        return ERROR;
+    }
+    (void)memset_s(req, sizeof(XSA_REQ), 0, sizeof(XSA_REQ));
+    req->is_weak = is_weak;
+    req->path_len = path_len;
+    req->len = len;
+    (void)memcpy_s(req->data, path_len + 1, path, path_len + 1);
+    (void)memcpy_s(req->data + path_len + 1, len + 1, value, len);
+    req->data[path_len + 1 + len] = '\0';
+
+    *job->tail = req;
+    job->tail = &req->next;
+    job->count++;
+    return SUCC;
+}
+
+void xsasync_job_free(XSA_JOB *job)
+{
+    XSA_REQ *req = NULL;
+
+    if (NULL == job)
+    {
+        return;
+    }
+    while (NULL != (req = job->head))
+    {
+        job->head = req->next;
+        free(req);
+    }
+    free(job);
+}
+
+/*****************************************************************************
+Function   : xsasync_submit
+Description: queue a job for the engine and return at once; the job belongs
+             to the engine from now on. When xenstore falls behind by
+             XSA_QUEUE_MAX jobs the oldest one is dropped and its keys are
+             reported as not written, newer values of them are queued.
+Input      : job -- the job
+Output     : None
+Return     : None
+*****************************************************************************/
+void xsasync_submit(XSA_JOB *job)
+{
+    XSA_JOB *dropped = NULL;
+
+    if (NULL == job)
+    {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_xsa_mutex);
+    if (g_xsa_queued >= XSA_QUEUE_MAX)
+    {
+        dropped = g_xsa_queue;
+        g_xsa_queue = dropped->next;
+        g_xsa_queued--;
+    }
+    job->next = NULL;
+    *g_xsa_queue_tail = job;
+    g_xsa_queue_tail = &job->next;
+    g_xsa_queued++;
+    (void)pthread_cond_signal(&g_xsa_cond);
+    (void)pthread_mutex_unlock(&g_xsa_mutex);
+
+    if (NULL != dropped)
+    {
+        ERR_LOG("xenstore falls behind, drop the %u keys of an old cycle.", dropped->count);
+        xsa_report(dropped, true);
+        xsasync_job_free(dropped);
+    }
+}
@@ -0,0 +1,205 @@
+/*
+ * xen-metrics.c
+ *
+ * Pages shared read-only with dom0 through the grant table, into which
+ * uvp-monitor publishes its metric records. dom0 maps the pages by the
+ * grant references, so reading the metrics costs no xenstore requests.
+ *
+ * /proc/xen/metrics: read() returns the grant references, one per page,
+ * separated by spaces; mmap() maps the pages into the monitor. The layout
+ * of the pages belongs to uvp-monitor, see uvp-monitor/include/metricring.h.
+ *
+ * Copyright (c) 2012, Huawei Technologies Co., Ltd
+ */
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/proc_fs.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <asm/atomic.h>
+#include <asm/uaccess.h>
+#include <asm/xen/page.h>
+#include <xen/grant_table.h>
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Xen metrics shared pages");
+
+/* must match METRIC_RING_PAGES of uvp-monitor */
+#define METRICS_ORDER		2
+#define METRICS_PAGES		(1 << METRICS_ORDER)
+#define METRICS_SIZE		(PAGE_SIZE << METRICS_ORDER)
+#define METRICS_BACKEND_DOMID	0
+#define METRICS_REFS_LEN	64
+
+static unsigned long metrics_area;
+static grant_ref_t metrics_refs[METRICS_PAGES];
+static int metrics_granted;
+static struct proc_dir_entry *proc_entry;
+static const char *proc_name;
+/* the module's own reference plus one per mapping of the pages */
+static atomic_t metrics_users = ATOMIC_INIT(0);
+
+static void xen_metrics_release(void);
+
+static void xen_metrics_put(void)
+{
+	if (atomic_dec_and_test(&metrics_users))
+		xen_metrics_release();
+}
+
+static ssize_t xen_metrics_read(struct file *filp, char __user *ubuf,
+				size_t len, loff_t *ppos)
+{
+	char refs[METRICS_REFS_LEN];
+	int i, n = 0;
+
+	for (i = 0; i < METRICS_PAGES; i++)
+		n += snprintf(refs + n, sizeof(refs) - n, "%s%u",
+			      i ? " " : "", metrics_refs[i]);
+	n += snprintf(refs + n, sizeof(refs) - n, "\n");
+
+	return simple_read_from_buffer(ubuf, len, ppos, refs, n);
+}
+
+/*
+ * Every mapping holds a reference on the pages and on the module, so
+ * neither goes away before the last munmap(); procfs does not pin the
+ * module for an open file on newer kernels, hence the explicit get.
+ */
+static void xen_metrics_vm_open(struct vm_area_struct *vma)
+{
+	__module_get(THIS_MODULE);
+	atomic_inc(&metrics_users);
+}
+
+static void xen_metrics_vm_close(struct vm_area_struct *vma)
+{
+	xen_metrics_put();
+	module_put(THIS_MODULE);
+}
+
+static const struct vm_operations_struct xen_metrics_vm_ops = {
+	.open = xen_metrics_vm_open,
+	.close = xen_metrics_vm_close,
+};
+
+static int xen_metrics_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int err;
+
+	if (vma->vm_pgoff != 0 || size > METRICS_SIZE)
+		return -EINVAL;
+
+	err = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys((void *)metrics_area) >> PAGE_SHIFT,
+			      size, vma->vm_page_prot);
+	if (err)
+		return err;
+
+	vma->vm_flags |= VM_DONTEXPAND;
+	vma->vm_ops = &xen_metrics_vm_ops;
+	/* ->open is only called for copies of the vma, not for this one */
+	xen_metrics_vm_open(vma);
+	return 0;
+}
+
+static const struct file_operations xen_metrics_file_ops = {
+	.owner = THIS_MODULE,
+	.read = xen_metrics_read,
+	.mmap = xen_metrics_mmap,
+};
+
+static struct proc_dir_entry *xen_metrics_proc_create(const char *name)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
+	return proc_create(name, 0600, NULL, &xen_metrics_file_ops);
+#else
+	struct proc_dir_entry *entry = create_proc_entry(name, 0600, NULL);
+
+	if (entry != NULL)
+		entry->proc_fops = &xen_metrics_file_ops;
+	return entry;
+#endif
+}
+
+/*
+ * A page dom0 still has mapped cannot be taken back; it is leaked rather
+ * than handed to the allocator while dom0 can read it.
+ */
+static void xen_metrics_release(void)
+{
+	int i, busy = 0;
+
+	for (i = 0; i < metrics_granted; i++) {
+		if (!gnttab_end_foreign_access_ref(metrics_refs[i], 1))
+			busy = 1;
+		else
+			gnttab_free_grant_reference(metrics_refs[i]);
+	}
+	metrics_granted = 0;
+
+	if (busy) {
+		printk(KERN_WARNING "Metrics: pages still mapped by dom0, leaking them.\n");
+		return;
+	}
+	for (i = 0; i < METRICS_PAGES; i++)
+		ClearPageReserved(virt_to_page(metrics_area + i * PAGE_SIZE));
+	free_pages(metrics_area, METRICS_ORDER);
+	metrics_area = 0;
+}
+
+static int xen_metrics_init(void)
+{
+	int i, ref;
+
+	metrics_area = __get_free_pages(GFP_KERNEL | __GFP_ZERO, METRICS_ORDER);
+	if (metrics_area == 0)
+		return -ENOMEM;
+
+	for (i = 0; i < METRICS_PAGES; i++) {
+		/* remap_pfn_range() of older kernels wants reserved pages */
+		SetPageReserved(virt_to_page(metrics_area + i * PAGE_SIZE));
+		ref = gnttab_grant_foreign_access(METRICS_BACKEND_DOMID,
+				virt_to_mfn(metrics_area + i * PAGE_SIZE), 1);
+		if (ref < 0) {
+			printk(KERN_INFO "Metrics: Couldn't grant page %d, err=%d.\n", i, ref);
+			xen_metrics_release();
+			return ref;
+		}
+		metrics_refs[i] = ref;
+		metrics_granted++;
+	}
+
+	/* /proc/xen is missing when neither xen-procfs nor xenfs is loaded */
+	proc_name = "xen/metrics";
+	proc_entry = xen_metrics_proc_create(proc_name);
+	if (proc_entry == NULL) {
+		proc_name = "xen_metrics";
+		proc_entry = xen_metrics_proc_create(proc_name);
+	}
+	if (proc_entry == NULL) {
+		printk(KERN_INFO "Metrics: Couldn't create metrics user-space entry!\n");
+		xen_metrics_release();
+		return -ENOMEM;
+	}
+	atomic_set(&metrics_users, 1);
+
+	printk(KERN_INFO "Metrics: %d pages shared with dom0.\n", METRICS_PAGES);
+	return 0;
+}
+module_init(xen_metrics_init);
+
+static void xen_metrics_exit(void)
+{
+	remove_proc_entry(proc_name, NULL);
+	/* the pages are freed here, or by the last munmap() if still mapped */
+	xen_metrics_put();
+	printk(KERN_INFO "Metrics: shared pages have been released.\n");
+}
+module_exit(xen_metrics_exit);